@@ -1,6 +1,7 @@
 #ifndef RDMA_CACHE_BASE_H
 #define RDMA_CACHE_BASE_H
 
+#include "rdma_cache_metrics.h"
 #include <unordered_map>
 #include <list>
 #include <mutex>
@@ -33,6 +34,8 @@ public:
             }
         } memory_usage;
 
+        // 采样得到的 get 耗时（每线程每 RdmaCacheCounters::kSampleInterval
+        // 次访问计时一次），access_count 为采样次数
         struct AccessTime {
             std::chrono::nanoseconds total_time{0};
             uint64_t access_count = 0;
@@ -41,6 +44,13 @@ public:
                     static_cast<float>(total_time.count()) / access_count : 0.0f; 
             }
         } access_time;
+
+        struct Churn {
+            uint64_t insertions = 0;
+            uint64_t evictions = 0;
+            uint64_t bytes_written = 0;
+            uint64_t bytes_evicted = 0;
+        } churn;
     };
 
     RdmaCacheBase(size_t max_size, CachePolicy policy = CachePolicy::LRU)
@@ -55,21 +65,17 @@ public:
     }
 
     virtual bool get(const KeyType& key, ValueType& value) {
+        // 计时器先于锁构造、后于锁析构，时钟调用不在临界区内
+        RdmaCacheAccessTimer timer(counters_);
         std::lock_guard<std::mutex> lock(mutex_);
         auto it = cache_map_.find(key);
         if (it == cache_map_.end()) {
-            metrics_.hit_rate.misses++;
+            counters_.record_miss();
             return false;
         }
 
-        auto start_time = std::chrono::high_resolution_clock::now();
         value = it->second;
-        auto end_time = std::chrono::high_resolution_clock::now();
-        
-        metrics_.access_time.total_time += (end_time - start_time);
-        metrics_.access_time.access_count++;
-        metrics_.hit_rate.hits++;
-        
+        counters_.record_hit();
         update_access_order(key);
         return true;
     }
@@ -77,20 +83,32 @@ public:
     virtual void put(const KeyType& key, const ValueType& value) {
         std::lock_guard<std::mutex> lock(mutex_);
         size_t value_size = get_value_size(value);
-        
-        // 检查是否需要驱逐
-        while (current_size_ + value_size > max_size_) {
-            evict();
-        }
+        size_t stored_size = get_stored_size(value);
 
-        // 更新或插入新值
+        // 更新或插入新值；覆盖时先扣除旧值，避免为自身驱逐其他条目
         auto it = cache_map_.find(key);
-        if (it != cache_map_.end()) {
+        const bool inserted = it == cache_map_.end();
+        if (!inserted) {
+            size_t old_stored = get_stored_size(it->second);
             current_size_ -= get_value_size(it->second);
+            stored_size_ -= old_stored;
+            counters_.record_release(old_stored);
+            cache_map_.erase(it);
+            access_order_.remove(key);
         }
-        
+
+        // 检查是否需要驱逐
+        while (current_size_ + value_size > max_size_ && evict()) {
+        }
+
         cache_map_[key] = value;
         current_size_ += value_size;
+        stored_size_ += stored_size;
+        if (inserted) {
+            counters_.record_insert(stored_size);
+        } else {
+            counters_.record_write(stored_size, stored_size, 0);
+        }
         update_access_order(key);
     }
 
@@ -98,7 +116,10 @@ public:
         std::lock_guard<std::mutex> lock(mutex_);
         auto it = cache_map_.find(key);
         if (it != cache_map_.end()) {
+            size_t stored = get_stored_size(it->second);
             current_size_ -= get_value_size(it->second);
+            stored_size_ -= stored;
+            counters_.record_release(stored);
             cache_map_.erase(it);
             access_order_.remove(key);
         }
@@ -108,28 +129,50 @@ public:
         std::lock_guard<std::mutex> lock(mutex_);
         cache_map_.clear();
         access_order_.clear();
+        counters_.record_release(stored_size_);
         current_size_ = 0;
-        metrics_ = CacheMetrics();
+        stored_size_ = 0;
+        counters_.reset();
     }
 
     virtual void resize(size_t new_size) {
         std::lock_guard<std::mutex> lock(mutex_);
         max_size_ = new_size;
-        while (current_size_ > max_size_) {
-            evict();
+        while (current_size_ > max_size_ && evict()) {
         }
     }
 
-    // 获取缓存指标
+    // 获取缓存指标；计数部分不需要缓存锁
     virtual CacheMetrics get_metrics() const {
+        RdmaCacheStats stats = counters_.read();
+        CacheMetrics metrics;
+        metrics.hit_rate.hits = stats.hits;
+        metrics.hit_rate.misses = stats.misses;
+        metrics.access_time.total_time =
+            std::chrono::nanoseconds(stats.latency_total_ns);
+        metrics.access_time.access_count = stats.latency_samples;
+        metrics.churn.insertions = stats.insertions;
+        metrics.churn.evictions = stats.evictions;
+        metrics.churn.bytes_written = stats.bytes_written;
+        metrics.churn.bytes_evicted = stats.bytes_evicted;
         std::lock_guard<std::mutex> lock(mutex_);
-        return metrics_;
+        metrics.memory_usage.original_size = current_size_;
+        metrics.memory_usage.compressed_size = stored_size_;
+        return metrics;
     }
 
+    RdmaCacheStats get_stats() const { return counters_.read(); }
+
 protected:
     // 获取值的大小（子类需要实现）
     virtual size_t get_value_size(const ValueType& value) const = 0;
 
+    // 值在缓存中实际占用的大小；压缩存储的子类覆盖此函数，
+    // 默认与 get_value_size 相同
+    virtual size_t get_stored_size(const ValueType& value) const {
+        return get_value_size(value);
+    }
+
     // 更新访问顺序
     void update_access_order(const KeyType& key) {
         if (policy_ == CachePolicy::FIFO) return;
@@ -142,9 +185,9 @@ protected:
         }
     }
 
-    // 驱逐策略
-    void evict() {
-        if (access_order_.empty()) return;
+    // 驱逐策略，没有可驱逐的条目时返回 false
+    bool evict() {
+        if (access_order_.empty()) return false;
         
         KeyType key_to_evict;
         if (policy_ == CachePolicy::LRU || policy_ == CachePolicy::FIFO) {
@@ -157,18 +200,23 @@ protected:
         
         auto it = cache_map_.find(key_to_evict);
         if (it != cache_map_.end()) {
+            size_t stored = get_stored_size(it->second);
             current_size_ -= get_value_size(it->second);
+            stored_size_ -= stored;
+            counters_.record_evict(stored);
             cache_map_.erase(it);
         }
+        return true;
     }
 
     size_t max_size_;
     size_t current_size_;
+    size_t stored_size_ = 0; // 按 get_stored_size 累计
     CachePolicy policy_;
     mutable std::mutex mutex_;
     std::unordered_map<KeyType, ValueType> cache_map_;
     std::list<KeyType> access_order_;
-    CacheMetrics metrics_;
+    RdmaCacheCounters counters_;
 };
 
 #endif // RDMA_CACHE_BASE_H 
\ No newline at end of file
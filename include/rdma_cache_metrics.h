@@ -0,0 +1,145 @@
+#ifndef RDMA_CACHE_METRICS_H
+#define RDMA_CACHE_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+// 缓存统计快照
+struct RdmaCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t insertions = 0;      // 新键写入
+  uint64_t evictions = 0;       // 因容量不足被淘汰的条目
+  uint64_t bytes_written = 0;   // 写入（新增、覆盖、追加）的字节数
+  uint64_t bytes_evicted = 0;   // 被淘汰条目的字节数
+  uint64_t resident_bytes = 0;  // 当前缓存内容占用的字节数
+  uint64_t latency_samples = 0; // 参与计时的访问次数
+  uint64_t latency_total_ns = 0;
+
+  double hit_ratio() const {
+    uint64_t total = hits + misses;
+    return total > 0 ? static_cast<double>(hits) / total : 0.0;
+  }
+  double average_access_ns() const {
+    return latency_samples > 0
+               ? static_cast<double>(latency_total_ns) / latency_samples
+               : 0.0;
+  }
+};
+
+/**
+ * @brief 缓存计数器
+ *
+ * 各项均为 relaxed 原子量，读取不需要缓存锁。访问延迟按线程每
+ * kSampleInterval 次访问采样一次，由 RdmaCacheAccessTimer 在加锁前后
+ * 取时钟，时钟调用不落在临界区内。
+ */
+class RdmaCacheCounters {
+public:
+  static constexpr uint32_t kSampleInterval = 64;
+
+  void record_hit() { hits_.fetch_add(1, std::memory_order_relaxed); }
+  void record_miss() { misses_.fetch_add(1, std::memory_order_relaxed); }
+
+  // 写入新条目
+  void record_insert(size_t bytes) {
+    insertions_.fetch_add(1, std::memory_order_relaxed);
+    record_write(bytes, bytes, 0);
+  }
+  // 覆盖或追加已有条目：written 为写入的字节数，条目大小由 old_bytes
+  // 变为 new_bytes
+  void record_write(size_t written, size_t new_bytes, size_t old_bytes) {
+    bytes_written_.fetch_add(written, std::memory_order_relaxed);
+    resident_bytes_.fetch_add(new_bytes - old_bytes,
+                              std::memory_order_relaxed);
+  }
+  // 因容量不足淘汰条目
+  void record_evict(size_t bytes) {
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+    bytes_evicted_.fetch_add(bytes, std::memory_order_relaxed);
+    resident_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+  // 显式删除条目或取走内容
+  void record_release(size_t bytes) {
+    resident_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+  void record_latency(std::chrono::nanoseconds elapsed) {
+    latency_samples_.fetch_add(1, std::memory_order_relaxed);
+    latency_total_ns_.fetch_add(static_cast<uint64_t>(elapsed.count()),
+                                std::memory_order_relaxed);
+  }
+
+  // 本线程的这次访问是否计时
+  static bool should_sample() {
+    thread_local uint32_t accesses = 0;
+    return ++accesses % kSampleInterval == 0;
+  }
+
+  RdmaCacheStats read() const {
+    RdmaCacheStats stats;
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    stats.insertions = insertions_.load(std::memory_order_relaxed);
+    stats.evictions = evictions_.load(std::memory_order_relaxed);
+    stats.bytes_written = bytes_written_.load(std::memory_order_relaxed);
+    stats.bytes_evicted = bytes_evicted_.load(std::memory_order_relaxed);
+    stats.resident_bytes = resident_bytes_.load(std::memory_order_relaxed);
+    stats.latency_samples = latency_samples_.load(std::memory_order_relaxed);
+    stats.latency_total_ns = latency_total_ns_.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  // 清零访问计数；resident_bytes 反映缓存内容，不受影响
+  void reset() {
+    for (auto *counter : {&hits_, &misses_, &insertions_, &evictions_,
+                          &bytes_written_, &bytes_evicted_, &latency_samples_,
+                          &latency_total_ns_}) {
+      counter->store(0, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<uint64_t> insertions_{0};
+  std::atomic<uint64_t> evictions_{0};
+  std::atomic<uint64_t> bytes_written_{0};
+  std::atomic<uint64_t> bytes_evicted_{0};
+  std::atomic<uint64_t> resident_bytes_{0}; // 无符号回绕，差值始终正确
+  std::atomic<uint64_t> latency_samples_{0};
+  std::atomic<uint64_t> latency_total_ns_{0};
+};
+
+/**
+ * @brief 采样计时一次缓存访问
+ *
+ * 在加缓存锁之前构造、锁释放之后析构（声明在 lock_guard 之前即可），
+ * 测得的是调用方看到的整次访问耗时（含等锁）。未被采样的访问不读时钟。
+ */
+class RdmaCacheAccessTimer {
+public:
+  explicit RdmaCacheAccessTimer(RdmaCacheCounters &counters)
+      : counters_(counters), sampled_(RdmaCacheCounters::should_sample()) {
+    if (sampled_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+  ~RdmaCacheAccessTimer() {
+    if (sampled_) {
+      counters_.record_latency(std::chrono::steady_clock::now() - start_);
+    }
+  }
+
+  RdmaCacheAccessTimer(const RdmaCacheAccessTimer &) = delete;
+  RdmaCacheAccessTimer &operator=(const RdmaCacheAccessTimer &) = delete;
+
+private:
+  RdmaCacheCounters &counters_;
+  bool sampled_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+#endif // RDMA_CACHE_METRICS_H
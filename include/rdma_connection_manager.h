@@ -0,0 +1,158 @@
+#ifndef RDMA_CONNECTION_MANAGER_H
+#define RDMA_CONNECTION_MANAGER_H
+
+#include "rdma_control_plane.h"
+#include "rdma_device.h"
+#include "rdma_types.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 被动端为入站连接创建QP时使用的参数
+struct RdmaCmParams {
+  uint32_t send_cq = 0;
+  uint32_t recv_cq = 0;
+  uint32_t max_send_wr = 64;
+  uint32_t max_recv_wr = 64;
+  uint32_t max_inline_data = 0;
+  uint32_t max_sge = 1;
+};
+
+// 一次建连的结果
+struct RdmaCmConnection {
+  uint64_t id = 0; // 连接编号，用于 disconnect()
+  bool ok = false;
+  std::string error;
+  std::vector<uint32_t> local_qps;  // 本端QP，成功时均已处于 RTS
+  std::vector<QPValue> remote_qps;  // 对端QP描述，与 local_qps 一一对应
+};
+
+// 连接管理器统计
+struct RdmaCmStats {
+  uint64_t established;  // 建立成功的连接数（主动端+被动端）
+  uint64_t failed;       // 主动建连失败数（含被拒绝）
+  uint64_t rejected;     // 被动端拒绝的请求数
+  uint64_t disconnected; // 已建立的连接中被对端断开的数量
+};
+
+/**
+ * @brief 连接管理器（类似 rdma_cm），在控制面之上异步完成整个建连过程
+ *
+ * 主动端 connect() 把本端QP迁移到 INIT 后发出批量连接请求，收到响应后
+ * 连接QP、迁移到 RTR/RTS 并发送 READY，结果通过 future 和回调报告；
+ * 被动端按 RdmaCmParams 为每个请求的QP创建本端QP并迁移到 RTS 后应答，
+ * 收到 READY 时报告连接建立。所有连接共享一个 epoll 事件循环，
+ * 大量连接可以同时进行而不需要每连接一个线程。
+ *
+ * 控制连接在QP连接的生命周期内保持打开：任一端 disconnect() 后，
+ * 对端的QP被迁移到 ERR（在途WQE以 WR_FLUSH_ERR 完成）并收到断开通知。
+ * 主动端的QP始终归调用方所有；被动端创建的QP在连接建立后交给应用，
+ * 建立之前失败或断开时由管理器销毁。
+ */
+class RdmaConnectionManager {
+public:
+  using ConnId = RdmaControlPlane::PeerId;
+  // 回调在事件循环线程中执行，不应阻塞；可以在回调中调用 connect/disconnect
+  using ConnectionHandler = std::function<void(const RdmaCmConnection &)>;
+  using DisconnectHandler = std::function<void(ConnId)>;
+
+  explicit RdmaConnectionManager(RdmaDevice &device);
+  ~RdmaConnectionManager();
+
+  RdmaConnectionManager(const RdmaConnectionManager &) = delete;
+  RdmaConnectionManager &operator=(const RdmaConnectionManager &) = delete;
+
+  /**
+   * @brief 作为被动端监听连接请求，应在 start() 之前调用
+   * @param port 0 表示由系统分配，实际端口由 listen_port() 返回
+   * @param on_established 收到主动端 READY、连接建立时调用
+   */
+  bool listen(uint16_t port, const RdmaCmParams &params,
+              ConnectionHandler on_established,
+              const std::string &ip = "0.0.0.0");
+  uint16_t listen_port() const;
+
+  /**
+   * @brief 设置对端断开已建立连接时的回调，应在 start() 之前调用
+   */
+  void set_disconnect_handler(DisconnectHandler on_disconnect);
+
+  /**
+   * @brief 启动/停止事件循环；停止时所有未完成的主动建连以失败结束
+   */
+  bool start();
+  void stop();
+
+  /**
+   * @brief 把本端QP连接到 ip:port 上的被动端
+   *
+   * 立即返回；本端QP必须处于 RESET，数量为 [1, RDMA_CONTROL_MAX_BATCH]。
+   * 失败（连接不上、被拒绝、控制连接提前关闭）时本端QP被重置为 RESET，
+   * 可以直接用于重试。
+   * @param on_done 完成时在事件循环线程中调用（参数无效等立即失败的情况
+   *        在调用线程中调用），可以为空
+   */
+  std::future<RdmaCmConnection> connect(const std::string &ip, uint16_t port,
+                                        const std::vector<uint32_t> &qps,
+                                        ConnectionHandler on_done = nullptr);
+
+  /**
+   * @brief 断开连接：关闭控制连接并把本端QP迁移到 ERR（不触发本端断开回调）；
+   * 对未完成的主动建连等同于取消，future 以失败结束
+   */
+  void disconnect(ConnId id);
+
+  size_t connection_count() const; // 已建立的连接数
+  size_t pending_count() const;    // 进行中的建连数
+  RdmaCmStats get_stats() const;
+  std::string get_error() const;
+
+private:
+  struct Conn {
+    bool active = false; // 本端发起
+    bool established = false;
+    std::vector<uint32_t> local_qps;
+    std::vector<QPValue> remote_qps;
+    std::promise<RdmaCmConnection> promise; // 主动端
+    ConnectionHandler on_done;              // 主动端
+  };
+
+  RdmaDevice &device_;
+  RdmaControlPlane plane_;
+  RdmaCmParams params_;
+  ConnectionHandler on_established_;
+  DisconnectHandler on_disconnect_;
+
+  mutable std::mutex conns_mutex_;
+  std::unordered_map<ConnId, Conn> conns_;
+  size_t established_count_ = 0; // 受 conns_mutex_ 保护
+
+  mutable std::mutex error_mutex_;
+  std::string error_msg_;
+
+  std::atomic<uint64_t> established_{0};
+  std::atomic<uint64_t> failed_{0};
+  std::atomic<uint64_t> rejected_{0};
+  std::atomic<uint64_t> disconnected_{0};
+
+  void set_error(const std::string &error);
+  void on_connect(ConnId id, bool ok);
+  void on_message(ConnId id, const RdmaControlMsgView &msg);
+  void on_close(ConnId id);
+  void handle_request(ConnId id, const RdmaControlMsgView &msg);
+  void handle_response(ConnId id, const RdmaControlMsgView &msg);
+  void handle_ready(ConnId id);
+  bool bring_up(uint32_t qp, const QPValue &remote);
+  void reset_qps(const std::vector<uint32_t> &qps, QpState state);
+  void reject(ConnId id, const RdmaControlMsgView &msg,
+              const std::string &error);
+  void fail(ConnId id, const std::string &error);
+  void abort(ConnId id, Conn &&conn, const std::string &error);
+};
+
+#endif // RDMA_CONNECTION_MANAGER_H
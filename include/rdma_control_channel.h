@@ -1,23 +1,41 @@
 #ifndef RDMA_CONTROL_CHANNEL_H
 #define RDMA_CONTROL_CHANNEL_H
 
+#include "rdma_control_codec.h"
+#include "rdma_control_transport.h"
 #include "rdma_types.h"
 #include <arpa/inet.h>
+#include <atomic>
 #include <cerrno>
 #include <cstring>
+#include <deque>
 #include <fcntl.h>
+#include <memory>
 #include <mutex>
 #include <netinet/in.h>
 #include <poll.h>
 #include <string>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <vector>
+
+// 控制通道收发统计
+struct ControlChannelStats {
+  uint64_t messages_tx;     // 发出的控制消息数
+  uint64_t messages_rx;     // 收到的控制消息数
+  uint64_t send_calls;      // sendmsg 调用次数
+  uint64_t recv_calls;      // recv 调用次数（不含 poll）
+  uint64_t zerocopy_sends;  // 以 MSG_ZEROCOPY 发出的消息数
+  uint64_t zerocopy_copied; // 内核回报实际发生了拷贝的零拷贝发送数
+};
 
 /**
  * @brief RDMA控制通道类，用于QP连接建立和控制消息交换
  *
- * 该类提供TCP/IP通信通道，用于在RDMA设备之间交换控制信息，
- * 如QP连接参数、连接请求和响应等。
+ * 该类提供点对点的控制通道，用于在RDMA设备之间交换控制信息，
+ * 如QP连接参数、连接请求和响应等。底层传输可以是TCP、Unix域套接字，
+ * 或同一进程内的无锁字节环（见 RdmaControlTransport）。
  */
 class RdmaControlChannel {
 public:
@@ -43,6 +61,20 @@ public:
    */
   bool start_server(uint16_t port);
 
+  /**
+   * @brief 在指定传输上启动服务器监听
+   * @param type 传输方式
+   * @param address 监听地址，格式见 ControlTransportType；
+   *        TCP 端口为0时由系统分配，实际地址由 get_listen_address() 返回
+   * @return 是否成功启动服务器
+   */
+  bool start_server(ControlTransportType type, const std::string &address);
+
+  /**
+   * @brief 获取实际监听的地址，未监听时返回空串
+   */
+  std::string get_listen_address() const;
+
   /**
    * @brief 接受客户端连接
    * @param timeout_ms 超时时间(毫秒)，0表示不超时
@@ -58,6 +90,15 @@ public:
    */
   bool connect_to_server(const std::string &server_ip, uint16_t port);
 
+  /**
+   * @brief 通过指定传输连接到服务器
+   * @param type 传输方式，须与服务器一致
+   * @param address 服务器地址，格式见 ControlTransportType
+   * @return 是否成功连接
+   */
+  bool connect_to_server(ControlTransportType type,
+                         const std::string &address);
+
   /**
    * @brief 发送连接请求
    * @param qp_info QP信息
@@ -73,6 +114,42 @@ public:
    */
   bool send_connect_response(const QPValue &qp_info, bool accept);
 
+  /**
+   * @brief 发送批量连接请求，一条消息携带多个QP描述
+   * @param qps 本端QP信息，不超过 RDMA_CONTROL_MAX_BATCH 个
+   * @param request_id 非空时返回本请求的编号，对端响应回带同一编号
+   * @return 是否成功发送
+   */
+  bool send_connect_batch_request(const std::vector<QPValue> &qps,
+                                  uint32_t *request_id = nullptr);
+
+  /**
+   * @brief 发送批量连接响应
+   * @param request_id 所响应请求的编号
+   * @param qps 与请求中的QP一一对应的本端QP信息
+   * @param accept 是否接受连接
+   * @return 是否成功发送
+   */
+  bool send_connect_batch_response(uint32_t request_id,
+                                   const std::vector<QPValue> &qps,
+                                   bool accept);
+
+  /**
+   * @brief 流水线批量建链
+   *
+   * 按顺序把每一批作为一个批量连接请求发出，不等待响应就继续发送下一批，
+   * 同时在途的请求不超过 window 个；响应按请求编号匹配，可以乱序到达。
+   * 建立 N 个QP只需要 ceil(N / RDMA_CONTROL_MAX_BATCH) 个请求，且往返时间相互重叠。
+   * @param batches 每批的本端QP信息
+   * @param remote 输出：与 batches 一一对应的对端QP信息
+   * @param window 最多同时在途的请求数，0 按1处理
+   * @param timeout_ms 等待每个响应的超时时间(毫秒)
+   * @return 任一请求被拒绝、响应与请求不匹配、超时或连接出错时返回 false
+   */
+  bool exchange_qp_batches(const std::vector<std::vector<QPValue>> &batches,
+                           std::vector<std::vector<QPValue>> &remote,
+                           uint32_t window, uint32_t timeout_ms);
+
   /**
    * @brief 发送就绪消息
    * @return 是否成功发送
@@ -101,6 +178,20 @@ public:
    */
   bool receive_message(RdmaControlMsg &msg, uint32_t timeout_ms);
 
+  /**
+   * @brief 消息体不小于 bytes 时以 MSG_ZEROCOPY 发送，0 表示关闭（默认）
+   *
+   * 零拷贝发送的帧缓冲保留到内核从错误队列回报完成为止，
+   * 在后续收发时顺带回收。需在连接建立之后调用，只支持TCP传输。
+   * @return 未连接、非TCP传输或内核不支持 SO_ZEROCOPY 时返回 false，保持关闭
+   */
+  bool set_zerocopy_threshold(size_t bytes);
+
+  /**
+   * @brief 获取收发统计
+   */
+  ControlChannelStats get_io_stats() const;
+
   /**
    * @brief 获取当前连接状态
    * @return 连接状态
@@ -126,14 +217,26 @@ public:
   uint16_t get_peer_port() const;
 
 private:
-  int socket_fd_;            // 当前活动的socket文件描述符
-  int server_socket_fd_;     // 服务器监听socket
-  int client_socket_fd_;     // 客户端连接socket
+  std::unique_ptr<RdmaControlTransport> transport_; // 监听或已连接的传输
   ConnectionState state_;    // 连接状态
-  std::mutex mutex_;         // 互斥锁
+  mutable std::mutex mutex_; // 互斥锁
   std::string error_msg_;    // 错误信息
   std::string peer_address_; // 对端地址
   uint16_t peer_port_;       // 对端端口
+  std::atomic<uint32_t> next_request_id_; // 下一个请求编号
+
+  // 接收缓冲：一次 recv 可能读入多条消息，未解析的部分留到下次
+  std::vector<char> rx_buffer_;
+  size_t rx_offset_; // 下一条未解析消息的起点
+  size_t rx_end_;    // 已读入数据的末尾
+  std::string tx_body_; // 复用的消息体编码缓冲
+
+  // 零拷贝发送：阈值，以及等待内核回报完成的帧（按发送序号排列）
+  size_t zerocopy_threshold_;
+  uint32_t zerocopy_seq_;
+  std::deque<std::pair<uint32_t, std::string>> zerocopy_pending_;
+
+  ControlChannelStats stats_;
 
   /**
    * @brief 关闭连接
@@ -141,19 +244,20 @@ private:
   void close_connection();
 
   /**
-   * @brief 序列化控制消息
-   * @param msg 控制消息
-   * @return 序列化后的字符串
+   * @brief 从接收缓冲解析一条完整的消息（调用方持有 mutex_）
+   * @return 1 解析出一条消息，0 数据不足，-1 帧非法
+   */
+  int parse_buffered(RdmaControlMsg &msg);
+
+  /**
+   * @brief 用一次 sendmsg 写出 iov 描述的全部数据，短写时继续写剩余部分
    */
-  std::string serialize_message(const RdmaControlMsg &msg);
+  bool send_iov(struct iovec *iov, int iovcnt, int flags);
 
   /**
-   * @brief 反序列化控制消息
-   * @param data 序列化的数据
-   * @param msg 输出的控制消息
-   * @return 是否成功反序列化
+   * @brief 非阻塞地回收内核已完成的零拷贝发送缓冲
    */
-  bool deserialize_message(const std::string &data, RdmaControlMsg &msg);
+  void reap_zerocopy();
 };
 
 #endif // RDMA_CONTROL_CHANNEL_H
\ No newline at end of file
@@ -0,0 +1,148 @@
+#ifndef RDMA_CONTROL_CODEC_H
+#define RDMA_CONTROL_CODEC_H
+
+#include "rdma_types.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// 一条批量建链消息最多携带的QP描述数
+constexpr uint32_t RDMA_CONTROL_MAX_BATCH = 1024;
+
+// 控制消息在流上的分帧：4字节网络序长度前缀 + 消息体，消息体不超过此长度
+// （足以容纳 RDMA_CONTROL_MAX_BATCH 个QP描述）
+constexpr uint32_t RDMA_CONTROL_MAX_FRAME = 128 * 1024;
+
+// 消息体线上格式：固定头 + TLV扩展区，所有多字节整数均为小端
+constexpr uint16_t RDMA_CONTROL_MAGIC = 0x4352; // "RC"
+constexpr uint8_t RDMA_CONTROL_WIRE_VERSION = 1;
+
+// 固定头 flags
+constexpr uint8_t RDMA_CONTROL_FLAG_ACCEPT = 1u << 0;
+
+// TLV类型；解码时跳过不认识的类型，新增字段不需要升级版本号
+enum class RdmaControlTlv : uint16_t {
+  ERROR_MSG = 1, // 错误信息（UTF-8，不含结尾0）
+  QP_BATCH = 2   // 连续的 RdmaControlWireQp 记录
+};
+
+// QP描述的线上记录，按自然对齐排列，不需要编译器打包
+struct RdmaControlWireQp {
+  uint32_t qp_num;
+  uint32_t dest_qp_num;
+  uint32_t qp_access_flags;
+  uint32_t psn;
+  uint32_t remote_psn;
+  uint32_t mtu;
+  uint16_t lid;
+  uint16_t remote_lid;
+  uint8_t port_num;
+  uint8_t state;
+  uint8_t reserved[2];
+  uint8_t gid[16];
+  uint8_t remote_gid[16];
+};
+static_assert(sizeof(RdmaControlWireQp) == 64,
+              "wire QP record must be packed");
+
+// 消息固定头，编码时在栈上填好后一次拷贝进输出缓冲
+struct RdmaControlWireHeader {
+  uint16_t magic;       // RDMA_CONTROL_MAGIC
+  uint8_t version;      // RDMA_CONTROL_WIRE_VERSION
+  uint8_t type;         // RdmaControlMsgType
+  uint8_t flags;        // RDMA_CONTROL_FLAG_*
+  uint8_t reserved[3];
+  uint32_t request_id;
+  uint32_t ext_length;  // 固定头之后TLV扩展区的总字节数
+  RdmaControlWireQp qp; // qp_info
+};
+static_assert(sizeof(RdmaControlWireHeader) == 80,
+              "wire header must be packed");
+
+// TLV头，值紧随其后，不做对齐填充
+struct RdmaControlWireTlv {
+  uint16_t type;
+  uint16_t reserved;
+  uint32_t length; // 值的字节数
+};
+static_assert(sizeof(RdmaControlWireTlv) == 8, "wire TLV must be packed");
+
+/**
+ * @brief 控制消息的只读视图
+ *
+ * parse() 只拷贝固定头并记录各TLV在缓冲区中的位置，错误信息和批量QP描述
+ * 不做拷贝，按需从原缓冲区读出；视图引用的缓冲区必须在视图使用期间保持有效。
+ */
+class RdmaControlMsgView {
+public:
+  /**
+   * @brief 解析消息体（不含长度前缀）
+   * @param error 失败时写入原因
+   * @return 魔数/版本不符、消息类型或QP状态越界、数据不完整或TLV越界时
+   *         返回 false
+   */
+  bool parse(const char *data, size_t size, std::string &error);
+
+  RdmaControlMsgType type() const {
+    return static_cast<RdmaControlMsgType>(header_.type);
+  }
+  uint8_t version() const { return header_.version; }
+  uint32_t request_id() const { return request_id_; }
+  bool accept() const {
+    return (header_.flags & RDMA_CONTROL_FLAG_ACCEPT) != 0;
+  }
+  QPValue qp_info() const;
+  std::string_view error_msg() const { return error_msg_; }
+  size_t batch_size() const { return batch_size_; }
+  QPValue batch_qp(size_t index) const;
+
+  /**
+   * @brief 把视图展开为独立的控制消息
+   */
+  void to_msg(RdmaControlMsg &msg) const;
+
+private:
+  RdmaControlWireHeader header_{};
+  uint32_t request_id_ = 0;
+  std::string_view error_msg_;
+  const char *batch_ = nullptr;
+  size_t batch_size_ = 0;
+};
+
+/**
+ * @brief 控制消息编码后的字节数（不含长度前缀）
+ */
+size_t control_msg_encoded_size(const RdmaControlMsg &msg);
+
+/**
+ * @brief 把控制消息编码到调用方预分配的缓冲区
+ * @return 写入的字节数；capacity 不足或 qp_batch 超过 RDMA_CONTROL_MAX_BATCH
+ *         时返回 0 且不写入
+ */
+size_t encode_control_msg(const RdmaControlMsg &msg, char *buffer,
+                          size_t capacity);
+
+/**
+ * @brief 把控制消息编码为消息体（不含长度前缀）
+ *
+ * qp_batch 超过 RDMA_CONTROL_MAX_BATCH 的消息对端无法解码，返回空串
+ */
+std::string encode_control_msg(const RdmaControlMsg &msg);
+
+/**
+ * @brief 在 out 末尾追加完整的帧（长度前缀 + 消息体），只扩容一次
+ * @return 消息体超过 RDMA_CONTROL_MAX_FRAME 或 qp_batch 超过
+ *         RDMA_CONTROL_MAX_BATCH 时返回 false，out 不变
+ */
+bool append_control_frame(const RdmaControlMsg &msg, std::string &out);
+
+/**
+ * @brief 从消息体解码控制消息
+ * @param error 失败时写入原因
+ * @return 数据不完整时返回 false
+ */
+bool decode_control_msg(const char *data, size_t size, RdmaControlMsg &msg,
+                        std::string &error);
+
+#endif // RDMA_CONTROL_CODEC_H
@@ -0,0 +1,170 @@
+#ifndef RDMA_CONTROL_PLANE_H
+#define RDMA_CONTROL_PLANE_H
+
+#include "rdma_control_codec.h"
+#include "rdma_types.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 控制面统计
+struct ControlPlaneStats {
+  uint64_t accepted;       // 接受的入站连接数
+  uint64_t connected;      // 建立成功的出站连接数
+  uint64_t connect_failed; // 建立失败的出站连接数
+  uint64_t closed;         // 已建立的连接中被关闭（含对端关闭和出错）的数量
+  uint64_t messages_rx;    // 收到的控制消息数
+  uint64_t messages_tx;    // 发出的控制消息数
+  uint64_t bytes_rx;
+  uint64_t bytes_tx;
+  uint64_t loop_wakeups; // epoll_wait 返回次数
+};
+
+/**
+ * @brief 基于 epoll 的控制面，单线程管理大量对端连接
+ *
+ * 所有 socket 均为非阻塞，由一个事件循环处理监听、出站连接建立、
+ * 分帧读取和缓冲写出；帧格式与 RdmaControlChannel 相同，两者可以互通。
+ * 事件循环可以由 start() 启动的后台线程驱动，也可以由调用方反复调用 poll()。
+ * connect/send/close 可在任意线程（包括回调中）调用：请求进入命令队列，
+ * 由事件循环在下一轮处理，socket 状态只由事件循环线程访问。
+ */
+class RdmaControlPlane {
+public:
+  using PeerId = uint64_t;
+
+  // 回调在事件循环线程中执行，不应阻塞
+  struct Callbacks {
+    std::function<void(PeerId)> on_accept;             // 接受了入站连接
+    std::function<void(PeerId, bool)> on_connect;      // 出站连接建立成功/失败
+    std::function<void(PeerId, const RdmaControlMsg &)> on_message;
+    // 设置时代替 on_message：直接交出接收缓冲区上的视图，不展开消息；
+    // 视图只在回调期间有效
+    std::function<void(PeerId, const RdmaControlMsgView &)> on_message_view;
+    std::function<void(PeerId)> on_close;              // 已建立的连接关闭
+  };
+
+  RdmaControlPlane();
+  ~RdmaControlPlane();
+
+  RdmaControlPlane(const RdmaControlPlane &) = delete;
+  RdmaControlPlane &operator=(const RdmaControlPlane &) = delete;
+
+  /**
+   * @brief 设置回调，应在 start()/poll() 之前调用
+   */
+  void set_callbacks(const Callbacks &callbacks);
+
+  /**
+   * @brief 在端口上监听入站连接
+   * @param port 0 表示由系统分配，实际端口由 listen_port() 返回
+   */
+  bool listen(uint16_t port, const std::string &ip = "0.0.0.0");
+  uint16_t listen_port() const;
+
+  /**
+   * @brief 发起非阻塞连接，结果通过 on_connect 回调报告
+   * @return 对端编号，地址无效时返回 0
+   */
+  PeerId connect(const std::string &ip, uint16_t port);
+
+  /**
+   * @brief 向对端发送控制消息；连接建立之前发送的消息在建立后按序发出，
+   * 发给已关闭或不存在的对端的消息被丢弃
+   * @return 消息过长时返回 false
+   */
+  bool send(PeerId peer, const RdmaControlMsg &msg);
+
+  /**
+   * @brief 关闭与对端的连接（不触发 on_close）
+   */
+  void close(PeerId peer);
+
+  /**
+   * @brief 运行一轮事件循环
+   * @param timeout_ms 没有事件时最多等待的时间，-1 表示一直等待
+   * @return 处理的事件数，出错时返回 -1
+   */
+  int poll(int timeout_ms);
+
+  /**
+   * @brief 启动/停止后台事件循环线程
+   */
+  bool start();
+  void stop();
+
+  size_t peer_count() const;
+  ControlPlaneStats get_stats() const;
+  std::string get_error() const;
+
+private:
+  struct Peer {
+    int fd = -1;
+    bool connected = false;
+    bool want_write = false; // 已注册 EPOLLOUT
+    std::string rx;          // 未解析完的接收数据
+    size_t rx_offset = 0;
+    std::string tx;          // 未写出的帧
+    size_t tx_offset = 0;
+  };
+
+  // 跨线程提交给事件循环的请求
+  struct Command {
+    enum class Kind : uint8_t { CONNECT, SEND, CLOSE } kind;
+    PeerId peer;
+    std::string data; // CONNECT：未使用；SEND：带长度前缀的帧
+    uint32_t addr = 0; // CONNECT：网络序IPv4地址
+    uint16_t port = 0; // CONNECT：网络序端口
+  };
+
+  int epoll_fd_;
+  int wake_fd_;   // eventfd，命令入队时唤醒事件循环
+  int listen_fd_;
+  uint16_t listen_port_;
+  Callbacks callbacks_;
+
+  std::unordered_map<PeerId, Peer> peers_; // 只由事件循环线程访问
+  // 事件循环共用的读缓冲：recv 读入此处，只把收到的字节追加到对端的 rx，
+  // 对端不必各自常驻一块读缓冲
+  std::vector<char> rx_scratch_;
+  std::atomic<size_t> peer_count_{0};
+  std::atomic<PeerId> next_peer_id_{1};
+
+  std::mutex command_mutex_;
+  std::deque<Command> commands_;
+
+  std::thread loop_thread_;
+  std::atomic<bool> running_{false};
+
+  mutable std::mutex error_mutex_;
+  std::string error_msg_;
+
+  // 统计
+  std::atomic<uint64_t> accepted_{0};
+  std::atomic<uint64_t> connected_{0};
+  std::atomic<uint64_t> connect_failed_{0};
+  std::atomic<uint64_t> closed_{0};
+  std::atomic<uint64_t> messages_rx_{0};
+  std::atomic<uint64_t> messages_tx_{0};
+  std::atomic<uint64_t> bytes_rx_{0};
+  std::atomic<uint64_t> bytes_tx_{0};
+  std::atomic<uint64_t> loop_wakeups_{0};
+
+  void set_error(const std::string &error);
+  void submit(Command &&command);
+  void run_commands();
+  void handle_accept();
+  void handle_connected(PeerId id, Peer &peer);
+  bool handle_read(PeerId id, Peer &peer);
+  bool flush(PeerId id, Peer &peer);
+  void update_events(PeerId id, Peer &peer, bool want_write);
+  void drop_peer(PeerId id, bool notify);
+};
+
+#endif // RDMA_CONTROL_PLANE_H
@@ -0,0 +1,93 @@
+#ifndef RDMA_CONTROL_TRANSPORT_H
+#define RDMA_CONTROL_TRANSPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// 控制通道的传输方式
+enum class ControlTransportType : uint8_t {
+  TCP = 0,   // AF_INET 流套接字，地址 "ip:port"
+  UNIX = 1,  // AF_UNIX 流套接字，地址为路径，以 '@' 开头表示抽象命名空间
+  INPROC = 2 // 进程内无锁字节环，地址为任意名字，只能连接同一进程内的监听者
+};
+
+/**
+ * @brief 控制通道的字节流传输接口
+ *
+ * 一个传输对象对应一条点对点连接：服务端 listen() 后 accept() 一个对端，
+ * 客户端 connect() 到对端。分帧、缓冲和消息编解码由 RdmaControlChannel 完成，
+ * 传输只负责可靠有序地搬运字节，语义与阻塞的流套接字一致。
+ */
+class RdmaControlTransport {
+public:
+  virtual ~RdmaControlTransport() = default;
+
+  virtual ControlTransportType type() const = 0;
+
+  /**
+   * @brief 在 address 上监听
+   */
+  virtual bool listen(const std::string &address) = 0;
+
+  /**
+   * @brief 实际监听的地址（TCP 端口为0时由系统分配）
+   */
+  virtual std::string listen_address() const = 0;
+
+  /**
+   * @brief 接受一个对端连接
+   * @param timeout_ms 超时时间(毫秒)，0 表示一直等待
+   */
+  virtual bool accept(uint32_t timeout_ms) = 0;
+
+  /**
+   * @brief 连接到 address 上的监听者
+   */
+  virtual bool connect(const std::string &address) = 0;
+
+  /**
+   * @brief 写出 iov 描述的数据，阻塞到至少写出一部分
+   * @param flags 透传给 sendmsg 的标志，非套接字传输忽略
+   * @return 写出的字节数，出错时返回 -1 并设置 errno
+   */
+  virtual ssize_t send(const struct iovec *iov, int iovcnt, int flags) = 0;
+
+  /**
+   * @brief 读出已到达的数据，不等待
+   * @return 读出的字节数；对端已关闭时返回 0；没有数据时返回 -1，errno 为 EAGAIN
+   */
+  virtual ssize_t recv(char *buffer, size_t length) = 0;
+
+  /**
+   * @brief 等待数据到达或对端关闭
+   * @param timeout_ms 超时时间(毫秒)，-1 表示一直等待
+   * @return 1 可读，0 超时，-1 出错
+   */
+  virtual int wait_readable(int timeout_ms) = 0;
+
+  /**
+   * @brief 关闭连接和监听
+   */
+  virtual void close() = 0;
+
+  /**
+   * @brief 已连接套接字的描述符，用于 SO_ZEROCOPY 等套接字选项；非套接字传输返回 -1
+   */
+  virtual int fd() const = 0;
+
+  virtual std::string peer_address() const = 0;
+  virtual uint16_t peer_port() const = 0;
+  virtual std::string get_error() const = 0;
+};
+
+/**
+ * @brief 创建指定类型的传输
+ */
+std::unique_ptr<RdmaControlTransport>
+make_control_transport(ControlTransportType type);
+
+#endif // RDMA_CONTROL_TRANSPORT_H
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "rdma_cache_metrics.h"
 #include "rdma_types.h"
 #include <cstdint>
 #include <memory>
@@ -13,6 +14,10 @@ public:
 
   bool get(uint32_t cq_num, CQValue &info);
   void set(uint32_t cq_num, const CQValue &info);
+  bool erase(uint32_t cq_num);
+  size_t size() const;
+  size_t capacity() const { return cache_size_; }
+  std::vector<uint32_t> keys() const;
   void batch_add_completions(uint32_t cq_num,
                              const std::vector<CompletionEntry> &completions);
   std::vector<CompletionEntry> batch_get_completions(uint32_t cq_num,
@@ -21,7 +26,13 @@ public:
   // 测试用途：设置模拟访问延迟（纳秒）
   static void set_simulated_delay_ns(uint32_t delay_ns);
 
+  // 命中/未命中/写入/淘汰计数与采样的访问延迟；
+  // batch_get_completions 找到该CQ即计为命中
+  RdmaCacheStats get_stats() const { return counters_.read(); }
+  void reset_stats() { counters_.reset(); }
+
 private:
   size_t cache_size_;
   std::unordered_map<uint32_t, CQValue> cache_;
+  RdmaCacheCounters counters_;
 };
\ No newline at end of file
@@ -4,17 +4,24 @@
 #include "rdma_cache.h"
 #include "rdma_control_channel.h"
 #include "rdma_cq_cache.h"
+#include "rdma_engine.h"
+#include "rdma_latency_histogram.h"
+#include "rdma_link_model.h"
 #include "rdma_mr_cache.h"
 #include "rdma_pd_cache.h"
+#include "rdma_perf_counters.h"
 #include "rdma_qp_cache.h"
 #include "rdma_types.h"
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <unordered_set>
 #include <vector>
 
 // Forward declarations
@@ -24,6 +31,14 @@ struct QPValue;
 struct CQValue;
 struct RdmaQPInfo;
 
+// 设备各中间缓存的统计
+struct MiddleCacheStats {
+  RdmaCacheStats qp;
+  RdmaCacheStats cq;
+  RdmaCacheStats mr;
+  RdmaCacheStats pd;
+};
+
 /**
  * @brief RDMA设备类，模拟RDMA网卡(RNIC)的功能
  *
@@ -49,29 +64,183 @@ public:
   ~RdmaDevice();
 
   // 基本资源管理函数
+  /**
+   * @brief 创建队列对
+   * @param max_send_wr 发送队列深度，取值 [1, RDMA_MAX_QP_WR]
+   * @param max_recv_wr 接收队列深度，不超过 RDMA_MAX_QP_WR
+   * @param max_inline_data inline 发送阈值，超过 RDMA_MAX_INLINE_DATA 时截断
+   * @param max_sge 发送/接收WQE的最大SGE数，截断到 [1, RDMA_MAX_SGE]
+   * @param qp_type 传输类型；UD QP 不绑定对端，发送时由 wr.ah/remote_qpn 指定目的
+   * @return QP编号，0表示创建失败
+   */
   uint32_t create_qp(uint32_t max_send_wr, uint32_t max_recv_wr,
-                     uint32_t send_cq, uint32_t recv_cq);
-  uint32_t create_cq(uint32_t max_cqe);
+                     uint32_t send_cq, uint32_t recv_cq,
+                     uint32_t max_inline_data = 0, uint32_t max_sge = 1,
+                     QpType qp_type = QpType::RC);
+  /**
+   * @brief 批量创建 count 个参数相同的QP
+   *
+   * 一次加锁内完成CQ校验、分配连续的QP编号区间，并按设备/中间缓存/主机
+   * 各层的剩余容量一次性预留表空间；每层的模拟访问延迟按批计一次。
+   * @param qp_nums 输出：新QP的编号，追加到末尾
+   * @return 参数无效或CQ不存在时返回 false，且不创建任何QP
+   */
+  bool create_qp_batch(uint32_t count, uint32_t max_send_wr,
+                       uint32_t max_recv_wr, uint32_t send_cq,
+                       uint32_t recv_cq, std::vector<uint32_t> &qp_nums,
+                       uint32_t max_inline_data = 0, uint32_t max_sge = 1,
+                       QpType qp_type = QpType::RC);
+  /**
+   * @brief 创建完成队列
+   * @param max_cqe CQ深度，取值 [1, RDMA_MAX_CQE]；完成数达到深度时CQ溢出，
+   *        产生 CQ_ERR 异步事件并把使用该CQ的QP置为 ERR
+   * @param comp_channel 绑定的完成通道（create_comp_channel 返回值），0 表示不绑定
+   * @return CQ编号，0表示创建失败
+   */
+  uint32_t create_cq(uint32_t max_cqe, uint32_t comp_channel = 0);
   uint32_t register_mr(void *addr, size_t length, uint32_t access_flags);
   uint32_t create_pd();
+  /**
+   * @brief 创建地址句柄（对应 ibv_create_ah），UD 发送通过 wr.ah 引用
+   *
+   * 地址句柄只记录目的端口的路由信息，目的QP仍经全局QP目录寻址；
+   * 与RC相比，向N个对端发送只需要一个UD QP加N个地址句柄。
+   * @return AH编号，0表示创建失败（既无 dlid 也不带GRH）
+   */
+  uint32_t create_ah(const AhAttr &attr);
+  bool destroy_ah(uint32_t ah);
 
   // QP操作函数
+  /**
+   * @brief 只迁移QP状态，按状态迁移表校验但不要求属性掩码
+   *        （属性取 create_qp 默认值和 connect_qp 交换的对端信息）
+   */
   bool modify_qp_state(uint32_t qp_num, QpState new_state);
+  /**
+   * @brief 修改QP属性并迁移状态（对应 ibv_modify_qp）
+   *
+   * 每个迁移有必需和可选的属性掩码，缺少必需属性或带有该迁移不允许的属性时失败；
+   * 掩码不含 QP_ATTR_STATE 时视为迁移到当前状态。
+   * 迁移到 ERR 时所有已投递、未完成的WQE以 WR_FLUSH_ERR 批量完成；
+   * 迁移到 RESET 时丢弃所有WQE且不产生完成；
+   * 进入 SQD 后在途发送全部完成时产生 SQ_DRAINED 异步事件。
+   */
+  bool modify_qp(uint32_t qp_num, const QpAttr &attr, uint32_t attr_mask);
   bool connect_qp(uint32_t qp_num, const QPValue &remote_info);
+  /**
+   * @brief 投递发送WR
+   *
+   * 发送队列中尚未完成的WR数达到 max_send_wr 时返回 false（计入 POST_ERRORS），
+   * 直到有发送完成、出错或被冲刷。
+   * UD QP 只支持 SEND，消息不能超过 MTU，目的由 wr.ah/remote_qpn/remote_qkey
+   * 指定；发送在上线后即完成，对端没有接收WQE或 Q_Key 不符时静默丢弃。
+   * UD 接收缓冲区的前 RDMA_GRH_BYTES 字节总是预留给GRH，地址句柄带GRH时写入。
+   *
+   * DCI 与RC一样可靠传输，目标 DCT 和 DC 访问密钥由 wr.remote_qpn/remote_qkey
+   * 按消息指定。目标与当前挂接的不同时，DCI 先断开旧目标再挂接新目标，
+   * 断开和挂接各按DCI及目标上下文所在层计一次访问延迟；
+   * 仍有未确认的消息时不能切换目标，返回 false。
+   */
   bool post_send(uint32_t qp_num, const RdmaWorkRequest &wr);
+  /**
+   * @brief 从DCI池中选一个发起端投递 wr（目标由 wr.remote_qpn 指定）
+   *
+   * 优先选已挂接到该目标的DCI（不产生连接开销），其次选没有在途消息的DCI；
+   * 池很小时也能服务任意多的对端，代价是切换目标时的断开/挂接。
+   * @return 使用的DCI编号，0 表示所有DCI都忙于其他目标或投递失败
+   */
+  uint32_t post_send_dc(const std::vector<uint32_t> &dci_pool,
+                        const RdmaWorkRequest &wr);
+  /**
+   * @brief 按顺序投递一组发送WR（对应 ibv_post_send 的WR链表）
+   *
+   * 配置了处理引擎时所有WQE写入提交环后只敲一次门铃，引擎按门铃记录
+   * 成批取回；未配置引擎时逐条同步投递。遇到第一条无法投递的WR即停止。
+   * @return 成功投递的WR数
+   */
+  size_t post_send_list(uint32_t qp_num,
+                        const std::vector<RdmaWorkRequest> &wrs);
   bool post_recv(uint32_t qp_num, const RdmaWorkRequest &wr);
 
   // CQ操作函数
   bool poll_cq(uint32_t cq_num, std::vector<CompletionEntry> &completions,
                uint32_t max_entries);
+  /**
+   * @brief 武装CQ通知：下一个完成事件到达时向绑定的完成通道投递一次事件
+   * @param solicited_only 为 true 时仅在 solicited 接收完成或出错完成时触发
+   */
   bool req_notify_cq(uint32_t cq_num, bool solicited_only);
 
+  /**
+   * @brief 等待CQ上的完成：按 CqWaitPolicy 先忙轮询、再 yield 轮询，
+   *        仍未取到时在CQ上登记等待并阻塞，直到有新完成或超时
+   * @param timeout_ms 总等待时间（毫秒），-1 表示一直等待，0 表示只轮询一次
+   * @return 取到至少一个完成返回 true
+   */
+  bool wait_cq(uint32_t cq_num, std::vector<CompletionEntry> &completions,
+               uint32_t max_entries, int timeout_ms = -1);
+  void set_cq_wait_policy(const CqWaitPolicy &policy);
+  CqWaitPolicy get_cq_wait_policy() const;
+  CqWaitStats get_cq_wait_stats() const;
+
+  /**
+   * @brief 设置CQ通知合并参数（对应 ibv_modify_cq 的 moderation）
+   * @param cq_count 武装后累计多少个完成触发一次事件，0/1 表示不合并
+   * @param cq_period_us 首个完成之后最多等待的微秒数，0 表示不设超时
+   */
+  bool modify_cq_moderation(uint32_t cq_num, uint16_t cq_count,
+                            uint32_t cq_period_us);
+  /**
+   * @brief 启用自适应通知合并：按观测到的完成速率调整 cq_count，
+   *        使事件在目标时延内攒够一批
+   * @param target_latency_us 目标通知时延（微秒），0 表示关闭自适应
+   */
+  bool set_cq_adaptive_moderation(uint32_t cq_num, uint32_t target_latency_us);
+
+  // 完成通道
+  /**
+   * @brief 创建完成通道，通道由 eventfd 承载，可加入 epoll/poll 等待
+   * @return 通道编号，0表示创建失败
+   */
+  uint32_t create_comp_channel();
+  /**
+   * @brief 销毁完成通道，仍有CQ绑定时失败
+   */
+  bool destroy_comp_channel(uint32_t channel);
+  /**
+   * @brief 获取通道的 eventfd（非阻塞），有待取事件时可读
+   */
+  int get_comp_channel_fd(uint32_t channel);
+  /**
+   * @brief 取出通道上的一个CQ事件
+   * @param cq_num 输出：触发事件的CQ
+   * @param timeout_ms 等待超时（毫秒），-1 表示一直等待，0 表示不等待
+   * @return 取到事件返回 true；事件取出后需重新 req_notify_cq 才会再次触发
+   */
+  bool get_cq_event(uint32_t channel, uint32_t &cq_num, int timeout_ms = -1);
+
+  // 异步事件
+  /**
+   * @brief 获取异步事件队列的 eventfd（非阻塞），有待取事件时可读
+   */
+  int get_async_fd() const;
+  /**
+   * @brief 取出一个异步事件（CQ溢出、QP致命错误等）
+   * @param timeout_ms 等待超时（毫秒），-1 表示一直等待，0 表示不等待
+   */
+  bool get_async_event(AsyncEvent &event, int timeout_ms = -1);
+
   // MR操作函数
   MRBlock *allocate_mr(size_t size, uint32_t access_flags);
   void free_mr(MRBlock *block);
 
   // 资源释放函数
   void destroy_qp(uint32_t qp_num);
+  /**
+   * @brief 批量销毁QP，从设备/中间缓存/主机三层中移除条目
+   * @return 实际销毁的QP数
+   */
+  size_t destroy_qp_batch(const std::vector<uint32_t> &qp_nums);
   void destroy_cq(uint32_t cq_num);
   void deregister_mr(uint32_t lkey);
   void destroy_pd(uint32_t pd_handle);
@@ -81,20 +250,124 @@ public:
   bool get_cq_info(uint32_t cq_num, CQValue &info);
   bool get_mr_info(uint32_t lkey, MRValue &info);
 
-  // 模拟配置：启用/禁用中间缓存，以及设置主机交换/设备/中间缓存访问延迟（纳秒）
+  /**
+   * @brief 获取传输层统计快照
+   */
+  TransportStats get_transport_stats() const;
+
+  /**
+   * @brief 获取设备性能计数器快照（类似 ethtool -S / rdma statistic）
+   *
+   * 包括投递、完成、字节数、QP/CQ上下文在设备/中间缓存/主机各层的命中次数
+   * 和设备锁的竞争次数；计数按线程分片累加，读取时汇总。
+   */
+  RdmaPerfSnapshot get_perf_counters() const;
+  /**
+   * @brief 获取QP/CQ/MR/PD中间缓存各自的命中、写入、淘汰和采样延迟统计
+   */
+  MiddleCacheStats get_cache_stats() const;
+  // 清零性能计数器和中间缓存的访问统计
+  void reset_perf_counters();
+
+  /**
+   * @brief 获取QP/CQ上发送WR从投递到产生完成的延迟分布
+   *
+   * 开启统计后发送WQE在 post 时打时间戳，有信号的发送完成生成时把两者之差
+   * 记入所属QP和发送CQ的直方图（对数-线性分桶，不保存样本）。直方图挂在
+   * QP/CQ上下文上，在已持有的QP/CQ锁内创建，记录只做 relaxed 原子加；
+   * QP/CQ销毁时一并释放。
+   * @return QP/CQ不存在或尚无样本时返回 false
+   */
+  bool get_qp_latency(uint32_t qp_num, RdmaLatencySnapshot &snapshot);
+  bool get_cq_latency(uint32_t cq_num, RdmaLatencySnapshot &snapshot);
+  // 清零所有QP/CQ的延迟直方图
+  void reset_latency();
+  /**
+   * @brief 开关投递时间戳与延迟统计（默认关闭），关闭时 post 不读取时钟
+   *
+   * 每个QP/CQ一个直方图，桶数为 2^sub_bits * (max_bits - sub_bits + 1)，
+   * 每桶8字节；QP很多时可降低 sub_bits（精度）或 max_bits（覆盖范围）。
+   * 新参数只作用于之后创建的直方图。
+   */
+  void set_latency_tracking(bool enable, uint32_t sub_bits = RDMA_HIST_SUB_BITS,
+                            uint32_t max_bits = RDMA_HIST_MAX_BITS);
+
+  /**
+   * @brief 配置端口链路模型
+   *
+   * 配置了带宽或传播时延后，发出的包经过本端口的发送调度、
+   * 对端入口队列和传播时延后才到达，发送完成在对端收到尾包后产生。
+   * 未配置时数据在 post_send 内同步投递。
+   */
+  void configure_link(const LinkConfig &config);
+  LinkConfig get_link_config() const;
+  LinkStats get_link_stats() const;
+
+  /**
+   * @brief 只修改链路带宽，其余链路配置保持不变
+   * @param gbps 链路速率（Gbit/s），0 表示不限速
+   */
+  void set_link_bandwidth(double gbps);
+
+  /**
+   * @brief 设置QP在端口加权调度中的权重（EgressScheduler::WEIGHTED）
+   */
+  void set_qp_weight(uint32_t qp_num, uint32_t weight);
+
+  /**
+   * @brief 获取QP当前的发送速率（受 DCQCN 控制），单位 Gbit/s
+   */
+  double get_qp_rate_gbps(uint32_t qp_num);
+
+  /**
+   * @brief 配置发送处理引擎
+   *
+   * 每个引擎是一个线程，独占一组QP的发送队列：post_send 只把WQE写入所属引擎的
+   * 无锁提交环并推进门铃记录（生产者索引），引擎线程按门铃记录每次最多取回
+   * wqe_prefetch_burst 条WQE，切包上线、处理 RNR 并产生发送完成。引擎之间
+   * 不共享发送端状态，也不经过端口发送锁。QP 默认按QP号散列到引擎，可用
+   * set_qp_engine 显式指定。重新配置时先排空并停止原有引擎；
+   * num_engines 为 0 时恢复为在 post_send 内同步投递。
+   * 配置了链路模型时包由链路事件引擎按时序投递，不经过处理引擎。
+   * 不能与 post_send 并发调用。
+   * @return 配置无效（提交环槽数为 0）时返回 false
+   */
+  bool configure_engines(const EngineConfig &config);
+  /**
+   * @brief 把QP绑定到指定引擎（按引擎数取模）
+   *
+   * 应在QP没有尚未被引擎处理的发送时调用，否则新旧引擎上的消息可能乱序。
+   */
+  bool set_qp_engine(uint32_t qp_num, uint32_t engine);
+  /**
+   * @brief 获取各引擎的统计快照
+   */
+  std::vector<EngineStats> get_engine_stats() const;
+
+  // 模拟配置：启用/禁用中间缓存，以及设置主机交换/设备/中间缓存访问延迟（纳秒）；
+  // sleep_on_delay 为 false 时访问延迟只累计到 TransportStats::tier_delay_ns
+  // 而不实际休眠，便于大规模场景按模型比较开销
   static void set_simulation_mode(bool enable_middle_cache,
                                   uint32_t host_swap_delay_ns = 0,
                                   uint32_t device_delay_ns = 0,
-                                  uint32_t middle_delay_ns = 0);
+                                  uint32_t middle_delay_ns = 0,
+                                  bool sleep_on_delay = true);
 
 private:
+  // 完成通道
+  struct CompChannel {
+    int fd;                      // eventfd（信号量模式），计数即待取事件数
+    std::deque<uint32_t> events; // 已触发的CQ编号
+    uint32_t attached_cqs;       // 绑定的CQ数量
+  };
+
   // 设备自己的资源
   std::unordered_map<uint32_t, QPValue> qps_;
   std::unordered_map<uint32_t, CQValue> cqs_;
   std::unordered_map<uint32_t, MRValue> mrs_;
   std::unordered_map<uint32_t, PDValue> pds_;
 
-  // 主机交换（慢路径）存储，用于禁用中间缓存时承载溢出数据
+  // 主机交换（慢路径）存储，承载设备和中间缓存都放不下（或禁用中间缓存时）的溢出数据
   std::unordered_map<uint32_t, QPValue> qps_host_;
   std::unordered_map<uint32_t, CQValue> cqs_host_;
 
@@ -110,28 +383,256 @@ private:
   std::unique_ptr<RdmaMRCache> mr_cache_;
   std::unique_ptr<RdmaPDCache> pd_cache_;
 
-  // 资源计数器
-  std::atomic<uint32_t> next_qp_num_;
+  // 资源计数器（QP编号在进程内全局唯一，作为线上寻址的目的QP号）
+  static std::atomic<uint32_t> next_qp_num_;
   std::atomic<uint32_t> next_cq_num_;
   std::atomic<uint32_t> next_mr_lkey_;
   std::atomic<uint32_t> next_pd_handle_;
+  std::atomic<uint32_t> next_channel_num_;
 
   // 互斥锁
-  std::mutex qp_mutex_;
-  std::mutex cq_mutex_;
+  RdmaCountedMutex qp_mutex_;
+  RdmaCountedMutex cq_mutex_;
+  std::condition_variable_any cq_cv_; // wait_cq 阻塞阶段，配合 cq_mutex_ 使用
   std::mutex mr_mutex_;
   std::mutex pd_mutex_;
+  std::mutex channel_mutex_;
+  std::unordered_map<uint32_t, CompChannel> channels_;
+  std::mutex ah_mutex_;
+  std::unordered_map<uint32_t, AhAttr> ahs_;
+  uint32_t next_ah_num_ = 1; // 由 ah_mutex_ 保护
+  RdmaCountedMutex tx_mutex_; // 端口发送串行化，保证包按PSN顺序上线
+
+  // RC请求端状态：尚未被确认的发送消息（按PSN顺序）及重传计数。
+  // 用于ACK/NAK处理、go-back-N 重传、冲刷和 SQD 排空检测
+  struct SendQueue {
+    std::deque<std::shared_ptr<OutboundMessage>> messages;
+    uint64_t timeout_ns = 0;  // ACK超时，0 表示不超时
+    uint8_t retry_cnt = 7;    // QP属性快照
+    uint8_t rnr_retry = 7;    // 7 表示无限重试
+    uint8_t retries_left = 7; // 收到新的确认时恢复为 retry_cnt
+    uint8_t rnr_left = 7;
+    uint64_t timer_epoch = 0; // ACK定时器/RNR等待的代号，过期的事件据此忽略
+    bool rnr_wait = false;    // 等待 RNR 定时器期间暂停发送
+  };
+  RdmaCountedMutex inflight_mutex_;
+  std::unordered_map<uint32_t, SendQueue> inflight_;
+  std::unordered_set<uint32_t> draining_; // 处于 SQD 且仍有未完成发送的QP
+  // draining_ 的大小，发送完成时无需加锁即可判断是否有QP在等待排空
+  std::atomic<size_t> draining_count_{0};
+  uint64_t next_timer_epoch_ = 0;         // 由 inflight_mutex_ 保护
 
-  // 网络处理线程
-  std::unique_ptr<std::thread> network_thread_;
-  std::atomic<bool> should_stop_;
+  // DCT 上每个已挂接DCI的响应端上下文，处理该DCI的包时换入 DCT 的 QPValue。
+  // 键为 (DCT << 32 | DCI)，由 qp_mutex_ 保护
+  struct DcStream {
+    uint32_t connect_psn; // 建立连接的首包PSN，重传的连接包据此识别
+    uint32_t rq_psn;
+    bool nak_pending;
+    bool rx_in_progress;
+    RecvWqe rx_wqe;
+    WcStatus rx_status;
+  };
+  std::unordered_map<uint64_t, DcStream> dc_streams_;
+
+  // 状态迁移的后续工作：在 qp_mutex_ 内记录，释放锁后执行
+  struct QpTransition {
+    uint32_t qp_num;
+    QpState state;
+    uint32_t send_cq;
+    uint32_t recv_cq;
+    std::vector<CompletionEntry> recv_flush; // 被冲刷的接收WQE
+    // 发送队列未完成计数（含仍在引擎提交环中的WR），SQD 据此判断是否已排空
+    std::shared_ptr<std::atomic<uint32_t>> sq_outstanding;
+  };
+
+  // 异步事件队列，由 eventfd（信号量模式）通知
+  int async_fd_;
+  std::mutex async_mutex_;
+  std::deque<AsyncEvent> async_events_;
+
+  // 传输层统计
+  std::atomic<uint64_t> tx_messages_{0};
+  std::atomic<uint64_t> tx_packets_{0};
+  std::atomic<uint64_t> tx_bytes_{0};
+  std::atomic<uint64_t> rx_messages_{0};
+  std::atomic<uint64_t> rx_packets_{0};
+  std::atomic<uint64_t> rx_bytes_{0};
+  std::atomic<uint64_t> rx_out_of_sequence_{0};
+  std::atomic<uint64_t> rx_dropped_{0};
+  std::atomic<uint64_t> rx_duplicate_{0};
+  std::atomic<uint64_t> wire_time_ns_{0};
+  std::atomic<uint64_t> tx_retransmitted_{0};
+  std::atomic<uint64_t> seq_naks_{0};
+  std::atomic<uint64_t> rnr_naks_{0};
+  std::atomic<uint64_t> ack_timeouts_{0};
+  std::atomic<uint64_t> dc_connects_{0};
+  std::atomic<uint64_t> dc_disconnects_{0};
+  std::atomic<uint64_t> tier_delay_ns_{0};
+
+  // 其他线程经QP目录持有的本设备引用数，析构前等待其归零
+  std::atomic<uint32_t> owner_refs_{0};
+
+  // 性能计数器
+  RdmaPerfCounters counters_;
+
+  // 投递到完成的延迟统计开关与新建直方图的分桶参数
+  std::atomic<bool> latency_tracking_{false};
+  std::atomic<uint32_t> latency_sub_bits_{RDMA_HIST_SUB_BITS};
+  std::atomic<uint32_t> latency_max_bits_{RDMA_HIST_MAX_BITS};
+
+  // wait_cq 策略与统计
+  std::atomic<uint32_t> cq_wait_spin_ns_;
+  std::atomic<uint32_t> cq_wait_yield_ns_;
+  std::atomic<uint64_t> cq_wait_spin_{0};
+  std::atomic<uint64_t> cq_wait_yield_{0};
+  std::atomic<uint64_t> cq_wait_block_{0};
+  std::atomic<uint64_t> cq_wait_timeout_{0};
+
+  // 端口链路模型
+  RdmaLinkModel link_;
+
+  // 发送处理引擎：提交环中的一项是一条已分配PSN的消息及QP的重传属性
+  struct EngineWork {
+    OutboundMessage out;
+    uint8_t timeout = 0;
+    uint8_t retry_cnt = 0;
+    uint8_t rnr_retry = 0;
+  };
+  struct Engine {
+    explicit Engine(size_t entries) : ring(entries) {}
+    RdmaMpscRing<EngineWork> ring;
+    std::thread thread;
+    std::atomic<bool> sleeping{false}; // 引擎阻塞等待时为真，生产者据此唤醒
+    std::mutex idle_mutex;
+    std::condition_variable idle_cv;
+    // 门铃记录：生产者写入的环位置上限，引擎只取其之前的WQE
+    alignas(64) std::atomic<size_t> doorbell{0};
+    std::atomic<uint64_t> doorbells{0};
+    std::atomic<uint64_t> ring_full{0};
+    // 引擎线程写的计数与生产者写的计数分处不同缓存行
+    alignas(64) std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> bursts{0};
+    std::atomic<uint64_t> sleeps{0};
+    int cpu = -1;
+  };
+  std::vector<std::unique_ptr<Engine>> engines_;
+  std::atomic<bool> engines_stop_{false};
+  uint32_t engine_spin_polls_ = 0;
+  uint32_t engine_burst_ = 1;
 
   // 设备配置
   size_t max_connections_;
 
   // 内部辅助函数
-  void network_thread_func();
+  void engine_loop(Engine &engine);
+  // 投递 wrs 的前 count 条，返回成功投递的条数
+  size_t post_send_n(uint32_t qp_num, const RdmaWorkRequest *wrs, size_t count);
+  // 校验WR并为消息分配PSN，调用方需持有 qp_mutex_。engine 非空时消息写入
+  // QP所属引擎的提交环，并返回该引擎及写入后的生产者索引
+  bool submit_send_locked(uint32_t qp_num, const RdmaWorkRequest &wr,
+                          EngineWork &work, Engine **engine,
+                          size_t *producer_index);
+  // 推进引擎的门铃记录，引擎阻塞时唤醒
+  void ring_doorbell(Engine &engine, size_t producer_index);
+  void stop_engines();
   bool validate_qp_transition(QpState current_state, QpState new_state);
+  bool validate_sge(const RdmaSge &sge);
+  bool build_send_wqe(const QPValue &qp, const RdmaWorkRequest &wr,
+                      SendWqe &wqe);
+  // 在设备/中间缓存/主机三层中定位QP并执行 fn，调用方需持有 qp_mutex_
+  template <typename Fn> bool with_qp(uint32_t qp_num, Fn &&fn);
+  // 在设备/中间缓存/主机三层中定位CQ并执行 fn，调用方需持有 cq_mutex_
+  template <typename Fn> bool with_cq(uint32_t cq_num, Fn &&fn);
+  // CQ是否存在于任一层，调用方需持有 cq_mutex_
+  bool cq_exists_locked(uint32_t cq_num);
+  // poll_cq 的主体（含计数），调用方需持有 cq_mutex_
+  bool poll_cq_locked(uint32_t cq_num, std::vector<CompletionEntry> &completions,
+                      uint32_t max_entries);
+  // 依次从设备/中间缓存/主机三层取出完成，调用方需持有 cq_mutex_
+  bool take_completions_locked(uint32_t cq_num,
+                               std::vector<CompletionEntry> &completions,
+                               uint32_t max_entries);
+  // post_ns 非0时把各完成相对该投递时刻的延迟记入CQ的直方图
+  void push_completions(uint32_t cq_num, const CompletionEntry *completions,
+                        size_t count, bool solicited = false,
+                        uint64_t post_ns = 0);
+  void push_completion(uint32_t cq_num, const CompletionEntry &completion,
+                       bool solicited = false, uint64_t post_ns = 0);
+  void signal_comp_channel(uint32_t channel, uint32_t cq_num);
+  void notify_cq(uint32_t cq_num, CQValue &cq);
+  void cq_moderation_timeout(uint32_t cq_num, uint64_t epoch);
+  void raise_async_event(AsyncEventType type, uint32_t element);
+  void fail_qps_on_cq(uint32_t cq_num);
+  void enter_qp_state(QPValue &qp, QpState new_state,
+                      std::vector<QpTransition> &transitions);
+  void finish_qp_transitions(std::vector<QpTransition> &transitions);
+  RxResponse receive_packet(const RdmaPacket &pkt);
+  // 可靠连接的响应端处理（RC QP，或换入了DCI上下文的 DCT），调用方需持有 qp_mutex_
+  bool rc_receive_locked(QPValue &qp, const RdmaPacket &pkt,
+                         RxResponse &response, CompletionEntry &completion,
+                         bool &completed);
+  // DCT 撤销 DCI 的连接上下文（DCI 切换目标时调用）
+  void dc_detach(uint32_t dct, uint32_t dci);
+  // 记录一次层访问延迟，按配置休眠
+  void charge_delay_ns(uint32_t ns);
+  // QP上下文所在层的访问延迟，调用方需持有 qp_mutex_
+  uint32_t qp_tier_delay_ns(uint32_t qp_num) const;
+  void complete_send(const OutboundMessage &out);
+  // 消息完成、出错或被冲刷时归还其占用的发送队列槽位，
+  // 返回 true 表示归还的是该QP最后一个未完成的槽位
+  static bool release_send_slot(const OutboundMessage &out);
+  std::shared_ptr<RdmaLatencyHistogram> make_latency_histogram() const;
+  // 已分配PSN的消息上线：非数据操作直接完成，RC消息进入请求端队列或同步投递。
+  // 由 post_send（持有 tx_mutex_）或消息所属的引擎线程调用
+  void transmit(OutboundMessage &out, uint8_t timeout, uint8_t retry_cnt,
+                uint8_t rnr_retry);
+  // 无链路模型时逐包同步投递一条消息，返回首包的处理结果
+  RxResponse deliver_message(const OutboundMessage &msg);
+  // DCI 断开旧目标：通知目标所在设备撤销连接上下文
+  void dc_disconnect(uint32_t dct, uint32_t dci);
+  // RC请求端：以下调用方需持有 inflight_mutex_
+  void enqueue_packets(uint32_t qp_num, const std::shared_ptr<OutboundMessage> &msg,
+                       uint32_t start, bool &arm);
+  void retransmit_from(uint32_t qp_num, SendQueue &queue, uint32_t psn,
+                       uint64_t now_ns);
+  void arm_ack_timer(uint32_t qp_num, SendQueue &queue, uint64_t now_ns);
+  bool start_rnr_wait(uint32_t qp_num, SendQueue &queue, uint32_t psn,
+                      uint64_t delay_ns, uint64_t now_ns);
+  // RC请求端：确认/NAK/定时器事件
+  void on_ack(uint32_t qp_num, uint32_t psn, uint64_t now_ns);
+  void on_nak(uint32_t qp_num, uint32_t psn, uint64_t now_ns);
+  void on_rnr_nak(uint32_t qp_num, uint32_t psn, uint64_t delay_ns,
+                  uint64_t now_ns);
+  void on_ack_timeout(uint32_t qp_num, uint64_t epoch, uint64_t now_ns);
+  void rnr_resume(uint32_t qp_num, uint32_t psn, uint64_t epoch,
+                  uint64_t now_ns);
+  void sync_redeliver(uint32_t qp_num, uint64_t now_ns);
+  void fail_requester(uint32_t qp_num, WcStatus status);
+  void link_egress(uint64_t now_ns);
+  void link_arrive(const WirePacket &packet, uint64_t now_ns);
+  void link_deliver(const WirePacket &packet, uint64_t now_ns);
+
+  // QP目录查找结果：在目录锁内登记对目的设备的引用，离开作用域时释放，
+  // 保证投递期间目的设备不会被析构
+  class OwnerRef {
+  public:
+    OwnerRef() = default;
+    explicit OwnerRef(RdmaDevice *device) : device_(device) {}
+    OwnerRef(const OwnerRef &) = delete;
+    OwnerRef &operator=(const OwnerRef &) = delete;
+    ~OwnerRef() {
+      if (device_ != nullptr) {
+        device_->owner_refs_.fetch_sub(1, std::memory_order_release);
+      }
+    }
+    RdmaDevice *get() const { return device_; }
+    RdmaDevice *operator->() const { return device_; }
+    explicit operator bool() const { return device_ != nullptr; }
+
+  private:
+    RdmaDevice *device_ = nullptr;
+  };
+  static OwnerRef lookup_qp_owner(uint32_t qp_num);
   void cleanup_resources();
 
   // 模拟配置（全局）
@@ -139,6 +640,7 @@ private:
   static std::atomic<uint32_t> host_swap_delay_ns_;
   static std::atomic<uint32_t> device_delay_ns_;
   static std::atomic<uint32_t> middle_delay_ns_;
+  static std::atomic<bool> sleep_on_delay_;
 };
 
 #endif // RDMA_DEVICE_H
\ No newline at end of file
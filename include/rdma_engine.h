@@ -0,0 +1,113 @@
+#ifndef RDMA_ENGINE_H
+#define RDMA_ENGINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// 设备处理引擎配置
+struct EngineConfig {
+  uint32_t num_engines = 0;     // 0 表示不启用引擎，数据在 post_send 内同步投递
+  std::vector<int> cpu_cores;   // 引擎 i 绑定到 cpu_cores[i % size]，为空时不绑核
+  // 每个引擎提交环的槽数，向上取整到2的幂。发送完成由引擎异步产生，
+  // 应用未及时回收时CQ中最多多出一个环的完成，CQ深度应留出相应余量
+  uint32_t ring_entries = 1024;
+  uint32_t spin_polls = 4096;   // 门铃未前进时，阻塞前的忙轮询次数
+  uint32_t wqe_prefetch_burst = 8; // 每次从提交环取回的最大WQE数
+};
+
+// 单个引擎的统计
+struct EngineStats {
+  uint64_t messages;  // 处理的发送消息（WQE）数
+  uint64_t doorbells; // 应用敲门铃（推进门铃记录）的次数
+  uint64_t bursts;    // 引擎成批取回WQE的次数
+  uint64_t ring_full; // 提交环已满而被拒绝的WR数
+  uint64_t sleeps;    // 空闲阻塞次数
+  int cpu;            // 绑定的CPU，-1 表示未绑定或绑定失败
+};
+
+/**
+ * @brief 有界多生产者单消费者无锁环
+ *
+ * 每个槽带一个序号（参照 Vyukov 的有界队列）：生产者以 CAS 认领写位置，
+ * 写完后发布序号；唯一的消费者按序号判断槽是否就绪，不需要任何锁。
+ * 生产者为投递WR的应用线程，消费者为引擎线程。
+ */
+template <typename T> class RdmaMpscRing {
+public:
+  explicit RdmaMpscRing(size_t entries) {
+    size_t size = 1;
+    while (size < entries) {
+      size <<= 1;
+    }
+    cells_.reset(new Cell[size]);
+    for (size_t i = 0; i < size; ++i) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+    mask_ = size - 1;
+  }
+
+  /**
+   * @brief 写入一项，环满时返回 false（可由多个线程并发调用）
+   * @param position 非空时返回写入的环位置（单调递增，不取模）
+   */
+  bool push(const T &item, size_t *position = nullptr) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = cells_[pos & mask_];
+      const size_t seq = cell.seq.load(std::memory_order_acquire);
+      const intptr_t diff =
+          static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          cell.value = item;
+          cell.seq.store(pos + 1, std::memory_order_release);
+          if (position != nullptr) {
+            *position = pos;
+          }
+          return true;
+        }
+      } else if (diff < 0) {
+        return false; // 消费者尚未取走一圈之前的数据
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * @brief 取出一项，环空时返回 false（只能由消费者线程调用）
+   */
+  bool pop(T &item) {
+    Cell &cell = cells_[head_ & mask_];
+    if (cell.seq.load(std::memory_order_acquire) != head_ + 1) {
+      return false;
+    }
+    item = cell.value;
+    cell.seq.store(head_ + mask_ + 1, std::memory_order_release);
+    ++head_;
+    return true;
+  }
+
+  // 只能由消费者线程调用
+  bool empty() const {
+    return cells_[head_ & mask_].seq.load(std::memory_order_acquire) !=
+           head_ + 1;
+  }
+
+private:
+  struct alignas(64) Cell {
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_ = 0;
+  alignas(64) std::atomic<size_t> tail_{0}; // 生产者共享
+  alignas(64) size_t head_ = 0;             // 消费者独占
+};
+
+#endif // RDMA_ENGINE_H
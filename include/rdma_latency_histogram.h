@@ -0,0 +1,99 @@
+#ifndef RDMA_LATENCY_HISTOGRAM_H
+#define RDMA_LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 默认精度：每个2的幂区间划分 2^5=32 个线性子桶，桶宽相对误差不超过 1/32
+constexpr uint32_t RDMA_HIST_SUB_BITS = 5;
+// 默认覆盖范围：可区分的最大值为 2^40-1 ns（约18分钟），更大的值计入最后一个桶
+constexpr uint32_t RDMA_HIST_MAX_BITS = 40;
+// 子桶位数与覆盖位数的取值上限，超出时截断
+constexpr uint32_t RDMA_HIST_MAX_SUB_BITS = 10;
+constexpr uint32_t RDMA_HIST_LIMIT_BITS = 63;
+constexpr size_t RDMA_HIST_BUCKETS =
+    (size_t{1} << RDMA_HIST_SUB_BITS) *
+    (RDMA_HIST_MAX_BITS - RDMA_HIST_SUB_BITS + 1);
+
+// 延迟分布快照
+struct RdmaLatencySnapshot {
+  std::vector<uint64_t> counts; // 各桶计数，空表示没有样本
+  uint32_t sub_bits = RDMA_HIST_SUB_BITS; // 直方图的子桶位数，决定桶边界
+  uint64_t count = 0;
+  uint64_t min_ns = 0;
+  uint64_t max_ns = 0;
+  uint64_t sum_ns = 0;
+
+  double mean_ns() const {
+    return count > 0 ? static_cast<double>(sum_ns) / count : 0.0;
+  }
+
+  /**
+   * @brief 百分位值（纳秒）
+   * @param percentile 0~100，例如 99.9
+   * @return 该百分位所在桶的上界（不超过 max_ns），与真实值的相对误差
+   *         不超过桶宽；没有样本时返回0
+   */
+  uint64_t value_at(double percentile) const;
+
+  /**
+   * @brief 格式化为 "count=... min=... p50=... p90=... p99=... p99.9=...
+   *        max=..."（微秒）
+   */
+  std::string to_string() const;
+};
+
+/**
+ * @brief 对数-线性延迟直方图（HdrHistogram 风格）
+ *
+ * 小于 2^sub_bits 的值每个值一桶；更大的值按所在的2的幂区间再均分为
+ * 2^sub_bits 个子桶，桶宽与值成比例，固定内存即可覆盖纳秒到分钟的范围
+ * 而不保存样本。桶数为 2^sub_bits * (max_bits - sub_bits + 1)，默认参数下
+ * 为 1152 个（约9KB）；大量QP同时统计时可降低精度或覆盖范围以节省内存。
+ * 记录是若干次 relaxed 原子操作，可由多个线程并发调用；
+ * 快照与记录并发时各字段之间可能相差正在进行的样本。
+ */
+class RdmaLatencyHistogram {
+public:
+  /**
+   * @param sub_bits 每个2的幂区间的子桶位数，截断到 [1, RDMA_HIST_MAX_SUB_BITS]
+   * @param max_bits 可区分的最大值为 2^max_bits-1 ns，
+   *        截断到 [sub_bits+1, RDMA_HIST_LIMIT_BITS]
+   */
+  explicit RdmaLatencyHistogram(uint32_t sub_bits = RDMA_HIST_SUB_BITS,
+                                uint32_t max_bits = RDMA_HIST_MAX_BITS);
+
+  void record(uint64_t value_ns);
+  RdmaLatencySnapshot snapshot() const;
+  void reset();
+
+  uint32_t sub_bits() const { return sub_bits_; }
+  uint32_t max_bits() const { return max_bits_; }
+  size_t bucket_count() const { return num_buckets_; }
+
+  static size_t bucket_count(uint32_t sub_bits, uint32_t max_bits);
+  static size_t bucket_index(uint64_t value_ns,
+                             uint32_t sub_bits = RDMA_HIST_SUB_BITS,
+                             uint32_t max_bits = RDMA_HIST_MAX_BITS);
+  // 桶内可表示的最小值与最大值
+  static uint64_t bucket_lower(size_t index,
+                               uint32_t sub_bits = RDMA_HIST_SUB_BITS);
+  static uint64_t bucket_upper(size_t index,
+                               uint32_t sub_bits = RDMA_HIST_SUB_BITS);
+
+private:
+  uint32_t sub_bits_;
+  uint32_t max_bits_;
+  size_t num_buckets_;
+  std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> min_{UINT64_MAX};
+  std::atomic<uint64_t> max_{0};
+};
+
+#endif // RDMA_LATENCY_HISTOGRAM_H
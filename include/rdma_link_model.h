@@ -0,0 +1,246 @@
+#ifndef RDMA_LINK_MODEL_H
+#define RDMA_LINK_MODEL_H
+
+#include "rdma_types.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 端口发送调度策略
+enum class EgressScheduler : uint8_t {
+  ROUND_ROBIN = 0, // 按包在活跃QP间轮转
+  WEIGHTED = 1     // 按字节加权公平（权重越大分得的带宽越多）
+};
+
+// DCQCN 拥塞控制参数（默认值取自 DCQCN 论文的推荐配置）
+struct DcqcnConfig {
+  bool enabled = false;                // 是否启用ECN标记/CNP/降速
+  uint32_t ecn_threshold_bytes = 65536; // 入口队列超过该深度时标记ECN
+  double g = 1.0 / 256;                // alpha 更新增益
+  uint64_t cnp_interval_ns = 50000;    // 接收端对同一QP发送CNP的最小间隔
+  uint64_t alpha_timer_ns = 55000;     // 未收到CNP时 alpha 衰减周期
+  uint64_t rate_timer_ns = 55000;      // 速率恢复周期
+  uint32_t fast_recovery_steps = 5;    // 快速恢复阶段的周期数
+  double rai_gbps = 0.04;              // 加性增速步长
+  double min_rate_gbps = 0.01;         // 降速下限
+};
+
+// 端口链路配置
+struct LinkConfig {
+  double bandwidth_gbps = 0;         // 链路速率，0 表示不限速
+  uint64_t propagation_delay_ns = 0; // 端口到交换机的单向传播时延
+  EgressScheduler scheduler = EgressScheduler::ROUND_ROBIN;
+  DcqcnConfig dcqcn;
+  // 数据包在线上丢失的概率（ACK/NAK 不丢失），由RC重传恢复
+  double loss_probability = 0;
+};
+
+// 端口统计
+struct LinkStats {
+  uint64_t tx_packets = 0;
+  uint64_t tx_bytes = 0; // 线上字节（含每包开销）
+  uint64_t rx_packets = 0;
+  uint64_t rx_bytes = 0;
+  uint64_t ecn_marked = 0;              // 入口队列标记ECN的包数
+  uint64_t cnp_sent = 0;                // 作为接收端发出的CNP
+  uint64_t cnp_received = 0;            // 作为发送端收到的CNP
+  uint64_t max_ingress_queue_bytes = 0; // 入口队列峰值深度
+  uint64_t ingress_queue_delay_ns = 0;  // 入口队列累计排队时延
+  uint64_t lost_packets = 0;            // 按丢包率在线上丢失的包数
+};
+
+// 发送中的消息：持有WQE副本直到对端确认，包描述符引用其中的SGE
+struct OutboundMessage {
+  SendWqe wqe;
+  RdmaSge inline_sge; // inline 消息的数据源，指向 wqe.inline_data
+  uint32_t send_cq;
+  uint32_t src_qp;
+  uint32_t dest_qp;
+  uint32_t first_psn;   // 消息占用的PSN区间 [first_psn, first_psn+num_packets)
+  uint32_t num_packets;
+  uint32_t mtu;
+  uint32_t sent = 0;    // 已首次上线的包数，之后再上线的包计为重传（仅链路线程访问）
+  bool flushed = false; // QP进入 ERR/RESET 时已被冲刷，确认到达时忽略
+  QpType qp_type = QpType::RC; // UD 消息上线即完成，对端不回确认
+  bool has_grh = false;
+  RdmaGrh grh; // UD：按地址句柄生成的GRH
+  bool dc_connect = false; // DCI 挂接到新目标后的第一条消息，首包携带连接请求
+  uint32_t detach_dct = 0; // DCI 切换目标时需先断开的旧目标（同步路径在投递前断开）
+  std::shared_ptr<RdmaLatencyHistogram> latency; // 源QP的延迟直方图，未统计时为空
+  std::shared_ptr<std::atomic<uint32_t>> sq_slot; // 源QP的未完成发送计数
+};
+
+// 在链路上传输的包
+struct WirePacket {
+  RdmaPacket pkt;
+  std::shared_ptr<OutboundMessage> msg;
+  bool ecn = false; // 经过拥塞队列时被标记
+};
+
+/**
+ * @brief 单个端口的链路模型
+ *
+ * 发送侧按QP维护发送队列，由调度器（轮转/加权）决定下一个上线的包，
+ * 端口按链路速率串行化；启用 DCQCN 时每个QP另有速率限制。
+ * 接收侧把入口队列（交换机到本端口的出队列）建模为按链路速率排空的单服务台，
+ * 队列深度超过阈值时标记ECN。所有时间均由调用方以纳秒传入。
+ */
+class RdmaLinkModel {
+public:
+  explicit RdmaLinkModel(const LinkConfig &config = LinkConfig());
+
+  void configure(const LinkConfig &config);
+  LinkConfig config() const;
+
+  /**
+   * @brief 是否需要经过定时的链路路径（配置了带宽、传播时延或丢包率）
+   */
+  bool timed() const;
+
+  /**
+   * @brief 线上字节数在本端口速率下的串行化时间
+   */
+  uint64_t serialize_ns(uint32_t wire_bytes) const;
+
+  // 发送侧
+  /**
+   * @brief 包加入QP的发送队列
+   * @return true 表示发送调度此前处于空闲，调用方需要安排一次发送事件
+   */
+  bool enqueue(uint32_t qp_num, WirePacket packet);
+
+  /**
+   * @brief 在 now_ns 时刻尝试让一个包上线
+   * @param done_ns 包串行化完成的时刻
+   * @param retry_ns 没有可发送的包时，下一次可能发送的时刻；0 表示队列已空
+   */
+  bool dequeue(uint64_t now_ns, WirePacket &packet, uint64_t &done_ns,
+               uint64_t &retry_ns);
+
+  void set_weight(uint32_t qp_num, uint32_t weight);
+  void remove_flow(uint32_t qp_num);
+
+  /**
+   * @brief 丢弃QP尚未上线的包（go-back-N 重传前调用），保留权重和 DCQCN 状态
+   * @return 被丢弃的包数
+   */
+  size_t purge_flow(uint32_t qp_num);
+
+  /**
+   * @brief 按配置的丢包率抽样，决定刚上线的包是否在线上丢失
+   */
+  bool lose_packet();
+  void on_cnp(uint32_t qp_num, uint64_t now_ns);
+  double flow_rate_gbps(uint32_t qp_num, uint64_t now_ns);
+
+  // 接收侧
+  /**
+   * @brief 包在 arrival_ns 到达入口队列
+   * @param ecn_marked 输出：排队深度超过阈值时置为 true
+   * @return 包离开入口队列的时刻
+   */
+  uint64_t ingress_admit(uint32_t wire_bytes, uint64_t arrival_ns,
+                         bool &ecn_marked);
+
+  /**
+   * @brief 收到被标记的包后是否向源QP发送CNP（按QP限频）
+   */
+  bool should_send_cnp(uint32_t src_qp, uint64_t now_ns);
+
+  LinkStats stats() const;
+
+private:
+  struct Flow {
+    std::deque<WirePacket> queue;
+    uint32_t weight = 1;
+    bool active = false;      // 是否在活跃列表中
+    double finish_tag = 0;    // 加权公平调度的虚拟完成时间
+    uint64_t next_send_ns = 0; // DCQCN 限速下次可发送时刻
+    // DCQCN 发送端（RP）状态
+    double rate_gbps = 0; // 当前速率，0 表示以线速发送
+    double target_gbps = 0;
+    double alpha = 1.0;
+    uint64_t alpha_ts = 0;
+    uint64_t rate_ts = 0;
+    uint32_t stage = 0;
+  };
+
+  Flow *pick_flow(uint64_t now_ns, uint64_t &retry_ns, size_t &index);
+  void update_rate(Flow &flow, uint64_t now_ns) const;
+
+  mutable std::mutex mutex_;
+  LinkConfig config_;
+  std::unordered_map<uint32_t, Flow> flows_;
+  std::deque<uint32_t> active_; // 有待发送包的QP，轮转顺序
+  bool egress_armed_ = false;
+  uint64_t port_busy_until_ = 0;
+  double virtual_time_ = 0; // 加权公平调度的系统虚拟时间
+
+  uint64_t ingress_busy_until_ = 0;
+  std::unordered_map<uint32_t, uint64_t> last_cnp_ns_;
+  std::mt19937_64 loss_rng_; // 固定种子，同样的流量得到同样的丢包序列
+  LinkStats stats_;
+};
+
+/**
+ * @brief 全局链路事件引擎
+ *
+ * 所有端口共享一个按时间排序的事件堆，由单个线程严格按时间顺序执行，
+ * 并按实际时间节拍推进（事件不会早于其时间戳执行）。
+ * 回调收到的是事件时间戳而不是实际执行时刻，
+ * 因此即使执行线程落后于实际时间，模型的时序仍然准确。
+ */
+class RdmaFabric {
+public:
+  using Callback = std::function<void(uint64_t)>;
+
+  static RdmaFabric &instance();
+  static uint64_t now_ns();
+
+  /**
+   * @brief 在 time_ns 执行回调
+   * @param owner 事件所属对象，cancel(owner) 时一并移除
+   */
+  void schedule(uint64_t time_ns, const void *owner, Callback fn);
+
+  /**
+   * @brief 移除 owner 的所有待执行事件，并等待正在执行的回调结束
+   */
+  void cancel(const void *owner);
+
+  ~RdmaFabric();
+
+private:
+  RdmaFabric() = default;
+  void run();
+
+  struct Event {
+    uint64_t time_ns;
+    uint64_t seq; // 同一时刻按调度顺序执行
+    const void *owner;
+    Callback fn;
+  };
+  struct Later {
+    bool operator()(const Event &a, const Event &b) const {
+      return a.time_ns != b.time_ns ? a.time_ns > b.time_ns : a.seq > b.seq;
+    }
+  };
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::condition_variable idle_cv_;
+  std::vector<Event> events_; // 最小堆
+  uint64_t next_seq_ = 0;
+  bool running_ = false;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+#endif // RDMA_LINK_MODEL_H
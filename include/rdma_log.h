@@ -0,0 +1,137 @@
+#ifndef RDMA_LOG_H
+#define RDMA_LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <streambuf>
+#include <string_view>
+
+// 日志级别；调试构建定义了 DEBUG 宏，故级别名使用缩写
+enum class RdmaLogLevel : uint8_t {
+  TRACE = 0, // 数据路径上的逐WQE/逐包信息
+  DBG = 1,
+  INFO = 2,
+  WARN = 3,
+  ERR = 4,
+  OFF = 5
+};
+
+// 编译期级别：低于此级别的日志语句连同参数求值一起被删除
+// （0=TRACE ... 5=OFF），默认只保留 INFO 及以上
+#ifndef RDMA_LOG_COMPILE_LEVEL
+#define RDMA_LOG_COMPILE_LEVEL 2
+#endif
+
+// 单条日志的最大字节数（含级别前缀），超出部分截断
+constexpr size_t RDMA_LOG_MAX_LINE = 256;
+// 异步环形缓冲的槽数，写满时新日志被丢弃并计数
+constexpr size_t RDMA_LOG_RING_SLOTS = 1024;
+
+struct RdmaLogLineStream;
+
+// 日志统计
+struct RdmaLogStats {
+  uint64_t written; // 已交给输出端的日志数
+  uint64_t dropped; // 环形缓冲已满而丢弃的日志数
+};
+
+/**
+ * @brief 全局日志器
+ *
+ * 语句通过 RDMA_LOG_* 宏写入：先与编译期级别比较（不满足时整条语句被删除），
+ * 再与运行期级别比较（一次 relaxed 原子读）。启用的日志在调用线程中格式化到
+ * 线程局部的定长缓冲，默认异步模式下拷入多生产者环形缓冲后立即返回，
+ * 由后台线程写到输出端；环形缓冲写满时丢弃而不阻塞调用方。
+ * 运行期级别的初值在首次使用时取环境变量 RDMA_LOG_LEVEL
+ * （trace/debug/info/warn/error/off），此前调用过 set_level 则以其为准；
+ * 因此静态初始化期间写日志也能看到环境变量设置的级别。
+ */
+class RdmaLogger {
+public:
+  // 输出端：在后台线程（同步模式下在调用线程）中调用，text 不含换行
+  using Sink = std::function<void(RdmaLogLevel, std::string_view text)>;
+
+  static bool enabled(RdmaLogLevel level) {
+    uint8_t current = level_.load(std::memory_order_relaxed);
+    if (current == kLevelUnset) {
+      current = load_level();
+    }
+    return static_cast<uint8_t>(level) >= current;
+  }
+  static void set_level(RdmaLogLevel level);
+  static RdmaLogLevel level();
+
+  /**
+   * @brief 切换异步/同步输出；切换到同步前先写完环形缓冲中的日志
+   */
+  static void set_async(bool async);
+
+  /**
+   * @brief 替换输出端，nullptr 恢复默认（WARN 及以上写 stderr，其余写 stdout）
+   */
+  static void set_sink(Sink sink);
+
+  /**
+   * @brief 等待此前提交的日志全部写到输出端
+   */
+  static void flush();
+
+  static RdmaLogStats get_stats();
+
+  /**
+   * @brief 提交一条已格式化的日志，由 RdmaLogLine 调用
+   */
+  static void write(RdmaLogLevel level, const char *text, size_t length);
+
+private:
+  // 尚未读取环境变量；level_ 以常量初始化，不依赖静态初始化顺序
+  static constexpr uint8_t kLevelUnset = 0xFF;
+
+  static uint8_t load_level();
+
+  static std::atomic<uint8_t> level_;
+};
+
+/**
+ * @brief 一条日志的格式化缓冲，析构时提交
+ *
+ * 使用线程局部的定长缓冲和输出流，格式化过程不分配内存。日志参数中可以
+ * 再写日志（如调用本身会写日志的函数），嵌套的语句逐层使用各自的缓冲，
+ * 先于外层提交；超过线程局部缓冲层数的嵌套临时分配缓冲。
+ */
+class RdmaLogLine {
+public:
+  RdmaLogLine(RdmaLogLevel level, const char *file, int line);
+  ~RdmaLogLine();
+
+  RdmaLogLine(const RdmaLogLine &) = delete;
+  RdmaLogLine &operator=(const RdmaLogLine &) = delete;
+
+  std::ostream &stream();
+
+private:
+  RdmaLogLevel level_;
+  RdmaLogLineStream *line_;
+  bool owned_; // line_ 为超出嵌套层数时临时分配的缓冲
+};
+
+#define RDMA_LOG_AT(level, expr)                                               \
+  do {                                                                         \
+    if constexpr (static_cast<int>(level) >= RDMA_LOG_COMPILE_LEVEL) {         \
+      if (RdmaLogger::enabled(level)) {                                        \
+        RdmaLogLine rdma_log_line_(level, __FILE__, __LINE__);                 \
+        rdma_log_line_.stream() << expr;                                       \
+      }                                                                        \
+    }                                                                          \
+  } while (0)
+
+#define RDMA_LOG_TRACE(expr) RDMA_LOG_AT(RdmaLogLevel::TRACE, expr)
+#define RDMA_LOG_DEBUG(expr) RDMA_LOG_AT(RdmaLogLevel::DBG, expr)
+#define RDMA_LOG_INFO(expr) RDMA_LOG_AT(RdmaLogLevel::INFO, expr)
+#define RDMA_LOG_WARN(expr) RDMA_LOG_AT(RdmaLogLevel::WARN, expr)
+#define RDMA_LOG_ERROR(expr) RDMA_LOG_AT(RdmaLogLevel::ERR, expr)
+
+#endif // RDMA_LOG_H
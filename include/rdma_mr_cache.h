@@ -1,5 +1,6 @@
 #pragma once
 
+#include "rdma_cache_metrics.h"
 #include "rdma_types.h"
 #include <cstdint>
 #include <memory>
@@ -15,7 +16,12 @@ public:
   MRBlock *allocate_block(size_t size, uint32_t flags);
   void free_block(MRBlock *block);
 
+  // 命中/未命中/写入/淘汰计数与采样的访问延迟
+  RdmaCacheStats get_stats() const { return counters_.read(); }
+  void reset_stats() { counters_.reset(); }
+
 private:
   size_t cache_size_;
   std::unordered_map<uint32_t, MRValue> cache_;
+  RdmaCacheCounters counters_;
 };
\ No newline at end of file
@@ -0,0 +1,123 @@
+#ifndef RDMA_PERF_COUNTERS_H
+#define RDMA_PERF_COUNTERS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// 设备性能计数器（类似 ethtool -S / rdma statistic 的计数项）
+enum class RdmaCounter : uint32_t {
+  POST_SEND = 0,   // 成功投递的发送WR
+  POST_RECV,       // 成功投递的接收WR
+  POST_ERRORS,     // 被拒绝的WR
+  POST_SEND_BYTES, // 发送WR的负载字节数
+  CQE,             // 写入CQ的完成
+  CQE_ERRORS,      // 状态不是 SUCCESS 的完成
+  POLL_CQ,         // poll_cq 调用次数
+  POLL_CQ_EMPTY,   // 没有取到完成的 poll_cq
+  CQE_POLLED,      // poll_cq 取走的完成
+  QP_HIT_DEVICE,   // QP上下文访问命中设备表
+  QP_HIT_CACHE,    // 命中中间缓存
+  QP_HIT_HOST,     // 从主机交换表换入
+  QP_MISS,         // 三层均不存在
+  CQ_HIT_DEVICE,
+  CQ_HIT_CACHE,
+  CQ_HIT_HOST,
+  CQ_MISS,
+  QP_LOCK_CONTENDED, // 以下为各设备锁的竞争次数（加锁时锁已被占用）
+  CQ_LOCK_CONTENDED,
+  TX_LOCK_CONTENDED,
+  INFLIGHT_LOCK_CONTENDED,
+  COUNT
+};
+
+constexpr size_t RDMA_COUNTER_COUNT = static_cast<size_t>(RdmaCounter::COUNT);
+
+/**
+ * @brief 计数器名称（小写，形如 "qp_hit_host"）
+ */
+const char *rdma_counter_name(RdmaCounter counter);
+
+// 计数器快照
+struct RdmaPerfSnapshot {
+  std::array<uint64_t, RDMA_COUNTER_COUNT> values{};
+
+  uint64_t operator[](RdmaCounter counter) const {
+    return values[static_cast<size_t>(counter)];
+  }
+
+  /**
+   * @brief QP或CQ上下文访问中落在某一层的比例
+   * @param tier QP_HIT_* / QP_MISS 或 CQ_HIT_* / CQ_MISS，
+   *        分母为同组四项之和；其他计数器返回0
+   */
+  double tier_ratio(RdmaCounter tier) const;
+
+  /**
+   * @brief 按 "名称: 值" 每行一项格式化
+   * @param skip_zero 省略值为0的计数器
+   */
+  std::string to_string(bool skip_zero = true) const;
+};
+
+/**
+ * @brief 按线程分片的计数器组
+ *
+ * 每个分片独占缓存行，线程按首次使用的顺序轮流分到一个分片，
+ * 递增是对本线程分片的一次 relaxed 原子加，不同线程之间没有缓存行争用；
+ * 读取时汇总所有分片。线程数超过分片数时共用分片，计数仍然准确。
+ */
+class RdmaPerfCounters {
+public:
+  static constexpr size_t kStripes = 32;
+
+  void add(RdmaCounter counter, uint64_t n = 1) {
+    stripes_[stripe_index()]
+        .values[static_cast<size_t>(counter)]
+        .fetch_add(n, std::memory_order_relaxed);
+  }
+
+  void read(RdmaPerfSnapshot &snapshot) const;
+  void reset();
+
+private:
+  struct alignas(64) Stripe {
+    std::atomic<uint64_t> values[RDMA_COUNTER_COUNT] = {};
+  };
+  Stripe stripes_[kStripes];
+
+  static size_t stripe_index();
+};
+
+/**
+ * @brief 记录竞争次数的互斥锁
+ *
+ * 先 try_lock，失败时计一次竞争再阻塞加锁；无竞争时只比 std::mutex 多一次
+ * 失败分支的判断。满足 Lockable，可用于 lock_guard/unique_lock 和
+ * condition_variable_any。
+ */
+class RdmaCountedMutex {
+public:
+  void lock() {
+    if (!mutex_.try_lock()) {
+      contended_.fetch_add(1, std::memory_order_relaxed);
+      mutex_.lock();
+    }
+  }
+  bool try_lock() { return mutex_.try_lock(); }
+  void unlock() { mutex_.unlock(); }
+
+  uint64_t contended() const {
+    return contended_.load(std::memory_order_relaxed);
+  }
+  void reset_contended() { contended_.store(0, std::memory_order_relaxed); }
+
+private:
+  std::mutex mutex_;
+  std::atomic<uint64_t> contended_{0};
+};
+
+#endif // RDMA_PERF_COUNTERS_H
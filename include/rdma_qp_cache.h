@@ -1,9 +1,11 @@
 #pragma once
 
+#include "rdma_cache_metrics.h"
 #include "rdma_types.h"
 #include <cstdint>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 class RdmaQPCache {
 public:
@@ -12,8 +14,17 @@ public:
 
   bool get(uint32_t qp_num, QPValue &info);
   void set(uint32_t qp_num, const QPValue &info);
+  bool erase(uint32_t qp_num);
+  size_t size() const;
+  size_t capacity() const { return cache_size_; }
+  std::vector<uint32_t> keys() const;
+
+  // 命中/未命中/写入/淘汰计数与采样的访问延迟
+  RdmaCacheStats get_stats() const { return counters_.read(); }
+  void reset_stats() { counters_.reset(); }
 
 private:
   size_t cache_size_;
   std::unordered_map<uint32_t, QPValue> cache_;
+  RdmaCacheCounters counters_;
 };
\ No newline at end of file
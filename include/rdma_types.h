@@ -1,14 +1,38 @@
 #ifndef RDMA_TYPES_H
 #define RDMA_TYPES_H
 
+#include "rdma_latency_histogram.h"
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+// 设备支持的最大inline数据长度（字节），QP的inline阈值不能超过该值
+constexpr uint32_t RDMA_MAX_INLINE_DATA = 512;
+
+// 设备支持的每个WQE最大SGE数量，QP的max_sge不能超过该值
+constexpr uint32_t RDMA_MAX_SGE = 16;
+
+// 设备支持的每个QP发送/接收队列最大深度
+constexpr uint32_t RDMA_MAX_QP_WR = 32768;
+
+// 设备支持的最大CQ深度
+constexpr uint32_t RDMA_MAX_CQE = 4194303;
+
+// PSN 为24位序号，按模 2^24 回绕
+constexpr uint32_t RDMA_PSN_MASK = 0xFFFFFF;
+
+// 每个RoCEv2包除负载外的线上开销（字节）：前导码+帧间隙(20) + 以太网头和FCS(18)
+// + IPv4(20) + UDP(8) + BTH(12) + ICRC(4)
+constexpr uint32_t RDMA_PACKET_OVERHEAD_BYTES = 82;
+
 // RDMA操作类型
 enum class RdmaOpcode : uint8_t {
   SEND = 0,
@@ -30,39 +54,281 @@ enum class QpState : uint8_t {
   ERR = 6  // Error
 };
 
+// QP传输类型（取值与 ibv_qp_type 保持一致）
+enum class QpType : uint8_t {
+  RC = 2, // 可靠连接：绑定一个对端，按PSN确认和重传
+  UD = 4, // 不可靠数据报：每条消息通过地址句柄指定目的，不确认不重传
+  // 动态连接（mlx5dv 中是 IBV_QPT_DRIVER 的子类型，这里单独编号）：
+  // DCI 为发起端，按消息挂接到目标；DCT 为目标端，接受任意DCI的连接
+  DCI = 0xF0,
+  DCT = 0xF1
+};
+
+// QP 未显式指定处理引擎时按QP号散列
+constexpr uint16_t RDMA_ENGINE_AUTO = 0xFFFF;
+
+// UD 接收缓冲区开头为全局路由头预留的字节数
+constexpr uint32_t RDMA_GRH_BYTES = 40;
+
+// modify_qp 的属性掩码（取值与 ibv_qp_attr_mask 保持一致）
+enum QpAttrMask : uint32_t {
+  QP_ATTR_STATE = 1u << 0,
+  QP_ATTR_CUR_STATE = 1u << 1,
+  QP_ATTR_ACCESS_FLAGS = 1u << 3,
+  QP_ATTR_PKEY_INDEX = 1u << 4,
+  QP_ATTR_PORT = 1u << 5,
+  QP_ATTR_QKEY = 1u << 6,
+  QP_ATTR_AV = 1u << 7,
+  QP_ATTR_PATH_MTU = 1u << 8,
+  QP_ATTR_TIMEOUT = 1u << 9,
+  QP_ATTR_RETRY_CNT = 1u << 10,
+  QP_ATTR_RNR_RETRY = 1u << 11,
+  QP_ATTR_RQ_PSN = 1u << 12,
+  QP_ATTR_MAX_QP_RD_ATOMIC = 1u << 13,
+  QP_ATTR_MIN_RNR_TIMER = 1u << 15,
+  QP_ATTR_SQ_PSN = 1u << 16,
+  QP_ATTR_MAX_DEST_RD_ATOMIC = 1u << 17,
+  QP_ATTR_DEST_QPN = 1u << 20
+};
+
+// modify_qp 的属性，只有掩码中对应位被置上的字段生效
+struct QpAttr {
+  QpState qp_state = QpState::RESET;
+  QpState cur_qp_state = QpState::RESET; // 调用方认为的当前状态，用于校验
+  uint32_t qp_access_flags = 0;
+  uint16_t pkey_index = 0;
+  uint8_t port_num = 1;
+  // 地址向量（AV）
+  uint16_t dlid = 0;
+  std::array<uint8_t, 16> dgid{};
+  uint32_t path_mtu = 1024;
+  uint8_t timeout = 14;       // 本地ACK超时，4.096us * 2^timeout
+  uint8_t retry_cnt = 7;      // 超时重传次数
+  uint8_t rnr_retry = 7;      // RNR重试次数，7 表示无限
+  uint8_t min_rnr_timer = 12; // 响应端通告的RNR等待时间编码
+  uint8_t max_rd_atomic = 1;
+  uint8_t max_dest_rd_atomic = 1;
+  uint32_t rq_psn = 0;
+  uint32_t sq_psn = 0;
+  uint32_t dest_qp_num = 0;
+  uint32_t qkey = 0; // UD：接收端只接受携带相同 Q_Key 的数据报；DCT：DC 访问密钥
+};
+
+// 地址句柄属性（对应 ibv_ah_attr）：UD 发送时按消息指定目的端口
+struct AhAttr {
+  uint16_t dlid = 0;
+  uint8_t port_num = 1;
+  bool is_global = false; // 是否携带GRH（跨子网及 RoCE 必需）
+  std::array<uint8_t, 16> dgid{};
+  uint32_t flow_label = 0;
+  uint8_t hop_limit = 64;
+  uint8_t traffic_class = 0;
+};
+
+// 全局路由头（IB GRH 线上格式，多字节字段为网络字节序）
+struct RdmaGrh {
+  uint32_t version_tclass_flow; // 版本(4) | 流量类别(8) | 流标签(20)
+  uint16_t paylen;              // GRH 之后的负载长度
+  uint8_t next_hdr;
+  uint8_t hop_limit;
+  std::array<uint8_t, 16> sgid;
+  std::array<uint8_t, 16> dgid;
+};
+static_assert(sizeof(RdmaGrh) == RDMA_GRH_BYTES, "GRH must be 40 bytes");
+
+// 完成状态（取值与 ibv_wc_status 保持一致）
+enum class WcStatus : uint32_t {
+  SUCCESS = 0,
+  LOC_LEN_ERR = 1,       // 接收缓冲区不足以容纳消息
+  LOC_QP_OP_ERR = 2,     // 本地QP操作错误
+  LOC_PROT_ERR = 4,      // 本地内存保护错误（lkey 无效或越界）
+  WR_FLUSH_ERR = 5,      // QP进入错误状态时被冲刷的WQE
+  REM_ACCESS_ERR = 10,   // 远端访问错误
+  RETRY_EXC_ERR = 12,    // 重传次数耗尽
+  RNR_RETRY_EXC_ERR = 13 // RNR重试次数耗尽
+};
+
 // 完成队列条目（统一 CompletionEntry 和 RdmaCompletion）
 struct CompletionEntry {
   uint64_t wr_id;    // 工作请求ID
-  uint32_t status;   // 完成状态
+  WcStatus status;   // 完成状态
   RdmaOpcode opcode; // 操作类型
-  uint32_t length;   // 数据长度
+  uint32_t length;   // 数据长度（UD 接收含 RDMA_GRH_BYTES 字节的GRH区）
   uint32_t imm_data; // 立即数据
+  uint32_t src_qp;   // UD 接收：发送方QP编号
+  bool grh;          // UD 接收：缓冲区开头的GRH区是否有效
+  uint64_t timestamp_ns; // 完成生成时刻（RdmaFabric::now_ns，类似 ibv_wc 的完成时间戳）
 
   CompletionEntry()
-      : wr_id(0), status(0), opcode(RdmaOpcode::SEND), length(0), imm_data(0) {}
+      : wr_id(0), status(WcStatus::SUCCESS), opcode(RdmaOpcode::SEND),
+        length(0), imm_data(0), src_qp(0), grh(false), timestamp_ns(0) {}
+};
+
+// 分散/聚合元素
+struct RdmaSge {
+  void *addr;      // 缓冲区地址
+  uint32_t length; // 缓冲区长度
+  uint32_t lkey;   // 本地内存key（0 表示保留的本地DMA key，不做MR检查）
 };
 
 // RDMA工作请求结构体
+// 本地缓冲区可以用 local_addr/length/lkey 描述单个缓冲区，
+// 也可以通过 sg_list/num_sge 描述多个缓冲区（num_sge > 0 时优先）
 struct RdmaWorkRequest {
-  RdmaOpcode opcode; // 操作类型
-  void *local_addr;  // 本地内存地址
-  uint32_t lkey;     // 本地内存key
-  uint32_t length;   // 数据长度
-  void *remote_addr; // 远程内存地址（用于RDMA操作）
-  uint32_t rkey;     // 远程内存key（用于RDMA操作）
-  uint32_t imm_data; // 立即数据（可选）
-  bool signaled;     // 是否产生完成事件
-  uint64_t wr_id;    // 工作请求ID
+  RdmaOpcode opcode;      // 操作类型
+  void *local_addr;       // 本地内存地址
+  uint32_t lkey;          // 本地内存key
+  uint32_t length;        // 数据长度
+  const RdmaSge *sg_list; // 分散/聚合列表（post期间有效即可）
+  uint32_t num_sge;       // SGE数量
+  void *remote_addr;      // 远程内存地址（用于RDMA操作）
+  uint32_t rkey;          // 远程内存key（用于RDMA操作）
+  uint32_t imm_data;      // 立即数据（可选）
+  bool signaled;          // 是否产生完成事件
+  bool send_inline;       // 是否inline发送（post时数据直接拷入WQE，不查lkey）
+  bool solicited;         // 接收端完成时触发 solicited-only 通知
+  uint64_t wr_id;         // 工作请求ID
+  // UD 发送的目的地址（对应 ibv_send_wr.wr.ud）
+  uint32_t ah;            // create_ah 返回的地址句柄
+  uint32_t remote_qpn;    // 目的QP编号（DCI 为目标 DCT 编号）
+  uint32_t remote_qkey;   // 目的QP的 Q_Key（DCI 为目标的 DC 访问密钥）
 
   RdmaWorkRequest()
       : opcode(RdmaOpcode::SEND), local_addr(nullptr), lkey(0), length(0),
-        remote_addr(nullptr), rkey(0), imm_data(0), signaled(true), wr_id(0) {}
+        sg_list(nullptr), num_sge(0), remote_addr(nullptr), rkey(0),
+        imm_data(0), signaled(true), send_inline(false), solicited(false),
+        wr_id(0), ah(0), remote_qpn(0), remote_qkey(0) {}
+};
+
+// 发送WQE：post_send 时由工作请求生成
+// SGE列表在post时拷贝进WQE；inline 请求的数据在post时即聚合到
+// inline_data 中（此时 num_sge 为0），源缓冲区随即可复用
+// 拷贝时只复制有效的SGE与 inline 数据，WQE在提交环和请求端队列之间
+// 按值传递时不搬运未用的部分
+struct SendWqe {
+  RdmaWorkRequest wr;                    // 工作请求副本
+  std::array<RdmaSge, RDMA_MAX_SGE> sge; // 聚合列表
+  uint32_t num_sge;                      // 有效SGE数量
+  uint32_t length;                       // 消息总长度
+  uint64_t post_ns; // 投递时刻（RdmaFabric::now_ns），0 表示不统计延迟
+  alignas(64) uint8_t inline_data[RDMA_MAX_INLINE_DATA]; // inline 数据
+
+  SendWqe() = default;
+  SendWqe(const SendWqe &other) { *this = other; }
+  SendWqe &operator=(const SendWqe &other) {
+    wr = other.wr;
+    num_sge = std::min(other.num_sge, RDMA_MAX_SGE);
+    length = other.length;
+    post_ns = other.post_ns;
+    std::copy_n(other.sge.begin(), num_sge, sge.begin());
+    if (wr.send_inline) {
+      std::memcpy(inline_data, other.inline_data,
+                  std::min(length, RDMA_MAX_INLINE_DATA));
+    }
+    return *this;
+  }
+};
+
+// 接收WQE：post_recv 时生成，按投递顺序被到达的消息消费
+struct RecvWqe {
+  uint64_t wr_id;                        // 工作请求ID
+  std::array<RdmaSge, RDMA_MAX_SGE> sge; // 分散列表
+  uint32_t num_sge;                      // 有效SGE数量
+  uint32_t length;                       // 可接收的总长度
+};
+
+// 线上数据包描述符：按 MTU 切分后的一个分段
+// 负载不做拷贝，src_sge 指向发送WQE的聚合列表（inline 时指向WQE内的数据），
+// 接收方按 offset 直接从源SGE分散到目的缓冲区
+struct RdmaPacket {
+  uint32_t src_qp;         // 源QP编号
+  uint32_t dest_qp;        // 目的QP编号
+  uint32_t psn;            // 包序号
+  RdmaOpcode opcode;       // 所属消息的操作类型
+  bool first;              // 是否为消息首包
+  bool last;               // 是否为消息尾包
+  uint32_t msg_length;     // 消息总长度
+  uint32_t offset;         // 负载在消息中的偏移
+  uint32_t payload_length; // 本包负载长度
+  void *remote_addr;       // RDMA_WRITE 的目的地址（消息起始）
+  uint32_t imm_data;       // 立即数据
+  bool solicited;          // 请求接收端产生 solicited 事件
+  const RdmaSge *src_sge;  // 负载来源
+  uint32_t num_src_sge;
+  bool src_inline;         // 来源是否为WQE内的 inline 数据
+  uint32_t qkey;           // UD：发送方指定的目的 Q_Key
+  const RdmaGrh *grh;      // UD：携带的GRH，nullptr 表示没有
+  bool dc_connect;         // DC：DCI 挂接到新目标后的首包，目标端据此建立连接上下文
+};
+
+// 响应端对一个入站包的处理结果，决定回给请求端的确认
+enum class RxVerdict : uint8_t {
+  ACCEPT = 0,    // 按序接收，尾包回ACK
+  DUPLICATE = 1, // 重传造成的重复包，回ACK（已收到的最后一个PSN）
+  NAK_SEQ = 2,   // 出现PSN缺口，回NAK要求从期望的PSN重传
+  NAK_RNR = 3,   // 消息首包到达时没有接收WQE，回 RNR NAK
+  DROP = 4       // 静默丢弃：QP不存在/状态不允许接收/同一缺口已NAK过
+};
+
+struct RxResponse {
+  RxVerdict verdict;
+  uint32_t psn;          // ACK/NAK 携带的PSN
+  uint64_t rnr_delay_ns; // NAK_RNR 时请求端的等待时间
+};
+
+// 传输层统计（按设备累计）
+struct TransportStats {
+  uint64_t tx_messages;        // 发出的消息数
+  uint64_t tx_packets;         // 发出的包数
+  uint64_t tx_bytes;           // 发出的负载字节数
+  uint64_t rx_messages;        // 重组完成的消息数
+  uint64_t rx_packets;         // 按序接收的包数
+  uint64_t rx_bytes;           // 接收的负载字节数
+  uint64_t rx_out_of_sequence; // PSN不连续而被丢弃的包数
+  uint64_t rx_dropped;         // 目的QP不存在或状态不允许接收而被丢弃的包数
+  uint64_t rx_duplicate;       // 重传造成的重复包数
+  uint64_t wire_time_ns;       // 按链路带宽折算的累计线上时间
+  uint64_t tx_retransmitted;   // 重传上线的包数
+  uint64_t seq_naks;           // 作为请求端收到的PSN序列错误 NAK
+  uint64_t rnr_naks;           // 作为请求端收到的 RNR NAK
+  uint64_t ack_timeouts;       // ACK超时触发的重传次数
+  uint64_t dc_connects;        // DCI 挂接到新目标的次数
+  uint64_t dc_disconnects;     // DCI 为切换目标而断开的次数
+  uint64_t tier_delay_ns;      // 设备/中间缓存/主机各层访问累计的模拟延迟
+};
+
+// 异步事件类型（取值参照 ibv_event_type 的子集）
+enum class AsyncEventType : uint8_t {
+  CQ_ERR = 0,  // CQ溢出，此后该CQ上的完成被丢弃
+  QP_FATAL = 1,  // QP因关联的CQ出错等原因被设备置为 ERR
+  SQ_DRAINED = 2 // 进入 SQD 的QP已没有在途的发送
+};
+
+// 异步事件：element 为事件涉及的CQ或QP编号
+struct AsyncEvent {
+  AsyncEventType type;
+  uint32_t element;
+};
+
+// wait_cq 的分阶段等待策略：先忙轮询，再让出CPU轮询，最后武装并阻塞
+struct CqWaitPolicy {
+  uint32_t spin_ns = 5000;   // 忙轮询预算
+  uint32_t yield_ns = 50000; // 忙轮询之后 yield 轮询的预算
+};
+
+// wait_cq 统计：每次等待由哪个阶段结束
+struct CqWaitStats {
+  uint64_t spin_completions;  // 忙轮询阶段取到完成
+  uint64_t yield_completions; // yield 阶段取到完成
+  uint64_t block_completions; // 阻塞后被唤醒取到完成
+  uint64_t timeouts;          // 超时未取到完成
 };
 
 // QP值结构体（统一 QPValue 和 RdmaQPInfo）
 struct QPValue {
   uint32_t qp_num;                    // 本地 QP 编号
-  uint32_t dest_qp_num;               // 对端 QP 编号
+  QpType qp_type;                     // 传输类型
+  uint32_t dest_qp_num;               // 对端 QP 编号（RC）/ 当前挂接的 DCT（DCI）
   uint16_t lid;                       // 本地 LID
   uint16_t remote_lid;                // 对端 LID
   uint8_t port_num;                   // 使用的端口
@@ -72,21 +338,56 @@ struct QPValue {
   std::array<uint8_t, 16> gid;        // 本地 GID（用于 RoCE）
   std::array<uint8_t, 16> remote_gid; // 对端 GID
   uint32_t mtu;                       // 最大传输单元
+  uint32_t max_send_wr;               // 发送队列深度
+  uint32_t max_recv_wr;               // 接收队列深度
+  uint32_t max_send_sge;              // 发送WQE最大SGE数
+  uint32_t max_recv_sge;              // 接收WQE最大SGE数
+  uint32_t max_inline_data;           // inline 发送阈值（字节）
+  uint32_t qkey;                      // UD 的 Q_Key / DCT 的 DC 访问密钥
+  uint16_t pkey_index;                // 分区键索引
+  uint8_t timeout;                    // 本地ACK超时编码
+  uint8_t retry_cnt;                  // 超时重传次数
+  uint8_t rnr_retry;                  // RNR重试次数
+  uint8_t min_rnr_timer;              // RNR等待时间编码
+  uint8_t max_rd_atomic;              // 作为发起端的并发 READ/原子 数
+  uint8_t max_dest_rd_atomic;         // 作为响应端的并发 READ/原子 数
   QpState state;                      // 当前状态
   uint32_t send_cq;                   // 发送完成队列
   uint32_t recv_cq;                   // 接收完成队列
+  uint16_t engine;                    // 处理发送队列的引擎
   std::chrono::steady_clock::time_point created_time;
 
   // 用于模拟数据传输的字段
-  void *recv_addr;                // 接收缓冲区地址
-  uint32_t recv_length;           // 接收缓冲区长度
-  std::vector<char> pending_data; // 待处理的数据（当接收缓冲区未准备好时）
+  std::deque<RecvWqe> recv_queue; // 已投递、尚未被消费的接收WQE
+
+  // 传输层状态
+  uint32_t sq_psn; // 下一个发送包的PSN
+  uint32_t rq_psn; // 期望收到的下一个PSN
+  // 正在重组的入站消息：由首包确定落点，后续包按偏移写入
+  bool rx_in_progress; // 已收到首包、尚未收到尾包
+  bool nak_pending;    // 已为当前缺口回过NAK，收到期望的PSN之前不再回NAK
+  RecvWqe rx_wqe;      // 首包消费的接收WQE
+  WcStatus rx_status;  // 消息的完成状态
+
+  // 发送队列中已投递、尚未完成（成功、出错或被冲刷）的WR数，达到 max_send_wr
+  // 时拒绝新的发送。首次投递时创建，由在途消息共享，完成时归还
+  std::shared_ptr<std::atomic<uint32_t>> sq_outstanding;
+
+  // 投递到完成的延迟直方图：开启统计后首次投递时创建，
+  // 在途消息持有引用，QP销毁后迟到的完成不会访问已释放的直方图
+  std::shared_ptr<RdmaLatencyHistogram> latency;
 
   QPValue()
-      : qp_num(0), dest_qp_num(0), lid(0), remote_lid(0), port_num(1),
-        qp_access_flags(0), psn(0), remote_psn(0), mtu(1024),
-        state(QpState::RESET), send_cq(0), recv_cq(0), recv_addr(nullptr),
-        recv_length(0) {
+      : qp_num(0), qp_type(QpType::RC), dest_qp_num(0), lid(0),
+        remote_lid(0), port_num(1), qp_access_flags(0), psn(0), remote_psn(0),
+        mtu(1024), max_send_wr(0), max_recv_wr(0), max_send_sge(1),
+        max_recv_sge(1), max_inline_data(0), qkey(0), pkey_index(0),
+        timeout(14), retry_cnt(7), rnr_retry(7), min_rnr_timer(12),
+        max_rd_atomic(1), max_dest_rd_atomic(1),
+        state(QpState::RESET), send_cq(0), recv_cq(0),
+        engine(RDMA_ENGINE_AUTO), sq_psn(0), rq_psn(0),
+        rx_in_progress(false), nak_pending(false), rx_wqe{},
+        rx_status(WcStatus::SUCCESS) {
     gid.fill(0);
     remote_gid.fill(0);
   }
@@ -121,6 +422,30 @@ struct CQValue {
   uint32_t cqe;
   uint32_t comp_vector;
   std::vector<CompletionEntry> completions;
+  uint32_t comp_channel = 0;   // 绑定的完成通道，0 表示未绑定
+  bool armed = false;          // req_notify_cq 已武装、尚未触发
+  bool solicited_only = false; // 仅在 solicited 或出错的完成上触发
+
+  // 通知合并（CQ moderation）：武装后累计 cq_count 个完成，
+  // 或首个完成之后经过 cq_period_us，二者先到者触发一次事件
+  uint16_t cq_count = 0;             // 0/1 表示不合并
+  uint32_t cq_period_us = 0;         // 0 表示不设超时
+  uint32_t moderation_target_us = 0; // 自适应目标通知时延，0 表示关闭自适应
+  uint32_t pending_notify = 0;       // 武装后尚未通知的完成数
+  uint64_t notify_epoch = 0;         // 每次触发递增，用于识别过期的超时
+  uint64_t notify_events = 0;        // 已投递的事件数
+  uint64_t window_completions = 0;   // 自适应观测窗口内的完成数
+  uint64_t window_start_ns = 0;      // 自适应观测窗口起点
+  double completion_rate = 0;        // 完成速率估计（个/微秒）
+
+  uint32_t waiters = 0; // 阻塞在 wait_cq 中的线程数，非0时新完成唤醒等待者
+
+  // 溢出：completions 达到 cqe 后CQ进入错误状态，后续完成计入丢弃数
+  bool overflowed = false;
+  uint64_t dropped_completions = 0;
+
+  // 发送完成的延迟直方图：开启统计后首个有时间戳的发送完成写入时创建
+  std::shared_ptr<RdmaLatencyHistogram> latency;
 };
 
 // 控制消息类型
@@ -128,7 +453,9 @@ enum class RdmaControlMsgType : uint8_t {
   CONNECT_REQUEST = 0,
   CONNECT_RESPONSE = 1,
   READY = 2,
-  ERROR = 3
+  ERROR = 3,
+  CONNECT_BATCH_REQUEST = 4, // 一次携带多个QP描述的连接请求
+  CONNECT_BATCH_RESPONSE = 5
 };
 
 // 控制消息结构体
@@ -137,8 +464,14 @@ struct RdmaControlMsg {
   QPValue qp_info;         // QP信息
   bool accept;             // 连接响应是否接受（用于CONNECT_RESPONSE）
   std::string error_msg;   // 错误信息（用于ERROR类型）
+  // 请求编号：响应回带请求的编号，多个请求同时在途时据此匹配
+  uint32_t request_id;
+  // 批量建链的QP描述（用于CONNECT_BATCH_*），响应按请求的顺序一一对应
+  std::vector<QPValue> qp_batch;
 
-  RdmaControlMsg() : type(RdmaControlMsgType::CONNECT_REQUEST), accept(false) {}
+  RdmaControlMsg()
+      : type(RdmaControlMsgType::CONNECT_REQUEST), accept(false),
+        request_id(0) {}
 };
 
 struct RdmaQPInfo {
@@ -0,0 +1,422 @@
+#include "../include/rdma_connection_manager.h"
+#include <utility>
+
+RdmaConnectionManager::RdmaConnectionManager(RdmaDevice &device)
+    : device_(device) {
+  RdmaControlPlane::Callbacks callbacks;
+  callbacks.on_connect = [this](ConnId id, bool ok) { on_connect(id, ok); };
+  callbacks.on_message_view = [this](ConnId id, const RdmaControlMsgView &msg) {
+    on_message(id, msg);
+  };
+  callbacks.on_close = [this](ConnId id) { on_close(id); };
+  plane_.set_callbacks(callbacks);
+}
+
+RdmaConnectionManager::~RdmaConnectionManager() { stop(); }
+
+void RdmaConnectionManager::set_error(const std::string &error) {
+  std::lock_guard<std::mutex> lock(error_mutex_);
+  error_msg_ = error;
+}
+
+std::string RdmaConnectionManager::get_error() const {
+  std::lock_guard<std::mutex> lock(error_mutex_);
+  return error_msg_;
+}
+
+bool RdmaConnectionManager::listen(uint16_t port, const RdmaCmParams &params,
+                                   ConnectionHandler on_established,
+                                   const std::string &ip) {
+  params_ = params;
+  on_established_ = std::move(on_established);
+  if (!plane_.listen(port, ip)) {
+    set_error(plane_.get_error());
+    return false;
+  }
+  return true;
+}
+
+uint16_t RdmaConnectionManager::listen_port() const {
+  return plane_.listen_port();
+}
+
+void RdmaConnectionManager::set_disconnect_handler(
+    DisconnectHandler on_disconnect) {
+  on_disconnect_ = std::move(on_disconnect);
+}
+
+bool RdmaConnectionManager::start() { return plane_.start(); }
+
+void RdmaConnectionManager::stop() {
+  plane_.stop();
+  // 事件循环已停止，未完成的建连不会再有进展
+  std::vector<std::pair<ConnId, Conn>> pending;
+  {
+    std::lock_guard<std::mutex> lock(conns_mutex_);
+    for (auto it = conns_.begin(); it != conns_.end();) {
+      if (it->second.established) {
+        ++it;
+        continue;
+      }
+      pending.emplace_back(it->first, std::move(it->second));
+      it = conns_.erase(it);
+    }
+  }
+  for (auto &entry : pending) {
+    plane_.close(entry.first);
+    abort(entry.first, std::move(entry.second),
+          "Connection manager stopped");
+  }
+}
+
+std::future<RdmaCmConnection>
+RdmaConnectionManager::connect(const std::string &ip, uint16_t port,
+                               const std::vector<uint32_t> &qps,
+                               ConnectionHandler on_done) {
+  std::promise<RdmaCmConnection> promise;
+  std::future<RdmaCmConnection> future = promise.get_future();
+  auto fail_now = [&](const std::string &error) {
+    RdmaCmConnection result;
+    result.error = error;
+    result.local_qps = qps;
+    set_error(error);
+    failed_.fetch_add(1, std::memory_order_relaxed);
+    if (on_done) {
+      on_done(result);
+    }
+    promise.set_value(std::move(result));
+    return std::move(future);
+  };
+
+  if (qps.empty() || qps.size() > RDMA_CONTROL_MAX_BATCH) {
+    return fail_now("Invalid QP count: " + std::to_string(qps.size()));
+  }
+  RdmaControlMsg request;
+  request.type = RdmaControlMsgType::CONNECT_BATCH_REQUEST;
+  request.qp_batch.resize(qps.size());
+  for (size_t i = 0; i < qps.size(); ++i) {
+    // 显式检查 RESET：INIT->INIT 也会成功，不能据此判断QP是否由本次调用移入
+    QPValue &info = request.qp_batch[i];
+    bool moved = device_.get_qp_info(qps[i], info) &&
+                 info.state == QpState::RESET &&
+                 device_.modify_qp_state(qps[i], QpState::INIT);
+    if (!moved || !device_.get_qp_info(qps[i], info)) {
+      // 只回滚本次调用移入 INIT 的QP，列表里正在使用的QP保持原状态
+      reset_qps(std::vector<uint32_t>(qps.begin(),
+                                      qps.begin() + (moved ? i + 1 : i)),
+                QpState::RESET);
+      return fail_now("QP " + std::to_string(qps[i]) +
+                      " is not in RESET state");
+    }
+  }
+
+  // 持锁提交连接和请求：事件循环的回调要等登记完成后才能查到这个连接
+  std::lock_guard<std::mutex> lock(conns_mutex_);
+  ConnId id = plane_.connect(ip, port);
+  if (id == 0) {
+    reset_qps(qps, QpState::RESET);
+    return fail_now(plane_.get_error());
+  }
+  Conn &conn = conns_[id];
+  conn.active = true;
+  conn.local_qps = qps;
+  conn.promise = std::move(promise);
+  conn.on_done = std::move(on_done);
+  // 控制面在连接建立后按序发出
+  plane_.send(id, request);
+  return future;
+}
+
+void RdmaConnectionManager::disconnect(ConnId id) {
+  Conn conn;
+  {
+    std::lock_guard<std::mutex> lock(conns_mutex_);
+    auto it = conns_.find(id);
+    if (it == conns_.end()) {
+      return;
+    }
+    conn = std::move(it->second);
+    conns_.erase(it);
+    if (conn.established) {
+      established_count_--;
+    }
+  }
+  plane_.close(id);
+  if (conn.established) {
+    reset_qps(conn.local_qps, QpState::ERR);
+    return;
+  }
+  abort(id, std::move(conn), "Disconnected");
+}
+
+size_t RdmaConnectionManager::connection_count() const {
+  std::lock_guard<std::mutex> lock(conns_mutex_);
+  return established_count_;
+}
+
+size_t RdmaConnectionManager::pending_count() const {
+  std::lock_guard<std::mutex> lock(conns_mutex_);
+  return conns_.size() - established_count_;
+}
+
+RdmaCmStats RdmaConnectionManager::get_stats() const {
+  RdmaCmStats stats;
+  stats.established = established_.load(std::memory_order_relaxed);
+  stats.failed = failed_.load(std::memory_order_relaxed);
+  stats.rejected = rejected_.load(std::memory_order_relaxed);
+  stats.disconnected = disconnected_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void RdmaConnectionManager::on_connect(ConnId id, bool ok) {
+  if (!ok) {
+    fail(id, "Failed to connect to peer: " + plane_.get_error());
+  }
+}
+
+void RdmaConnectionManager::on_message(ConnId id,
+                                       const RdmaControlMsgView &msg) {
+  switch (msg.type()) {
+  case RdmaControlMsgType::CONNECT_REQUEST:
+  case RdmaControlMsgType::CONNECT_BATCH_REQUEST:
+    handle_request(id, msg);
+    break;
+  case RdmaControlMsgType::CONNECT_RESPONSE:
+  case RdmaControlMsgType::CONNECT_BATCH_RESPONSE:
+    handle_response(id, msg);
+    break;
+  case RdmaControlMsgType::READY:
+    handle_ready(id);
+    break;
+  case RdmaControlMsgType::ERROR:
+    fail(id, "Peer error: " + std::string(msg.error_msg()));
+    break;
+  }
+}
+
+void RdmaConnectionManager::on_close(ConnId id) {
+  Conn conn;
+  {
+    std::lock_guard<std::mutex> lock(conns_mutex_);
+    auto it = conns_.find(id);
+    if (it == conns_.end()) {
+      return;
+    }
+    conn = std::move(it->second);
+    conns_.erase(it);
+    if (conn.established) {
+      established_count_--;
+    }
+  }
+  if (!conn.established) {
+    abort(id, std::move(conn), "Connection closed by peer");
+    return;
+  }
+  // 对端断开：在途WQE以 WR_FLUSH_ERR 完成，QP留给应用回收
+  reset_qps(conn.local_qps, QpState::ERR);
+  disconnected_.fetch_add(1, std::memory_order_relaxed);
+  if (on_disconnect_) {
+    on_disconnect_(id);
+  }
+}
+
+// 被动端：为请求中的每个远端QP创建本端QP并迁移到 RTS，一次应答
+void RdmaConnectionManager::handle_request(ConnId id,
+                                           const RdmaControlMsgView &msg) {
+  const bool batch = msg.type() == RdmaControlMsgType::CONNECT_BATCH_REQUEST;
+  const size_t count = batch ? msg.batch_size() : 1;
+  std::lock_guard<std::mutex> lock(conns_mutex_);
+  if (conns_.count(id) != 0) {
+    reject(id, msg, "Connection already in use");
+    return;
+  }
+  if (count == 0) {
+    reject(id, msg, "Empty connect request");
+    return;
+  }
+
+  std::vector<uint32_t> qps;
+  if (!device_.create_qp_batch(static_cast<uint32_t>(count),
+                               params_.max_send_wr, params_.max_recv_wr,
+                               params_.send_cq, params_.recv_cq, qps,
+                               params_.max_inline_data, params_.max_sge)) {
+    reject(id, msg, "Failed to create QPs");
+    return;
+  }
+
+  RdmaControlMsg response;
+  response.type = batch ? RdmaControlMsgType::CONNECT_BATCH_RESPONSE
+                        : RdmaControlMsgType::CONNECT_RESPONSE;
+  response.request_id = msg.request_id();
+  response.accept = true;
+  std::vector<QPValue> remotes(count);
+  if (batch) {
+    response.qp_batch.resize(count);
+  }
+  for (size_t i = 0; i < count; ++i) {
+    remotes[i] = batch ? msg.batch_qp(i) : msg.qp_info();
+    QPValue &local = batch ? response.qp_batch[i] : response.qp_info;
+    if (!bring_up(qps[i], remotes[i]) || !device_.get_qp_info(qps[i], local)) {
+      device_.destroy_qp_batch(qps);
+      reject(id, msg, "Failed to bring up QP");
+      return;
+    }
+  }
+
+  Conn &conn = conns_[id];
+  conn.local_qps = std::move(qps);
+  conn.remote_qps = std::move(remotes);
+  plane_.send(id, response);
+}
+
+// 主动端：按响应连接本端QP，迁移到 RTS 后发送 READY
+void RdmaConnectionManager::handle_response(ConnId id,
+                                            const RdmaControlMsgView &msg) {
+  const bool batch = msg.type() == RdmaControlMsgType::CONNECT_BATCH_RESPONSE;
+  const size_t count = batch ? msg.batch_size() : 1;
+  std::string error;
+  RdmaCmConnection result;
+  std::promise<RdmaCmConnection> promise;
+  ConnectionHandler on_done;
+  {
+    std::lock_guard<std::mutex> lock(conns_mutex_);
+    auto it = conns_.find(id);
+    if (it == conns_.end() || !it->second.active || it->second.established) {
+      return;
+    }
+    Conn &conn = it->second;
+    if (!msg.accept()) {
+      error = msg.error_msg().empty()
+                  ? std::string("Connection rejected")
+                  : "Connection rejected: " + std::string(msg.error_msg());
+    } else if (count != conn.local_qps.size()) {
+      error = "Unexpected QP count in response: " + std::to_string(count);
+    } else {
+      conn.remote_qps.resize(count);
+      for (size_t i = 0; i < count && error.empty(); ++i) {
+        conn.remote_qps[i] = batch ? msg.batch_qp(i) : msg.qp_info();
+        if (!bring_up(conn.local_qps[i], conn.remote_qps[i])) {
+          error = "Failed to bring up QP " +
+                  std::to_string(conn.local_qps[i]);
+        }
+      }
+    }
+    if (error.empty()) {
+      RdmaControlMsg ready;
+      ready.type = RdmaControlMsgType::READY;
+      ready.request_id = msg.request_id();
+      plane_.send(id, ready);
+      conn.established = true;
+      established_count_++;
+      result.id = id;
+      result.ok = true;
+      result.local_qps = conn.local_qps;
+      result.remote_qps = conn.remote_qps;
+      promise = std::move(conn.promise);
+      on_done = std::move(conn.on_done);
+    }
+  }
+  if (!error.empty()) {
+    fail(id, error);
+    return;
+  }
+  established_.fetch_add(1, std::memory_order_relaxed);
+  if (on_done) {
+    on_done(result);
+  }
+  promise.set_value(std::move(result));
+}
+
+// 被动端：主动端的QP已进入 RTS，连接建立
+void RdmaConnectionManager::handle_ready(ConnId id) {
+  RdmaCmConnection result;
+  {
+    std::lock_guard<std::mutex> lock(conns_mutex_);
+    auto it = conns_.find(id);
+    if (it == conns_.end() || it->second.active || it->second.established) {
+      return;
+    }
+    Conn &conn = it->second;
+    conn.established = true;
+    established_count_++;
+    result.id = id;
+    result.ok = true;
+    result.local_qps = conn.local_qps;
+    result.remote_qps = conn.remote_qps;
+  }
+  established_.fetch_add(1, std::memory_order_relaxed);
+  if (on_established_) {
+    on_established_(result);
+  }
+}
+
+bool RdmaConnectionManager::bring_up(uint32_t qp, const QPValue &remote) {
+  QPValue info;
+  if (!device_.get_qp_info(qp, info)) {
+    return false;
+  }
+  if (info.state == QpState::RESET &&
+      !device_.modify_qp_state(qp, QpState::INIT)) {
+    return false;
+  }
+  return device_.connect_qp(qp, remote) &&
+         device_.modify_qp_state(qp, QpState::RTR) &&
+         device_.modify_qp_state(qp, QpState::RTS);
+}
+
+void RdmaConnectionManager::reset_qps(const std::vector<uint32_t> &qps,
+                                      QpState state) {
+  for (uint32_t qp : qps) {
+    device_.modify_qp_state(qp, state);
+  }
+}
+
+void RdmaConnectionManager::reject(ConnId id, const RdmaControlMsgView &msg,
+                                   const std::string &error) {
+  RdmaControlMsg response;
+  response.type = msg.type() == RdmaControlMsgType::CONNECT_BATCH_REQUEST
+                      ? RdmaControlMsgType::CONNECT_BATCH_RESPONSE
+                      : RdmaControlMsgType::CONNECT_RESPONSE;
+  response.request_id = msg.request_id();
+  response.accept = false;
+  response.error_msg = error;
+  plane_.send(id, response);
+  set_error(error);
+  rejected_.fetch_add(1, std::memory_order_relaxed);
+}
+
+// 未建立的连接出错：关闭控制连接并清理
+void RdmaConnectionManager::fail(ConnId id, const std::string &error) {
+  Conn conn;
+  {
+    std::lock_guard<std::mutex> lock(conns_mutex_);
+    auto it = conns_.find(id);
+    if (it == conns_.end() || it->second.established) {
+      return;
+    }
+    conn = std::move(it->second);
+    conns_.erase(it);
+  }
+  plane_.close(id);
+  abort(id, std::move(conn), error);
+}
+
+// 已从连接表移除、尚未建立的连接：主动端重置QP并报告失败，被动端销毁QP
+void RdmaConnectionManager::abort(ConnId id, Conn &&conn,
+                                  const std::string &error) {
+  set_error(error);
+  if (!conn.active) {
+    device_.destroy_qp_batch(conn.local_qps);
+    return;
+  }
+  reset_qps(conn.local_qps, QpState::RESET);
+  failed_.fetch_add(1, std::memory_order_relaxed);
+  RdmaCmConnection result;
+  result.id = id;
+  result.error = error;
+  result.local_qps = std::move(conn.local_qps);
+  if (conn.on_done) {
+    conn.on_done(result);
+  }
+  conn.promise.set_value(std::move(result));
+}
@@ -1,283 +1,121 @@
 #include "../include/rdma_control_channel.h"
-#include <iostream>
-#include <thread>
+#include "../include/rdma_log.h"
+#include <chrono>
+#include <linux/errqueue.h>
+#include <unordered_map>
 
 RdmaControlChannel::RdmaControlChannel()
-    : socket_fd_(-1), server_socket_fd_(-1), client_socket_fd_(-1),
-      state_(ConnectionState::DISCONNECTED), peer_port_(0) {}
+    : state_(ConnectionState::DISCONNECTED), peer_port_(0),
+      next_request_id_(1), rx_offset_(0), rx_end_(0), zerocopy_threshold_(0),
+      zerocopy_seq_(0), stats_() {}
 
 RdmaControlChannel::~RdmaControlChannel() { close_connection(); }
 
 bool RdmaControlChannel::start_server(uint16_t port) {
+  return start_server(ControlTransportType::TCP,
+                      "0.0.0.0:" + std::to_string(port));
+}
+
+bool RdmaControlChannel::start_server(ControlTransportType type,
+                                      const std::string &address) {
   std::lock_guard<std::mutex> lock(mutex_);
 
-  std::cout << "Starting control channel server on port " << port << std::endl;
+  RDMA_LOG_INFO("Starting control channel server on " << address);
 
   if (state_ != ConnectionState::DISCONNECTED) {
     error_msg_ = "Cannot start server: Invalid state " +
                  std::to_string(static_cast<int>(state_));
-    std::cerr << error_msg_ << std::endl;
-    return false;
-  }
-
-  // 检查是否有旧的socket需要关闭
-  if (server_socket_fd_ >= 0) {
-    std::cout << "Closing existing server socket: " << server_socket_fd_
-              << std::endl;
-    close(server_socket_fd_);
-    server_socket_fd_ = -1;
-  }
-
-  // 创建服务器socket
-  server_socket_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-  if (server_socket_fd_ < 0) {
-    error_msg_ = "Failed to create socket: " + std::string(strerror(errno));
-    std::cerr << error_msg_ << std::endl;
-    state_ = ConnectionState::ERROR;
+    RDMA_LOG_WARN(error_msg_);
     return false;
   }
-  std::cout << "Created server socket: " << server_socket_fd_ << std::endl;
 
-  // 设置socket选项，允许地址重用
-  int opt = 1;
-  if (setsockopt(server_socket_fd_, SOL_SOCKET, SO_REUSEADDR, &opt,
-                 sizeof(opt)) < 0) {
-    error_msg_ =
-        "Failed to set socket options: " + std::string(strerror(errno));
-    std::cerr << error_msg_ << std::endl;
-    close(server_socket_fd_);
-    server_socket_fd_ = -1;
-    state_ = ConnectionState::ERROR;
-    return false;
-  }
-  std::cout << "Set SO_REUSEADDR option" << std::endl;
-
-  // 绑定地址和端口
-  struct sockaddr_in server_addr;
-  memset(&server_addr, 0, sizeof(server_addr));
-  server_addr.sin_family = AF_INET;
-  server_addr.sin_addr.s_addr = INADDR_ANY;
-  server_addr.sin_port = htons(port);
-
-  std::cout << "Binding to port " << port << " (INADDR_ANY)..." << std::endl;
-  if (bind(server_socket_fd_, (struct sockaddr *)&server_addr,
-           sizeof(server_addr)) < 0) {
-    error_msg_ = "Failed to bind socket: " + std::string(strerror(errno));
-    std::cerr << error_msg_ << std::endl;
-
-    // 检查端口是否已被占用
-    if (errno == EADDRINUSE) {
-      std::cerr << "Port " << port << " is already in use. Try another port."
-                << std::endl;
-    }
-
-    close(server_socket_fd_);
-    server_socket_fd_ = -1;
+  transport_ = make_control_transport(type);
+  if (!transport_->listen(address)) {
+    error_msg_ = transport_->get_error();
+    RDMA_LOG_WARN(error_msg_);
+    transport_.reset();
     state_ = ConnectionState::ERROR;
     return false;
   }
-  std::cout << "Successfully bound to port " << port << std::endl;
 
-  // 开始监听连接
-  std::cout << "Starting to listen for connections..." << std::endl;
-  if (listen(server_socket_fd_, 5) < 0) {
-    error_msg_ = "Failed to listen on socket: " + std::string(strerror(errno));
-    std::cerr << error_msg_ << std::endl;
-    close(server_socket_fd_);
-    server_socket_fd_ = -1;
-    state_ = ConnectionState::ERROR;
-    return false;
-  }
-
-  // 保持阻塞模式以确保可靠连接
   state_ = ConnectionState::CONNECTING;
-  std::cout << "Server successfully started on port " << port << std::endl;
+  RDMA_LOG_INFO("Server successfully started on "
+                << transport_->listen_address());
   return true;
 }
 
+std::string RdmaControlChannel::get_listen_address() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return transport_ ? transport_->listen_address() : std::string();
+}
+
 bool RdmaControlChannel::accept_connection(uint32_t timeout_ms) {
   std::lock_guard<std::mutex> lock(mutex_);
 
-  if (state_ != ConnectionState::CONNECTING || server_socket_fd_ < 0) {
-    std::cerr << "Invalid state for accepting connection. State: "
-              << static_cast<int>(state_) << ", Socket: " << server_socket_fd_
-              << std::endl;
+  if (state_ != ConnectionState::CONNECTING || !transport_) {
+    RDMA_LOG_WARN("Invalid state for accepting connection. State: "
+                  << static_cast<int>(state_));
     return false;
   }
 
-  std::cout << "Waiting for client connection..." << std::endl;
-
-  // 设置超时时间
-  const int MAX_RETRIES = 5;
-  const int RETRY_INTERVAL_MS = 1000;
-  int remaining_timeout = timeout_ms;
-
-  for (int retry = 0; retry < MAX_RETRIES; ++retry) {
-    struct pollfd pfd;
-    pfd.fd = server_socket_fd_;
-    pfd.events = POLLIN;
-
-    int poll_timeout =
-        (timeout_ms == 0)
-            ? -1
-            : (remaining_timeout > RETRY_INTERVAL_MS ? RETRY_INTERVAL_MS
-                                                     : remaining_timeout);
-
-    int poll_result = poll(&pfd, 1, poll_timeout);
-    if (poll_result < 0) {
-      std::cerr << "Poll error (attempt " << retry + 1
-                << "): " << strerror(errno) << std::endl;
-      continue;
-    } else if (poll_result == 0) {
-      std::cout << "Waiting for connection (attempt " << retry + 1 << ")..."
-                << std::endl;
-      if (timeout_ms > 0) {
-        remaining_timeout -= poll_timeout;
-        if (remaining_timeout <= 0) {
-          std::cerr << "Connection timeout after " << timeout_ms << "ms"
-                    << std::endl;
-          return false;
-        }
-      }
-      continue;
-    }
-
-    struct sockaddr_in client_addr;
-    socklen_t client_addr_len = sizeof(client_addr);
-
-    client_socket_fd_ = accept(
-        server_socket_fd_, (struct sockaddr *)&client_addr, &client_addr_len);
-    if (client_socket_fd_ < 0) {
-      std::cerr << "Accept failed (attempt " << retry + 1
-                << "): " << strerror(errno) << std::endl;
-      continue;
-    }
-
-    // 连接成功
-    char client_ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &(client_addr.sin_addr), client_ip, INET_ADDRSTRLEN);
-    std::cout << "Client connected from " << client_ip << ":"
-              << ntohs(client_addr.sin_port) << std::endl;
-
-    // 保存客户端IP地址
-    peer_address_ = client_ip;
-    peer_port_ = ntohs(client_addr.sin_port);
-
-    socket_fd_ = client_socket_fd_;
-    state_ = ConnectionState::CONNECTED;
-    return true;
+  RDMA_LOG_DEBUG("Waiting for client connection...");
+  if (!transport_->accept(timeout_ms)) {
+    error_msg_ = transport_->get_error();
+    RDMA_LOG_WARN(error_msg_);
+    return false;
   }
 
-  // 如果执行到这里，说明所有重试都失败了
-  error_msg_ = "Failed to accept connection after " +
-               std::to_string(MAX_RETRIES) + " attempts";
-  std::cerr << error_msg_ << std::endl;
-  state_ = ConnectionState::ERROR;
-  return false;
+  // 保存对端地址
+  peer_address_ = transport_->peer_address();
+  peer_port_ = transport_->peer_port();
+  state_ = ConnectionState::CONNECTED;
+  return true;
 }
 
 bool RdmaControlChannel::connect_to_server(const std::string &server_ip,
                                            uint16_t port) {
+  return connect_to_server(ControlTransportType::TCP,
+                           server_ip + ":" + std::to_string(port));
+}
+
+bool RdmaControlChannel::connect_to_server(ControlTransportType type,
+                                           const std::string &address) {
   std::lock_guard<std::mutex> lock(mutex_);
 
   if (state_ != ConnectionState::DISCONNECTED) {
-    std::cerr << "Invalid state for connecting to server. State: "
-              << static_cast<int>(state_) << std::endl;
+    RDMA_LOG_WARN("Invalid state for connecting to server. State: "
+                  << static_cast<int>(state_));
     return false;
   }
 
-  std::cout << "Connecting to server at " << server_ip << ":" << port
-            << std::endl;
+  RDMA_LOG_INFO("Connecting to server at " << address);
 
-  // 创建客户端socket
-  socket_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-  if (socket_fd_ < 0) {
-    error_msg_ = "Failed to create socket: " + std::string(strerror(errno));
-    std::cerr << error_msg_ << std::endl;
+  transport_ = make_control_transport(type);
+  if (!transport_->connect(address)) {
+    error_msg_ = transport_->get_error();
+    RDMA_LOG_WARN(error_msg_);
+    transport_.reset();
     state_ = ConnectionState::ERROR;
     return false;
   }
 
-  // 设置服务器地址
-  struct sockaddr_in server_addr;
-  memset(&server_addr, 0, sizeof(server_addr));
-  server_addr.sin_family = AF_INET;
-  server_addr.sin_port = htons(port);
-
-  if (inet_pton(AF_INET, server_ip.c_str(), &server_addr.sin_addr) <= 0) {
-    error_msg_ = "Invalid address: " + server_ip;
-    std::cerr << error_msg_ << std::endl;
-    close(socket_fd_);
-    socket_fd_ = -1;
-    state_ = ConnectionState::ERROR;
-    return false;
-  }
-
-  // 添加连接重试机制
-  const int MAX_RETRIES = 5;
-  const int RETRY_INTERVAL_MS = 1000;
-
-  for (int retry = 0; retry < MAX_RETRIES; ++retry) {
-    std::cout << "Attempting to connect (attempt " << retry + 1 << ")..."
-              << std::endl;
-
-    if (connect(socket_fd_, (struct sockaddr *)&server_addr,
-                sizeof(server_addr)) == 0) {
-      // 连接成功
-      std::cout << "Successfully connected to " << server_ip << ":" << port
-                << std::endl;
-      peer_address_ = server_ip;
-      peer_port_ = port;
-      state_ = ConnectionState::CONNECTED;
-      return true;
-    }
-
-    // 连接失败，记录错误并重试
-    error_msg_ = "Connection attempt " + std::to_string(retry + 1) +
-                 " failed: " + std::string(strerror(errno));
-    std::cerr << error_msg_ << std::endl;
-
-    // 最后一次尝试失败
-    if (retry == MAX_RETRIES - 1) {
-      close(socket_fd_);
-      socket_fd_ = -1;
-      state_ = ConnectionState::ERROR;
-      return false;
-    }
-
-    // 等待一段时间后重试
-    std::this_thread::sleep_for(std::chrono::milliseconds(RETRY_INTERVAL_MS));
-
-    // 重新创建socket
-    close(socket_fd_);
-    socket_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (socket_fd_ < 0) {
-      error_msg_ = "Failed to recreate socket: " + std::string(strerror(errno));
-      std::cerr << error_msg_ << std::endl;
-      state_ = ConnectionState::ERROR;
-      return false;
-    }
-  }
-
-  // 如果执行到这里，说明所有重试都失败了
-  error_msg_ =
-      "Failed to connect after " + std::to_string(MAX_RETRIES) + " attempts";
-  std::cerr << error_msg_ << std::endl;
-  state_ = ConnectionState::ERROR;
-  return false;
+  peer_address_ = transport_->peer_address();
+  peer_port_ = transport_->peer_port();
+  state_ = ConnectionState::CONNECTED;
+  return true;
 }
 
 bool RdmaControlChannel::send_connect_request(const QPValue &qp_info) {
-  std::cout << "Sending connect request with QP number: " << qp_info.qp_num
-            << std::endl;
+  RDMA_LOG_DEBUG("Sending connect request with QP number: "
+                 << qp_info.qp_num);
   RdmaControlMsg msg;
   msg.type = RdmaControlMsgType::CONNECT_REQUEST;
   msg.qp_info = qp_info;
   bool result = send_message(msg);
   if (result) {
-    std::cout << "Connect request sent successfully" << std::endl;
+    RDMA_LOG_DEBUG("Connect request sent successfully");
   } else {
-    std::cerr << "Failed to send connect request: " << error_msg_ << std::endl;
+    RDMA_LOG_WARN("Failed to send connect request: " << error_msg_);
   }
   return result;
 }
@@ -291,6 +129,94 @@ bool RdmaControlChannel::send_connect_response(const QPValue &qp_info,
   return send_message(msg);
 }
 
+bool RdmaControlChannel::send_connect_batch_request(
+    const std::vector<QPValue> &qps, uint32_t *request_id) {
+  if (qps.size() > RDMA_CONTROL_MAX_BATCH) {
+    error_msg_ = "Too many QPs in batch: " + std::to_string(qps.size());
+    return false;
+  }
+  RdmaControlMsg msg;
+  msg.type = RdmaControlMsgType::CONNECT_BATCH_REQUEST;
+  msg.request_id = next_request_id_++;
+  msg.qp_batch = qps;
+  if (request_id != nullptr) {
+    *request_id = msg.request_id;
+  }
+  return send_message(msg);
+}
+
+bool RdmaControlChannel::send_connect_batch_response(
+    uint32_t request_id, const std::vector<QPValue> &qps, bool accept) {
+  if (qps.size() > RDMA_CONTROL_MAX_BATCH) {
+    error_msg_ = "Too many QPs in batch: " + std::to_string(qps.size());
+    return false;
+  }
+  RdmaControlMsg msg;
+  msg.type = RdmaControlMsgType::CONNECT_BATCH_RESPONSE;
+  msg.request_id = request_id;
+  msg.qp_batch = qps;
+  msg.accept = accept;
+  return send_message(msg);
+}
+
+bool RdmaControlChannel::exchange_qp_batches(
+    const std::vector<std::vector<QPValue>> &batches,
+    std::vector<std::vector<QPValue>> &remote, uint32_t window,
+    uint32_t timeout_ms) {
+  remote.assign(batches.size(), std::vector<QPValue>());
+  if (window == 0) {
+    window = 1;
+  }
+
+  // 在途请求：请求编号 -> 批次下标
+  std::unordered_map<uint32_t, size_t> pending;
+  size_t next = 0;
+  size_t done = 0;
+  while (done < batches.size()) {
+    // 窗口未满时继续发送，不等待前面请求的响应
+    while (next < batches.size() && pending.size() < window) {
+      uint32_t request_id = 0;
+      if (!send_connect_batch_request(batches[next], &request_id)) {
+        return false;
+      }
+      pending[request_id] = next++;
+    }
+
+    RdmaControlMsg msg;
+    if (!receive_message(msg, timeout_ms)) {
+      return false;
+    }
+    if (msg.type == RdmaControlMsgType::ERROR) {
+      error_msg_ = "Peer reported error: " + msg.error_msg;
+      return false;
+    }
+    auto it = pending.find(msg.request_id);
+    if (msg.type != RdmaControlMsgType::CONNECT_BATCH_RESPONSE ||
+        it == pending.end()) {
+      error_msg_ = "Unexpected batch response: type=" +
+                   std::to_string(static_cast<int>(msg.type)) +
+                   " request_id=" + std::to_string(msg.request_id);
+      return false;
+    }
+    size_t index = it->second;
+    if (!msg.accept) {
+      error_msg_ = "Batch request " + std::to_string(msg.request_id) +
+                   " rejected by peer";
+      return false;
+    }
+    if (msg.qp_batch.size() != batches[index].size()) {
+      error_msg_ = "Batch response size mismatch: expected " +
+                   std::to_string(batches[index].size()) + ", got " +
+                   std::to_string(msg.qp_batch.size());
+      return false;
+    }
+    remote[index] = std::move(msg.qp_batch);
+    pending.erase(it);
+    ++done;
+  }
+  return true;
+}
+
 bool RdmaControlChannel::send_ready() {
   RdmaControlMsg msg;
   msg.type = RdmaControlMsgType::READY;
@@ -309,176 +235,279 @@ bool RdmaControlChannel::send_error(const std::string &error) {
 bool RdmaControlChannel::send_message(const RdmaControlMsg &msg) {
   std::lock_guard<std::mutex> lock(mutex_);
 
-  if (state_ != ConnectionState::CONNECTED || socket_fd_ < 0) {
+  if (state_ != ConnectionState::CONNECTED || !transport_) {
     return false;
   }
+  if (!zerocopy_pending_.empty()) {
+    reap_zerocopy();
+  }
 
-  // 序列化消息
-  std::string serialized_msg = serialize_message(msg);
-
-  // 发送消息长度
-  uint32_t msg_len = serialized_msg.size();
-  uint32_t net_msg_len = htonl(msg_len);
+  if (msg.qp_batch.size() > RDMA_CONTROL_MAX_BATCH) {
+    error_msg_ = "QP batch too large: " + std::to_string(msg.qp_batch.size());
+    return false;
+  }
+  const size_t body_len = control_msg_encoded_size(msg);
+  if (body_len > RDMA_CONTROL_MAX_FRAME) {
+    error_msg_ = "Control message too long: " + std::to_string(body_len);
+    return false;
+  }
 
-  if (send(socket_fd_, &net_msg_len, sizeof(net_msg_len), 0) !=
-      sizeof(net_msg_len)) {
-    error_msg_ =
-        "Failed to send message length: " + std::string(strerror(errno));
-    state_ = ConnectionState::ERROR;
+#ifdef MSG_ZEROCOPY
+  // 大消息：整帧放进独立缓冲，内核回报完成前不能释放或复用
+  if (zerocopy_threshold_ > 0 && body_len >= zerocopy_threshold_) {
+    std::string frame;
+    append_control_frame(msg, frame);
+    struct iovec iov;
+    iov.iov_base = &frame[0];
+    iov.iov_len = frame.size();
+    if (!send_iov(&iov, 1, MSG_ZEROCOPY)) {
+      return false;
+    }
+    // 每次成功的零拷贝 sendmsg 占用一个完成序号（短写时为多个）
+    zerocopy_pending_.emplace_back(zerocopy_seq_ - 1, std::move(frame));
+    stats_.zerocopy_sends++;
+    stats_.messages_tx++;
+    return true;
+  }
+#endif
+
+  // 长度前缀和消息体由一次 sendmsg 写出，不会被 Nagle 拆成两个报文段
+  tx_body_.resize(body_len);
+  encode_control_msg(msg, &tx_body_[0], body_len);
+  uint32_t net_msg_len = htonl(static_cast<uint32_t>(body_len));
+  struct iovec iov[2];
+  iov[0].iov_base = &net_msg_len;
+  iov[0].iov_len = sizeof(net_msg_len);
+  iov[1].iov_base = &tx_body_[0];
+  iov[1].iov_len = body_len;
+  if (!send_iov(iov, 2, 0)) {
     return false;
   }
+  stats_.messages_tx++;
+  return true;
+}
 
-  // 发送消息内容
-  ssize_t sent = 0;
-  while (sent < msg_len) {
-    ssize_t result =
-        send(socket_fd_, serialized_msg.c_str() + sent, msg_len - sent, 0);
-    if (result < 0) {
+bool RdmaControlChannel::send_iov(struct iovec *iov, int iovcnt, int flags) {
+  while (iovcnt > 0) {
+    ssize_t sent = transport_->send(iov, iovcnt, flags);
+    stats_.send_calls++;
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
       error_msg_ = "Failed to send message: " + std::string(strerror(errno));
       state_ = ConnectionState::ERROR;
       return false;
     }
-    sent += result;
+#ifdef MSG_ZEROCOPY
+    if (flags & MSG_ZEROCOPY) {
+      zerocopy_seq_++;
+    }
+#endif
+    // 跳过已写出的部分
+    size_t done = static_cast<size_t>(sent);
+    while (iovcnt > 0 && done >= iov->iov_len) {
+      done -= iov->iov_len;
+      ++iov;
+      --iovcnt;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + done;
+      iov->iov_len -= done;
+    }
   }
-
   return true;
 }
 
-bool RdmaControlChannel::receive_message(RdmaControlMsg &msg,
-                                         uint32_t timeout_ms) {
+void RdmaControlChannel::reap_zerocopy() {
+#ifdef MSG_ZEROCOPY
+  while (!zerocopy_pending_.empty()) {
+    char control[128];
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_control = control;
+    mh.msg_controllen = sizeof(control);
+    if (recvmsg(transport_->fd(), &mh, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      return; // 没有新的完成通知
+    }
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&mh); cm != nullptr;
+         cm = CMSG_NXTHDR(&mh, cm)) {
+      if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+          !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+        continue;
+      }
+      struct sock_extended_err err;
+      memcpy(&err, CMSG_DATA(cm), sizeof(err));
+      if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+      // 通知覆盖序号区间 [ee_info, ee_data]，区间内的缓冲都可以释放
+      while (!zerocopy_pending_.empty() &&
+             static_cast<int32_t>(err.ee_data -
+                                  zerocopy_pending_.front().first) >= 0) {
+        if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+          stats_.zerocopy_copied++;
+        }
+        zerocopy_pending_.pop_front();
+      }
+    }
+  }
+#endif
+}
+
+bool RdmaControlChannel::set_zerocopy_threshold(size_t bytes) {
   std::lock_guard<std::mutex> lock(mutex_);
 
-  if (state_ != ConnectionState::CONNECTED || socket_fd_ < 0) {
-    error_msg_ =
-        "Cannot receive message: Socket not connected or invalid state";
-    std::cerr << error_msg_ << " (state=" << static_cast<int>(state_)
-              << ", socket_fd=" << socket_fd_ << ")" << std::endl;
+  if (bytes == 0) {
+    zerocopy_threshold_ = 0;
+    return true;
+  }
+  // 只有TCP套接字支持零拷贝发送
+  if (state_ != ConnectionState::CONNECTED || !transport_ ||
+      transport_->type() != ControlTransportType::TCP) {
+    error_msg_ = "Zero-copy requires a connected TCP socket";
     return false;
   }
+#ifdef SO_ZEROCOPY
+  int one = 1;
+  if (setsockopt(transport_->fd(), SOL_SOCKET, SO_ZEROCOPY, &one,
+                 sizeof(one)) == 0) {
+    zerocopy_threshold_ = bytes;
+    return true;
+  }
+  error_msg_ = "Failed to enable SO_ZEROCOPY: " + std::string(strerror(errno));
+#else
+  error_msg_ = "SO_ZEROCOPY is not supported";
+#endif
+  return false;
+}
 
-  std::cout << "Waiting to receive message (timeout: " << timeout_ms << "ms)..."
-            << std::endl;
+ControlChannelStats RdmaControlChannel::get_io_stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
 
-  struct pollfd pfd;
-  pfd.fd = socket_fd_;
-  pfd.events = POLLIN;
+int RdmaControlChannel::parse_buffered(RdmaControlMsg &msg) {
+  const size_t available = rx_end_ - rx_offset_;
+  if (available < sizeof(uint32_t)) {
+    return 0;
+  }
+  uint32_t net_msg_len;
+  memcpy(&net_msg_len, rx_buffer_.data() + rx_offset_, sizeof(net_msg_len));
+  const uint32_t msg_len = ntohl(net_msg_len);
 
-  int poll_result = poll(&pfd, 1, timeout_ms);
-  if (poll_result <= 0) {
-    // 超时或错误
-    if (poll_result < 0) {
-      error_msg_ = "Poll error: " + std::string(strerror(errno));
-      std::cerr << error_msg_ << std::endl;
-      state_ = ConnectionState::ERROR;
-    } else {
-      error_msg_ = "Receive timeout after " + std::to_string(timeout_ms) + "ms";
-      std::cerr << error_msg_ << std::endl;
-    }
-    return false;
+  // 验证消息长度的合理性
+  if (msg_len > RDMA_CONTROL_MAX_FRAME || msg_len == 0) {
+    error_msg_ = "Invalid message length: " + std::to_string(msg_len);
+    RDMA_LOG_ERROR(error_msg_);
+    state_ = ConnectionState::ERROR;
+    return -1;
+  }
+  if (available < sizeof(net_msg_len) + msg_len) {
+    return 0;
   }
 
-  std::cout << "Data available for reading" << std::endl;
+  const char *body = rx_buffer_.data() + rx_offset_ + sizeof(net_msg_len);
+  rx_offset_ += sizeof(net_msg_len) + msg_len;
+  bool ok = decode_control_msg(body, msg_len, msg, error_msg_);
 
-  // 接收消息长度
-  uint32_t net_msg_len;
-  ssize_t recv_result = recv(socket_fd_, &net_msg_len, sizeof(net_msg_len), 0);
-  if (recv_result != sizeof(net_msg_len)) {
-    error_msg_ = "Failed to receive message length: ";
-    if (recv_result < 0) {
-      error_msg_ += std::string(strerror(errno));
-    } else if (recv_result == 0) {
-      error_msg_ += "Connection closed by peer";
-    } else {
-      error_msg_ += "Incomplete data (received " + std::to_string(recv_result) +
-                    " bytes, expected " + std::to_string(sizeof(net_msg_len)) +
-                    " bytes)";
-    }
-    std::cerr << error_msg_ << std::endl;
-    state_ = ConnectionState::ERROR;
-    return false;
+  if (rx_offset_ == rx_end_) {
+    rx_offset_ = rx_end_ = 0;
+  }
+  if (!ok) {
+    RDMA_LOG_ERROR("Failed to deserialize message: " << error_msg_);
+    return -1;
   }
+  stats_.messages_rx++;
+  return 1;
+}
 
-  uint32_t msg_len = ntohl(net_msg_len);
-  std::cout << "Message length received: " << msg_len << " bytes" << std::endl;
+bool RdmaControlChannel::receive_message(RdmaControlMsg &msg,
+                                         uint32_t timeout_ms) {
+  std::lock_guard<std::mutex> lock(mutex_);
 
-  // 验证消息长度的合理性
-  if (msg_len > 4096 || msg_len == 0) {
-    error_msg_ = "Invalid message length: " + std::to_string(msg_len);
-    std::cerr << error_msg_ << std::endl;
-    state_ = ConnectionState::ERROR;
+  if (state_ != ConnectionState::CONNECTED || !transport_) {
+    error_msg_ =
+        "Cannot receive message: Socket not connected or invalid state";
+    RDMA_LOG_WARN(error_msg_ << " (state=" << static_cast<int>(state_)
+                             << ")");
     return false;
   }
+  if (!zerocopy_pending_.empty()) {
+    reap_zerocopy();
+  }
 
-  // 接收消息内容
-  std::string serialized_msg;
-  serialized_msg.resize(msg_len);
-
-  size_t received = 0;
-  // 为正文接收实现超时控制：按剩余时间分段 poll + recv
+  // 每次 recv 尽量多读，读入的多条消息留在缓冲中，后续调用不再进入内核
+  const size_t kReadChunk = 64 * 1024;
   auto start_time = std::chrono::steady_clock::now();
-  while (received < msg_len) {
-    int poll_timeout = -1; // -1 表示无限等待
+  for (;;) {
+    int parsed = parse_buffered(msg);
+    if (parsed != 0) {
+      return parsed > 0;
+    }
+
+    int poll_timeout = 0;
     if (timeout_ms > 0) {
-      auto now = std::chrono::steady_clock::now();
-      auto elapsed =
-          std::chrono::duration_cast<std::chrono::milliseconds>(now - start_time)
-              .count();
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now() - start_time)
+                         .count();
       int remaining = static_cast<int>(timeout_ms) - static_cast<int>(elapsed);
       if (remaining <= 0) {
-        error_msg_ = "Receive timeout while reading message body";
-        std::cerr << error_msg_ << std::endl;
+        error_msg_ =
+            "Receive timeout after " + std::to_string(timeout_ms) + "ms";
+        RDMA_LOG_DEBUG(error_msg_);
         return false;
       }
-      // 每次轮询不超过 1000ms，避免长时间阻塞难以响应取消
-      poll_timeout = remaining > 1000 ? 1000 : remaining;
+      poll_timeout = remaining;
     }
 
-    struct pollfd pfd_body;
-    pfd_body.fd = socket_fd_;
-    pfd_body.events = POLLIN;
-    int pr = poll(&pfd_body, 1, poll_timeout);
-    if (pr <= 0) {
-      if (pr < 0) {
-        error_msg_ = "Poll error while receiving body: " +
-                     std::string(strerror(errno));
-        std::cerr << error_msg_ << std::endl;
-      } else {
-        error_msg_ = "Receive timeout while waiting for body data";
-        std::cerr << error_msg_ << std::endl;
-      }
+    int poll_result = transport_->wait_readable(poll_timeout);
+    if (poll_result < 0) {
+      error_msg_ = transport_->get_error();
+      RDMA_LOG_WARN(error_msg_);
       state_ = ConnectionState::ERROR;
       return false;
     }
+    if (poll_result == 0) {
+      if (timeout_ms > 0) {
+        continue; // 由上面的剩余时间判断超时
+      }
+      error_msg_ = "Receive timeout after 0ms";
+      return false;
+    }
 
-    ssize_t result =
-        recv(socket_fd_, &serialized_msg[received], msg_len - received, 0);
+    // 尾部空间不足一次读取时先把未解析的数据搬到开头，仍不足再扩容
+    if (rx_buffer_.size() - rx_end_ < kReadChunk) {
+      if (rx_offset_ > 0) {
+        memmove(rx_buffer_.data(), rx_buffer_.data() + rx_offset_,
+                rx_end_ - rx_offset_);
+        rx_end_ -= rx_offset_;
+        rx_offset_ = 0;
+      }
+      if (rx_buffer_.size() - rx_end_ < kReadChunk) {
+        rx_buffer_.resize(rx_end_ + kReadChunk);
+      }
+    }
+    ssize_t result = transport_->recv(rx_buffer_.data() + rx_end_,
+                                      rx_buffer_.size() - rx_end_);
+    stats_.recv_calls++;
     if (result <= 0) {
-      error_msg_ = "Failed to receive message content: ";
+      if (result < 0 &&
+          (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+        continue;
+      }
+      error_msg_ = "Failed to receive message: ";
       if (result < 0) {
         error_msg_ += std::string(strerror(errno));
       } else {
         error_msg_ += "Connection closed by peer";
       }
-      std::cerr << error_msg_ << std::endl;
+      RDMA_LOG_WARN(error_msg_);
       state_ = ConnectionState::ERROR;
       return false;
     }
-    received += result;
-    std::cout << "Received " << result << " bytes, total " << received << "/"
-              << msg_len << std::endl;
+    rx_end_ += static_cast<size_t>(result);
   }
-
-  std::cout << "Message content fully received, deserializing..." << std::endl;
-
-  // 反序列化消息
-  bool deserialize_result = deserialize_message(serialized_msg, msg);
-  if (deserialize_result) {
-    std::cout << "Message successfully deserialized, type="
-              << static_cast<int>(msg.type) << std::endl;
-  } else {
-    std::cerr << "Failed to deserialize message: " << error_msg_ << std::endl;
-  }
-  return deserialize_result;
 }
 
 RdmaControlChannel::ConnectionState RdmaControlChannel::get_state() const {
@@ -496,233 +525,13 @@ uint16_t RdmaControlChannel::get_peer_port() const { return peer_port_; }
 void RdmaControlChannel::close_connection() {
   std::lock_guard<std::mutex> lock(mutex_);
 
-  if (client_socket_fd_ >= 0) {
-    close(client_socket_fd_);
-    client_socket_fd_ = -1;
-  }
-
-  if (server_socket_fd_ >= 0) {
-    close(server_socket_fd_);
-    server_socket_fd_ = -1;
-  }
-
-  if (socket_fd_ >= 0) {
-    close(socket_fd_);
-    socket_fd_ = -1;
+  if (transport_) {
+    transport_->close();
+    transport_.reset();
   }
 
+  rx_offset_ = rx_end_ = 0;
+  zerocopy_pending_.clear();
+  zerocopy_threshold_ = 0;
   state_ = ConnectionState::DISCONNECTED;
 }
-
-std::string RdmaControlChannel::serialize_message(const RdmaControlMsg &msg) {
-  std::string result;
-
-  // 1. 序列化消息类型
-  uint8_t type = static_cast<uint8_t>(msg.type);
-  result.append(reinterpret_cast<char *>(&type), sizeof(type));
-
-  // 2. 序列化QPValue结构体
-  // qp_num
-  result.append(reinterpret_cast<const char *>(&msg.qp_info.qp_num),
-                sizeof(msg.qp_info.qp_num));
-  // dest_qp_num
-  result.append(reinterpret_cast<const char *>(&msg.qp_info.dest_qp_num),
-                sizeof(msg.qp_info.dest_qp_num));
-  // lid
-  result.append(reinterpret_cast<const char *>(&msg.qp_info.lid),
-                sizeof(msg.qp_info.lid));
-  // remote_lid
-  result.append(reinterpret_cast<const char *>(&msg.qp_info.remote_lid),
-                sizeof(msg.qp_info.remote_lid));
-  // port_num
-  result.append(reinterpret_cast<const char *>(&msg.qp_info.port_num),
-                sizeof(msg.qp_info.port_num));
-  // qp_access_flags
-  result.append(reinterpret_cast<const char *>(&msg.qp_info.qp_access_flags),
-                sizeof(msg.qp_info.qp_access_flags));
-  // psn
-  result.append(reinterpret_cast<const char *>(&msg.qp_info.psn),
-                sizeof(msg.qp_info.psn));
-  // remote_psn
-  result.append(reinterpret_cast<const char *>(&msg.qp_info.remote_psn),
-                sizeof(msg.qp_info.remote_psn));
-  // gid (16 bytes)
-  result.append(reinterpret_cast<const char *>(msg.qp_info.gid.data()),
-                msg.qp_info.gid.size());
-  // remote_gid (16 bytes)
-  result.append(reinterpret_cast<const char *>(msg.qp_info.remote_gid.data()),
-                msg.qp_info.remote_gid.size());
-  // mtu
-  result.append(reinterpret_cast<const char *>(&msg.qp_info.mtu),
-                sizeof(msg.qp_info.mtu));
-  // state
-  uint8_t state = static_cast<uint8_t>(msg.qp_info.state);
-  result.append(reinterpret_cast<char *>(&state), sizeof(state));
-
-  // 3. 序列化accept标志
-  uint8_t accept = msg.accept ? 1 : 0;
-  result.append(reinterpret_cast<char *>(&accept), sizeof(accept));
-
-  // 4. 序列化error_msg
-  uint32_t error_len = msg.error_msg.length();
-  result.append(reinterpret_cast<char *>(&error_len), sizeof(error_len));
-  if (error_len > 0) {
-    result.append(msg.error_msg);
-  }
-
-  return result;
-}
-
-bool RdmaControlChannel::deserialize_message(const std::string &data,
-                                             RdmaControlMsg &msg) {
-  if (data.empty()) {
-    error_msg_ = "Empty data for deserialization";
-    return false;
-  }
-
-  size_t offset = 0;
-
-  // 1. 反序列化消息类型
-  if (offset + sizeof(uint8_t) > data.size()) {
-    error_msg_ = "Insufficient data for message type";
-    return false;
-  }
-  uint8_t type = *reinterpret_cast<const uint8_t *>(data.data() + offset);
-  msg.type = static_cast<RdmaControlMsgType>(type);
-  offset += sizeof(uint8_t);
-
-  // 2. 反序列化QPValue结构体
-  // qp_num
-  if (offset + sizeof(msg.qp_info.qp_num) > data.size()) {
-    error_msg_ = "Insufficient data for qp_num";
-    return false;
-  }
-  msg.qp_info.qp_num =
-      *reinterpret_cast<const uint32_t *>(data.data() + offset);
-  offset += sizeof(msg.qp_info.qp_num);
-
-  // dest_qp_num
-  if (offset + sizeof(msg.qp_info.dest_qp_num) > data.size()) {
-    error_msg_ = "Insufficient data for dest_qp_num";
-    return false;
-  }
-  msg.qp_info.dest_qp_num =
-      *reinterpret_cast<const uint32_t *>(data.data() + offset);
-  offset += sizeof(msg.qp_info.dest_qp_num);
-
-  // lid
-  if (offset + sizeof(msg.qp_info.lid) > data.size()) {
-    error_msg_ = "Insufficient data for lid";
-    return false;
-  }
-  msg.qp_info.lid = *reinterpret_cast<const uint16_t *>(data.data() + offset);
-  offset += sizeof(msg.qp_info.lid);
-
-  // remote_lid
-  if (offset + sizeof(msg.qp_info.remote_lid) > data.size()) {
-    error_msg_ = "Insufficient data for remote_lid";
-    return false;
-  }
-  msg.qp_info.remote_lid =
-      *reinterpret_cast<const uint16_t *>(data.data() + offset);
-  offset += sizeof(msg.qp_info.remote_lid);
-
-  // port_num
-  if (offset + sizeof(msg.qp_info.port_num) > data.size()) {
-    error_msg_ = "Insufficient data for port_num";
-    return false;
-  }
-  msg.qp_info.port_num =
-      *reinterpret_cast<const uint8_t *>(data.data() + offset);
-  offset += sizeof(msg.qp_info.port_num);
-
-  // qp_access_flags
-  if (offset + sizeof(msg.qp_info.qp_access_flags) > data.size()) {
-    error_msg_ = "Insufficient data for qp_access_flags";
-    return false;
-  }
-  msg.qp_info.qp_access_flags =
-      *reinterpret_cast<const uint32_t *>(data.data() + offset);
-  offset += sizeof(msg.qp_info.qp_access_flags);
-
-  // psn
-  if (offset + sizeof(msg.qp_info.psn) > data.size()) {
-    error_msg_ = "Insufficient data for psn";
-    return false;
-  }
-  msg.qp_info.psn = *reinterpret_cast<const uint32_t *>(data.data() + offset);
-  offset += sizeof(msg.qp_info.psn);
-
-  // remote_psn
-  if (offset + sizeof(msg.qp_info.remote_psn) > data.size()) {
-    error_msg_ = "Insufficient data for remote_psn";
-    return false;
-  }
-  msg.qp_info.remote_psn =
-      *reinterpret_cast<const uint32_t *>(data.data() + offset);
-  offset += sizeof(msg.qp_info.remote_psn);
-
-  // gid (16 bytes)
-  if (offset + msg.qp_info.gid.size() > data.size()) {
-    error_msg_ = "Insufficient data for gid";
-    return false;
-  }
-  memcpy(msg.qp_info.gid.data(), data.data() + offset, msg.qp_info.gid.size());
-  offset += msg.qp_info.gid.size();
-
-  // remote_gid (16 bytes)
-  if (offset + msg.qp_info.remote_gid.size() > data.size()) {
-    error_msg_ = "Insufficient data for remote_gid";
-    return false;
-  }
-  memcpy(msg.qp_info.remote_gid.data(), data.data() + offset,
-         msg.qp_info.remote_gid.size());
-  offset += msg.qp_info.remote_gid.size();
-
-  // mtu
-  if (offset + sizeof(msg.qp_info.mtu) > data.size()) {
-    error_msg_ = "Insufficient data for mtu";
-    return false;
-  }
-  msg.qp_info.mtu = *reinterpret_cast<const uint32_t *>(data.data() + offset);
-  offset += sizeof(msg.qp_info.mtu);
-
-  // state
-  if (offset + sizeof(uint8_t) > data.size()) {
-    error_msg_ = "Insufficient data for state";
-    return false;
-  }
-  uint8_t state = *reinterpret_cast<const uint8_t *>(data.data() + offset);
-  msg.qp_info.state = static_cast<QpState>(state);
-  offset += sizeof(uint8_t);
-
-  // 3. 反序列化accept标志
-  if (offset + sizeof(uint8_t) > data.size()) {
-    error_msg_ = "Insufficient data for accept flag";
-    return false;
-  }
-  uint8_t accept = *reinterpret_cast<const uint8_t *>(data.data() + offset);
-  msg.accept = (accept != 0);
-  offset += sizeof(uint8_t);
-
-  // 4. 反序列化error_msg
-  if (offset + sizeof(uint32_t) > data.size()) {
-    error_msg_ = "Insufficient data for error_msg length";
-    return false;
-  }
-  uint32_t error_len =
-      *reinterpret_cast<const uint32_t *>(data.data() + offset);
-  offset += sizeof(uint32_t);
-
-  if (error_len > 0) {
-    if (offset + error_len > data.size()) {
-      error_msg_ = "Insufficient data for error_msg content";
-      return false;
-    }
-    msg.error_msg = data.substr(offset, error_len);
-  } else {
-    msg.error_msg.clear();
-  }
-
-  return true;
-}
\ No newline at end of file
@@ -0,0 +1,259 @@
+#include "../include/rdma_control_codec.h"
+#include <arpa/inet.h>
+#include <cstddef>
+#include <cstring>
+
+// 线上整数为小端：小端主机上是空操作，大端主机上交换字节序
+static inline uint16_t wire16(uint16_t v) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_bswap16(v);
+#else
+  return v;
+#endif
+}
+
+static inline uint32_t wire32(uint32_t v) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return __builtin_bswap32(v);
+#else
+  return v;
+#endif
+}
+
+static void to_wire(const QPValue &qp, RdmaControlWireQp &wire) {
+  wire.qp_num = wire32(qp.qp_num);
+  wire.dest_qp_num = wire32(qp.dest_qp_num);
+  wire.qp_access_flags = wire32(qp.qp_access_flags);
+  wire.psn = wire32(qp.psn);
+  wire.remote_psn = wire32(qp.remote_psn);
+  wire.mtu = wire32(qp.mtu);
+  wire.lid = wire16(qp.lid);
+  wire.remote_lid = wire16(qp.remote_lid);
+  wire.port_num = qp.port_num;
+  wire.state = static_cast<uint8_t>(qp.state);
+  wire.reserved[0] = wire.reserved[1] = 0;
+  memcpy(wire.gid, qp.gid.data(), sizeof(wire.gid));
+  memcpy(wire.remote_gid, qp.remote_gid.data(), sizeof(wire.remote_gid));
+}
+
+static void from_wire(const RdmaControlWireQp &wire, QPValue &qp) {
+  qp.qp_num = wire32(wire.qp_num);
+  qp.dest_qp_num = wire32(wire.dest_qp_num);
+  qp.qp_access_flags = wire32(wire.qp_access_flags);
+  qp.psn = wire32(wire.psn);
+  qp.remote_psn = wire32(wire.remote_psn);
+  qp.mtu = wire32(wire.mtu);
+  qp.lid = wire16(wire.lid);
+  qp.remote_lid = wire16(wire.remote_lid);
+  qp.port_num = wire.port_num;
+  qp.state = static_cast<QpState>(wire.state);
+  memcpy(qp.gid.data(), wire.gid, sizeof(wire.gid));
+  memcpy(qp.remote_gid.data(), wire.remote_gid, sizeof(wire.remote_gid));
+}
+
+static bool valid_qp_state(uint8_t state) {
+  return state <= static_cast<uint8_t>(QpState::ERR);
+}
+
+// 写入一个TLV头，返回值区的起始位置
+static char *put_tlv(char *p, RdmaControlTlv type, uint32_t length) {
+  RdmaControlWireTlv tlv;
+  tlv.type = wire16(static_cast<uint16_t>(type));
+  tlv.reserved = 0;
+  tlv.length = wire32(length);
+  memcpy(p, &tlv, sizeof(tlv));
+  return p + sizeof(tlv);
+}
+
+size_t control_msg_encoded_size(const RdmaControlMsg &msg) {
+  size_t size = sizeof(RdmaControlWireHeader);
+  if (!msg.error_msg.empty()) {
+    size += sizeof(RdmaControlWireTlv) + msg.error_msg.size();
+  }
+  if (!msg.qp_batch.empty()) {
+    size += sizeof(RdmaControlWireTlv) +
+            msg.qp_batch.size() * sizeof(RdmaControlWireQp);
+  }
+  return size;
+}
+
+size_t encode_control_msg(const RdmaControlMsg &msg, char *buffer,
+                          size_t capacity) {
+  const size_t size = control_msg_encoded_size(msg);
+  if (size > capacity || msg.qp_batch.size() > RDMA_CONTROL_MAX_BATCH) {
+    return 0;
+  }
+
+  RdmaControlWireHeader header;
+  header.magic = wire16(RDMA_CONTROL_MAGIC);
+  header.version = RDMA_CONTROL_WIRE_VERSION;
+  header.type = static_cast<uint8_t>(msg.type);
+  header.flags = msg.accept ? RDMA_CONTROL_FLAG_ACCEPT : 0;
+  header.reserved[0] = header.reserved[1] = header.reserved[2] = 0;
+  header.request_id = wire32(msg.request_id);
+  header.ext_length =
+      wire32(static_cast<uint32_t>(size - sizeof(RdmaControlWireHeader)));
+  to_wire(msg.qp_info, header.qp);
+  memcpy(buffer, &header, sizeof(header));
+
+  char *p = buffer + sizeof(header);
+  if (!msg.error_msg.empty()) {
+    p = put_tlv(p, RdmaControlTlv::ERROR_MSG,
+                static_cast<uint32_t>(msg.error_msg.size()));
+    memcpy(p, msg.error_msg.data(), msg.error_msg.size());
+    p += msg.error_msg.size();
+  }
+  if (!msg.qp_batch.empty()) {
+    p = put_tlv(p, RdmaControlTlv::QP_BATCH,
+                static_cast<uint32_t>(msg.qp_batch.size() *
+                                      sizeof(RdmaControlWireQp)));
+    for (const QPValue &qp : msg.qp_batch) {
+      RdmaControlWireQp wire;
+      to_wire(qp, wire);
+      memcpy(p, &wire, sizeof(wire));
+      p += sizeof(wire);
+    }
+  }
+  return size;
+}
+
+std::string encode_control_msg(const RdmaControlMsg &msg) {
+  if (msg.qp_batch.size() > RDMA_CONTROL_MAX_BATCH) {
+    return std::string();
+  }
+  std::string result(control_msg_encoded_size(msg), '\0');
+  encode_control_msg(msg, &result[0], result.size());
+  return result;
+}
+
+bool append_control_frame(const RdmaControlMsg &msg, std::string &out) {
+  const size_t size = control_msg_encoded_size(msg);
+  if (size > RDMA_CONTROL_MAX_FRAME ||
+      msg.qp_batch.size() > RDMA_CONTROL_MAX_BATCH) {
+    return false;
+  }
+  const size_t start = out.size();
+  out.resize(start + sizeof(uint32_t) + size);
+  uint32_t net_len = htonl(static_cast<uint32_t>(size));
+  memcpy(&out[start], &net_len, sizeof(net_len));
+  encode_control_msg(msg, &out[start + sizeof(net_len)], size);
+  return true;
+}
+
+bool RdmaControlMsgView::parse(const char *data, size_t size,
+                               std::string &error) {
+  error_msg_ = std::string_view();
+  batch_ = nullptr;
+  batch_size_ = 0;
+
+  if (size < sizeof(header_)) {
+    error = "Insufficient data for header: " + std::to_string(size) + " bytes";
+    return false;
+  }
+  memcpy(&header_, data, sizeof(header_));
+  if (wire16(header_.magic) != RDMA_CONTROL_MAGIC) {
+    error = "Bad control message magic";
+    return false;
+  }
+  if (header_.version != RDMA_CONTROL_WIRE_VERSION) {
+    error = "Unsupported control message version: " +
+            std::to_string(header_.version);
+    return false;
+  }
+  if (header_.type >
+      static_cast<uint8_t>(RdmaControlMsgType::CONNECT_BATCH_RESPONSE)) {
+    error = "Unknown control message type: " + std::to_string(header_.type);
+    return false;
+  }
+  if (!valid_qp_state(header_.qp.state)) {
+    error = "Invalid QP state: " + std::to_string(header_.qp.state);
+    return false;
+  }
+  request_id_ = wire32(header_.request_id);
+  const uint32_t ext_length = wire32(header_.ext_length);
+  if (ext_length > size - sizeof(header_)) {
+    error = "Insufficient data for extensions";
+    return false;
+  }
+
+  const char *p = data + sizeof(header_);
+  const char *end = p + ext_length;
+  while (p != end) {
+    if (static_cast<size_t>(end - p) < sizeof(RdmaControlWireTlv)) {
+      error = "Truncated TLV header";
+      return false;
+    }
+    RdmaControlWireTlv tlv;
+    memcpy(&tlv, p, sizeof(tlv));
+    p += sizeof(tlv);
+    const uint32_t length = wire32(tlv.length);
+    if (length > static_cast<size_t>(end - p)) {
+      error = "TLV length exceeds message";
+      return false;
+    }
+    switch (static_cast<RdmaControlTlv>(wire16(tlv.type))) {
+    case RdmaControlTlv::ERROR_MSG:
+      error_msg_ = std::string_view(p, length);
+      break;
+    case RdmaControlTlv::QP_BATCH:
+      if (length % sizeof(RdmaControlWireQp) != 0 ||
+          length / sizeof(RdmaControlWireQp) > RDMA_CONTROL_MAX_BATCH) {
+        error = "Invalid QP batch length: " + std::to_string(length);
+        return false;
+      }
+      for (const char *q = p; q != p + length; q += sizeof(RdmaControlWireQp)) {
+        const uint8_t state = static_cast<uint8_t>(
+            q[offsetof(RdmaControlWireQp, state)]);
+        if (!valid_qp_state(state)) {
+          error = "Invalid QP state in batch: " + std::to_string(state);
+          return false;
+        }
+      }
+      batch_ = p;
+      batch_size_ = length / sizeof(RdmaControlWireQp);
+      break;
+    default:
+      break; // 新版本增加的扩展，跳过
+    }
+    p += length;
+  }
+  return true;
+}
+
+QPValue RdmaControlMsgView::qp_info() const {
+  QPValue qp;
+  from_wire(header_.qp, qp);
+  return qp;
+}
+
+QPValue RdmaControlMsgView::batch_qp(size_t index) const {
+  RdmaControlWireQp wire;
+  memcpy(&wire, batch_ + index * sizeof(wire), sizeof(wire));
+  QPValue qp;
+  from_wire(wire, qp);
+  return qp;
+}
+
+void RdmaControlMsgView::to_msg(RdmaControlMsg &msg) const {
+  msg.type = type();
+  msg.request_id = request_id_;
+  msg.accept = accept();
+  from_wire(header_.qp, msg.qp_info);
+  msg.error_msg.assign(error_msg_.data(), error_msg_.size());
+  msg.qp_batch.resize(batch_size_);
+  for (size_t i = 0; i < batch_size_; ++i) {
+    RdmaControlWireQp wire;
+    memcpy(&wire, batch_ + i * sizeof(wire), sizeof(wire));
+    from_wire(wire, msg.qp_batch[i]);
+  }
+}
+
+bool decode_control_msg(const char *data, size_t size, RdmaControlMsg &msg,
+                        std::string &error) {
+  RdmaControlMsgView view;
+  if (!view.parse(data, size, error)) {
+    return false;
+  }
+  view.to_msg(msg);
+  return true;
+}
@@ -0,0 +1,511 @@
+#include "../include/rdma_control_plane.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+// epoll 事件的 data.u64：对端编号从1开始分配，0 和全1保留给唤醒fd和监听socket
+static const uint64_t kWakeId = 0;
+static const uint64_t kListenId = UINT64_MAX;
+// 单次 epoll_wait 最多取回的事件数
+static const int kMaxEvents = 256;
+// 每次 recv 的读缓冲大小
+static const size_t kReadChunk = 64 * 1024;
+// 接收缓冲全部解析完后保留的容量上限，收过大帧的对端据此释放多余内存
+static const size_t kRxRetainBytes = 4 * 1024;
+
+static void set_nodelay(int fd) {
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+RdmaControlPlane::RdmaControlPlane()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      wake_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), listen_fd_(-1),
+      listen_port_(0) {
+  if (epoll_fd_ >= 0 && wake_fd_ >= 0) {
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = kWakeId;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+  }
+}
+
+RdmaControlPlane::~RdmaControlPlane() {
+  stop();
+  for (auto &entry : peers_) {
+    ::close(entry.second.fd);
+  }
+  peers_.clear();
+  if (listen_fd_ >= 0) {
+    ::close(listen_fd_);
+  }
+  if (wake_fd_ >= 0) {
+    ::close(wake_fd_);
+  }
+  if (epoll_fd_ >= 0) {
+    ::close(epoll_fd_);
+  }
+}
+
+void RdmaControlPlane::set_callbacks(const Callbacks &callbacks) {
+  callbacks_ = callbacks;
+}
+
+void RdmaControlPlane::set_error(const std::string &error) {
+  std::lock_guard<std::mutex> lock(error_mutex_);
+  error_msg_ = error;
+}
+
+std::string RdmaControlPlane::get_error() const {
+  std::lock_guard<std::mutex> lock(error_mutex_);
+  return error_msg_;
+}
+
+bool RdmaControlPlane::listen(uint16_t port, const std::string &ip) {
+  if (listen_fd_ >= 0 || epoll_fd_ < 0) {
+    set_error("Control plane is already listening or not initialized");
+    return false;
+  }
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) <= 0) {
+    set_error("Invalid address: " + ip);
+    return false;
+  }
+
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    set_error("Failed to create socket: " + std::string(strerror(errno)));
+    return false;
+  }
+  int opt = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  socklen_t len = sizeof(addr);
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      ::listen(fd, SOMAXCONN) < 0 ||
+      getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) < 0) {
+    set_error("Failed to listen: " + std::string(strerror(errno)));
+    ::close(fd);
+    return false;
+  }
+
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.u64 = kListenId;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    set_error("Failed to register listener: " + std::string(strerror(errno)));
+    ::close(fd);
+    return false;
+  }
+  listen_fd_ = fd;
+  listen_port_ = ntohs(addr.sin_port);
+  return true;
+}
+
+uint16_t RdmaControlPlane::listen_port() const { return listen_port_; }
+
+RdmaControlPlane::PeerId RdmaControlPlane::connect(const std::string &ip,
+                                                   uint16_t port) {
+  in_addr addr{};
+  if (inet_pton(AF_INET, ip.c_str(), &addr) <= 0) {
+    set_error("Invalid address: " + ip);
+    return 0;
+  }
+  Command command;
+  command.kind = Command::Kind::CONNECT;
+  command.peer = next_peer_id_.fetch_add(1, std::memory_order_relaxed);
+  command.addr = addr.s_addr;
+  command.port = htons(port);
+  PeerId id = command.peer;
+  submit(std::move(command));
+  return id;
+}
+
+bool RdmaControlPlane::send(PeerId peer, const RdmaControlMsg &msg) {
+  Command command;
+  command.kind = Command::Kind::SEND;
+  command.peer = peer;
+  if (!append_control_frame(msg, command.data)) {
+    set_error(msg.qp_batch.size() > RDMA_CONTROL_MAX_BATCH
+                  ? "QP batch too large: " +
+                        std::to_string(msg.qp_batch.size())
+                  : "Control message too long: " +
+                        std::to_string(control_msg_encoded_size(msg)));
+    return false;
+  }
+  submit(std::move(command));
+  return true;
+}
+
+void RdmaControlPlane::close(PeerId peer) {
+  Command command;
+  command.kind = Command::Kind::CLOSE;
+  command.peer = peer;
+  submit(std::move(command));
+}
+
+void RdmaControlPlane::submit(Command &&command) {
+  bool wake = false;
+  {
+    std::lock_guard<std::mutex> lock(command_mutex_);
+    wake = commands_.empty();
+    commands_.push_back(std::move(command));
+  }
+  // 队列由空变为非空时才需要唤醒，事件循环每轮会取走整个队列
+  if (wake) {
+    uint64_t one = 1;
+    ssize_t ret = write(wake_fd_, &one, sizeof(one));
+    (void)ret;
+  }
+}
+
+void RdmaControlPlane::run_commands() {
+  std::deque<Command> commands;
+  {
+    std::lock_guard<std::mutex> lock(command_mutex_);
+    commands.swap(commands_);
+  }
+  for (Command &command : commands) {
+    switch (command.kind) {
+    case Command::Kind::CONNECT: {
+      int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      sockaddr_in addr{};
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = command.addr;
+      addr.sin_port = command.port;
+      int ret = fd < 0 ? -1
+                       : ::connect(fd, reinterpret_cast<sockaddr *>(&addr),
+                                   sizeof(addr));
+      if (fd < 0 || (ret < 0 && errno != EINPROGRESS)) {
+        set_error("Failed to connect: " + std::string(strerror(errno)));
+        if (fd >= 0) {
+          ::close(fd);
+        }
+        connect_failed_.fetch_add(1, std::memory_order_relaxed);
+        if (callbacks_.on_connect) {
+          callbacks_.on_connect(command.peer, false);
+        }
+        break;
+      }
+      set_nodelay(fd);
+      Peer &peer = peers_[command.peer];
+      peer.fd = fd;
+      peer_count_.fetch_add(1, std::memory_order_relaxed);
+      // 连接完成时 socket 变为可写
+      epoll_event ev{};
+      ev.events = EPOLLOUT;
+      ev.data.u64 = command.peer;
+      epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+      peer.want_write = true;
+      if (ret == 0) {
+        handle_connected(command.peer, peer);
+      }
+      break;
+    }
+    case Command::Kind::SEND: {
+      auto it = peers_.find(command.peer);
+      if (it == peers_.end()) {
+        break;
+      }
+      Peer &peer = it->second;
+      peer.tx.append(command.data);
+      messages_tx_.fetch_add(1, std::memory_order_relaxed);
+      if (peer.connected && !peer.want_write && !flush(command.peer, peer)) {
+        drop_peer(command.peer, true);
+      }
+      break;
+    }
+    case Command::Kind::CLOSE:
+      drop_peer(command.peer, false);
+      break;
+    }
+  }
+}
+
+int RdmaControlPlane::poll(int timeout_ms) {
+  if (epoll_fd_ < 0) {
+    return -1;
+  }
+  run_commands();
+  epoll_event events[kMaxEvents];
+  int n = epoll_wait(epoll_fd_, events, kMaxEvents, timeout_ms);
+  if (n < 0) {
+    if (errno == EINTR) {
+      return 0;
+    }
+    set_error("epoll_wait failed: " + std::string(strerror(errno)));
+    return -1;
+  }
+  loop_wakeups_.fetch_add(1, std::memory_order_relaxed);
+
+  for (int i = 0; i < n; ++i) {
+    const uint64_t id = events[i].data.u64;
+    const uint32_t mask = events[i].events;
+    if (id == kWakeId) {
+      uint64_t count;
+      ssize_t ret = read(wake_fd_, &count, sizeof(count));
+      (void)ret;
+      continue;
+    }
+    if (id == kListenId) {
+      handle_accept();
+      continue;
+    }
+    // 同一轮中先处理的事件可能已经关闭了该对端
+    auto it = peers_.find(id);
+    if (it == peers_.end()) {
+      continue;
+    }
+    Peer &peer = it->second;
+    if (!peer.connected) {
+      handle_connected(id, peer);
+      continue;
+    }
+    bool ok = true;
+    if (mask & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+      ok = handle_read(id, peer);
+    }
+    if (ok && (mask & EPOLLOUT)) {
+      // 回调可能已经通过命令关闭该对端，但命令在本轮结束后才执行
+      ok = flush(id, peer);
+    }
+    if (!ok) {
+      drop_peer(id, true);
+    }
+  }
+  run_commands();
+  return n;
+}
+
+bool RdmaControlPlane::start() {
+  if (running_.exchange(true)) {
+    return false;
+  }
+  loop_thread_ = std::thread([this]() {
+    while (running_.load(std::memory_order_acquire)) {
+      if (poll(100) < 0) {
+        break;
+      }
+    }
+  });
+  return true;
+}
+
+void RdmaControlPlane::stop() {
+  if (!running_.exchange(false)) {
+    return;
+  }
+  uint64_t one = 1;
+  ssize_t ret = write(wake_fd_, &one, sizeof(one));
+  (void)ret;
+  if (loop_thread_.joinable()) {
+    loop_thread_.join();
+  }
+}
+
+size_t RdmaControlPlane::peer_count() const {
+  return peer_count_.load(std::memory_order_relaxed);
+}
+
+ControlPlaneStats RdmaControlPlane::get_stats() const {
+  ControlPlaneStats stats;
+  stats.accepted = accepted_.load(std::memory_order_relaxed);
+  stats.connected = connected_.load(std::memory_order_relaxed);
+  stats.connect_failed = connect_failed_.load(std::memory_order_relaxed);
+  stats.closed = closed_.load(std::memory_order_relaxed);
+  stats.messages_rx = messages_rx_.load(std::memory_order_relaxed);
+  stats.messages_tx = messages_tx_.load(std::memory_order_relaxed);
+  stats.bytes_rx = bytes_rx_.load(std::memory_order_relaxed);
+  stats.bytes_tx = bytes_tx_.load(std::memory_order_relaxed);
+  stats.loop_wakeups = loop_wakeups_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+// 一次取完 backlog 中的所有连接
+void RdmaControlPlane::handle_accept() {
+  for (;;) {
+    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        set_error("Accept failed: " + std::string(strerror(errno)));
+      }
+      return;
+    }
+    set_nodelay(fd);
+    PeerId id = next_peer_id_.fetch_add(1, std::memory_order_relaxed);
+    Peer &peer = peers_[id];
+    peer.fd = fd;
+    peer.connected = true;
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = id;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+    peer_count_.fetch_add(1, std::memory_order_relaxed);
+    accepted_.fetch_add(1, std::memory_order_relaxed);
+    if (callbacks_.on_accept) {
+      callbacks_.on_accept(id);
+    }
+  }
+}
+
+// 非阻塞 connect 完成（socket 可写）：按 SO_ERROR 判断结果
+void RdmaControlPlane::handle_connected(PeerId id, Peer &peer) {
+  int err = 0;
+  socklen_t len = sizeof(err);
+  if (getsockopt(peer.fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+    set_error("Failed to connect: " + std::string(strerror(err ? err : errno)));
+    connect_failed_.fetch_add(1, std::memory_order_relaxed);
+    drop_peer(id, false);
+    if (callbacks_.on_connect) {
+      callbacks_.on_connect(id, false);
+    }
+    return;
+  }
+  peer.connected = true;
+  connected_.fetch_add(1, std::memory_order_relaxed);
+  // 连接建立前排队的帧立即写出
+  update_events(id, peer, false);
+  if (!flush(id, peer)) {
+    drop_peer(id, true);
+    return;
+  }
+  if (callbacks_.on_connect) {
+    callbacks_.on_connect(id, true);
+  }
+}
+
+// 读到 EAGAIN 为止，按长度前缀切出所有完整的帧
+bool RdmaControlPlane::handle_read(PeerId id, Peer &peer) {
+  bool eof = false;
+  if (rx_scratch_.empty()) {
+    rx_scratch_.resize(kReadChunk);
+  }
+  for (;;) {
+    ssize_t n = recv(peer.fd, rx_scratch_.data(), rx_scratch_.size(), 0);
+    if (n > 0) {
+      peer.rx.append(rx_scratch_.data(), static_cast<size_t>(n));
+    }
+    if (n == 0) {
+      eof = true; // 对端关闭，已收到的完整帧仍然交付
+      break;
+    }
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes_rx_.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+    if (static_cast<size_t>(n) < kReadChunk) {
+      break;
+    }
+  }
+
+  RdmaControlMsg msg;
+  RdmaControlMsgView view;
+  std::string error;
+  while (peer.rx.size() - peer.rx_offset >= sizeof(uint32_t)) {
+    uint32_t net_len;
+    memcpy(&net_len, peer.rx.data() + peer.rx_offset, sizeof(net_len));
+    const uint32_t len = ntohl(net_len);
+    if (len == 0 || len > RDMA_CONTROL_MAX_FRAME) {
+      set_error("Invalid message length: " + std::to_string(len));
+      return false;
+    }
+    if (peer.rx.size() - peer.rx_offset < sizeof(net_len) + len) {
+      break;
+    }
+    // 视图直接引用接收缓冲区，回调返回前缓冲区不会被搬移
+    if (!view.parse(peer.rx.data() + peer.rx_offset + sizeof(net_len), len,
+                    error)) {
+      set_error(error);
+      return false;
+    }
+    peer.rx_offset += sizeof(net_len) + len;
+    messages_rx_.fetch_add(1, std::memory_order_relaxed);
+    if (callbacks_.on_message_view) {
+      callbacks_.on_message_view(id, view);
+    } else if (callbacks_.on_message) {
+      view.to_msg(msg);
+      callbacks_.on_message(id, msg);
+    }
+  }
+  // 已解析的前缀过半时再搬移，避免每条消息都移动剩余数据
+  if (peer.rx_offset == peer.rx.size()) {
+    if (peer.rx.capacity() > kRxRetainBytes) {
+      std::string().swap(peer.rx);
+    } else {
+      peer.rx.clear();
+    }
+    peer.rx_offset = 0;
+  } else if (peer.rx_offset > peer.rx.size() / 2) {
+    peer.rx.erase(0, peer.rx_offset);
+    peer.rx_offset = 0;
+  }
+  return !eof;
+}
+
+// 尽量写出发送缓冲；写不完时注册 EPOLLOUT，写完后撤销
+bool RdmaControlPlane::flush(PeerId id, Peer &peer) {
+  while (peer.tx_offset < peer.tx.size()) {
+    ssize_t n = ::send(peer.fd, peer.tx.data() + peer.tx_offset,
+                       peer.tx.size() - peer.tx_offset, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        update_events(id, peer, true);
+        return true;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    peer.tx_offset += static_cast<size_t>(n);
+    bytes_tx_.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+  }
+  peer.tx.clear();
+  peer.tx_offset = 0;
+  update_events(id, peer, false);
+  return true;
+}
+
+void RdmaControlPlane::update_events(PeerId id, Peer &peer, bool want_write) {
+  if (peer.want_write == want_write) {
+    return;
+  }
+  epoll_event ev{};
+  ev.events = want_write ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+  ev.data.u64 = id;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, peer.fd, &ev);
+  peer.want_write = want_write;
+}
+
+void RdmaControlPlane::drop_peer(PeerId id, bool notify) {
+  auto it = peers_.find(id);
+  if (it == peers_.end()) {
+    return;
+  }
+  const bool was_connected = it->second.connected;
+  // close 会把 fd 从 epoll 中移除
+  ::close(it->second.fd);
+  peers_.erase(it);
+  peer_count_.fetch_sub(1, std::memory_order_relaxed);
+  if (!was_connected) {
+    return;
+  }
+  closed_.fetch_add(1, std::memory_order_relaxed);
+  if (notify && callbacks_.on_close) {
+    callbacks_.on_close(id);
+  }
+}
@@ -0,0 +1,538 @@
+#include "../include/rdma_control_transport.h"
+#include "../include/rdma_log.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+// 连接失败时的重试：对端可能尚未开始监听
+const int kConnectRetries = 5;
+const int kConnectRetryIntervalMs = 1000;
+
+// ---------------------------------------------------------------------------
+// TCP / Unix 域流套接字
+// ---------------------------------------------------------------------------
+
+class SocketTransport : public RdmaControlTransport {
+public:
+  explicit SocketTransport(ControlTransportType type) : type_(type) {}
+  ~SocketTransport() override { close(); }
+
+  ControlTransportType type() const override { return type_; }
+
+  bool listen(const std::string &address) override {
+    sockaddr_storage addr;
+    socklen_t len = 0;
+    if (!resolve(address, addr, len)) {
+      return false;
+    }
+    listen_fd_ = socket(family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+      set_errno_error("Failed to create socket");
+      return false;
+    }
+    if (type_ == ControlTransportType::TCP) {
+      // 设置socket选项，允许地址重用
+      int opt = 1;
+      setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    } else if (address[0] != '@') {
+      unlink(address.c_str()); // 上次运行遗留的套接字文件
+      unlink_path_ = address;
+    }
+    if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), len) < 0) {
+      set_errno_error("Failed to bind socket");
+      close_fd(listen_fd_);
+      return false;
+    }
+    if (::listen(listen_fd_, 5) < 0) {
+      set_errno_error("Failed to listen on socket");
+      close_fd(listen_fd_);
+      return false;
+    }
+    listen_address_ = address;
+    if (type_ == ControlTransportType::TCP) {
+      sockaddr_in bound;
+      socklen_t bound_len = sizeof(bound);
+      getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&bound),
+                  &bound_len);
+      listen_address_ = address.substr(0, address.rfind(':') + 1) +
+                        std::to_string(ntohs(bound.sin_port));
+    }
+    RDMA_LOG_INFO("Control transport listening on " << listen_address_);
+    return true;
+  }
+
+  std::string listen_address() const override { return listen_address_; }
+
+  bool accept(uint32_t timeout_ms) override {
+    if (listen_fd_ < 0) {
+      error_ = "Transport is not listening";
+      return false;
+    }
+    pollfd pfd;
+    pfd.fd = listen_fd_;
+    pfd.events = POLLIN;
+    int rc;
+    do {
+      rc = poll(&pfd, 1, timeout_ms == 0 ? -1 : static_cast<int>(timeout_ms));
+    } while (rc < 0 && errno == EINTR);
+    if (rc == 0) {
+      error_ = "Accept timeout after " + std::to_string(timeout_ms) + "ms";
+      return false;
+    }
+    if (rc < 0) {
+      set_errno_error("Poll error");
+      return false;
+    }
+
+    sockaddr_storage peer;
+    socklen_t peer_len = sizeof(peer);
+    fd_ = accept4(listen_fd_, reinterpret_cast<sockaddr *>(&peer), &peer_len,
+                  SOCK_CLOEXEC);
+    if (fd_ < 0) {
+      set_errno_error("Accept failed");
+      return false;
+    }
+    if (type_ == ControlTransportType::TCP) {
+      const sockaddr_in *in = reinterpret_cast<const sockaddr_in *>(&peer);
+      char ip[INET_ADDRSTRLEN];
+      inet_ntop(AF_INET, &in->sin_addr, ip, sizeof(ip));
+      peer_address_ = ip;
+      peer_port_ = ntohs(in->sin_port);
+    } else {
+      peer_address_ = "unix:" + listen_address_;
+    }
+    RDMA_LOG_INFO("Client connected from " << peer_address_ << ":"
+                                           << peer_port_);
+    return true;
+  }
+
+  bool connect(const std::string &address) override {
+    sockaddr_storage addr;
+    socklen_t len = 0;
+    if (!resolve(address, addr, len)) {
+      return false;
+    }
+    for (int retry = 0; retry < kConnectRetries; ++retry) {
+      fd_ = socket(family(), SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (fd_ < 0) {
+        set_errno_error("Failed to create socket");
+        return false;
+      }
+      if (::connect(fd_, reinterpret_cast<sockaddr *>(&addr), len) == 0) {
+        RDMA_LOG_INFO("Successfully connected to " << address);
+        if (type_ == ControlTransportType::TCP) {
+          peer_address_ = address.substr(0, address.rfind(':'));
+          peer_port_ = static_cast<uint16_t>(
+              strtoul(address.c_str() + address.rfind(':') + 1, nullptr, 10));
+        } else {
+          peer_address_ = "unix:" + address;
+        }
+        return true;
+      }
+      // 连接失败，记录错误并重试
+      set_errno_error("Connection attempt " + std::to_string(retry + 1) +
+                      " failed");
+      RDMA_LOG_WARN(error_);
+      close_fd(fd_);
+      if (retry + 1 < kConnectRetries) {
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(kConnectRetryIntervalMs));
+      }
+    }
+    return false;
+  }
+
+  ssize_t send(const struct iovec *iov, int iovcnt, int flags) override {
+    msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = const_cast<struct iovec *>(iov);
+    mh.msg_iovlen = iovcnt;
+    return sendmsg(fd_, &mh, flags | MSG_NOSIGNAL);
+  }
+
+  ssize_t recv(char *buffer, size_t length) override {
+    return ::recv(fd_, buffer, length, MSG_DONTWAIT);
+  }
+
+  int wait_readable(int timeout_ms) override {
+    pollfd pfd;
+    pfd.fd = fd_;
+    pfd.events = POLLIN;
+    int rc = poll(&pfd, 1, timeout_ms);
+    if (rc < 0) {
+      if (errno == EINTR) {
+        return 0;
+      }
+      set_errno_error("Poll error");
+      return -1;
+    }
+    return rc > 0 ? 1 : 0;
+  }
+
+  void close() override {
+    close_fd(fd_);
+    close_fd(listen_fd_);
+    if (!unlink_path_.empty()) {
+      unlink(unlink_path_.c_str());
+      unlink_path_.clear();
+    }
+  }
+
+  int fd() const override { return fd_; }
+  std::string peer_address() const override { return peer_address_; }
+  uint16_t peer_port() const override { return peer_port_; }
+  std::string get_error() const override { return error_; }
+
+private:
+  ControlTransportType type_;
+  int fd_ = -1;
+  int listen_fd_ = -1;
+  std::string listen_address_;
+  std::string unlink_path_; // 由本端创建、关闭时删除的套接字文件
+  std::string peer_address_;
+  uint16_t peer_port_ = 0;
+  std::string error_;
+
+  int family() const {
+    return type_ == ControlTransportType::TCP ? AF_INET : AF_UNIX;
+  }
+
+  void set_errno_error(const std::string &what) {
+    error_ = what + ": " + strerror(errno);
+  }
+
+  static void close_fd(int &fd) {
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+
+  bool resolve(const std::string &address, sockaddr_storage &addr,
+               socklen_t &len) {
+    memset(&addr, 0, sizeof(addr));
+    if (type_ == ControlTransportType::TCP) {
+      size_t colon = address.rfind(':');
+      sockaddr_in *in = reinterpret_cast<sockaddr_in *>(&addr);
+      in->sin_family = AF_INET;
+      if (colon == std::string::npos ||
+          inet_pton(AF_INET, address.substr(0, colon).c_str(),
+                    &in->sin_addr) <= 0) {
+        error_ = "Invalid address: " + address;
+        return false;
+      }
+      unsigned long port = strtoul(address.c_str() + colon + 1, nullptr, 10);
+      if (port > 65535) {
+        error_ = "Invalid port: " + address;
+        return false;
+      }
+      in->sin_port = htons(static_cast<uint16_t>(port));
+      len = sizeof(sockaddr_in);
+      return true;
+    }
+
+    sockaddr_un *un = reinterpret_cast<sockaddr_un *>(&addr);
+    un->sun_family = AF_UNIX;
+    if (address.empty() || address.size() >= sizeof(un->sun_path)) {
+      error_ = "Invalid unix socket path: " + address;
+      return false;
+    }
+    memcpy(un->sun_path, address.data(), address.size());
+    if (address[0] == '@') {
+      un->sun_path[0] = '\0'; // 抽象命名空间，不在文件系统中创建文件
+    }
+    len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) +
+                                 address.size() + (address[0] == '@' ? 0 : 1));
+    return true;
+  }
+};
+
+// ---------------------------------------------------------------------------
+// 进程内传输
+// ---------------------------------------------------------------------------
+
+// 单生产者单消费者字节环：读写位置各由一方推进，数据路径不加锁；
+// 只有一方需要阻塞等待时才经由互斥锁和条件变量唤醒
+struct InprocPipe {
+  static const size_t kCapacity = 1 << 20;
+
+  std::unique_ptr<char[]> data{new char[kCapacity]};
+  alignas(64) std::atomic<size_t> head{0}; // 读者推进
+  alignas(64) std::atomic<size_t> tail{0}; // 写者推进
+  alignas(64) std::atomic<bool> closed{false};
+  std::atomic<uint32_t> waiters{0};
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  size_t write(const char *src, size_t length) {
+    const size_t t = tail.load(std::memory_order_relaxed);
+    const size_t free_bytes =
+        kCapacity - (t - head.load(std::memory_order_acquire));
+    const size_t n = length < free_bytes ? length : free_bytes;
+    const size_t offset = t & (kCapacity - 1);
+    const size_t first = n < kCapacity - offset ? n : kCapacity - offset;
+    memcpy(data.get() + offset, src, first);
+    memcpy(data.get(), src + first, n - first);
+    tail.store(t + n, std::memory_order_release);
+    return n;
+  }
+
+  size_t read(char *dst, size_t length) {
+    const size_t h = head.load(std::memory_order_relaxed);
+    const size_t used = tail.load(std::memory_order_acquire) - h;
+    const size_t n = length < used ? length : used;
+    const size_t offset = h & (kCapacity - 1);
+    const size_t first = n < kCapacity - offset ? n : kCapacity - offset;
+    memcpy(dst, data.get() + offset, first);
+    memcpy(dst + first, data.get(), n - first);
+    head.store(h + n, std::memory_order_release);
+    return n;
+  }
+
+  size_t readable() const {
+    return tail.load(std::memory_order_acquire) -
+           head.load(std::memory_order_relaxed);
+  }
+
+  // 推进读写位置后调用：只有对方在等待时才进入内核
+  void wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed) != 0) {
+      std::lock_guard<std::mutex> lock(mutex);
+      cv.notify_all();
+    }
+  }
+
+  // 先短暂自旋，仍不满足时阻塞；timeout_ms 为 -1 时一直等待
+  template <typename Pred> bool wait(Pred ready, int timeout_ms) {
+    for (int i = 0; i < 1024; ++i) {
+      if (ready()) {
+        return true;
+      }
+    }
+    waiters.fetch_add(1, std::memory_order_seq_cst);
+    std::unique_lock<std::mutex> lock(mutex);
+    bool ok;
+    if (timeout_ms < 0) {
+      cv.wait(lock, ready);
+      ok = true;
+    } else {
+      ok = cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready);
+    }
+    waiters.fetch_sub(1, std::memory_order_relaxed);
+    return ok;
+  }
+
+  void close() {
+    closed.store(true, std::memory_order_seq_cst);
+    std::lock_guard<std::mutex> lock(mutex);
+    cv.notify_all();
+  }
+};
+
+// 一条进程内连接：两个方向各一个字节环
+struct InprocConnection {
+  InprocPipe to_server;
+  InprocPipe to_client;
+};
+
+struct InprocListener {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<std::shared_ptr<InprocConnection>> pending;
+};
+
+// 进程内监听者目录：名字 -> 监听者
+std::mutex g_inproc_mutex;
+std::unordered_map<std::string, std::shared_ptr<InprocListener>> g_inproc;
+
+class InprocTransport : public RdmaControlTransport {
+public:
+  ~InprocTransport() override { close(); }
+
+  ControlTransportType type() const override {
+    return ControlTransportType::INPROC;
+  }
+
+  bool listen(const std::string &address) override {
+    std::lock_guard<std::mutex> lock(g_inproc_mutex);
+    auto inserted = g_inproc.emplace(address, nullptr);
+    if (!inserted.second) {
+      error_ = "In-process address already in use: " + address;
+      return false;
+    }
+    listener_ = std::make_shared<InprocListener>();
+    inserted.first->second = listener_;
+    name_ = address;
+    return true;
+  }
+
+  std::string listen_address() const override { return name_; }
+
+  bool accept(uint32_t timeout_ms) override {
+    if (!listener_) {
+      error_ = "Transport is not listening";
+      return false;
+    }
+    std::unique_lock<std::mutex> lock(listener_->mutex);
+    auto ready = [this]() { return !listener_->pending.empty(); };
+    if (timeout_ms == 0) {
+      listener_->cv.wait(lock, ready);
+    } else if (!listener_->cv.wait_for(
+                   lock, std::chrono::milliseconds(timeout_ms), ready)) {
+      error_ = "Accept timeout after " + std::to_string(timeout_ms) + "ms";
+      return false;
+    }
+    conn_ = listener_->pending.front();
+    listener_->pending.pop_front();
+    rx_ = &conn_->to_server;
+    tx_ = &conn_->to_client;
+    peer_address_ = "inproc:" + name_;
+    return true;
+  }
+
+  bool connect(const std::string &address) override {
+    std::shared_ptr<InprocListener> listener;
+    {
+      std::lock_guard<std::mutex> lock(g_inproc_mutex);
+      auto it = g_inproc.find(address);
+      if (it != g_inproc.end()) {
+        listener = it->second;
+      }
+    }
+    if (!listener) {
+      error_ = "No in-process listener at " + address;
+      return false;
+    }
+    conn_ = std::make_shared<InprocConnection>();
+    rx_ = &conn_->to_client;
+    tx_ = &conn_->to_server;
+    peer_address_ = "inproc:" + address;
+    {
+      std::lock_guard<std::mutex> lock(listener->mutex);
+      listener->pending.push_back(conn_);
+    }
+    listener->cv.notify_all();
+    return true;
+  }
+
+  // 与阻塞套接字一致：环满时等待读者腾出空间，直到全部写入或对端关闭
+  ssize_t send(const struct iovec *iov, int iovcnt, int /*flags*/) override {
+    if (!tx_) {
+      errno = ENOTCONN;
+      return -1;
+    }
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+      const char *p = static_cast<const char *>(iov[i].iov_base);
+      size_t left = iov[i].iov_len;
+      while (left > 0) {
+        if (tx_->closed.load(std::memory_order_acquire)) {
+          errno = EPIPE;
+          return total > 0 ? total : -1;
+        }
+        size_t n = tx_->write(p, left);
+        if (n > 0) {
+          tx_->wake();
+          p += n;
+          left -= n;
+          total += static_cast<ssize_t>(n);
+          continue;
+        }
+        InprocPipe *pipe = tx_;
+        pipe->wait(
+            [pipe]() {
+              return pipe->readable() < InprocPipe::kCapacity ||
+                     pipe->closed.load(std::memory_order_acquire);
+            },
+            -1);
+      }
+    }
+    return total;
+  }
+
+  ssize_t recv(char *buffer, size_t length) override {
+    if (!rx_) {
+      errno = ENOTCONN;
+      return -1;
+    }
+    size_t n = rx_->read(buffer, length);
+    if (n > 0) {
+      rx_->wake(); // 写者可能在等待空间
+      return static_cast<ssize_t>(n);
+    }
+    if (rx_->closed.load(std::memory_order_acquire) && rx_->readable() == 0) {
+      return 0;
+    }
+    errno = EAGAIN;
+    return -1;
+  }
+
+  int wait_readable(int timeout_ms) override {
+    if (!rx_) {
+      return -1;
+    }
+    InprocPipe *pipe = rx_;
+    return pipe->wait(
+               [pipe]() {
+                 return pipe->readable() > 0 ||
+                        pipe->closed.load(std::memory_order_acquire);
+               },
+               timeout_ms)
+               ? 1
+               : 0;
+  }
+
+  void close() override {
+    if (conn_) {
+      conn_->to_server.close();
+      conn_->to_client.close();
+      conn_.reset();
+      rx_ = tx_ = nullptr;
+    }
+    if (listener_) {
+      std::lock_guard<std::mutex> lock(g_inproc_mutex);
+      g_inproc.erase(name_);
+      listener_.reset();
+    }
+  }
+
+  int fd() const override { return -1; }
+  std::string peer_address() const override { return peer_address_; }
+  uint16_t peer_port() const override { return 0; }
+  std::string get_error() const override { return error_; }
+
+private:
+  std::shared_ptr<InprocListener> listener_;
+  std::string name_;
+  std::shared_ptr<InprocConnection> conn_;
+  InprocPipe *rx_ = nullptr;
+  InprocPipe *tx_ = nullptr;
+  std::string peer_address_;
+  std::string error_;
+};
+
+} // namespace
+
+std::unique_ptr<RdmaControlTransport>
+make_control_transport(ControlTransportType type) {
+  if (type == ControlTransportType::INPROC) {
+    return std::unique_ptr<RdmaControlTransport>(new InprocTransport());
+  }
+  return std::unique_ptr<RdmaControlTransport>(new SocketTransport(type));
+}
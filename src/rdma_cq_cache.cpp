@@ -8,9 +8,15 @@
 namespace {
 std::mutex cq_mutex; // 可选：线程安全（如不需要并发，可去掉）
 std::atomic<uint32_t> simulated_delay_ns{0};
+
+// 条目占用的字节数（含缓存的完成）
+size_t entry_bytes(const CQValue &cq) {
+  return sizeof(CQValue) + cq.completions.size() * sizeof(CompletionEntry);
+}
 }
 
 bool RdmaCQCache::get(uint32_t cq_num, CQValue &info) {
+  RdmaCacheAccessTimer timer(counters_);
   std::lock_guard<std::mutex> lock(cq_mutex);
   if (simulated_delay_ns.load(std::memory_order_relaxed) > 0) {
     std::this_thread::sleep_for(
@@ -20,53 +26,99 @@ bool RdmaCQCache::get(uint32_t cq_num, CQValue &info) {
   auto it = cache_.find(cq_num);
   if (it != cache_.end()) {
     info = it->second;
+    counters_.record_hit();
     return true;
   }
+  counters_.record_miss();
   return false;
 }
 
 void RdmaCQCache::set(uint32_t cq_num, const CQValue &info) {
+  RdmaCacheAccessTimer timer(counters_);
   std::lock_guard<std::mutex> lock(cq_mutex);
   if (simulated_delay_ns.load(std::memory_order_relaxed) > 0) {
     std::this_thread::sleep_for(
         std::chrono::nanoseconds(simulated_delay_ns.load(std::memory_order_relaxed)));
   }
 
+  const size_t bytes = entry_bytes(info);
+  auto existing = cache_.find(cq_num);
+  if (existing != cache_.end()) {
+    // 覆盖已有条目时不淘汰
+    counters_.record_write(bytes, bytes, entry_bytes(existing->second));
+    existing->second = info;
+    return;
+  }
+
   // 简单容量限制策略（非LRU）
   if (cache_.size() >= cache_size_) {
     auto it = cache_.begin();
     if (it != cache_.end()) {
+      counters_.record_evict(entry_bytes(it->second));
       cache_.erase(it);
     }
   }
 
   cache_[cq_num] = info;
+  counters_.record_insert(bytes);
+}
+
+bool RdmaCQCache::erase(uint32_t cq_num) {
+  std::lock_guard<std::mutex> lock(cq_mutex);
+  auto it = cache_.find(cq_num);
+  if (it == cache_.end()) {
+    return false;
+  }
+  counters_.record_release(entry_bytes(it->second));
+  cache_.erase(it);
+  return true;
+}
+
+size_t RdmaCQCache::size() const {
+  std::lock_guard<std::mutex> lock(cq_mutex);
+  return cache_.size();
+}
+
+std::vector<uint32_t> RdmaCQCache::keys() const {
+  std::lock_guard<std::mutex> lock(cq_mutex);
+
+  std::vector<uint32_t> result;
+  result.reserve(cache_.size());
+  for (const auto &entry : cache_) {
+    result.push_back(entry.first);
+  }
+  return result;
 }
 
 void RdmaCQCache::batch_add_completions(
     uint32_t cq_num, const std::vector<CompletionEntry> &completions) {
+  RdmaCacheAccessTimer timer(counters_);
   std::lock_guard<std::mutex> lock(cq_mutex);
   if (simulated_delay_ns.load(std::memory_order_relaxed) > 0) {
     std::this_thread::sleep_for(
         std::chrono::nanoseconds(simulated_delay_ns.load(std::memory_order_relaxed)));
   }
 
+  const size_t added = completions.size() * sizeof(CompletionEntry);
   auto it = cache_.find(cq_num);
   if (it != cache_.end()) {
     // 添加到已有 CQ 的 completions 列表末尾
     it->second.completions.insert(it->second.completions.end(),
                                   completions.begin(), completions.end());
+    counters_.record_write(added, added, 0);
   } else {
     // 不存在，创建一个新的 CQValue
     CQValue cq;
     cq.cq_num = cq_num;
     cq.completions = completions;
+    counters_.record_insert(entry_bytes(cq));
     cache_[cq_num] = std::move(cq);
   }
 }
 
 std::vector<CompletionEntry>
 RdmaCQCache::batch_get_completions(uint32_t cq_num, uint32_t max_count) {
+  RdmaCacheAccessTimer timer(counters_);
   std::lock_guard<std::mutex> lock(cq_mutex);
   if (simulated_delay_ns.load(std::memory_order_relaxed) > 0) {
     std::this_thread::sleep_for(
@@ -84,6 +136,10 @@ RdmaCQCache::batch_get_completions(uint32_t cq_num, uint32_t max_count) {
 
     // 移除这些已消费的完成事件
     comps.erase(comps.begin(), comps.begin() + count);
+    counters_.record_hit();
+    counters_.record_release(count * sizeof(CompletionEntry));
+  } else {
+    counters_.record_miss();
   }
 
   return result;
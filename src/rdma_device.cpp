@@ -1,5 +1,13 @@
 #include "../include/rdma_device.h"
-#include <iostream>
+#include "../include/rdma_log.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 #include <stdexcept>
 #include <atomic>
 #include <thread>
@@ -7,9 +15,10 @@
 RdmaDevice::RdmaDevice(size_t max_connections, size_t max_qps, size_t max_cqs,
                        size_t max_mrs, size_t max_pds)
     : max_qps_(max_qps), max_cqs_(max_cqs), max_mrs_(max_mrs),
-      max_pds_(max_pds), next_qp_num_(1), next_cq_num_(1), next_mr_lkey_(1),
-      next_pd_handle_(1), should_stop_(false),
-      max_connections_(max_connections) {
+      max_pds_(max_pds), next_cq_num_(1), next_mr_lkey_(1),
+      next_pd_handle_(1), next_channel_num_(1),
+      cq_wait_spin_ns_(CqWaitPolicy().spin_ns),
+      cq_wait_yield_ns_(CqWaitPolicy().yield_ns), max_connections_(max_connections) {
 
   // 初始化缓存系统 - 缓存大小设置为设备资源限制的2倍，作为溢出缓存
   qp_cache_ = std::make_unique<RdmaQPCache>(max_qps * 2);
@@ -17,133 +26,444 @@ RdmaDevice::RdmaDevice(size_t max_connections, size_t max_qps, size_t max_cqs,
   mr_cache_ = std::make_unique<RdmaMRCache>(max_mrs * 2);
   pd_cache_ = std::make_unique<RdmaPDCache>(max_pds * 2);
 
-  // 启动网络处理线程
-  network_thread_ =
-      std::make_unique<std::thread>(&RdmaDevice::network_thread_func, this);
+  // 设备层是固定容量的上下文表，按容量一次性分配桶
+  qps_.reserve(max_qps_);
+  cqs_.reserve(max_cqs_);
+
+  async_fd_ = eventfd(0, EFD_NONBLOCK | EFD_SEMAPHORE | EFD_CLOEXEC);
 }
 
+// QP编号在所有设备间唯一分配，对端通过QP号即可定位所属设备
+std::atomic<uint32_t> RdmaDevice::next_qp_num_{1};
+
+// QP目录：QP编号 -> 所属设备，在 create_qp/destroy_qp 时维护
+static std::unordered_map<uint32_t, RdmaDevice *> global_qp_map;
+static std::mutex global_qp_mutex;
+
 // 模拟配置（静态）
 std::atomic<bool> RdmaDevice::enable_middle_cache_{true};
 std::atomic<uint32_t> RdmaDevice::host_swap_delay_ns_{0};
 std::atomic<uint32_t> RdmaDevice::device_delay_ns_{0};
 std::atomic<uint32_t> RdmaDevice::middle_delay_ns_{0};
+std::atomic<bool> RdmaDevice::sleep_on_delay_{true};
 
 void RdmaDevice::set_simulation_mode(bool enable_middle_cache,
                                      uint32_t host_swap_delay_ns,
                                      uint32_t device_delay_ns,
-                                     uint32_t middle_delay_ns) {
+                                     uint32_t middle_delay_ns,
+                                     bool sleep_on_delay) {
   enable_middle_cache_.store(enable_middle_cache, std::memory_order_relaxed);
   host_swap_delay_ns_.store(host_swap_delay_ns, std::memory_order_relaxed);
   device_delay_ns_.store(device_delay_ns, std::memory_order_relaxed);
   middle_delay_ns_.store(middle_delay_ns, std::memory_order_relaxed);
+  sleep_on_delay_.store(sleep_on_delay, std::memory_order_relaxed);
 }
 
-static inline void maybe_sleep_ns(uint32_t ns) {
-  if (ns > 0) {
+void RdmaDevice::charge_delay_ns(uint32_t ns) {
+  if (ns == 0) {
+    return;
+  }
+  tier_delay_ns_.fetch_add(ns, std::memory_order_relaxed);
+  if (sleep_on_delay_.load(std::memory_order_relaxed)) {
     std::this_thread::sleep_for(std::chrono::nanoseconds(ns));
   }
 }
 
-RdmaDevice::~RdmaDevice() {
-  // 停止网络处理线程
-  should_stop_ = true;
-  if (network_thread_ && network_thread_->joinable()) {
-    network_thread_->join();
+uint32_t RdmaDevice::qp_tier_delay_ns(uint32_t qp_num) const {
+  if (qps_.count(qp_num) > 0) {
+    return device_delay_ns_.load(std::memory_order_relaxed);
+  }
+  if (qps_host_.count(qp_num) > 0) {
+    return host_swap_delay_ns_.load(std::memory_order_relaxed);
   }
+  return middle_delay_ns_.load(std::memory_order_relaxed);
+}
 
-  // 清理资源
-  cleanup_resources();
+// inline 数据拷贝：按固定大小的块拷贝，每个 memcpy 的长度都是编译期常量，
+// 编译器会将其展开为 SIMD 寄存器搬运；尾部使用与末尾对齐的重叠块补齐，
+// 避免逐字节循环
+static inline void inline_copy(void *dst, const void *src, size_t len) {
+  auto *d = static_cast<uint8_t *>(dst);
+  auto *s = static_cast<const uint8_t *>(src);
+  if (len >= 32) {
+    size_t off = 0;
+    for (; off + 32 <= len; off += 32) {
+      std::memcpy(d + off, s + off, 32);
+    }
+    if (off < len) {
+      std::memcpy(d + len - 32, s + len - 32, 32);
+    }
+  } else if (len >= 16) {
+    std::memcpy(d, s, 16);
+    std::memcpy(d + len - 16, s + len - 16, 16);
+  } else if (len >= 8) {
+    std::memcpy(d, s, 8);
+    std::memcpy(d + len - 8, s + len - 8, 8);
+  } else if (len >= 4) {
+    std::memcpy(d, s, 4);
+    std::memcpy(d + len - 4, s + len - 4, 4);
+  } else {
+    for (size_t i = 0; i < len; ++i) {
+      d[i] = s[i];
+    }
+  }
 }
 
-uint32_t RdmaDevice::create_qp(uint32_t /*max_send_wr*/,
-                               uint32_t /*max_recv_wr*/, uint32_t send_cq,
-                               uint32_t recv_cq) {
-  std::lock_guard<std::mutex> lock(qp_mutex_);
+// 按SGE列表执行分散/聚合拷贝：源和目的各自维护游标逐段搬运，
+// 不经过中间缓冲区。dst_offset/src_offset 为在各自列表中的起始字节偏移，
+// 用于按包重组；use_inline_copy 为真时使用固定块拷贝
+static void sg_copy(const RdmaSge *dst, uint32_t num_dst, size_t dst_offset,
+                    const RdmaSge *src, uint32_t num_src, size_t src_offset,
+                    size_t length, bool use_inline_copy) {
+  uint32_t di = 0, si = 0;
+  while (di < num_dst && dst_offset >= dst[di].length) {
+    dst_offset -= dst[di++].length;
+  }
+  while (si < num_src && src_offset >= src[si].length) {
+    src_offset -= src[si++].length;
+  }
 
-  // 验证CQ是否存在
+  size_t doff = dst_offset, soff = src_offset;
+  while (length > 0 && di < num_dst && si < num_src) {
+    size_t n = std::min({length, static_cast<size_t>(dst[di].length) - doff,
+                         static_cast<size_t>(src[si].length) - soff});
+    auto *d = static_cast<uint8_t *>(dst[di].addr) + doff;
+    auto *s = static_cast<const uint8_t *>(src[si].addr) + soff;
+    if (use_inline_copy) {
+      inline_copy(d, s, n);
+    } else {
+      std::memcpy(d, s, n);
+    }
+    length -= n;
+    doff += n;
+    soff += n;
+    if (doff == dst[di].length) {
+      ++di;
+      doff = 0;
+    }
+    if (soff == src[si].length) {
+      ++si;
+      soff = 0;
+    }
+  }
+}
+
+// PSN a 是否在 b 之前（24位序号空间，按半窗口判断回绕）
+static inline bool psn_before(uint32_t a, uint32_t b) {
+  uint32_t diff = (b - a) & RDMA_PSN_MASK;
+  return diff != 0 && diff < (RDMA_PSN_MASK + 1) / 2;
+}
+
+// 本地ACK超时：4.096us * 2^timeout，0 表示不超时
+static inline uint64_t ack_timeout_ns(uint8_t timeout) {
+  return timeout == 0 ? 0 : 4096ULL << std::min<uint8_t>(timeout, 31);
+}
+
+// RNR NAK 等待时间编码（IB 规范表，单位 10us），0 对应 655.36ms
+static uint64_t rnr_timer_ns(uint8_t code) {
+  static const uint32_t kRnrTimer10us[32] = {
+      65536, 1,    2,    3,    4,    6,    8,     12,    16,    24,   32,
+      48,    64,   96,   128,  192,  256,  384,   512,   768,   1024, 1536,
+      2048,  3072, 4096, 6144, 8192, 12288, 16384, 24576, 32768, 49152};
+  return kRnrTimer10us[code & 31] * 10000ULL;
+}
+
+// 由发送中的消息生成第 index 个包
+static void fill_packet(const OutboundMessage &msg, uint32_t index,
+                        RdmaPacket &pkt) {
+  const SendWqe &wqe = msg.wqe;
+  pkt.src_qp = msg.src_qp;
+  pkt.dest_qp = msg.dest_qp;
+  pkt.opcode = wqe.wr.opcode;
+  pkt.msg_length = wqe.length;
+  pkt.remote_addr = wqe.wr.remote_addr;
+  pkt.imm_data = wqe.wr.imm_data;
+  pkt.solicited = wqe.wr.solicited;
+  pkt.src_inline = wqe.wr.send_inline;
+  pkt.src_sge = pkt.src_inline ? &msg.inline_sge : wqe.sge.data();
+  pkt.num_src_sge = pkt.src_inline ? 1 : wqe.num_sge;
+  pkt.psn = (msg.first_psn + index) & RDMA_PSN_MASK;
+  pkt.first = index == 0;
+  pkt.last = index + 1 == msg.num_packets;
+  pkt.offset = index * msg.mtu;
+  pkt.payload_length = std::min(msg.mtu, wqe.length - pkt.offset);
+  pkt.qkey = wqe.wr.remote_qkey;
+  pkt.grh = msg.has_grh ? &msg.grh : nullptr;
+  pkt.dc_connect = msg.dc_connect && index == 0;
+}
+
+// 按地址句柄生成GRH（多字节字段转为网络字节序）
+static void build_grh(const AhAttr &ah, const std::array<uint8_t, 16> &sgid,
+                      uint32_t payload, RdmaGrh &grh) {
+  grh.version_tclass_flow =
+      htonl((6u << 28) | (static_cast<uint32_t>(ah.traffic_class) << 20) |
+            (ah.flow_label & 0xFFFFF));
+  grh.paylen = htons(static_cast<uint16_t>(payload));
+  grh.next_hdr = 0x1B; // IBA 传输头
+  grh.hop_limit = ah.hop_limit;
+  grh.sgid = sgid;
+  grh.dgid = ah.dgid;
+}
+
+// 把工作请求中的本地缓冲区统一展开为SGE列表
+// num_sge 为0时 local_addr/length/lkey 视为单个SGE
+static bool load_sg_list(const RdmaWorkRequest &wr, uint32_t max_sge,
+                         RdmaSge *out, uint32_t &num_sge, uint32_t &length) {
+  if (wr.num_sge == 0) {
+    out[0] = RdmaSge{wr.local_addr, wr.length, wr.lkey};
+    num_sge = 1;
+    length = wr.length;
+    return true;
+  }
+  if (wr.num_sge > max_sge || wr.sg_list == nullptr) {
+    return false;
+  }
+
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < wr.num_sge; ++i) {
+    out[i] = wr.sg_list[i];
+    total += wr.sg_list[i].length;
+  }
+  if (total > UINT32_MAX) {
+    return false;
+  }
+  num_sge = wr.num_sge;
+  length = static_cast<uint32_t>(total);
+  return true;
+}
+
+// 在三层存储中定位QP：设备资源 -> 中间缓存（启用时）-> 主机交换表
+// 中间缓存返回的是副本，fn 返回 true 时写回缓存
+template <typename Fn> bool RdmaDevice::with_qp(uint32_t qp_num, Fn &&fn) {
+  auto it = qps_.find(qp_num);
+  if (it != qps_.end()) {
+    counters_.add(RdmaCounter::QP_HIT_DEVICE);
+    return fn(it->second);
+  }
+
+  if (enable_middle_cache_.load(std::memory_order_relaxed)) {
+    QPValue qp_info;
+    if (qp_cache_->get(qp_num, qp_info)) {
+      counters_.add(RdmaCounter::QP_HIT_CACHE);
+      charge_delay_ns(middle_delay_ns_.load(std::memory_order_relaxed));
+      if (!fn(qp_info)) {
+        return false;
+      }
+      qp_cache_->set(qp_num, qp_info);
+      return true;
+    }
+  }
+
+  auto it_host = qps_host_.find(qp_num);
+  if (it_host == qps_host_.end()) {
+    counters_.add(RdmaCounter::QP_MISS);
+    return false;
+  }
+  counters_.add(RdmaCounter::QP_HIT_HOST);
+  charge_delay_ns(host_swap_delay_ns_.load(std::memory_order_relaxed));
+  return fn(it_host->second);
+}
+
+// 在三层存储中定位CQ：设备资源 -> 中间缓存 -> 主机交换表
+// 中间缓存返回的是副本，fn 返回 true 时写回缓存
+template <typename Fn> bool RdmaDevice::with_cq(uint32_t cq_num, Fn &&fn) {
+  auto it = cqs_.find(cq_num);
+  if (it != cqs_.end()) {
+    counters_.add(RdmaCounter::CQ_HIT_DEVICE);
+    fn(it->second);
+    return true;
+  }
+
+  CQValue cq_info;
+  if (cq_cache_->get(cq_num, cq_info)) {
+    counters_.add(RdmaCounter::CQ_HIT_CACHE);
+    charge_delay_ns(middle_delay_ns_.load(std::memory_order_relaxed));
+    if (fn(cq_info)) {
+      cq_cache_->set(cq_num, cq_info);
+    }
+    return true;
+  }
+
+  auto host_it = cqs_host_.find(cq_num);
+  if (host_it != cqs_host_.end()) {
+    counters_.add(RdmaCounter::CQ_HIT_HOST);
+    charge_delay_ns(host_swap_delay_ns_.load(std::memory_order_relaxed));
+    fn(host_it->second);
+    return true;
+  }
+  counters_.add(RdmaCounter::CQ_MISS);
+  return false;
+}
+
+RdmaDevice::~RdmaDevice() {
+  // 排空并停止发送处理引擎
+  stop_engines();
+
+  // 先从QP目录中移除本设备的QP，等待已查到本设备的投递结束，
+  // 再撤销链路上属于本设备的事件，此后不会再有包投递到本设备
   {
-    std::lock_guard<std::mutex> cq_lock(cq_mutex_);
-    CQValue send_cq_value;
-    CQValue recv_cq_value;
-    bool send_cq_exists = cqs_.find(send_cq) != cqs_.end();
-    bool recv_cq_exists = cqs_.find(recv_cq) != cqs_.end();
-    if (!send_cq_exists || !recv_cq_exists) {
-      if (enable_middle_cache_.load(std::memory_order_relaxed)) {
-        send_cq_exists = send_cq_exists || cq_cache_->get(send_cq, send_cq_value);
-        recv_cq_exists = recv_cq_exists || cq_cache_->get(recv_cq, recv_cq_value);
+    std::lock_guard<std::mutex> global_lock(global_qp_mutex);
+    for (auto it = global_qp_map.begin(); it != global_qp_map.end();) {
+      if (it->second == this) {
+        it = global_qp_map.erase(it);
       } else {
-        send_cq_exists = send_cq_exists || (cqs_host_.find(send_cq) != cqs_host_.end());
-        recv_cq_exists = recv_cq_exists || (cqs_host_.find(recv_cq) != cqs_host_.end());
+        ++it;
       }
     }
+  }
+  while (owner_refs_.load(std::memory_order_acquire) != 0) {
+    std::this_thread::yield();
+  }
+  RdmaFabric::instance().cancel(this);
 
-    if (!send_cq_exists || !recv_cq_exists) {
-      return 0; // 返回0表示创建失败
-    }
+  // 清理资源
+  cleanup_resources();
+}
+
+uint32_t RdmaDevice::create_qp(uint32_t max_send_wr, uint32_t max_recv_wr,
+                               uint32_t send_cq, uint32_t recv_cq,
+                               uint32_t max_inline_data, uint32_t max_sge,
+                               QpType qp_type) {
+  std::vector<uint32_t> qp_nums;
+  if (!create_qp_batch(1, max_send_wr, max_recv_wr, send_cq, recv_cq, qp_nums,
+                       max_inline_data, max_sge, qp_type)) {
+    return 0; // 返回0表示创建失败
   }
+  return qp_nums.front();
+}
 
-  uint32_t qp_num = next_qp_num_++;
+bool RdmaDevice::create_qp_batch(uint32_t count, uint32_t max_send_wr,
+                                 uint32_t max_recv_wr, uint32_t send_cq,
+                                 uint32_t recv_cq,
+                                 std::vector<uint32_t> &qp_nums,
+                                 uint32_t max_inline_data, uint32_t max_sge,
+                                 QpType qp_type) {
+  if (count == 0 || max_send_wr == 0 || max_send_wr > RDMA_MAX_QP_WR ||
+      max_recv_wr > RDMA_MAX_QP_WR) {
+    return false;
+  }
 
-  // 检查设备资源是否已满
-  if (qps_.size() < max_qps_) {
-    maybe_sleep_ns(device_delay_ns_.load(std::memory_order_relaxed));
-    // 创建新的QP
-    QPValue qp_value{};
-    qp_value.qp_num = qp_num;
-    qp_value.state = QpState::RESET; // RESET state
-    qp_value.send_cq = send_cq;      // 设置发送CQ
-    qp_value.recv_cq = recv_cq;      // 设置接收CQ
-    qp_value.created_time = std::chrono::steady_clock::now();
+  std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
 
-    // 存储在设备的资源中
-    qps_[qp_num] = qp_value;
-    return qp_num;
+  // 验证CQ是否存在
+  {
+    std::lock_guard<RdmaCountedMutex> cq_lock(cq_mutex_);
+    if (!cq_exists_locked(send_cq) || !cq_exists_locked(recv_cq)) {
+      return false;
+    }
   }
 
-  // 如果设备资源已满
   QPValue qp_value{};
-  qp_value.qp_num = qp_num;
   qp_value.state = QpState::RESET; // RESET state
+  qp_value.qp_type = qp_type;
   qp_value.send_cq = send_cq;      // 设置发送CQ
   qp_value.recv_cq = recv_cq;      // 设置接收CQ
+  qp_value.max_send_wr = max_send_wr;
+  qp_value.max_recv_wr = max_recv_wr;
+  qp_value.max_send_sge = std::max(1u, std::min(max_sge, RDMA_MAX_SGE));
+  qp_value.max_recv_sge = qp_value.max_send_sge;
+  qp_value.max_inline_data = std::min(max_inline_data, RDMA_MAX_INLINE_DATA);
   qp_value.created_time = std::chrono::steady_clock::now();
 
+  // 按各层剩余容量划分：先占满设备资源，再放入中间缓存，其余进入主机交换表
+  const size_t to_device =
+      std::min<size_t>(count, max_qps_ - std::min(qps_.size(), max_qps_));
+  size_t to_cache = 0;
   if (enable_middle_cache_.load(std::memory_order_relaxed)) {
-    maybe_sleep_ns(middle_delay_ns_.load(std::memory_order_relaxed));
-    qp_cache_->set(qp_num, qp_value);
-  } else {
-    maybe_sleep_ns(host_swap_delay_ns_.load(std::memory_order_relaxed));
-    qps_host_[qp_num] = qp_value;
+    size_t cached = qp_cache_->size();
+    size_t capacity = qp_cache_->capacity();
+    to_cache = std::min(count - to_device,
+                        capacity - std::min(cached, capacity));
+  }
+  const size_t to_host = count - to_device - to_cache;
+  if (to_device > 0) {
+    charge_delay_ns(device_delay_ns_.load(std::memory_order_relaxed));
+  }
+  if (to_cache > 0) {
+    charge_delay_ns(middle_delay_ns_.load(std::memory_order_relaxed));
+  }
+  if (to_host > 0) {
+    charge_delay_ns(host_swap_delay_ns_.load(std::memory_order_relaxed));
+    qps_host_.reserve(qps_host_.size() + to_host);
+  }
+
+  // 一次分配连续的QP编号区间
+  const uint32_t first = next_qp_num_.fetch_add(count);
+  qp_nums.reserve(qp_nums.size() + count);
+  for (uint32_t i = 0; i < count; ++i) {
+    qp_value.qp_num = first + i;
+    if (i < to_device) {
+      qps_.emplace(qp_value.qp_num, qp_value);
+    } else if (i < to_device + to_cache) {
+      qp_cache_->set(qp_value.qp_num, qp_value);
+    } else {
+      qps_host_.emplace(qp_value.qp_num, qp_value);
+    }
+    qp_nums.push_back(qp_value.qp_num);
+  }
+
+  {
+    std::lock_guard<std::mutex> global_lock(global_qp_mutex);
+    global_qp_map.reserve(global_qp_map.size() + count);
+    for (uint32_t i = 0; i < count; ++i) {
+      global_qp_map[first + i] = this;
+    }
+  }
+  return true;
+}
+
+bool RdmaDevice::cq_exists_locked(uint32_t cq_num) {
+  if (cqs_.find(cq_num) != cqs_.end() ||
+      cqs_host_.find(cq_num) != cqs_host_.end()) {
+    return true;
   }
-  return qp_num;
+  CQValue cached;
+  return cq_cache_->get(cq_num, cached);
 }
 
-uint32_t RdmaDevice::create_cq(uint32_t max_cqe) {
-  std::lock_guard<std::mutex> lock(cq_mutex_);
+uint32_t RdmaDevice::create_cq(uint32_t max_cqe, uint32_t comp_channel) {
+  if (max_cqe == 0 || max_cqe > RDMA_MAX_CQE) {
+    return 0;
+  }
+  std::lock_guard<RdmaCountedMutex> lock(cq_mutex_);
+
+  // 绑定完成通道
+  if (comp_channel != 0) {
+    std::lock_guard<std::mutex> channel_lock(channel_mutex_);
+    auto ch = channels_.find(comp_channel);
+    if (ch == channels_.end()) {
+      return 0;
+    }
+    ch->second.attached_cqs++;
+  }
 
   uint32_t cq_num = next_cq_num_++;
 
   // 检查设备资源是否已满
   if (cqs_.size() < max_cqs_) {
-    maybe_sleep_ns(device_delay_ns_.load(std::memory_order_relaxed));
+    charge_delay_ns(device_delay_ns_.load(std::memory_order_relaxed));
     // 创建新的CQ
     CQValue cq_value{};
     cq_value.cq_num = cq_num;
     cq_value.cqe = max_cqe;
+    cq_value.comp_channel = comp_channel;
 
     cqs_[cq_num] = cq_value;
     return cq_num;
   }
 
-  // 如果设备资源已满
+  // 如果设备资源已满，放入中间缓存；缓存也满时进入主机交换表，
+  // 而不是挤掉缓存中仍在使用的CQ
   CQValue cq_value{};
   cq_value.cq_num = cq_num;
   cq_value.cqe = max_cqe;
-  if (enable_middle_cache_.load(std::memory_order_relaxed)) {
-    maybe_sleep_ns(middle_delay_ns_.load(std::memory_order_relaxed));
+  cq_value.comp_channel = comp_channel;
+  if (enable_middle_cache_.load(std::memory_order_relaxed) &&
+      cq_cache_->size() < cq_cache_->capacity()) {
+    charge_delay_ns(middle_delay_ns_.load(std::memory_order_relaxed));
     cq_cache_->set(cq_num, cq_value);
   } else {
-    maybe_sleep_ns(host_swap_delay_ns_.load(std::memory_order_relaxed));
+    charge_delay_ns(host_swap_delay_ns_.load(std::memory_order_relaxed));
     cqs_host_[cq_num] = cq_value;
   }
   return cq_num;
@@ -151,6 +471,10 @@ uint32_t RdmaDevice::create_cq(uint32_t max_cqe) {
 
 uint32_t RdmaDevice::register_mr(void *addr, size_t length,
                                  uint32_t access_flags) {
+  if (addr == nullptr) {
+    return 0;
+  }
+
   std::lock_guard<std::mutex> lock(mr_mutex_);
 
   uint32_t lkey = next_mr_lkey_++;
@@ -205,7 +529,7 @@ uint32_t RdmaDevice::create_pd() {
 }
 
 bool RdmaDevice::get_qp_info(uint32_t qp_num, QPValue &info) {
-  std::lock_guard<std::mutex> lock(qp_mutex_);
+  std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
 
   // 首先在设备资源中查找
   auto it = qps_.find(qp_num);
@@ -214,21 +538,21 @@ bool RdmaDevice::get_qp_info(uint32_t qp_num, QPValue &info) {
     return true;
   }
 
-  // 如果在设备资源中找不到
-  if (enable_middle_cache_.load(std::memory_order_relaxed)) {
-    return qp_cache_->get(qp_num, info);
-  } else {
-    auto hit = qps_host_.find(qp_num);
-    if (hit != qps_host_.end()) {
-      info = hit->second;
-      return true;
-    }
-    return false;
+  // 如果在设备资源中找不到，依次查中间缓存和主机交换表
+  if (enable_middle_cache_.load(std::memory_order_relaxed) &&
+      qp_cache_->get(qp_num, info)) {
+    return true;
+  }
+  auto hit = qps_host_.find(qp_num);
+  if (hit != qps_host_.end()) {
+    info = hit->second;
+    return true;
   }
+  return false;
 }
 
 bool RdmaDevice::get_cq_info(uint32_t cq_num, CQValue &info) {
-  std::lock_guard<std::mutex> lock(cq_mutex_);
+  std::lock_guard<RdmaCountedMutex> lock(cq_mutex_);
 
   // 首先在设备资源中查找
   auto it = cqs_.find(cq_num);
@@ -237,17 +561,17 @@ bool RdmaDevice::get_cq_info(uint32_t cq_num, CQValue &info) {
     return true;
   }
 
-  if (enable_middle_cache_.load(std::memory_order_relaxed)) {
-    return cq_cache_->get(cq_num, info);
-  } else {
-    auto hit = cqs_host_.find(cq_num);
-    if (hit != cqs_host_.end()) {
-      maybe_sleep_ns(host_swap_delay_ns_.load(std::memory_order_relaxed));
-      info = hit->second;
-      return true;
-    }
-    return false;
+  if (enable_middle_cache_.load(std::memory_order_relaxed) &&
+      cq_cache_->get(cq_num, info)) {
+    return true;
   }
+  auto hit = cqs_host_.find(cq_num);
+  if (hit != cqs_host_.end()) {
+    charge_delay_ns(host_swap_delay_ns_.load(std::memory_order_relaxed));
+    info = hit->second;
+    return true;
+  }
+  return false;
 }
 
 bool RdmaDevice::get_mr_info(uint32_t lkey, MRValue &info) {
@@ -265,11 +589,24 @@ bool RdmaDevice::get_mr_info(uint32_t lkey, MRValue &info) {
 }
 
 void RdmaDevice::cleanup_resources() {
-  std::lock_guard<std::mutex> qp_lock(qp_mutex_);
-  std::lock_guard<std::mutex> cq_lock(cq_mutex_);
+  std::lock_guard<RdmaCountedMutex> qp_lock(qp_mutex_);
+  std::lock_guard<RdmaCountedMutex> cq_lock(cq_mutex_);
   std::lock_guard<std::mutex> mr_lock(mr_mutex_);
   std::lock_guard<std::mutex> pd_lock(pd_mutex_);
 
+  // 关闭完成通道
+  {
+    std::lock_guard<std::mutex> channel_lock(channel_mutex_);
+    for (auto &ch : channels_) {
+      close(ch.second.fd);
+    }
+    channels_.clear();
+  }
+  if (async_fd_ >= 0) {
+    close(async_fd_);
+    async_fd_ = -1;
+  }
+
   // 清理设备资源
   qps_.clear();
   cqs_.clear();
@@ -283,41 +620,199 @@ void RdmaDevice::cleanup_resources() {
   pd_cache_.reset();
 }
 
-void RdmaDevice::network_thread_func() {
-  while (!should_stop_) {
-    // TODO: 实现网络处理逻辑
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+bool RdmaDevice::configure_engines(const EngineConfig &config) {
+  if (config.ring_entries == 0) {
+    return false;
+  }
+  stop_engines();
+  engines_stop_.store(false, std::memory_order_relaxed);
+  engine_spin_polls_ = config.spin_polls;
+  engine_burst_ = std::max<uint32_t>(1, config.wqe_prefetch_burst);
+  for (uint32_t i = 0; i < config.num_engines; ++i) {
+    engines_.push_back(std::make_unique<Engine>(config.ring_entries));
+  }
+  for (uint32_t i = 0; i < config.num_engines; ++i) {
+    Engine &engine = *engines_[i];
+    engine.thread = std::thread(&RdmaDevice::engine_loop, this, std::ref(engine));
+    if (config.cpu_cores.empty()) {
+      continue;
+    }
+    // 绑核失败（核号超出范围或没有权限）时引擎照常运行，只是不绑核
+    const int core = config.cpu_cores[i % config.cpu_cores.size()];
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (core >= 0 && core < CPU_SETSIZE) {
+      CPU_SET(core, &cpus);
+      if (pthread_setaffinity_np(engine.thread.native_handle(), sizeof(cpus),
+                                 &cpus) == 0) {
+        engine.cpu = core;
+      }
+    }
+  }
+  return true;
+}
+
+void RdmaDevice::stop_engines() {
+  engines_stop_.store(true, std::memory_order_release);
+  for (auto &engine : engines_) {
+    {
+      std::lock_guard<std::mutex> idle_lock(engine->idle_mutex);
+      engine->idle_cv.notify_one();
+    }
+    if (engine->thread.joinable()) {
+      engine->thread.join();
+    }
+  }
+  engines_.clear();
+}
+
+// 引擎线程：读取门铃记录，把门铃之前的WQE按 burst 一次取回再逐条处理；
+// 门铃未前进时先忙轮询，再阻塞等待生产者唤醒。停止时先处理完已敲门铃的WQE
+void RdmaDevice::engine_loop(Engine &engine) {
+  std::vector<EngineWork> burst(engine_burst_);
+  size_t consumer_index = 0;
+  uint32_t idle_polls = 0;
+  for (;;) {
+    const size_t producer_index =
+        engine.doorbell.load(std::memory_order_acquire);
+    if (consumer_index != producer_index) {
+      size_t fetched = 0;
+      while (fetched < burst.size() &&
+             consumer_index + fetched < producer_index &&
+             engine.ring.pop(burst[fetched])) {
+        ++fetched;
+      }
+      if (fetched == 0) {
+        continue; // 门铃已覆盖该槽，但其生产者尚未写完
+      }
+      consumer_index += fetched;
+      engine.bursts.fetch_add(1, std::memory_order_relaxed);
+      for (size_t i = 0; i < fetched; ++i) {
+        EngineWork &work = burst[i];
+        transmit(work.out, work.timeout, work.retry_cnt, work.rnr_retry);
+      }
+      engine.messages.fetch_add(fetched, std::memory_order_relaxed);
+      idle_polls = 0;
+      continue;
+    }
+    if (engines_stop_.load(std::memory_order_acquire)) {
+      return;
+    }
+    if (++idle_polls < engine_spin_polls_) {
+      continue;
+    }
+    idle_polls = 0;
+    std::unique_lock<std::mutex> idle_lock(engine.idle_mutex);
+    engine.sleeping.store(true, std::memory_order_relaxed);
+    // 与生产者“推进门铃后检查 sleeping”配对，二者至少有一方看到对方的写入
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (engine.doorbell.load(std::memory_order_relaxed) == consumer_index &&
+        !engines_stop_.load(std::memory_order_acquire)) {
+      engine.sleeps.fetch_add(1, std::memory_order_relaxed);
+      engine.idle_cv.wait_for(idle_lock, std::chrono::milliseconds(10));
+    }
+    engine.sleeping.store(false, std::memory_order_relaxed);
+  }
+}
+
+bool RdmaDevice::set_qp_engine(uint32_t qp_num, uint32_t engine) {
+  std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+  return with_qp(qp_num, [&](QPValue &qp) {
+    qp.engine = static_cast<uint16_t>(engine % RDMA_ENGINE_AUTO);
+    return true;
+  });
+}
+
+std::vector<EngineStats> RdmaDevice::get_engine_stats() const {
+  std::vector<EngineStats> stats;
+  for (const auto &engine : engines_) {
+    EngineStats s;
+    s.messages = engine->messages.load(std::memory_order_relaxed);
+    s.doorbells = engine->doorbells.load(std::memory_order_relaxed);
+    s.bursts = engine->bursts.load(std::memory_order_relaxed);
+    s.ring_full = engine->ring_full.load(std::memory_order_relaxed);
+    s.sleeps = engine->sleeps.load(std::memory_order_relaxed);
+    s.cpu = engine->cpu;
+    stats.push_back(s);
   }
+  return stats;
 }
 
 // 资源释放函数
-void RdmaDevice::destroy_qp(uint32_t qp_num) {
-  std::lock_guard<std::mutex> lock(qp_mutex_);
+void RdmaDevice::destroy_qp(uint32_t qp_num) { destroy_qp_batch({qp_num}); }
 
-  // 首先尝试从设备资源中删除
-  if (qps_.erase(qp_num) > 0) {
-    return;
+size_t RdmaDevice::destroy_qp_batch(const std::vector<uint32_t> &qp_nums) {
+  std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+  {
+    std::lock_guard<std::mutex> global_lock(global_qp_mutex);
+    for (uint32_t qp_num : qp_nums) {
+      auto owner = global_qp_map.find(qp_num);
+      if (owner != global_qp_map.end() && owner->second == this) {
+        global_qp_map.erase(owner);
+      }
+    }
+  }
+  {
+    // 在途消息随QP一起丢弃，之后到达的确认不再产生完成
+    std::lock_guard<RdmaCountedMutex> inflight_lock(inflight_mutex_);
+    for (uint32_t qp_num : qp_nums) {
+      auto it = inflight_.find(qp_num);
+      if (it != inflight_.end()) {
+        for (auto &msg : it->second.messages) {
+          msg->flushed = true;
+        }
+        inflight_.erase(it);
+      }
+      draining_.erase(qp_num);
+    }
+    draining_count_.store(draining_.size());
   }
 
-  // 如果不在设备资源中，尝试从缓存中删除
-  QPValue dummy;
-  if (qp_cache_->get(qp_num, dummy)) {
-    qp_cache_->set(qp_num, QPValue{}); // 使用空值覆盖缓存中的条目
+  // 被销毁的 DCT 上的DC连接上下文一并撤销
+  if (!dc_streams_.empty()) {
+    std::unordered_set<uint32_t> doomed(qp_nums.begin(), qp_nums.end());
+    for (auto it = dc_streams_.begin(); it != dc_streams_.end();) {
+      if (doomed.count(static_cast<uint32_t>(it->first >> 32)) > 0) {
+        it = dc_streams_.erase(it);
+      } else {
+        ++it;
+      }
+    }
   }
+
+  // 依次从设备资源、中间缓存、主机交换表中删除
+  size_t destroyed = 0;
+  for (uint32_t qp_num : qp_nums) {
+    link_.remove_flow(qp_num);
+    if (qps_.erase(qp_num) > 0 || qp_cache_->erase(qp_num) ||
+        qps_host_.erase(qp_num) > 0) {
+      destroyed++;
+    }
+  }
+  return destroyed;
 }
 
 void RdmaDevice::destroy_cq(uint32_t cq_num) {
-  std::lock_guard<std::mutex> lock(cq_mutex_);
+  std::lock_guard<RdmaCountedMutex> lock(cq_mutex_);
+  cq_cv_.notify_all(); // 阻塞在该CQ上的 wait_cq 醒来后发现CQ已不存在
 
-  // 首先尝试从设备资源中删除
-  if (cqs_.erase(cq_num) > 0) {
-    return;
+  // 解除与完成通道的绑定
+  uint32_t comp_channel = 0;
+  with_cq(cq_num, [&](CQValue &cq) {
+    comp_channel = cq.comp_channel;
+    return false;
+  });
+  if (comp_channel != 0) {
+    std::lock_guard<std::mutex> channel_lock(channel_mutex_);
+    auto ch = channels_.find(comp_channel);
+    if (ch != channels_.end() && ch->second.attached_cqs > 0) {
+      ch->second.attached_cqs--;
+    }
   }
 
-  // 如果不在设备资源中，尝试从缓存中删除
-  CQValue dummy;
-  if (cq_cache_->get(cq_num, dummy)) {
-    cq_cache_->set(cq_num, CQValue{}); // 使用空值覆盖缓存中的条目
+  // 依次从设备资源、中间缓存、主机交换表中删除
+  if (cqs_.erase(cq_num) == 0 && !cq_cache_->erase(cq_num)) {
+    cqs_host_.erase(cq_num);
   }
 }
 
@@ -351,350 +846,1791 @@ void RdmaDevice::destroy_pd(uint32_t pd_handle) {
   }
 }
 
+uint32_t RdmaDevice::create_ah(const AhAttr &attr) {
+  if (attr.dlid == 0 && !attr.is_global) {
+    return 0; // 没有可路由的目的地址
+  }
+  std::lock_guard<std::mutex> lock(ah_mutex_);
+  uint32_t ah = next_ah_num_++;
+  ahs_.emplace(ah, attr);
+  return ah;
+}
+
+bool RdmaDevice::destroy_ah(uint32_t ah) {
+  std::lock_guard<std::mutex> lock(ah_mutex_);
+  return ahs_.erase(ah) > 0;
+}
+
 // QP操作函数
 bool RdmaDevice::modify_qp_state(uint32_t qp_num, QpState new_state) {
-  std::lock_guard<std::mutex> lock(qp_mutex_);
-
-  // 首先在设备资源中查找
-  auto it = qps_.find(qp_num);
-  if (it != qps_.end()) {
-    if (!validate_qp_transition(it->second.state, new_state)) {
+  std::vector<QpTransition> transitions;
+  {
+    std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+    bool ok = with_qp(qp_num, [&](QPValue &qp) {
+      if (!validate_qp_transition(qp.state, new_state)) {
+        return false;
+      }
+      enter_qp_state(qp, new_state, transitions);
+      return true;
+    });
+    if (!ok) {
       return false;
     }
-    it->second.state = new_state;
-    return true;
   }
+  finish_qp_transitions(transitions);
+  return true;
+}
 
-  // 如果不在设备资源中
-  if (enable_middle_cache_.load(std::memory_order_relaxed)) {
-    QPValue qp_info;
-    if (!qp_cache_->get(qp_num, qp_info)) {
-      return false;
-    }
-    if (!validate_qp_transition(qp_info.state, new_state)) {
-      return false;
+// UD QP 的属性掩码：没有对端地址和可靠性参数，只有 Q_Key
+static bool ud_transition_masks(QpState cur, QpState next, uint32_t &required,
+                                uint32_t &optional) {
+  switch (cur) {
+  case QpState::RESET:
+    required = QP_ATTR_PKEY_INDEX | QP_ATTR_PORT | QP_ATTR_QKEY;
+    return next == QpState::INIT;
+  case QpState::INIT:
+    if (next == QpState::INIT) {
+      optional = QP_ATTR_PKEY_INDEX | QP_ATTR_PORT | QP_ATTR_QKEY;
+      return true;
     }
-    qp_info.state = new_state;
-    maybe_sleep_ns(middle_delay_ns_.load(std::memory_order_relaxed));
-    qp_cache_->set(qp_num, qp_info);
-    return true;
-  } else {
-    auto it_host = qps_host_.find(qp_num);
-    if (it_host == qps_host_.end()) return false;
-    if (!validate_qp_transition(it_host->second.state, new_state)) {
-      return false;
+    optional = QP_ATTR_PKEY_INDEX | QP_ATTR_QKEY;
+    return next == QpState::RTR;
+  case QpState::RTR:
+    required = QP_ATTR_SQ_PSN;
+    optional = QP_ATTR_CUR_STATE | QP_ATTR_QKEY;
+    return next == QpState::RTS;
+  case QpState::RTS:
+    if (next == QpState::RTS) {
+      optional = QP_ATTR_CUR_STATE | QP_ATTR_QKEY;
+      return true;
     }
-    it_host->second.state = new_state;
-    return true;
+    return next == QpState::SQD;
+  case QpState::SQE:
+    optional = QP_ATTR_CUR_STATE | QP_ATTR_QKEY;
+    return next == QpState::RTS;
+  case QpState::SQD:
+    optional = next == QpState::SQD ? QP_ATTR_PKEY_INDEX | QP_ATTR_QKEY
+                                    : QP_ATTR_CUR_STATE | QP_ATTR_QKEY;
+    return next == QpState::RTS || next == QpState::SQD;
+  case QpState::ERR:
+    return false;
   }
+  return false;
 }
 
-bool RdmaDevice::connect_qp(uint32_t qp_num, const QPValue &remote_info) {
-  std::lock_guard<std::mutex> lock(qp_mutex_);
-
-  // 首先在设备资源中查找
-  auto it = qps_.find(qp_num);
-  if (it != qps_.end()) {
-    it->second.dest_qp_num = remote_info.qp_num;
-    it->second.remote_lid = remote_info.lid;
-    it->second.remote_psn = remote_info.psn;
-    it->second.remote_gid = remote_info.gid;
-    return true;
+// RC QP 的属性掩码
+static bool rc_transition_masks(QpState cur, QpState next, uint32_t &required,
+                                uint32_t &optional) {
+  switch (cur) {
+  case QpState::RESET:
+    if (next == QpState::INIT) {
+      required = QP_ATTR_PKEY_INDEX | QP_ATTR_PORT | QP_ATTR_ACCESS_FLAGS;
+      return true;
+    }
+    return false;
+  case QpState::INIT:
+    if (next == QpState::INIT) {
+      optional = QP_ATTR_PKEY_INDEX | QP_ATTR_PORT | QP_ATTR_ACCESS_FLAGS;
+      return true;
+    }
+    if (next == QpState::RTR) {
+      required = QP_ATTR_AV | QP_ATTR_PATH_MTU | QP_ATTR_DEST_QPN |
+                 QP_ATTR_RQ_PSN | QP_ATTR_MAX_DEST_RD_ATOMIC |
+                 QP_ATTR_MIN_RNR_TIMER;
+      optional = QP_ATTR_PKEY_INDEX | QP_ATTR_ACCESS_FLAGS;
+      return true;
+    }
+    return false;
+  case QpState::RTR:
+    if (next == QpState::RTS) {
+      required = QP_ATTR_SQ_PSN | QP_ATTR_TIMEOUT | QP_ATTR_RETRY_CNT |
+                 QP_ATTR_RNR_RETRY | QP_ATTR_MAX_QP_RD_ATOMIC;
+      optional = QP_ATTR_CUR_STATE | QP_ATTR_ACCESS_FLAGS |
+                 QP_ATTR_MIN_RNR_TIMER;
+      return true;
+    }
+    return false;
+  case QpState::RTS:
+    if (next == QpState::RTS) {
+      optional = QP_ATTR_CUR_STATE | QP_ATTR_ACCESS_FLAGS |
+                 QP_ATTR_MIN_RNR_TIMER;
+      return true;
+    }
+    return next == QpState::SQD;
+  case QpState::SQD:
+    if (next == QpState::RTS) {
+      optional = QP_ATTR_CUR_STATE | QP_ATTR_ACCESS_FLAGS |
+                 QP_ATTR_MIN_RNR_TIMER;
+      return true;
+    }
+    if (next == QpState::SQD) {
+      optional = QP_ATTR_AV | QP_ATTR_PKEY_INDEX | QP_ATTR_PORT |
+                 QP_ATTR_ACCESS_FLAGS | QP_ATTR_TIMEOUT | QP_ATTR_RETRY_CNT |
+                 QP_ATTR_RNR_RETRY | QP_ATTR_MAX_QP_RD_ATOMIC |
+                 QP_ATTR_MAX_DEST_RD_ATOMIC | QP_ATTR_MIN_RNR_TIMER;
+      return true;
+    }
+    return false;
+  case QpState::SQE:
+    if (next == QpState::RTS) {
+      optional = QP_ATTR_CUR_STATE | QP_ATTR_ACCESS_FLAGS;
+      return true;
+    }
+    return false;
+  case QpState::ERR:
+    return false;
   }
+  return false;
+}
 
-  if (enable_middle_cache_.load(std::memory_order_relaxed)) {
-    QPValue qp_info;
-    if (!qp_cache_->get(qp_num, qp_info)) {
+// DC 的属性掩码：DCI 没有固定对端，INIT->RTR 不需要路径和目的参数；
+// DCT 只作为响应端，停留在 RTR，DC 访问密钥通过 QP_ATTR_QKEY 设置
+static bool dc_transition_masks(QpType type, QpState cur, QpState next,
+                                uint32_t &required, uint32_t &optional) {
+  if (type == QpType::DCT) {
+    switch (cur) {
+    case QpState::RESET:
+      required = QP_ATTR_PKEY_INDEX | QP_ATTR_PORT | QP_ATTR_ACCESS_FLAGS |
+                 QP_ATTR_QKEY;
+      return next == QpState::INIT;
+    case QpState::INIT:
+      if (next == QpState::INIT) {
+        optional = QP_ATTR_PKEY_INDEX | QP_ATTR_PORT | QP_ATTR_ACCESS_FLAGS |
+                   QP_ATTR_QKEY;
+        return true;
+      }
+      required = QP_ATTR_MIN_RNR_TIMER;
+      optional = QP_ATTR_PATH_MTU;
+      return next == QpState::RTR;
+    default:
+      return false;
+    }
+  }
+  if (cur == QpState::RESET) {
+    required = QP_ATTR_PKEY_INDEX | QP_ATTR_PORT;
+    return next == QpState::INIT;
+  }
+  if (cur == QpState::INIT) {
+    optional = next == QpState::INIT ? QP_ATTR_PKEY_INDEX | QP_ATTR_PORT
+                                     : QP_ATTR_PKEY_INDEX | QP_ATTR_PATH_MTU;
+    return next == QpState::INIT || next == QpState::RTR;
+  }
+  return rc_transition_masks(cur, next, required, optional);
+}
+
+// 每个合法迁移的必需/可选属性掩码（参照 IB 规范 11.2.4.2）
+static bool qp_transition_masks(QpType type, QpState cur, QpState next,
+                                uint32_t &required, uint32_t &optional) {
+  required = 0;
+  optional = 0;
+  if (next == QpState::RESET || next == QpState::ERR) {
+    return true; // 任意状态都可以迁移到 RESET/ERR
+  }
+  if (type == QpType::UD) {
+    return ud_transition_masks(cur, next, required, optional);
+  }
+  if (type == QpType::DCI || type == QpType::DCT) {
+    return dc_transition_masks(type, cur, next, required, optional);
+  }
+  return rc_transition_masks(cur, next, required, optional);
+}
+
+bool RdmaDevice::modify_qp(uint32_t qp_num, const QpAttr &attr,
+                           uint32_t attr_mask) {
+  std::vector<QpTransition> transitions;
+  {
+    std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+    bool ok = with_qp(qp_num, [&](QPValue &qp) {
+      const QpState next =
+          (attr_mask & QP_ATTR_STATE) ? attr.qp_state : qp.state;
+      uint32_t required = 0;
+      uint32_t optional = 0;
+      if (!qp_transition_masks(qp.qp_type, qp.state, next, required,
+                               optional)) {
+        return false;
+      }
+      const uint32_t attrs = attr_mask & ~QP_ATTR_STATE;
+      if ((attrs & required) != required ||
+          (attrs & ~(required | optional)) != 0) {
+        return false;
+      }
+      if ((attr_mask & QP_ATTR_CUR_STATE) && attr.cur_qp_state != qp.state) {
+        return false;
+      }
+      if ((attr_mask & QP_ATTR_PATH_MTU) &&
+          (attr.path_mtu < 256 || attr.path_mtu > 4096 ||
+           (attr.path_mtu & (attr.path_mtu - 1)) != 0)) {
+        return false;
+      }
+
+      if (attr_mask & QP_ATTR_ACCESS_FLAGS) {
+        qp.qp_access_flags = attr.qp_access_flags;
+      }
+      if (attr_mask & QP_ATTR_PKEY_INDEX) {
+        qp.pkey_index = attr.pkey_index;
+      }
+      if (attr_mask & QP_ATTR_PORT) {
+        qp.port_num = attr.port_num;
+      }
+      if (attr_mask & QP_ATTR_AV) {
+        qp.remote_lid = attr.dlid;
+        qp.remote_gid = attr.dgid;
+      }
+      if (attr_mask & QP_ATTR_PATH_MTU) {
+        qp.mtu = attr.path_mtu;
+      }
+      if (attr_mask & QP_ATTR_TIMEOUT) {
+        qp.timeout = attr.timeout;
+      }
+      if (attr_mask & QP_ATTR_RETRY_CNT) {
+        qp.retry_cnt = attr.retry_cnt;
+      }
+      if (attr_mask & QP_ATTR_RNR_RETRY) {
+        qp.rnr_retry = attr.rnr_retry;
+      }
+      if (attr_mask & QP_ATTR_MIN_RNR_TIMER) {
+        qp.min_rnr_timer = attr.min_rnr_timer;
+      }
+      if (attr_mask & QP_ATTR_MAX_QP_RD_ATOMIC) {
+        qp.max_rd_atomic = attr.max_rd_atomic;
+      }
+      if (attr_mask & QP_ATTR_MAX_DEST_RD_ATOMIC) {
+        qp.max_dest_rd_atomic = attr.max_dest_rd_atomic;
+      }
+      if (attr_mask & QP_ATTR_DEST_QPN) {
+        qp.dest_qp_num = attr.dest_qp_num;
+      }
+      if (attr_mask & QP_ATTR_QKEY) {
+        qp.qkey = attr.qkey;
+      }
+      if (attr_mask & QP_ATTR_RQ_PSN) {
+        qp.remote_psn = attr.rq_psn & RDMA_PSN_MASK;
+        qp.rq_psn = qp.remote_psn;
+      }
+      if (attr_mask & QP_ATTR_SQ_PSN) {
+        qp.psn = attr.sq_psn & RDMA_PSN_MASK;
+        qp.sq_psn = qp.psn;
+      }
+      enter_qp_state(qp, next, transitions);
+      return true;
+    });
+    if (!ok) {
+      return false;
+    }
+  }
+  finish_qp_transitions(transitions);
+  return true;
+}
+
+bool RdmaDevice::connect_qp(uint32_t qp_num, const QPValue &remote_info) {
+  std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+
+  return with_qp(qp_num, [&](QPValue &qp) {
+    if (qp.qp_type != QpType::RC) {
+      return false; // UD/DC 没有固定对端，目的随每个WR指定
+    }
+    qp.dest_qp_num = remote_info.qp_num;
+    qp.remote_lid = remote_info.lid;
+    qp.remote_psn = remote_info.psn;
+    qp.remote_gid = remote_info.gid;
+    // 对端的起始PSN即本端期望收到的第一个PSN
+    qp.rq_psn = remote_info.psn & RDMA_PSN_MASK;
+    // 采用对端通告的路径MTU，仅接受 256~4096 的2的幂
+    uint32_t mtu = remote_info.mtu;
+    if (mtu >= 256 && mtu <= 4096 && (mtu & (mtu - 1)) == 0) {
+      qp.mtu = mtu;
+    }
+    return true;
+  });
+}
+
+void RdmaDevice::push_completion(uint32_t cq_num,
+                                 const CompletionEntry &completion,
+                                 bool solicited, uint64_t post_ns) {
+  push_completions(cq_num, &completion, 1, solicited, post_ns);
+}
+
+// 将一批完成事件在一次加锁内写入CQ；CQ已武装且满足触发条件时向完成通道投递事件
+void RdmaDevice::push_completions(uint32_t cq_num,
+                                  const CompletionEntry *completions,
+                                  size_t count, bool solicited,
+                                  uint64_t post_ns) {
+  bool overflow = false;
+  const uint64_t now_ns = RdmaFabric::now_ns();
+  {
+    std::lock_guard<RdmaCountedMutex> cq_lock(cq_mutex_);
+    bool found = with_cq(cq_num, [&](CQValue &cq) {
+      for (size_t i = 0; i < count; ++i) {
+        const CompletionEntry &completion = completions[i];
+        // CQ已满：与硬件一致，CQ进入错误状态，之后的完成全部丢弃
+        if (cq.overflowed || cq.completions.size() >= cq.cqe) {
+          overflow = overflow || !cq.overflowed;
+          cq.overflowed = true;
+          cq.dropped_completions++;
+          continue;
+        }
+        cq.completions.push_back(completion);
+        if (completion.timestamp_ns == 0) {
+          cq.completions.back().timestamp_ns = now_ns;
+        }
+        if (post_ns != 0) {
+          if (!cq.latency) {
+            cq.latency = make_latency_histogram();
+          }
+          cq.latency->record(cq.completions.back().timestamp_ns - post_ns);
+        }
+        cq.window_completions++;
+        // solicited-only 下，出错的完成同样触发通知
+        const bool error = completion.status != WcStatus::SUCCESS;
+        counters_.add(RdmaCounter::CQE);
+        if (error) {
+          counters_.add(RdmaCounter::CQE_ERRORS);
+        }
+        if (!cq.armed || (cq.solicited_only && !solicited && !error)) {
+          continue;
+        }
+
+        // 出错的完成不参与合并；其余按 cq_count/cq_period 攒批
+        if (error ||
+            ++cq.pending_notify >= std::max<uint16_t>(cq.cq_count, 1)) {
+          notify_cq(cq_num, cq);
+        } else if (cq.pending_notify == 1 && cq.cq_period_us > 0) {
+          uint64_t epoch = cq.notify_epoch;
+          RdmaFabric::instance().schedule(
+              RdmaFabric::now_ns() + cq.cq_period_us * 1000ULL, this,
+              [this, cq_num, epoch](uint64_t) {
+                cq_moderation_timeout(cq_num, epoch);
+              });
+        }
+      }
+      if (cq.waiters > 0) {
+        cq_cv_.notify_all();
+      }
+      return true;
+    });
+    if (!found) {
+      RDMA_LOG_ERROR("Failed to find CQ " << cq_num << " for completion");
+    }
+  }
+
+  // 在释放 cq_mutex_ 之后处理溢出，QP锁在CQ锁之前获取
+  if (overflow) {
+    RDMA_LOG_WARN("CQ " << cq_num << " overflow");
+    raise_async_event(AsyncEventType::CQ_ERR, cq_num);
+    fail_qps_on_cq(cq_num);
+  }
+}
+
+void RdmaDevice::raise_async_event(AsyncEventType type, uint32_t element) {
+  std::lock_guard<std::mutex> async_lock(async_mutex_);
+  async_events_.push_back(AsyncEvent{type, element});
+  uint64_t one = 1;
+  if (async_fd_ < 0 || write(async_fd_, &one, sizeof(one)) != sizeof(one)) {
+    RDMA_LOG_ERROR("Failed to signal async event");
+  }
+}
+
+// 把使用该CQ（发送或接收）的QP置为 ERR，并为每个QP产生 QP_FATAL 事件
+void RdmaDevice::fail_qps_on_cq(uint32_t cq_num) {
+  std::vector<QpTransition> failed;
+  {
+    std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+    std::vector<uint32_t> candidates;
+    for (const auto &entry : qps_) {
+      candidates.push_back(entry.first);
+    }
+    if (enable_middle_cache_.load(std::memory_order_relaxed)) {
+      std::vector<uint32_t> cached = qp_cache_->keys();
+      candidates.insert(candidates.end(), cached.begin(), cached.end());
+    }
+    for (const auto &entry : qps_host_) {
+      candidates.push_back(entry.first);
+    }
+    for (uint32_t qp_num : candidates) {
+      with_qp(qp_num, [&](QPValue &qp) {
+        if ((qp.send_cq != cq_num && qp.recv_cq != cq_num) ||
+            qp.state == QpState::ERR || qp.state == QpState::RESET) {
+          return false;
+        }
+        enter_qp_state(qp, QpState::ERR, failed);
+        return true;
+      });
+    }
+  }
+  for (const QpTransition &t : failed) {
+    raise_async_event(AsyncEventType::QP_FATAL, t.qp_num);
+  }
+  finish_qp_transitions(failed);
+}
+
+// 在 qp_mutex_ 内切换状态并取出接收侧需要冲刷/丢弃的WQE，
+// 发送侧的在途消息和完成写入留给 finish_qp_transitions 在锁外处理
+void RdmaDevice::enter_qp_state(QPValue &qp, QpState new_state,
+                                std::vector<QpTransition> &transitions) {
+  const QpState old_state = qp.state;
+  qp.state = new_state;
+  if (new_state == old_state && new_state != QpState::RESET) {
+    return;
+  }
+
+  QpTransition t{qp.qp_num, new_state, qp.send_cq, qp.recv_cq, {},
+                 qp.sq_outstanding};
+  if (new_state == QpState::ERR) {
+    // 已消费接收WQE、尚未收齐的消息同样被冲刷
+    if (qp.rx_in_progress) {
+      CompletionEntry c;
+      c.wr_id = qp.rx_wqe.wr_id;
+      c.opcode = RdmaOpcode::RECV;
+      c.status = WcStatus::WR_FLUSH_ERR;
+      t.recv_flush.push_back(c);
+    }
+    for (const RecvWqe &wqe : qp.recv_queue) {
+      CompletionEntry c;
+      c.wr_id = wqe.wr_id;
+      c.opcode = RdmaOpcode::RECV;
+      c.status = WcStatus::WR_FLUSH_ERR;
+      t.recv_flush.push_back(c);
+    }
+  }
+  if (new_state == QpState::ERR || new_state == QpState::RESET) {
+    qp.recv_queue.clear();
+    qp.rx_in_progress = false;
+    qp.nak_pending = false;
+  }
+  if (new_state == QpState::RESET) {
+    qp.sq_psn = qp.psn;
+    qp.rq_psn = qp.remote_psn;
+    if (qp.qp_type == QpType::DCI) {
+      qp.dest_qp_num = 0; // 下一条消息重新挂接，目标端按新的首包PSN重建连接
+    }
+  }
+  // 离开 SQD（例如排空前回到 RTS）时同样需要撤销未完成的排空等待
+  if (new_state == QpState::ERR || new_state == QpState::RESET ||
+      new_state == QpState::SQD || old_state == QpState::SQD) {
+    transitions.push_back(std::move(t));
+  }
+}
+
+void RdmaDevice::finish_qp_transitions(std::vector<QpTransition> &transitions) {
+  for (QpTransition &t : transitions) {
+    std::vector<CompletionEntry> send_flush;
+    bool drained = false;
+    if (t.state == QpState::ERR || t.state == QpState::RESET) {
+      // 丢弃尚未上线的包；已上线的包到达对端后其确认被忽略
+      link_.remove_flow(t.qp_num);
+    }
+    {
+      std::lock_guard<RdmaCountedMutex> inflight_lock(inflight_mutex_);
+      auto it = inflight_.find(t.qp_num);
+      if (t.state == QpState::SQD) {
+        // 先登记再检查计数：与 complete_send 中“先归还槽位再检查登记”配对，
+        // 最后一个槽位无论在登记前后归还，排空事件都恰好产生一次
+        draining_.insert(t.qp_num);
+        draining_count_.store(draining_.size());
+        if (!t.sq_outstanding || t.sq_outstanding->load() == 0) {
+          draining_.erase(t.qp_num);
+          draining_count_.store(draining_.size());
+          drained = true;
+        }
+      } else {
+        draining_.erase(t.qp_num);
+        draining_count_.store(draining_.size());
+        if (t.state != QpState::RTS && it != inflight_.end()) {
+          // 请求端状态一并丢弃，尚未触发的定时器找不到队列后自行失效
+          for (auto &msg : it->second.messages) {
+            msg->flushed = true;
+            release_send_slot(*msg);
+            if (t.state == QpState::ERR) {
+              CompletionEntry c;
+              c.wr_id = msg->wqe.wr.wr_id;
+              c.opcode = msg->wqe.wr.opcode;
+              c.status = WcStatus::WR_FLUSH_ERR;
+              send_flush.push_back(c);
+            }
+          }
+          inflight_.erase(it);
+        }
+      }
+    }
+
+    if (!send_flush.empty()) {
+      push_completions(t.send_cq, send_flush.data(), send_flush.size());
+    }
+    if (!t.recv_flush.empty()) {
+      push_completions(t.recv_cq, t.recv_flush.data(), t.recv_flush.size());
+    }
+    if (drained) {
+      raise_async_event(AsyncEventType::SQ_DRAINED, t.qp_num);
+    }
+  }
+}
+
+// 累积ACK：PSN不超过 psn 的消息全部完成。有进展时恢复重试计数并重新计时
+void RdmaDevice::on_ack(uint32_t qp_num, uint32_t psn, uint64_t now_ns) {
+  std::vector<std::shared_ptr<OutboundMessage>> acked;
+  {
+    std::lock_guard<RdmaCountedMutex> inflight_lock(inflight_mutex_);
+    auto it = inflight_.find(qp_num);
+    if (it == inflight_.end()) {
+      return;
+    }
+    SendQueue &queue = it->second;
+    while (!queue.messages.empty()) {
+      const OutboundMessage &front = *queue.messages.front();
+      uint32_t last_psn = (front.first_psn + front.num_packets - 1) &
+                          RDMA_PSN_MASK;
+      if (psn_before(psn, last_psn)) {
+        break;
+      }
+      acked.push_back(queue.messages.front());
+      queue.messages.pop_front();
+    }
+    if (acked.empty()) {
+      return;
+    }
+    queue.retries_left = queue.retry_cnt;
+    queue.rnr_left = queue.rnr_retry;
+    if (queue.messages.empty()) {
+      inflight_.erase(it);
+    } else if (!queue.rnr_wait) {
+      arm_ack_timer(qp_num, queue, now_ns);
+    }
+  }
+  for (const auto &msg : acked) {
+    complete_send(*msg);
+  }
+}
+
+// PSN序列错误 NAK：响应端从 psn 起没有收到，go-back-N 从该包重传
+void RdmaDevice::on_nak(uint32_t qp_num, uint32_t psn, uint64_t now_ns) {
+  // NAK 隐含确认了 psn 之前的所有包
+  on_ack(qp_num, (psn - 1) & RDMA_PSN_MASK, now_ns);
+  bool failed = false;
+  {
+    std::lock_guard<RdmaCountedMutex> inflight_lock(inflight_mutex_);
+    auto it = inflight_.find(qp_num);
+    if (it == inflight_.end() || it->second.rnr_wait) {
+      return;
+    }
+    SendQueue &queue = it->second;
+    seq_naks_.fetch_add(1, std::memory_order_relaxed);
+    if (queue.retries_left == 0) {
+      failed = true;
+    } else {
+      queue.retries_left--;
+      retransmit_from(qp_num, queue, psn, now_ns);
+      arm_ack_timer(qp_num, queue, now_ns);
+    }
+  }
+  if (failed) {
+    fail_requester(qp_num, WcStatus::RETRY_EXC_ERR);
+  }
+}
+
+// RNR NAK：响应端没有接收WQE，等待其给出的时间后从 psn 重传
+void RdmaDevice::on_rnr_nak(uint32_t qp_num, uint32_t psn, uint64_t delay_ns,
+                            uint64_t now_ns) {
+  on_ack(qp_num, (psn - 1) & RDMA_PSN_MASK, now_ns);
+  bool failed = false;
+  {
+    std::lock_guard<RdmaCountedMutex> inflight_lock(inflight_mutex_);
+    auto it = inflight_.find(qp_num);
+    if (it == inflight_.end() || it->second.rnr_wait) {
+      return;
+    }
+    failed = !start_rnr_wait(qp_num, it->second, psn, delay_ns, now_ns);
+  }
+  if (failed) {
+    fail_requester(qp_num, WcStatus::RNR_RETRY_EXC_ERR);
+  }
+}
+
+// 进入 RNR 等待：丢弃尚未上线的包并暂停发送。重试次数耗尽时返回 false
+bool RdmaDevice::start_rnr_wait(uint32_t qp_num, SendQueue &queue,
+                                uint32_t psn, uint64_t delay_ns,
+                                uint64_t now_ns) {
+  rnr_naks_.fetch_add(1, std::memory_order_relaxed);
+  if (queue.rnr_retry != 7) {
+    if (queue.rnr_left == 0) {
+      return false;
+    }
+    queue.rnr_left--;
+  }
+  link_.purge_flow(qp_num);
+  queue.rnr_wait = true;
+  const uint64_t epoch = ++next_timer_epoch_;
+  queue.timer_epoch = epoch;
+  RdmaFabric::instance().schedule(
+      now_ns + delay_ns, this, [this, qp_num, psn, epoch](uint64_t t) {
+        rnr_resume(qp_num, psn, epoch, t);
+      });
+  return true;
+}
+
+void RdmaDevice::rnr_resume(uint32_t qp_num, uint32_t psn, uint64_t epoch,
+                            uint64_t now_ns) {
+  // 同步路径的重投递与 post_send 共用发送串行化
+  std::lock_guard<RdmaCountedMutex> tx_lock(tx_mutex_);
+  {
+    std::lock_guard<RdmaCountedMutex> inflight_lock(inflight_mutex_);
+    auto it = inflight_.find(qp_num);
+    if (it == inflight_.end() || it->second.timer_epoch != epoch) {
+      return;
+    }
+    SendQueue &queue = it->second;
+    queue.rnr_wait = false;
+    if (link_.timed()) {
+      retransmit_from(qp_num, queue, psn, now_ns);
+      arm_ack_timer(qp_num, queue, now_ns);
+      return;
+    }
+  }
+  sync_redeliver(qp_num, now_ns);
+}
+
+// ACK超时：从最早未确认的包重传
+void RdmaDevice::on_ack_timeout(uint32_t qp_num, uint64_t epoch,
+                                uint64_t now_ns) {
+  bool failed = false;
+  bool redeliver = false;
+  {
+    std::lock_guard<RdmaCountedMutex> inflight_lock(inflight_mutex_);
+    auto it = inflight_.find(qp_num);
+    if (it == inflight_.end() || it->second.timer_epoch != epoch ||
+        it->second.rnr_wait || it->second.messages.empty()) {
+      return;
+    }
+    SendQueue &queue = it->second;
+    ack_timeouts_.fetch_add(1, std::memory_order_relaxed);
+    if (queue.retries_left == 0) {
+      failed = true;
+    } else if (link_.timed()) {
+      queue.retries_left--;
+      retransmit_from(qp_num, queue, queue.messages.front()->first_psn,
+                      now_ns);
+      arm_ack_timer(qp_num, queue, now_ns);
+    } else {
+      queue.retries_left--;
+      queue.timer_epoch = ++next_timer_epoch_;
+      redeliver = true;
+    }
+  }
+  if (failed) {
+    fail_requester(qp_num, WcStatus::RETRY_EXC_ERR);
+  } else if (redeliver) {
+    // 同步路径没有端口发送队列，重新投递与 post_send 共用发送串行化
+    std::lock_guard<RdmaCountedMutex> tx_lock(tx_mutex_);
+    sync_redeliver(qp_num, now_ns);
+  }
+}
+
+void RdmaDevice::arm_ack_timer(uint32_t qp_num, SendQueue &queue,
+                               uint64_t now_ns) {
+  const uint64_t epoch = ++next_timer_epoch_;
+  queue.timer_epoch = epoch;
+  if (queue.timeout_ns == 0) {
+    return;
+  }
+  RdmaFabric::instance().schedule(
+      now_ns + queue.timeout_ns, this, [this, qp_num, epoch](uint64_t t) {
+        on_ack_timeout(qp_num, epoch, t);
+      });
+}
+
+void RdmaDevice::enqueue_packets(uint32_t qp_num,
+                                 const std::shared_ptr<OutboundMessage> &msg,
+                                 uint32_t start, bool &arm) {
+  WirePacket packet;
+  packet.msg = msg;
+  for (uint32_t i = start; i < msg->num_packets; ++i) {
+    fill_packet(*msg, i, packet.pkt);
+    arm = link_.enqueue(qp_num, packet) || arm;
+  }
+}
+
+// go-back-N：丢弃尚未上线的包，从 psn 起按顺序重新排队所有未确认的包
+void RdmaDevice::retransmit_from(uint32_t qp_num, SendQueue &queue,
+                                 uint32_t psn, uint64_t now_ns) {
+  link_.purge_flow(qp_num);
+  bool arm = false;
+  for (const auto &msg : queue.messages) {
+    uint32_t offset = (psn - msg->first_psn) & RDMA_PSN_MASK;
+    if (offset < msg->num_packets) {
+      enqueue_packets(qp_num, msg, offset, arm);
+    } else if (psn_before(psn, msg->first_psn)) {
+      enqueue_packets(qp_num, msg, 0, arm);
+    }
+  }
+  // 按事件时间戳安排发送，事件线程落后于实际时间时重传仍排在后续定时器之前
+  if (arm) {
+    RdmaFabric::instance().schedule(now_ns, this,
+                                    [this](uint64_t t) { link_egress(t); });
+  }
+}
+
+// 重试次数耗尽：最早未确认的消息以 status 完成（不论是否 signaled），
+// QP进入 ERR，其余消息和接收WQE被冲刷
+void RdmaDevice::fail_requester(uint32_t qp_num, WcStatus status) {
+  std::shared_ptr<OutboundMessage> msg;
+  {
+    std::lock_guard<RdmaCountedMutex> inflight_lock(inflight_mutex_);
+    auto it = inflight_.find(qp_num);
+    if (it == inflight_.end() || it->second.messages.empty()) {
+      return;
+    }
+    msg = it->second.messages.front();
+    it->second.messages.pop_front();
+    msg->flushed = true;
+  }
+  release_send_slot(*msg);
+  CompletionEntry completion;
+  completion.wr_id = msg->wqe.wr.wr_id;
+  completion.opcode = msg->wqe.wr.opcode;
+  completion.status = status;
+  push_completion(msg->send_cq, completion);
+
+  std::vector<QpTransition> transitions;
+  {
+    std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+    with_qp(qp_num, [&](QPValue &qp) {
+      if (qp.state == QpState::ERR || qp.state == QpState::RESET) {
+        return false;
+      }
+      enter_qp_state(qp, QpState::ERR, transitions);
+      return true;
+    });
+  }
+  finish_qp_transitions(transitions);
+}
+
+// 同步路径：RNR 等待结束或ACK超时后按顺序重新投递排队的消息，再次遇到 RNR 时
+// 继续等待，仍未被确认时等待下一次ACK超时。调用方需持有 tx_mutex_
+void RdmaDevice::sync_redeliver(uint32_t qp_num, uint64_t now_ns) {
+  for (;;) {
+    std::shared_ptr<OutboundMessage> msg;
+    {
+      std::lock_guard<RdmaCountedMutex> inflight_lock(inflight_mutex_);
+      auto it = inflight_.find(qp_num);
+      if (it == inflight_.end() || it->second.rnr_wait ||
+          it->second.messages.empty()) {
+        return;
+      }
+      msg = it->second.messages.front();
+    }
+
+    RxResponse response = deliver_message(*msg);
+    if (response.verdict == RxVerdict::NAK_RNR) {
+      on_rnr_nak(qp_num, response.psn, response.rnr_delay_ns, now_ns);
+      return;
+    }
+    if (response.verdict == RxVerdict::DROP && msg->qp_type != QpType::UD) {
+      // 仍未被确认，等待下一次ACK超时
+      std::lock_guard<RdmaCountedMutex> inflight_lock(inflight_mutex_);
+      auto it = inflight_.find(qp_num);
+      if (it != inflight_.end()) {
+        arm_ack_timer(qp_num, it->second, now_ns);
+      }
+      return;
+    }
+    on_ack(qp_num, (msg->first_psn + msg->num_packets - 1) & RDMA_PSN_MASK,
+           now_ns);
+  }
+}
+
+// 投递一次CQ事件并解除武装；启用自适应合并时，按上一窗口的完成速率
+// 把 cq_count 调整为目标时延内预计到达的完成数
+void RdmaDevice::notify_cq(uint32_t cq_num, CQValue &cq) {
+  cq.armed = false;
+  cq.pending_notify = 0;
+  cq.notify_epoch++;
+  cq.notify_events++;
+  signal_comp_channel(cq.comp_channel, cq_num);
+
+  if (cq.moderation_target_us == 0) {
+    return;
+  }
+  uint64_t now = RdmaFabric::now_ns();
+  if (now > cq.window_start_ns) {
+    double rate = cq.window_completions * 1000.0 / (now - cq.window_start_ns);
+    cq.completion_rate = cq.completion_rate > 0
+                             ? 0.5 * cq.completion_rate + 0.5 * rate
+                             : rate;
+    double batch = cq.completion_rate * cq.moderation_target_us;
+    double limit = std::max(1u, std::min<uint32_t>(cq.cqe / 2, UINT16_MAX));
+    cq.cq_count = static_cast<uint16_t>(std::max(1.0, std::min(batch, limit)));
+  }
+  cq.cq_period_us = cq.moderation_target_us;
+  cq.window_start_ns = now;
+  cq.window_completions = 0;
+}
+
+void RdmaDevice::cq_moderation_timeout(uint32_t cq_num, uint64_t epoch) {
+  std::lock_guard<RdmaCountedMutex> lock(cq_mutex_);
+  with_cq(cq_num, [&](CQValue &cq) {
+    // 超时到达前已经按数量触发过，或CQ已重新武装开始新一批
+    if (!cq.armed || cq.notify_epoch != epoch || cq.pending_notify == 0) {
       return false;
     }
-    qp_info.dest_qp_num = remote_info.qp_num;
-    qp_info.remote_lid = remote_info.lid;
-    qp_info.remote_psn = remote_info.psn;
-    qp_info.remote_gid = remote_info.gid;
-    qp_cache_->set(qp_num, qp_info);
-    return true;
-  } else {
-    auto it_host = qps_host_.find(qp_num);
-    if (it_host == qps_host_.end()) return false;
-    it_host->second.dest_qp_num = remote_info.qp_num;
-    it_host->second.remote_lid = remote_info.lid;
-    it_host->second.remote_psn = remote_info.psn;
-    it_host->second.remote_gid = remote_info.gid;
+    notify_cq(cq_num, cq);
+    return true;
+  });
+}
+
+void RdmaDevice::signal_comp_channel(uint32_t channel, uint32_t cq_num) {
+  std::lock_guard<std::mutex> channel_lock(channel_mutex_);
+  auto ch = channels_.find(channel);
+  if (ch == channels_.end()) {
+    return;
+  }
+  ch->second.events.push_back(cq_num);
+  uint64_t one = 1;
+  if (write(ch->second.fd, &one, sizeof(one)) != sizeof(one)) {
+    RDMA_LOG_ERROR("Failed to signal completion channel " << channel);
+  }
+}
+
+RdmaDevice::OwnerRef RdmaDevice::lookup_qp_owner(uint32_t qp_num) {
+  std::lock_guard<std::mutex> global_lock(global_qp_mutex);
+  auto it = global_qp_map.find(qp_num);
+  if (it == global_qp_map.end()) {
+    return OwnerRef();
+  }
+  it->second->owner_refs_.fetch_add(1, std::memory_order_relaxed);
+  return OwnerRef(it->second);
+}
+
+void RdmaDevice::configure_link(const LinkConfig &config) {
+  link_.configure(config);
+}
+
+LinkConfig RdmaDevice::get_link_config() const { return link_.config(); }
+
+LinkStats RdmaDevice::get_link_stats() const { return link_.stats(); }
+
+void RdmaDevice::set_link_bandwidth(double gbps) {
+  LinkConfig config = link_.config();
+  config.bandwidth_gbps = gbps > 0 ? gbps : 0.0;
+  link_.configure(config);
+}
+
+void RdmaDevice::set_qp_weight(uint32_t qp_num, uint32_t weight) {
+  link_.set_weight(qp_num, weight);
+}
+
+double RdmaDevice::get_qp_rate_gbps(uint32_t qp_num) {
+  return link_.flow_rate_gbps(qp_num, RdmaFabric::now_ns());
+}
+
+TransportStats RdmaDevice::get_transport_stats() const {
+  TransportStats stats;
+  stats.tx_messages = tx_messages_.load(std::memory_order_relaxed);
+  stats.tx_packets = tx_packets_.load(std::memory_order_relaxed);
+  stats.tx_bytes = tx_bytes_.load(std::memory_order_relaxed);
+  stats.rx_messages = rx_messages_.load(std::memory_order_relaxed);
+  stats.rx_packets = rx_packets_.load(std::memory_order_relaxed);
+  stats.rx_bytes = rx_bytes_.load(std::memory_order_relaxed);
+  stats.rx_out_of_sequence =
+      rx_out_of_sequence_.load(std::memory_order_relaxed);
+  stats.rx_dropped = rx_dropped_.load(std::memory_order_relaxed);
+  stats.rx_duplicate = rx_duplicate_.load(std::memory_order_relaxed);
+  stats.wire_time_ns = wire_time_ns_.load(std::memory_order_relaxed);
+  stats.tx_retransmitted = tx_retransmitted_.load(std::memory_order_relaxed);
+  stats.seq_naks = seq_naks_.load(std::memory_order_relaxed);
+  stats.rnr_naks = rnr_naks_.load(std::memory_order_relaxed);
+  stats.ack_timeouts = ack_timeouts_.load(std::memory_order_relaxed);
+  stats.dc_connects = dc_connects_.load(std::memory_order_relaxed);
+  stats.dc_disconnects = dc_disconnects_.load(std::memory_order_relaxed);
+  stats.tier_delay_ns = tier_delay_ns_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+RdmaPerfSnapshot RdmaDevice::get_perf_counters() const {
+  RdmaPerfSnapshot snapshot;
+  counters_.read(snapshot);
+  auto set = [&](RdmaCounter counter, uint64_t value) {
+    snapshot.values[static_cast<size_t>(counter)] = value;
+  };
+  set(RdmaCounter::QP_LOCK_CONTENDED, qp_mutex_.contended());
+  set(RdmaCounter::CQ_LOCK_CONTENDED, cq_mutex_.contended());
+  set(RdmaCounter::TX_LOCK_CONTENDED, tx_mutex_.contended());
+  set(RdmaCounter::INFLIGHT_LOCK_CONTENDED, inflight_mutex_.contended());
+  return snapshot;
+}
+
+MiddleCacheStats RdmaDevice::get_cache_stats() const {
+  MiddleCacheStats stats;
+  stats.qp = qp_cache_->get_stats();
+  stats.cq = cq_cache_->get_stats();
+  stats.mr = mr_cache_->get_stats();
+  stats.pd = pd_cache_->get_stats();
+  return stats;
+}
+
+bool RdmaDevice::get_qp_latency(uint32_t qp_num,
+                                RdmaLatencySnapshot &snapshot) {
+  std::shared_ptr<RdmaLatencyHistogram> hist;
+  {
+    std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+    with_qp(qp_num, [&](QPValue &qp) {
+      hist = qp.latency;
+      return false;
+    });
+  }
+  if (!hist) {
+    return false;
+  }
+  snapshot = hist->snapshot();
+  return snapshot.count > 0;
+}
+
+bool RdmaDevice::get_cq_latency(uint32_t cq_num,
+                                RdmaLatencySnapshot &snapshot) {
+  std::shared_ptr<RdmaLatencyHistogram> hist;
+  {
+    std::lock_guard<RdmaCountedMutex> lock(cq_mutex_);
+    with_cq(cq_num, [&](CQValue &cq) {
+      hist = cq.latency;
+      return false;
+    });
+  }
+  if (!hist) {
+    return false;
+  }
+  snapshot = hist->snapshot();
+  return snapshot.count > 0;
+}
+
+void RdmaDevice::reset_latency() {
+  {
+    std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+    std::vector<uint32_t> qp_nums;
+    for (const auto &entry : qps_) {
+      qp_nums.push_back(entry.first);
+    }
+    if (enable_middle_cache_.load(std::memory_order_relaxed)) {
+      std::vector<uint32_t> cached = qp_cache_->keys();
+      qp_nums.insert(qp_nums.end(), cached.begin(), cached.end());
+    }
+    for (const auto &entry : qps_host_) {
+      qp_nums.push_back(entry.first);
+    }
+    for (uint32_t qp_num : qp_nums) {
+      with_qp(qp_num, [](QPValue &qp) {
+        if (qp.latency) {
+          qp.latency->reset();
+        }
+        return false;
+      });
+    }
+  }
+  std::lock_guard<RdmaCountedMutex> lock(cq_mutex_);
+  std::vector<uint32_t> cq_nums;
+  for (const auto &entry : cqs_) {
+    cq_nums.push_back(entry.first);
+  }
+  std::vector<uint32_t> cached = cq_cache_->keys();
+  cq_nums.insert(cq_nums.end(), cached.begin(), cached.end());
+  for (const auto &entry : cqs_host_) {
+    cq_nums.push_back(entry.first);
+  }
+  for (uint32_t cq_num : cq_nums) {
+    with_cq(cq_num, [](CQValue &cq) {
+      if (cq.latency) {
+        cq.latency->reset();
+      }
+      return false;
+    });
+  }
+}
+
+void RdmaDevice::set_latency_tracking(bool enable, uint32_t sub_bits,
+                                      uint32_t max_bits) {
+  latency_sub_bits_.store(sub_bits, std::memory_order_relaxed);
+  latency_max_bits_.store(max_bits, std::memory_order_relaxed);
+  latency_tracking_.store(enable, std::memory_order_relaxed);
+}
+
+std::shared_ptr<RdmaLatencyHistogram>
+RdmaDevice::make_latency_histogram() const {
+  return std::make_shared<RdmaLatencyHistogram>(
+      latency_sub_bits_.load(std::memory_order_relaxed),
+      latency_max_bits_.load(std::memory_order_relaxed));
+}
+
+void RdmaDevice::reset_perf_counters() {
+  counters_.reset();
+  qp_mutex_.reset_contended();
+  cq_mutex_.reset_contended();
+  tx_mutex_.reset_contended();
+  inflight_mutex_.reset_contended();
+  qp_cache_->reset_stats();
+  cq_cache_->reset_stats();
+  mr_cache_->reset_stats();
+  pd_cache_->reset_stats();
+}
+
+bool RdmaDevice::post_send(uint32_t qp_num, const RdmaWorkRequest &wr) {
+  return post_send_n(qp_num, &wr, 1) == 1;
+}
+
+size_t RdmaDevice::post_send_list(uint32_t qp_num,
+                                  const std::vector<RdmaWorkRequest> &wrs) {
+  return post_send_n(qp_num, wrs.data(), wrs.size());
+}
+
+size_t RdmaDevice::post_send_n(uint32_t qp_num, const RdmaWorkRequest *wrs,
+                               size_t count) {
+  if (count == 0) {
+    return 0;
+  }
+  size_t posted = 0;
+  uint64_t bytes = 0;
+  if (engines_.empty() || link_.timed()) {
+    // 同一设备的发送串行化：分配PSN与包上线的顺序一致
+    std::lock_guard<RdmaCountedMutex> tx_lock(tx_mutex_);
+    EngineWork work;
+    for (; posted < count; ++posted) {
+      {
+        std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+        if (!submit_send_locked(qp_num, wrs[posted], work, nullptr, nullptr)) {
+          break;
+        }
+      }
+      bytes += work.out.wqe.length;
+      transmit(work.out, work.timeout, work.retry_cnt, work.rnr_retry);
+    }
+  } else {
+    // 引擎模式：整个列表在一次 qp_mutex_ 内写入所属引擎的提交环（同一QP的
+    // 消息在环中按PSN排列），写完后只敲一次门铃
+    Engine *engine = nullptr;
+    size_t producer_index = 0;
+    {
+      std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+      EngineWork work;
+      while (posted < count &&
+             submit_send_locked(qp_num, wrs[posted], work, &engine,
+                                &producer_index)) {
+        bytes += work.out.wqe.length;
+        ++posted;
+      }
+    }
+    if (posted > 0) {
+      ring_doorbell(*engine, producer_index);
+    }
+  }
+  counters_.add(RdmaCounter::POST_SEND, posted);
+  counters_.add(RdmaCounter::POST_SEND_BYTES, bytes);
+  if (posted < count) {
+    counters_.add(RdmaCounter::POST_ERRORS);
+  }
+  return posted;
+}
+
+bool RdmaDevice::submit_send_locked(uint32_t qp_num, const RdmaWorkRequest &wr,
+                                    EngineWork &work, Engine **engine,
+                                    size_t *producer_index) {
+  // 同一个 work 在批量投递中复用：WQE与按QP类型赋值的字段由下面逐一写入，
+  // 这里只复位可能残留上一条消息取值的字段
+  OutboundMessage &out = work.out;
+  SendWqe &wqe = out.wqe;
+  out.sent = 0;
+  out.flushed = false;
+  out.has_grh = false;
+  out.dc_connect = false;
+  out.detach_dct = 0;
+  out.latency.reset();
+
+  // UD/DCI 的目的地址句柄
+  AhAttr ah;
+  bool has_ah = false;
+  if (wr.ah != 0) {
+    std::lock_guard<std::mutex> ah_lock(ah_mutex_);
+    auto it = ahs_.find(wr.ah);
+    if (it != ahs_.end()) {
+      ah = it->second;
+      has_ah = true;
+    }
+  }
+
+  bool ok = with_qp(qp_num, [&](QPValue &qp) {
+    // 检查QP状态是否为RTS
+    if (qp.state != QpState::RTS || qp.qp_type == QpType::DCT ||
+        !build_send_wqe(qp, wr, wqe)) {
+      return false;
+    }
+    // 发送队列已满：未完成的WR数达到队列深度
+    if (!qp.sq_outstanding) {
+      qp.sq_outstanding = std::make_shared<std::atomic<uint32_t>>(0);
+    }
+    if (qp.sq_outstanding->load(std::memory_order_relaxed) >= qp.max_send_wr) {
+      return false;
+    }
+    out.sq_slot = qp.sq_outstanding;
+    if (wqe.post_ns != 0) {
+      if (!qp.latency) {
+        qp.latency = make_latency_histogram();
+      }
+      out.latency = qp.latency;
+    }
+    out.mtu = qp.mtu > 0 ? qp.mtu : 1024;
+    out.num_packets = 1;
+    out.qp_type = qp.qp_type;
+    out.dest_qp = qp.dest_qp_num;
+    if (qp.qp_type == QpType::UD) {
+      // UD 每条消息是一个包，只支持 SEND
+      if (wr.opcode != RdmaOpcode::SEND || !has_ah || wqe.length > out.mtu) {
+        return false;
+      }
+      out.dest_qp = wr.remote_qpn;
+      out.has_grh = ah.is_global;
+      if (ah.is_global) {
+        build_grh(ah, qp.gid, wqe.length, out.grh);
+      }
+    } else {
+      if (qp.qp_type == QpType::DCI && (!has_ah || wr.remote_qpn == 0)) {
+        return false;
+      }
+      if (qp.qp_type == QpType::DCI && qp.dest_qp_num != wr.remote_qpn) {
+        // 旧目标的消息全部确认之前不能切换（含仍在引擎提交环中的消息）
+        if (qp.sq_outstanding->load(std::memory_order_relaxed) != 0) {
+          return false;
+        }
+        out.detach_dct = qp.dest_qp_num;
+        out.dest_qp = wr.remote_qpn;
+        out.dc_connect = true;
+      }
+      if (wqe.length > out.mtu) {
+        out.num_packets = (wqe.length + out.mtu - 1) / out.mtu;
+      }
+    }
+    // 为整条消息预留连续的PSN区间
+    out.first_psn = qp.sq_psn;
+    out.send_cq = qp.send_cq;
+    out.src_qp = qp_num;
+    work.timeout = qp.timeout;
+    work.retry_cnt = qp.retry_cnt;
+    work.rnr_retry = qp.rnr_retry;
+    // 槽位在写入提交环之前占用，引擎可能在本函数返回前就完成该消息
+    qp.sq_outstanding->fetch_add(1, std::memory_order_relaxed);
+    if (engine != nullptr) {
+      const uint32_t index = qp.engine != RDMA_ENGINE_AUTO ? qp.engine : qp_num;
+      Engine &target = *engines_[index % engines_.size()];
+      size_t position = 0;
+      if (!target.ring.push(work, &position)) {
+        target.ring_full.fetch_add(1, std::memory_order_relaxed);
+        qp.sq_outstanding->fetch_sub(1, std::memory_order_relaxed);
+        return false;
+      }
+      *engine = &target;
+      *producer_index = position + 1;
+    }
+    // 消息已提交，更新QP上下文
+    qp.sq_psn = (qp.sq_psn + out.num_packets) & RDMA_PSN_MASK;
+    if (out.dc_connect) {
+      // 断开旧目标、挂接新目标各改写一次DCI上下文
+      const uint32_t delay_ns = qp_tier_delay_ns(qp_num);
+      if (out.detach_dct != 0) {
+        charge_delay_ns(delay_ns);
+      }
+      charge_delay_ns(delay_ns);
+      qp.dest_qp_num = wr.remote_qpn;
+    }
     return true;
+  });
+  if (!ok) {
+    return false;
+  }
+  if (out.dc_connect) {
+    dc_connects_.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (out.detach_dct != 0) {
+    dc_disconnects_.fetch_add(1, std::memory_order_relaxed);
   }
+  return true;
 }
 
-// 静态映射表，用于存储所有设备中的QP信息
-// 键是QP编号，值是指向QPValue的指针和指向RdmaDevice的指针
-static std::unordered_map<uint32_t, std::pair<QPValue *, RdmaDevice *>>
-    global_qp_map;
-static std::mutex global_qp_mutex;
-
-bool RdmaDevice::post_send(uint32_t qp_num, const RdmaWorkRequest &wr) {
-  std::lock_guard<std::mutex> lock(qp_mutex_);
+// 门铃记录只前进不后退：多个生产者并发写入时，较晚敲响的门铃可能已经
+// 覆盖了其他生产者写入的WQE，此时后者的门铃不再推进记录
+void RdmaDevice::ring_doorbell(Engine &engine, size_t producer_index) {
+  size_t current = engine.doorbell.load(std::memory_order_relaxed);
+  while (current < producer_index &&
+         !engine.doorbell.compare_exchange_weak(current, producer_index,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+  }
+  engine.doorbells.fetch_add(1, std::memory_order_relaxed);
+  // 与引擎线程“置 sleeping 后检查门铃”配对，避免漏掉唤醒
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (engine.sleeping.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> idle_lock(engine.idle_mutex);
+    engine.idle_cv.notify_one();
+  }
+}
 
-  // 获取QP信息
-  QPValue qp_info;
-  bool found = false;
+void RdmaDevice::transmit(OutboundMessage &out, uint8_t timeout,
+                          uint8_t retry_cnt, uint8_t rnr_retry) {
+  const uint32_t qp_num = out.src_qp;
+  const SendWqe &wqe = out.wqe;
+  // inline 消息的数据源是WQE自身的 inline 缓冲区
+  out.inline_sge = RdmaSge{out.wqe.inline_data, wqe.length, 0};
+  // 需要留待确认或重投递的消息才拷贝到堆上
+  auto persist = [&out]() {
+    auto msg = std::make_shared<OutboundMessage>(out);
+    msg->inline_sge.addr = msg->wqe.inline_data;
+    return msg;
+  };
+
+  // 有链路模型时DCI切换目标前旧目标的消息均已确认，立即断开；
+  // 同步路径上断开随消息一起按提交顺序在投递前进行
+  const bool timed = link_.timed();
+  if (timed && out.detach_dct != 0) {
+    dc_disconnect(out.detach_dct, qp_num);
+    out.detach_dct = 0;
+  }
 
-  // 首先在设备资源中查找
-  auto it = qps_.find(qp_num);
-  if (it != qps_.end()) {
-    qp_info = it->second;
-    found = true;
+  const RdmaOpcode opcode = wqe.wr.opcode;
+  const bool carries_data =
+      opcode == RdmaOpcode::RDMA_WRITE || opcode == RdmaOpcode::SEND;
+  if (!carries_data) {
+    tx_messages_.fetch_add(1, std::memory_order_relaxed);
+    complete_send(out);
+    return;
+  }
 
-    // 将QP信息添加到全局映射表
-    std::lock_guard<std::mutex> global_lock(global_qp_mutex);
-    global_qp_map[qp_num] = std::make_pair(&(it->second), this);
-  } else {
-    if (enable_middle_cache_.load(std::memory_order_relaxed)) {
-      if (qp_cache_->get(qp_num, qp_info)) {
-        found = true;
+  // 消息（含WQE副本）留在请求端队列中，直到对端确认其尾包；
+  // 配置了链路模型时包进入端口发送队列，由链路事件引擎按时序投递
+  bool blocked = false;
+  {
+    std::lock_guard<RdmaCountedMutex> inflight_lock(inflight_mutex_);
+    auto it = inflight_.find(qp_num);
+    if (timed || it != inflight_.end()) {
+      SendQueue &queue = it != inflight_.end() ? it->second : inflight_[qp_num];
+      const bool idle = queue.messages.empty();
+      if (idle) {
+        queue.timeout_ns = timed && out.qp_type != QpType::UD
+                               ? ack_timeout_ns(timeout)
+                               : 0;
+        queue.retry_cnt = queue.retries_left = retry_cnt;
+        queue.rnr_retry = queue.rnr_left = rnr_retry;
       }
-    } else {
-      auto it_host = qps_host_.find(qp_num);
-      if (it_host != qps_host_.end()) {
-        qp_info = it_host->second;
-        found = true;
-        // 加入全局映射，指向 host 表中的对象
-        std::lock_guard<std::mutex> global_lock(global_qp_mutex);
-        global_qp_map[qp_num] = std::make_pair(&(it_host->second), this);
+      auto msg = persist();
+      queue.messages.push_back(msg);
+      blocked = !timed;
+      // RNR 等待期间只排队，等待结束后随重传一起上线
+      if (timed && !queue.rnr_wait) {
+        bool arm = false;
+        enqueue_packets(qp_num, msg, 0, arm);
+        if (idle) {
+          arm_ack_timer(qp_num, queue, RdmaFabric::now_ns());
+        }
+        if (arm) {
+          RdmaFabric::instance().schedule(
+              RdmaFabric::now_ns(), this,
+              [this](uint64_t now_ns) { link_egress(now_ns); });
+        }
       }
     }
   }
-
-  if (!found) {
-    return false;
+  tx_messages_.fetch_add(1, std::memory_order_relaxed);
+  if (timed || blocked) {
+    return; // 同步路径上排在 RNR 等待的消息之后
   }
 
-  // 检查QP状态是否为RTS
-  if (qp_info.state != QpState::RTS) {
-    return false;
+  // 无链路模型：按MTU切分并逐包同步投递到对端设备
+  RxResponse response = deliver_message(out);
+  if (response.verdict == RxVerdict::NAK_RNR) {
+    bool failed = false;
+    {
+      std::lock_guard<RdmaCountedMutex> inflight_lock(inflight_mutex_);
+      SendQueue &queue = inflight_[qp_num];
+      queue.timeout_ns = ack_timeout_ns(timeout);
+      queue.retry_cnt = queue.retries_left = retry_cnt;
+      queue.rnr_retry = queue.rnr_left = rnr_retry;
+      queue.messages.push_back(persist());
+      failed = !start_rnr_wait(qp_num, queue, response.psn,
+                               response.rnr_delay_ns, RdmaFabric::now_ns());
+    }
+    if (failed) {
+      fail_requester(qp_num, WcStatus::RNR_RETRY_EXC_ERR);
+    }
+    return;
+  }
+  if (response.verdict == RxVerdict::DROP && out.qp_type != QpType::UD) {
+    // 对端没有回确认（目的QP不存在或不接收）：消息留在请求端队列中，
+    // 由ACK超时重新投递，重试耗尽后以 RETRY_EXC_ERR 完成
+    std::lock_guard<RdmaCountedMutex> inflight_lock(inflight_mutex_);
+    SendQueue &queue = inflight_[qp_num];
+    queue.timeout_ns = ack_timeout_ns(timeout);
+    queue.retry_cnt = queue.retries_left = retry_cnt;
+    queue.rnr_retry = queue.rnr_left = rnr_retry;
+    queue.messages.push_back(persist());
+    arm_ack_timer(qp_num, queue, RdmaFabric::now_ns());
+    return;
   }
 
-  // 创建完成事件
-  if (wr.signaled) {
-    CompletionEntry completion;
-    completion.wr_id = wr.wr_id;
-    completion.status = 0; // 成功状态
-    completion.opcode = wr.opcode;
-    completion.length = wr.length;
-
-    // 将完成事件添加到CQ
-    std::lock_guard<std::mutex> cq_lock(cq_mutex_);
-    auto cq_it = cqs_.find(qp_info.send_cq);
-    if (cq_it != cqs_.end()) {
-      cq_it->second.completions.push_back(completion);
-      // std::cout << "Added completion to device CQ " << qp_info.send_cq
-      //           << std::endl;
-    } else {
-      CQValue cq_info;
-      if (cq_cache_->get(qp_info.send_cq, cq_info)) {
-        maybe_sleep_ns(middle_delay_ns_.load(std::memory_order_relaxed));
-        cq_info.completions.push_back(completion);
-        cq_cache_->set(qp_info.send_cq, cq_info);
-        // std::cout << "Added completion to cached CQ " << qp_info.send_cq
-        //           << std::endl;
-      } else {
-        // 尝试主机交换路径
-        auto host_it = cqs_host_.find(qp_info.send_cq);
-        if (host_it != cqs_host_.end()) {
-          maybe_sleep_ns(host_swap_delay_ns_.load(std::memory_order_relaxed));
-          host_it->second.completions.push_back(completion);
-          // std::cout << "Added completion to host CQ " << qp_info.send_cq
-          //           << std::endl;
-        } else {
-          std::cerr << "Failed to find CQ " << qp_info.send_cq
-                    << " for completion" << std::endl;
+  // 消息全部上线后产生发送完成
+  complete_send(out);
+}
+
+uint32_t RdmaDevice::post_send_dc(const std::vector<uint32_t> &dci_pool,
+                                  const RdmaWorkRequest &wr) {
+  // 候选顺序：已挂接到目标的DCI、未挂接的空闲DCI、挂接到其他目标的空闲DCI
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> unattached;
+  std::vector<uint32_t> reattach;
+  {
+    std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+    for (uint32_t dci : dci_pool) {
+      with_qp(dci, [&](QPValue &qp) {
+        if (qp.qp_type != QpType::DCI || qp.state != QpState::RTS) {
+          return false;
         }
+        if (qp.dest_qp_num == wr.remote_qpn) {
+          candidates.push_back(dci);
+        } else if (!qp.sq_outstanding ||
+                   qp.sq_outstanding->load(std::memory_order_relaxed) == 0) {
+          (qp.dest_qp_num == 0 ? unattached : reattach).push_back(dci);
+        }
+        return false; // 只读，不写回缓存
+      });
+    }
+  }
+  candidates.insert(candidates.end(), unattached.begin(), unattached.end());
+  candidates.insert(candidates.end(), reattach.begin(), reattach.end());
+  for (uint32_t dci : candidates) {
+    if (post_send(dci, wr)) {
+      return dci;
+    }
+  }
+  return 0;
+}
+
+void RdmaDevice::dc_detach(uint32_t dct, uint32_t dci) {
+  std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+  if (dc_streams_.erase((static_cast<uint64_t>(dct) << 32) | dci) > 0) {
+    charge_delay_ns(qp_tier_delay_ns(dct));
+  }
+}
+
+void RdmaDevice::dc_disconnect(uint32_t dct, uint32_t dci) {
+  OwnerRef owner = lookup_qp_owner(dct);
+  if (owner) {
+    owner->dc_detach(dct, dci);
+  }
+}
+
+// 包只描述负载位置，不拷贝数据；首包被 RNR 拒绝时其余包不再发送
+RxResponse RdmaDevice::deliver_message(const OutboundMessage &msg) {
+  if (msg.detach_dct != 0) {
+    dc_disconnect(msg.detach_dct, msg.src_qp);
+  }
+  OwnerRef dest_device = lookup_qp_owner(msg.dest_qp);
+  RxResponse first{RxVerdict::DROP, msg.first_psn, 0};
+  RdmaPacket pkt{};
+  for (uint32_t i = 0; i < msg.num_packets; ++i) {
+    fill_packet(msg, i, pkt);
+    tx_packets_.fetch_add(1, std::memory_order_relaxed);
+    tx_bytes_.fetch_add(pkt.payload_length, std::memory_order_relaxed);
+    if (!dest_device) {
+      continue;
+    }
+    RxResponse response = dest_device->receive_packet(pkt);
+    if (i == 0) {
+      first = response;
+      if (response.verdict == RxVerdict::NAK_RNR) {
+        break;
       }
     }
   }
+  return first;
+}
 
-  // 模拟数据传输 - 在实际场景中，这里会通过网络发送数据
-  if (wr.opcode == RdmaOpcode::RDMA_WRITE || wr.opcode == RdmaOpcode::SEND) {
-    uint32_t dest_qp_num = qp_info.dest_qp_num;
+bool RdmaDevice::release_send_slot(const OutboundMessage &out) {
+  return out.sq_slot && out.sq_slot->fetch_sub(1) == 1;
+}
 
-    // 在全局映射表中查找目标QP
-    QPValue *dest_qp_ptr = nullptr;
-    RdmaDevice *dest_device = nullptr;
+void RdmaDevice::complete_send(const OutboundMessage &out) {
+  // 槽位先于完成归还：应用取到完成时即可复用该槽位
+  const bool last = release_send_slot(out);
+  const SendWqe &wqe = out.wqe;
+  if (wqe.wr.signaled) {
+    CompletionEntry completion;
+    completion.wr_id = wqe.wr.wr_id;
+    completion.status = WcStatus::SUCCESS;
+    completion.opcode = wqe.wr.opcode;
+    completion.length = wqe.length;
+    completion.timestamp_ns = RdmaFabric::now_ns();
+    if (out.latency) {
+      out.latency->record(completion.timestamp_ns - wqe.post_ns);
+    }
+    push_completion(out.send_cq, completion, false, wqe.post_ns);
+  }
 
+  // 处于 SQD 的QP归还最后一个槽位时发送队列排空，事件在完成写入之后产生
+  if (last && draining_count_.load() != 0) {
+    bool drained = false;
     {
-      std::lock_guard<std::mutex> global_lock(global_qp_mutex);
-      auto dest_it = global_qp_map.find(dest_qp_num);
-      if (dest_it != global_qp_map.end()) {
-        dest_qp_ptr = dest_it->second.first;
-        dest_device = dest_it->second.second;
-      }
-    }
-
-    // 如果找到目标QP，执行数据传输
-    if (dest_qp_ptr && dest_device) {
-      // 执行数据复制，即使目标QP当前没有接收缓冲区也要保存数据
-      if (dest_qp_ptr->recv_addr != nullptr) {
-        size_t copy_size = std::min(wr.length, dest_qp_ptr->recv_length);
-        memcpy(dest_qp_ptr->recv_addr, wr.local_addr, copy_size);
-
-        // 创建接收完成事件
-        CompletionEntry recv_completion;
-        recv_completion.wr_id = 0;  // 简化处理
-        recv_completion.status = 0; // 成功状态
-        recv_completion.length = copy_size;
-        recv_completion.opcode = RdmaOpcode::RECV;
-
-        // 将完成事件添加到接收CQ
-        std::lock_guard<std::mutex> dest_cq_lock(dest_device->cq_mutex_);
-        auto dest_cq_it = dest_device->cqs_.find(dest_qp_ptr->recv_cq);
-        if (dest_cq_it != dest_device->cqs_.end()) {
-          dest_cq_it->second.completions.push_back(recv_completion);
-          std::cout << "Added receive completion to device CQ "
-                    << dest_qp_ptr->recv_cq << std::endl;
-        } else {
-          CQValue dest_cq_info;
-          if (dest_device->cq_cache_->get(dest_qp_ptr->recv_cq, dest_cq_info)) {
-            maybe_sleep_ns(middle_delay_ns_.load(std::memory_order_relaxed));
-            dest_cq_info.completions.push_back(recv_completion);
-            dest_device->cq_cache_->set(dest_qp_ptr->recv_cq, dest_cq_info);
-            std::cout << "Added receive completion to cached CQ "
-                      << dest_qp_ptr->recv_cq << std::endl;
-          } else {
-            // 主机交换路径
-            auto host_it = dest_device->cqs_host_.find(dest_qp_ptr->recv_cq);
-            if (host_it != dest_device->cqs_host_.end()) {
-              maybe_sleep_ns(host_swap_delay_ns_.load(std::memory_order_relaxed));
-              host_it->second.completions.push_back(recv_completion);
-              std::cout << "Added receive completion to host CQ "
-                        << dest_qp_ptr->recv_cq << std::endl;
-            } else {
-              std::cerr << "Failed to find receive CQ " << dest_qp_ptr->recv_cq
-                        << " for completion" << std::endl;
-            }
-          }
-        }
+      std::lock_guard<RdmaCountedMutex> inflight_lock(inflight_mutex_);
+      drained = draining_.erase(out.src_qp) > 0;
+      draining_count_.store(draining_.size());
+    }
+    if (drained) {
+      raise_async_event(AsyncEventType::SQ_DRAINED, out.src_qp);
+    }
+  }
+}
 
-        // 清除接收缓冲区信息，表示已经使用过了
-        dest_qp_ptr->recv_addr = nullptr;
-        dest_qp_ptr->recv_length = 0;
-      } else {
-        // 如果目标QP没有接收缓冲区，先保存数据
-        dest_qp_ptr->pending_data.assign(
-            static_cast<const char *>(wr.local_addr),
-            static_cast<const char *>(wr.local_addr) + wr.length);
-      }
+// 链路事件：端口空闲时按调度策略发出一个包，包在串行化完成后
+// 经本端口传播时延到达对端入口队列
+void RdmaDevice::link_egress(uint64_t now_ns) {
+  WirePacket packet;
+  uint64_t done_ns = 0;
+  uint64_t retry_ns = 0;
+  if (!link_.dequeue(now_ns, packet, done_ns, retry_ns)) {
+    if (retry_ns != 0) {
+      RdmaFabric::instance().schedule(
+          retry_ns, this, [this](uint64_t t) { link_egress(t); });
     }
+    return;
   }
 
-  return true;
+  tx_packets_.fetch_add(1, std::memory_order_relaxed);
+  tx_bytes_.fetch_add(packet.pkt.payload_length, std::memory_order_relaxed);
+  wire_time_ns_.fetch_add(done_ns - now_ns, std::memory_order_relaxed);
+  // 同一QP的包按PSN顺序上线，序号落在已上线区间内的即为重传
+  const uint32_t index =
+      (packet.pkt.psn - packet.msg->first_psn) & RDMA_PSN_MASK;
+  if (index < packet.msg->sent) {
+    tx_retransmitted_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    packet.msg->sent = index + 1;
+  }
+
+  RdmaFabric &fabric = RdmaFabric::instance();
+  fabric.schedule(done_ns, this, [this](uint64_t t) { link_egress(t); });
+  // UD 消息串行化完成即产生发送完成，不论之后是否丢失或送达
+  const bool ud = packet.msg->qp_type == QpType::UD;
+  if (ud && packet.pkt.last) {
+    uint32_t src_qp = packet.pkt.src_qp;
+    uint32_t psn = packet.pkt.psn;
+    fabric.schedule(done_ns, this, [this, src_qp, psn](uint64_t t) {
+      on_ack(src_qp, psn, t);
+    });
+  }
+  if (link_.lose_packet()) {
+    return; // 在线上丢失，RC由对端的 NAK 或本端的ACK超时恢复
+  }
+  OwnerRef dest_ref = lookup_qp_owner(packet.pkt.dest_qp);
+  // 目的QP不存在时包被丢弃，RC由ACK超时重试，重试耗尽后以 RETRY_EXC_ERR 完成
+  // 事件以目的设备为属主，目的设备析构时会撤销它
+  if (dest_ref) {
+    RdmaDevice *dest = dest_ref.get();
+    uint64_t arrive_ns = done_ns + link_.config().propagation_delay_ns;
+    fabric.schedule(arrive_ns, dest, [dest, packet](uint64_t t) {
+      dest->link_arrive(packet, t);
+    });
+  }
 }
 
-bool RdmaDevice::post_recv(uint32_t qp_num, const RdmaWorkRequest &wr) {
-  std::lock_guard<std::mutex> lock(qp_mutex_);
+// 链路事件：包到达本端口的入口队列，排空后经本端口传播时延交付
+void RdmaDevice::link_arrive(const WirePacket &packet, uint64_t now_ns) {
+  WirePacket marked = packet;
+  uint64_t leave_ns = link_.ingress_admit(
+      packet.pkt.payload_length + RDMA_PACKET_OVERHEAD_BYTES, now_ns,
+      marked.ecn);
+  uint64_t deliver_ns = leave_ns + link_.config().propagation_delay_ns;
+  RdmaFabric::instance().schedule(
+      deliver_ns, this,
+      [this, marked](uint64_t t) { link_deliver(marked, t); });
+}
 
-  // 获取QP信息
-  QPValue qp_info;
-  bool found = false;
-  bool is_cached = false;
+// 链路事件：包交付给目的QP；被标记ECN的包触发CNP，
+// 响应端的 ACK/NAK 与CNP一样经反向路径的传播时延到达源设备（反向路径不丢包）
+void RdmaDevice::link_deliver(const WirePacket &packet, uint64_t now_ns) {
+  RxResponse response = receive_packet(packet.pkt);
 
-  // 首先在设备资源中查找
-  auto it = qps_.find(qp_num);
-  if (it != qps_.end()) {
-    qp_info = it->second;
-    found = true;
-    std::cout << "Found QP " << qp_num << " in device resources" << std::endl;
-  } else {
-    if (enable_middle_cache_.load(std::memory_order_relaxed)) {
-      if (qp_cache_->get(qp_num, qp_info)) {
-        found = true;
-        is_cached = true;
-        std::cout << "Found QP " << qp_num << " in cache" << std::endl;
-      }
-    } else {
-      auto it_host = qps_host_.find(qp_num);
-      if (it_host != qps_host_.end()) {
-        qp_info = it_host->second;
-        found = true;
-        std::cout << "Found QP " << qp_num << " in host table" << std::endl;
-      }
+  OwnerRef src_ref = lookup_qp_owner(packet.pkt.src_qp);
+  if (!src_ref) {
+    return;
+  }
+  RdmaDevice *src = src_ref.get();
+  uint64_t reverse_ns = now_ns + link_.config().propagation_delay_ns +
+                        src->link_.config().propagation_delay_ns;
+  RdmaFabric &fabric = RdmaFabric::instance();
+  const uint32_t src_qp = packet.pkt.src_qp;
+  if (packet.ecn && link_.should_send_cnp(src_qp, now_ns)) {
+    fabric.schedule(reverse_ns, src, [src, src_qp](uint64_t t) {
+      src->link_.on_cnp(src_qp, t);
+    });
+  }
+
+  if (packet.msg->qp_type == QpType::UD) {
+    return; // 数据报不确认
+  }
+  const uint32_t psn = response.psn;
+  switch (response.verdict) {
+  case RxVerdict::ACCEPT:
+    // 每条消息在尾包处确认一次
+    if (packet.pkt.last) {
+      fabric.schedule(reverse_ns, src, [src, src_qp, psn](uint64_t t) {
+        src->on_ack(src_qp, psn, t);
+      });
     }
+    break;
+  case RxVerdict::DUPLICATE:
+    fabric.schedule(reverse_ns, src, [src, src_qp, psn](uint64_t t) {
+      src->on_ack(src_qp, psn, t);
+    });
+    break;
+  case RxVerdict::NAK_SEQ:
+    fabric.schedule(reverse_ns, src, [src, src_qp, psn](uint64_t t) {
+      src->on_nak(src_qp, psn, t);
+    });
+    break;
+  case RxVerdict::NAK_RNR: {
+    const uint64_t delay_ns = response.rnr_delay_ns;
+    fabric.schedule(reverse_ns, src,
+                    [src, src_qp, psn, delay_ns](uint64_t t) {
+                      src->on_rnr_nak(src_qp, psn, delay_ns, t);
+                    });
+    break;
+  }
+  case RxVerdict::DROP:
+    break; // 请求端由ACK超时恢复
   }
+}
 
-  if (!found) {
-    std::cerr << "QP " << qp_num << " not found for post_recv" << std::endl;
-    return false;
+// 接收一个数据包：校验PSN，首包消费接收WQE确定落点，
+// 每个包按偏移直接分散到目的缓冲区，尾包到达时产生接收完成。
+// 返回值决定回给请求端的 ACK/NAK
+RxResponse RdmaDevice::receive_packet(const RdmaPacket &pkt) {
+  CompletionEntry recv_completion;
+  bool completed = false;
+  uint32_t recv_cq = 0;
+  RxResponse response{RxVerdict::DROP, pkt.psn, 0};
+  {
+    std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+    with_qp(pkt.dest_qp, [&](QPValue &qp) {
+      // SQD/SQE 只影响发送队列，接收侧照常工作
+      if (qp.state != QpState::RTR && qp.state != QpState::RTS &&
+          qp.state != QpState::SQD && qp.state != QpState::SQE) {
+        rx_dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      if (qp.qp_type == QpType::UD) {
+        // 数据报不检查PSN；Q_Key 不符或没有接收WQE时静默丢弃
+        if (pkt.qkey != qp.qkey || qp.recv_queue.empty()) {
+          rx_dropped_.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        }
+        const RecvWqe recv_wqe = qp.recv_queue.front();
+        qp.recv_queue.pop_front();
+        rx_packets_.fetch_add(1, std::memory_order_relaxed);
+        rx_bytes_.fetch_add(pkt.payload_length, std::memory_order_relaxed);
+        rx_messages_.fetch_add(1, std::memory_order_relaxed);
+
+        recv_completion.wr_id = recv_wqe.wr_id;
+        recv_completion.opcode = RdmaOpcode::RECV;
+        recv_completion.imm_data = pkt.imm_data;
+        recv_completion.src_qp = pkt.src_qp;
+        recv_completion.grh = pkt.grh != nullptr;
+        // 缓冲区开头的 RDMA_GRH_BYTES 字节为GRH预留，负载紧随其后
+        if (pkt.msg_length + RDMA_GRH_BYTES > recv_wqe.length) {
+          recv_completion.status = WcStatus::LOC_LEN_ERR;
+        } else {
+          if (pkt.grh != nullptr) {
+            RdmaSge grh_sge{const_cast<RdmaGrh *>(pkt.grh), RDMA_GRH_BYTES, 0};
+            sg_copy(recv_wqe.sge.data(), recv_wqe.num_sge, 0, &grh_sge, 1, 0,
+                    RDMA_GRH_BYTES, false);
+          }
+          sg_copy(recv_wqe.sge.data(), recv_wqe.num_sge, RDMA_GRH_BYTES,
+                  pkt.src_sge, pkt.num_src_sge, 0, pkt.payload_length,
+                  pkt.src_inline);
+          recv_completion.length = pkt.msg_length + RDMA_GRH_BYTES;
+        }
+        completed = true;
+        recv_cq = qp.recv_cq;
+        response = RxResponse{RxVerdict::ACCEPT, pkt.psn, 0};
+        return true;
+      }
+      if (qp.qp_type != QpType::DCT) {
+        recv_cq = qp.recv_cq;
+        return rc_receive_locked(qp, pkt, response, recv_completion,
+                                 completed);
+      }
+
+      // DCT：校验 DC 访问密钥，换入发包DCI的连接上下文后按RC处理
+      if (pkt.qkey != qp.qkey) {
+        rx_dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      const uint64_t key =
+          (static_cast<uint64_t>(qp.qp_num) << 32) | pkt.src_qp;
+      auto it = dc_streams_.find(key);
+      if (pkt.dc_connect &&
+          (it == dc_streams_.end() || it->second.connect_psn != pkt.psn)) {
+        // 新的连接（重传的连接包PSN相同，按普通包处理）
+        charge_delay_ns(qp_tier_delay_ns(qp.qp_num));
+        DcStream stream{};
+        stream.connect_psn = pkt.psn;
+        stream.rq_psn = pkt.psn;
+        stream.rx_status = WcStatus::SUCCESS;
+        it = dc_streams_.insert_or_assign(key, stream).first;
+      }
+      if (it == dc_streams_.end()) {
+        // 未连接的DCI（例如断开后迟到的重传包）
+        rx_dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      DcStream &stream = it->second;
+      qp.rq_psn = stream.rq_psn;
+      qp.nak_pending = stream.nak_pending;
+      qp.rx_in_progress = stream.rx_in_progress;
+      qp.rx_wqe = stream.rx_wqe;
+      qp.rx_status = stream.rx_status;
+      rc_receive_locked(qp, pkt, response, recv_completion, completed);
+      stream.rq_psn = qp.rq_psn;
+      stream.nak_pending = qp.nak_pending;
+      stream.rx_in_progress = qp.rx_in_progress;
+      stream.rx_wqe = qp.rx_wqe;
+      stream.rx_status = qp.rx_status;
+      recv_completion.src_qp = pkt.src_qp;
+      recv_cq = qp.recv_cq;
+      return true; // 接收队列可能被消费，写回缓存
+    });
   }
 
-  // 检查QP状态是否至少为RTR
-  if (qp_info.state != QpState::RTR && qp_info.state != QpState::RTS) {
-    return false;
+  if (completed) {
+    push_completion(recv_cq, recv_completion, pkt.solicited);
+    RDMA_LOG_TRACE("Added receive completion to CQ " << recv_cq);
   }
+  return response;
+}
 
-  // 保存接收缓冲区信息
-  qp_info.recv_addr = wr.local_addr;
-  qp_info.recv_length = wr.length;
-
-  // 检查是否有待处理的数据
-  if (!qp_info.pending_data.empty()) {
-    // 有待处理数据，复制到接收缓冲区
-    size_t copy_size =
-        std::min(qp_info.pending_data.size(), (unsigned long)wr.length);
-    memcpy(wr.local_addr, qp_info.pending_data.data(), copy_size);
-
-    // 创建接收完成事件
-    CompletionEntry recv_completion;
-    recv_completion.wr_id = wr.wr_id;
-    recv_completion.status = 0; // 成功状态
-    recv_completion.length = copy_size;
-    recv_completion.opcode = RdmaOpcode::RECV;
-
-    // 将完成事件添加到CQ
-    std::lock_guard<std::mutex> cq_lock(cq_mutex_);
-    auto cq_it = cqs_.find(qp_info.recv_cq);
-    if (cq_it != cqs_.end()) {
-      cq_it->second.completions.push_back(recv_completion);
-    } else {
-      CQValue cq_info;
-      if (cq_cache_->get(qp_info.recv_cq, cq_info)) {
-        maybe_sleep_ns(middle_delay_ns_.load(std::memory_order_relaxed));
-        cq_info.completions.push_back(recv_completion);
-        cq_cache_->set(qp_info.recv_cq, cq_info);
-      }
+// 可靠连接的响应端：校验PSN，首包消费接收WQE确定落点，按偏移写入；
+// 返回 true 表示 qp 被修改
+bool RdmaDevice::rc_receive_locked(QPValue &qp, const RdmaPacket &pkt,
+                                   RxResponse &response,
+                                   CompletionEntry &completion,
+                                   bool &completed) {
+  if (pkt.psn != qp.rq_psn) {
+    const uint32_t last_psn = (qp.rq_psn - 1) & RDMA_PSN_MASK;
+    if (psn_before(pkt.psn, qp.rq_psn)) {
+      // 重传造成的重复包：重新确认已收到的最后一个PSN
+      rx_duplicate_.fetch_add(1, std::memory_order_relaxed);
+      response = RxResponse{RxVerdict::DUPLICATE, last_psn, 0};
+      return true;
+    }
+    // 出现缺口：每个缺口只回一次NAK，之后的乱序包静默丢弃。
+    // nak_pending 变化时需写回，否则缓存中的QP会对每个乱序包重复回NAK
+    rx_out_of_sequence_.fetch_add(1, std::memory_order_relaxed);
+    if (qp.nak_pending) {
+      return false;
     }
+    qp.nak_pending = true;
+    response = RxResponse{RxVerdict::NAK_SEQ, qp.rq_psn, 0};
+    return true;
+  }
 
-    // 清除待处理数据和接收缓冲区信息
-    qp_info.pending_data.clear();
-    qp_info.recv_addr = nullptr;
-    qp_info.recv_length = 0;
+  // 带目的地址的 RDMA_WRITE 直接写入远端内存，不消耗接收WQE
+  const bool to_memory =
+      pkt.opcode == RdmaOpcode::RDMA_WRITE && pkt.remote_addr != nullptr;
+  if (!to_memory && pkt.first && qp.recv_queue.empty()) {
+    // 没有接收WQE：不接收该包（rq_psn 不前进），要求请求端稍后重试
+    const bool changed = !qp.nak_pending;
+    qp.nak_pending = true;
+    response = RxResponse{RxVerdict::NAK_RNR, pkt.psn,
+                          rnr_timer_ns(qp.min_rnr_timer)};
+    return changed;
   }
 
-  // 更新QP信息
-  if (it != qps_.end()) {
-    it->second = qp_info;
-    std::cout << "Updated QP " << qp_num
-              << " receive buffer: addr=" << qp_info.recv_addr
-              << ", length=" << qp_info.recv_length << std::endl;
+  qp.nak_pending = false;
+  qp.rq_psn = (qp.rq_psn + 1) & RDMA_PSN_MASK;
+  rx_packets_.fetch_add(1, std::memory_order_relaxed);
+  rx_bytes_.fetch_add(pkt.payload_length, std::memory_order_relaxed);
+  response = RxResponse{RxVerdict::ACCEPT, pkt.psn, 0};
+
+  if (to_memory) {
+    RdmaSge remote_sge{pkt.remote_addr, pkt.msg_length, 0};
+    sg_copy(&remote_sge, 1, pkt.offset, pkt.src_sge, pkt.num_src_sge,
+            pkt.offset, pkt.payload_length, pkt.src_inline);
+    if (pkt.last) {
+      rx_messages_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+  }
 
-    // 将更新后的QP信息添加到全局映射表
-    std::lock_guard<std::mutex> global_lock(global_qp_mutex);
-    global_qp_map[qp_num] = std::make_pair(&(it->second), this);
-    std::cout << "Updated global QP map for QP " << qp_num << std::endl;
-  } else {
-    if (enable_middle_cache_.load(std::memory_order_relaxed)) {
-      qp_cache_->set(qp_num, qp_info);
-      std::cout << "Updated cached QP " << qp_num << " receive buffer"
-                << std::endl;
-    } else {
-      qps_host_[qp_num] = qp_info;
-      std::cout << "Updated host QP " << qp_num << " receive buffer"
-                << std::endl;
+  if (pkt.first) {
+    qp.rx_in_progress = true;
+    qp.rx_status = WcStatus::SUCCESS;
+    qp.rx_wqe = qp.recv_queue.front();
+    qp.recv_queue.pop_front();
+    if (pkt.msg_length > qp.rx_wqe.length) {
+      qp.rx_status = WcStatus::LOC_LEN_ERR;
     }
   }
+  if (!qp.rx_in_progress) {
+    return true;
+  }
 
-  // 检查是否有待处理数据可以立即处理
-  if (!qp_info.pending_data.empty() && qp_info.recv_addr) {
-    std::cout << "Processing pending data for QP " << qp_num
-              << ", size=" << qp_info.pending_data.size() << std::endl;
+  if (qp.rx_status == WcStatus::SUCCESS) {
+    sg_copy(qp.rx_wqe.sge.data(), qp.rx_wqe.num_sge, pkt.offset,
+            pkt.src_sge, pkt.num_src_sge, pkt.offset, pkt.payload_length,
+            pkt.src_inline);
+  }
+
+  if (!pkt.last) {
+    return true;
+  }
+  qp.rx_in_progress = false;
+  rx_messages_.fetch_add(1, std::memory_order_relaxed);
+  completion.wr_id = qp.rx_wqe.wr_id;
+  completion.opcode = RdmaOpcode::RECV;
+  completion.status = qp.rx_status;
+  completion.imm_data = pkt.imm_data;
+  if (qp.rx_status == WcStatus::SUCCESS) {
+    completion.length = pkt.msg_length;
   }
+  completed = true;
+  return true;
+}
+
+bool RdmaDevice::post_recv(uint32_t qp_num, const RdmaWorkRequest &wr) {
+  std::lock_guard<RdmaCountedMutex> lock(qp_mutex_);
+  bool ok = with_qp(qp_num, [&](QPValue &qp) {
+    // INIT 之后、ERR 之前都可以投递接收WQE
+    if (qp.state == QpState::RESET || qp.state == QpState::ERR) {
+      return false;
+    }
+
+    // 生成接收WQE
+    RecvWqe recv_wqe;
+    recv_wqe.wr_id = wr.wr_id;
+    if (!load_sg_list(wr, qp.max_recv_sge, recv_wqe.sge.data(),
+                      recv_wqe.num_sge, recv_wqe.length)) {
+      return false;
+    }
+    for (uint32_t i = 0; i < recv_wqe.num_sge; ++i) {
+      if (!validate_sge(recv_wqe.sge[i])) {
+        return false;
+      }
+    }
 
+    if (qp.recv_queue.size() >= qp.max_recv_wr) {
+      return false; // 接收队列已满
+    }
+    qp.recv_queue.push_back(recv_wqe);
+    RDMA_LOG_TRACE("Updated QP " << qp_num
+                                 << " receive queue: depth="
+                                 << qp.recv_queue.size());
+    return true;
+  });
+  if (!ok) {
+    counters_.add(RdmaCounter::POST_ERRORS);
+    RDMA_LOG_DEBUG("post_recv failed on QP " << qp_num);
+    return false;
+  }
+  counters_.add(RdmaCounter::POST_RECV);
   return true;
 }
 
@@ -702,66 +2638,279 @@ bool RdmaDevice::post_recv(uint32_t qp_num, const RdmaWorkRequest &wr) {
 bool RdmaDevice::poll_cq(uint32_t cq_num,
                          std::vector<CompletionEntry> &completions,
                          uint32_t max_entries) {
-  std::lock_guard<std::mutex> lock(cq_mutex_);
+  std::lock_guard<RdmaCountedMutex> lock(cq_mutex_);
+  return poll_cq_locked(cq_num, completions, max_entries);
+}
 
+bool RdmaDevice::poll_cq_locked(uint32_t cq_num,
+                                std::vector<CompletionEntry> &completions,
+                                uint32_t max_entries) {
+  const size_t before = completions.size();
+  const bool got = take_completions_locked(cq_num, completions, max_entries);
+  counters_.add(RdmaCounter::POLL_CQ);
+  if (got) {
+    counters_.add(RdmaCounter::CQE_POLLED, completions.size() - before);
+  } else {
+    counters_.add(RdmaCounter::POLL_CQ_EMPTY);
+  }
+  return got;
+}
+
+bool RdmaDevice::take_completions_locked(
+    uint32_t cq_num, std::vector<CompletionEntry> &completions,
+    uint32_t max_entries) {
   // 首先在设备资源中查找
   auto it = cqs_.find(cq_num);
   if (it != cqs_.end()) {
-    if (!it->second.completions.empty()) {
-      size_t num_entries = std::min(static_cast<size_t>(max_entries),
-                                    it->second.completions.size());
-      completions.insert(completions.end(), it->second.completions.begin(),
-                         it->second.completions.begin() + num_entries);
-      it->second.completions.erase(it->second.completions.begin(),
-                                   it->second.completions.begin() +
-                                       num_entries);
-      return true;
+    // 设备上的CQ的完成只写入设备资源，CQ为空时不再查中间缓存和主机表，
+    // 以免空轮询被计为中间缓存未命中
+    if (it->second.completions.empty()) {
+      return false;
     }
+    counters_.add(RdmaCounter::CQ_HIT_DEVICE);
+    size_t num_entries = std::min(static_cast<size_t>(max_entries),
+                                  it->second.completions.size());
+    completions.insert(completions.end(), it->second.completions.begin(),
+                       it->second.completions.begin() + num_entries);
+    it->second.completions.erase(it->second.completions.begin(),
+                                 it->second.completions.begin() +
+                                     num_entries);
+    return true;
   }
 
-  // 如果不在设备资源中或设备资源中没有完成事件，尝试从缓存/主机获取
+  // 不在设备资源中，尝试从缓存/主机获取
   if (enable_middle_cache_.load(std::memory_order_relaxed)) {
     auto cached_completions =
         cq_cache_->batch_get_completions(cq_num, max_entries);
     if (!cached_completions.empty()) {
+      counters_.add(RdmaCounter::CQ_HIT_CACHE);
       completions.insert(completions.end(), cached_completions.begin(),
                          cached_completions.end());
       return true;
     }
-  } else {
-    auto hit = cqs_host_.find(cq_num);
-    if (hit != cqs_host_.end() && !hit->second.completions.empty()) {
-      maybe_sleep_ns(host_swap_delay_ns_.load(std::memory_order_relaxed));
-      size_t num_entries = std::min(static_cast<size_t>(max_entries),
-                                    hit->second.completions.size());
-      completions.insert(completions.end(), hit->second.completions.begin(),
-                         hit->second.completions.begin() + num_entries);
-      hit->second.completions.erase(hit->second.completions.begin(),
-                                    hit->second.completions.begin() + num_entries);
+  }
+  auto hit = cqs_host_.find(cq_num);
+  if (hit != cqs_host_.end() && !hit->second.completions.empty()) {
+    counters_.add(RdmaCounter::CQ_HIT_HOST);
+    charge_delay_ns(host_swap_delay_ns_.load(std::memory_order_relaxed));
+    size_t num_entries = std::min(static_cast<size_t>(max_entries),
+                                  hit->second.completions.size());
+    completions.insert(completions.end(), hit->second.completions.begin(),
+                       hit->second.completions.begin() + num_entries);
+    hit->second.completions.erase(hit->second.completions.begin(),
+                                  hit->second.completions.begin() +
+                                      num_entries);
+    return true;
+  }
+
+  return false;
+}
+
+bool RdmaDevice::req_notify_cq(uint32_t cq_num, bool solicited_only) {
+  std::lock_guard<RdmaCountedMutex> lock(cq_mutex_);
+
+  bool armed = false;
+  bool found = with_cq(cq_num, [&](CQValue &cq) {
+    // 未绑定完成通道的CQ无处投递事件
+    if (cq.comp_channel == 0) {
+      return false;
+    }
+    // 已武装为任意完成时，再次以 solicited-only 武装不会收窄触发条件
+    cq.solicited_only = cq.armed ? cq.solicited_only && solicited_only
+                                 : solicited_only;
+    cq.armed = true;
+    armed = true;
+    return true;
+  });
+  return found && armed;
+}
+
+bool RdmaDevice::wait_cq(uint32_t cq_num,
+                         std::vector<CompletionEntry> &completions,
+                         uint32_t max_entries, int timeout_ms) {
+  using Clock = std::chrono::steady_clock;
+  const auto start = Clock::now();
+  const bool forever = timeout_ms < 0;
+  const auto deadline = start + std::chrono::milliseconds(std::max(0, timeout_ms));
+  const auto spin_end =
+      start + std::chrono::nanoseconds(
+                  cq_wait_spin_ns_.load(std::memory_order_relaxed));
+  const auto yield_end =
+      spin_end + std::chrono::nanoseconds(
+                     cq_wait_yield_ns_.load(std::memory_order_relaxed));
+
+  // 阶段1：忙轮询，负载高时完成通常在这里取到
+  do {
+    if (poll_cq(cq_num, completions, max_entries)) {
+      cq_wait_spin_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  } while (Clock::now() < spin_end && (forever || Clock::now() < deadline));
+
+  // 阶段2：每次轮询之间让出CPU
+  while (Clock::now() < yield_end && (forever || Clock::now() < deadline)) {
+    std::this_thread::yield();
+    if (poll_cq(cq_num, completions, max_entries)) {
+      cq_wait_yield_.fetch_add(1, std::memory_order_relaxed);
       return true;
     }
   }
 
-  return false;
+  // 阶段3：在CQ上登记等待者后阻塞，push_completion 负责唤醒
+  std::unique_lock<RdmaCountedMutex> lock(cq_mutex_);
+  auto set_waiting = [&](bool waiting) {
+    return with_cq(cq_num, [&](CQValue &cq) {
+      if (waiting) {
+        cq.waiters++;
+      } else if (cq.waiters > 0) {
+        cq.waiters--;
+      }
+      return true;
+    });
+  };
+  if (!set_waiting(true)) {
+    return false;
+  }
+  bool got = false;
+  while (!(got = poll_cq_locked(cq_num, completions, max_entries))) {
+    if (forever) {
+      cq_cv_.wait(lock);
+    } else if (cq_cv_.wait_until(lock, deadline) == std::cv_status::timeout) {
+      got = poll_cq_locked(cq_num, completions, max_entries);
+      break;
+    }
+    // 被唤醒时CQ可能已被销毁
+    if (!with_cq(cq_num, [](CQValue &) { return false; })) {
+      break;
+    }
+  }
+  set_waiting(false);
+  (got ? cq_wait_block_ : cq_wait_timeout_)
+      .fetch_add(1, std::memory_order_relaxed);
+  return got;
 }
 
-bool RdmaDevice::req_notify_cq(uint32_t cq_num, bool /*solicited_only*/) {
-  std::lock_guard<std::mutex> lock(cq_mutex_);
+void RdmaDevice::set_cq_wait_policy(const CqWaitPolicy &policy) {
+  cq_wait_spin_ns_.store(policy.spin_ns, std::memory_order_relaxed);
+  cq_wait_yield_ns_.store(policy.yield_ns, std::memory_order_relaxed);
+}
 
-  // 首先在设备资源中查找
-  auto it = cqs_.find(cq_num);
-  if (it != cqs_.end()) {
-    // TODO: 实现CQ通知机制
+CqWaitPolicy RdmaDevice::get_cq_wait_policy() const {
+  CqWaitPolicy policy;
+  policy.spin_ns = cq_wait_spin_ns_.load(std::memory_order_relaxed);
+  policy.yield_ns = cq_wait_yield_ns_.load(std::memory_order_relaxed);
+  return policy;
+}
+
+CqWaitStats RdmaDevice::get_cq_wait_stats() const {
+  CqWaitStats stats;
+  stats.spin_completions = cq_wait_spin_.load(std::memory_order_relaxed);
+  stats.yield_completions = cq_wait_yield_.load(std::memory_order_relaxed);
+  stats.block_completions = cq_wait_block_.load(std::memory_order_relaxed);
+  stats.timeouts = cq_wait_timeout_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+bool RdmaDevice::modify_cq_moderation(uint32_t cq_num, uint16_t cq_count,
+                                      uint32_t cq_period_us) {
+  std::lock_guard<RdmaCountedMutex> lock(cq_mutex_);
+  return with_cq(cq_num, [&](CQValue &cq) {
+    cq.cq_count = cq_count;
+    cq.cq_period_us = cq_period_us;
+    cq.moderation_target_us = 0; // 显式设置参数时关闭自适应
+    return true;
+  });
+}
+
+bool RdmaDevice::set_cq_adaptive_moderation(uint32_t cq_num,
+                                            uint32_t target_latency_us) {
+  std::lock_guard<RdmaCountedMutex> lock(cq_mutex_);
+  return with_cq(cq_num, [&](CQValue &cq) {
+    cq.moderation_target_us = target_latency_us;
+    cq.cq_count = 1;
+    cq.cq_period_us = target_latency_us;
+    cq.completion_rate = 0;
+    cq.window_completions = 0;
+    cq.window_start_ns = RdmaFabric::now_ns();
     return true;
+  });
+}
+
+uint32_t RdmaDevice::create_comp_channel() {
+  int fd = eventfd(0, EFD_NONBLOCK | EFD_SEMAPHORE | EFD_CLOEXEC);
+  if (fd < 0) {
+    return 0;
   }
+  std::lock_guard<std::mutex> channel_lock(channel_mutex_);
+  uint32_t channel = next_channel_num_++;
+  channels_[channel] = CompChannel{fd, {}, 0};
+  return channel;
+}
 
-  // 如果不在设备资源中，检查缓存
-  CQValue cq_info;
-  if (!cq_cache_->get(cq_num, cq_info)) {
+bool RdmaDevice::destroy_comp_channel(uint32_t channel) {
+  std::lock_guard<std::mutex> channel_lock(channel_mutex_);
+  auto ch = channels_.find(channel);
+  if (ch == channels_.end() || ch->second.attached_cqs > 0) {
+    return false;
+  }
+  close(ch->second.fd);
+  channels_.erase(ch);
+  return true;
+}
+
+int RdmaDevice::get_comp_channel_fd(uint32_t channel) {
+  std::lock_guard<std::mutex> channel_lock(channel_mutex_);
+  auto ch = channels_.find(channel);
+  return ch != channels_.end() ? ch->second.fd : -1;
+}
+
+// 从信号量模式的 eventfd 消费一个计数，无计数时按 timeout_ms 等待
+static bool consume_eventfd(int fd, int timeout_ms) {
+  uint64_t value = 0;
+  while (read(fd, &value, sizeof(value)) != sizeof(value)) {
+    if (errno != EAGAIN && errno != EINTR) {
+      return false;
+    }
+    if (errno == EAGAIN) {
+      pollfd pfd{fd, POLLIN, 0};
+      int ready = poll(&pfd, 1, timeout_ms);
+      if (ready == 0 || (ready < 0 && errno != EINTR)) {
+        return false; // 超时或出错
+      }
+    }
+  }
+  return true;
+}
+
+bool RdmaDevice::get_cq_event(uint32_t channel, uint32_t &cq_num,
+                              int timeout_ms) {
+  int fd = get_comp_channel_fd(channel);
+  if (fd < 0 || !consume_eventfd(fd, timeout_ms)) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> channel_lock(channel_mutex_);
+  auto ch = channels_.find(channel);
+  if (ch == channels_.end() || ch->second.events.empty()) {
     return false;
   }
+  cq_num = ch->second.events.front();
+  ch->second.events.pop_front();
+  return true;
+}
 
-  // TODO: 实现CQ通知机制
+int RdmaDevice::get_async_fd() const { return async_fd_; }
+
+bool RdmaDevice::get_async_event(AsyncEvent &event, int timeout_ms) {
+  if (async_fd_ < 0 || !consume_eventfd(async_fd_, timeout_ms)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> async_lock(async_mutex_);
+  if (async_events_.empty()) {
+    return false;
+  }
+  event = async_events_.front();
+  async_events_.pop_front();
   return true;
 }
 
@@ -785,6 +2934,69 @@ void RdmaDevice::free_mr(MRBlock *block) {
 
 bool RdmaDevice::validate_qp_transition(QpState current_state,
                                         QpState new_state) {
-  // TODO: 实现QP状态转换验证逻辑
+  uint32_t required = 0;
+  uint32_t optional = 0;
+  // RC 与 UD 的合法迁移相同，只有属性掩码不同
+  return qp_transition_masks(QpType::RC, current_state, new_state, required,
+                             optional);
+}
+
+bool RdmaDevice::validate_sge(const RdmaSge &sge) {
+  // lkey 为0 表示保留的本地DMA key，可访问任意本地内存
+  if (sge.lkey == 0) {
+    return true;
+  }
+  if (sge.length > 0 && sge.addr == nullptr) {
+    return false;
+  }
+
+  MRValue mr;
+  if (!get_mr_info(sge.lkey, mr) || mr.addr == nullptr) {
+    return false;
+  }
+  auto begin = reinterpret_cast<uintptr_t>(sge.addr);
+  auto mr_begin = reinterpret_cast<uintptr_t>(mr.addr);
+  return begin >= mr_begin && begin + sge.length <= mr_begin + mr.length;
+}
+
+// 根据工作请求生成发送WQE
+// SGE列表拷贝进WQE，调用方的 sg_list 数组在返回后即可释放；
+// inline 请求在此处把数据聚合进WQE，之后数据路径只访问WQE，不再需要lkey
+bool RdmaDevice::build_send_wqe(const QPValue &qp, const RdmaWorkRequest &wr,
+                                SendWqe &wqe) {
+  wqe.post_ns = latency_tracking_.load(std::memory_order_relaxed)
+                    ? RdmaFabric::now_ns()
+                    : 0;
+  wqe.wr = wr;
+  wqe.wr.sg_list = nullptr;
+  wqe.wr.num_sge = 0;
+  if (!load_sg_list(wr, qp.max_send_sge, wqe.sge.data(), wqe.num_sge,
+                    wqe.length)) {
+    return false;
+  }
+  wqe.wr.length = wqe.length;
+
+  if (!wr.send_inline) {
+    for (uint32_t i = 0; i < wqe.num_sge; ++i) {
+      if (!validate_sge(wqe.sge[i])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // inline 仅适用于携带本地数据的 SEND / RDMA_WRITE，且长度不能超过QP阈值
+  if ((wr.opcode != RdmaOpcode::SEND && wr.opcode != RdmaOpcode::RDMA_WRITE) ||
+      wqe.length > qp.max_inline_data) {
+    return false;
+  }
+  uint32_t offset = 0;
+  for (uint32_t i = 0; i < wqe.num_sge; ++i) {
+    inline_copy(wqe.inline_data + offset, wqe.sge[i].addr, wqe.sge[i].length);
+    offset += wqe.sge[i].length;
+  }
+  wqe.num_sge = 0;
+  wqe.wr.local_addr = nullptr;
+  wqe.wr.lkey = 0;
   return true;
-}
\ No newline at end of file
+}
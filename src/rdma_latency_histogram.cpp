@@ -0,0 +1,127 @@
+#include "../include/rdma_latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+RdmaLatencyHistogram::RdmaLatencyHistogram(uint32_t sub_bits,
+                                           uint32_t max_bits)
+    : sub_bits_(std::min(std::max(sub_bits, 1u), RDMA_HIST_MAX_SUB_BITS)),
+      max_bits_(std::min(std::max(max_bits, sub_bits_ + 1),
+                         RDMA_HIST_LIMIT_BITS)),
+      num_buckets_(bucket_count(sub_bits_, max_bits_)),
+      counts_(new std::atomic<uint64_t>[num_buckets_]()) {}
+
+size_t RdmaLatencyHistogram::bucket_count(uint32_t sub_bits,
+                                          uint32_t max_bits) {
+  return (size_t{1} << sub_bits) * (max_bits - sub_bits + 1);
+}
+
+size_t RdmaLatencyHistogram::bucket_index(uint64_t value_ns, uint32_t sub_bits,
+                                          uint32_t max_bits) {
+  const uint64_t sub_buckets = uint64_t{1} << sub_bits;
+  uint64_t value = std::min(value_ns, (uint64_t{1} << max_bits) - 1);
+  if (value < sub_buckets) {
+    return static_cast<size_t>(value);
+  }
+  // value 位于 [2^m, 2^(m+1))，右移 m-sub_bits 位后落在 [sub, 2*sub)
+  uint32_t magnitude = 63 - static_cast<uint32_t>(__builtin_clzll(value));
+  uint32_t shift = magnitude - sub_bits;
+  return static_cast<size_t>(sub_buckets + shift * sub_buckets +
+                             ((value >> shift) - sub_buckets));
+}
+
+uint64_t RdmaLatencyHistogram::bucket_lower(size_t index, uint32_t sub_bits) {
+  const uint64_t sub_buckets = uint64_t{1} << sub_bits;
+  if (index < sub_buckets) {
+    return index;
+  }
+  uint64_t shift = (index - sub_buckets) / sub_buckets;
+  uint64_t sub = (index - sub_buckets) % sub_buckets + sub_buckets;
+  return sub << shift;
+}
+
+uint64_t RdmaLatencyHistogram::bucket_upper(size_t index, uint32_t sub_bits) {
+  const uint64_t sub_buckets = uint64_t{1} << sub_bits;
+  if (index < sub_buckets) {
+    return index;
+  }
+  uint64_t shift = (index - sub_buckets) / sub_buckets;
+  return bucket_lower(index, sub_bits) + (uint64_t{1} << shift) - 1;
+}
+
+void RdmaLatencyHistogram::record(uint64_t value_ns) {
+  counts_[bucket_index(value_ns, sub_bits_, max_bits_)].fetch_add(
+      1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value_ns, std::memory_order_relaxed);
+  uint64_t seen = min_.load(std::memory_order_relaxed);
+  while (value_ns < seen &&
+         !min_.compare_exchange_weak(seen, value_ns,
+                                     std::memory_order_relaxed)) {
+  }
+  seen = max_.load(std::memory_order_relaxed);
+  while (value_ns > seen &&
+         !max_.compare_exchange_weak(seen, value_ns,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+RdmaLatencySnapshot RdmaLatencyHistogram::snapshot() const {
+  RdmaLatencySnapshot snap;
+  snap.count = count_.load(std::memory_order_relaxed);
+  if (snap.count == 0) {
+    return snap;
+  }
+  snap.sub_bits = sub_bits_;
+  snap.counts.resize(num_buckets_);
+  for (size_t i = 0; i < num_buckets_; ++i) {
+    snap.counts[i] = counts_[i].load(std::memory_order_relaxed);
+  }
+  snap.sum_ns = sum_.load(std::memory_order_relaxed);
+  snap.min_ns = min_.load(std::memory_order_relaxed);
+  snap.max_ns = max_.load(std::memory_order_relaxed);
+  return snap;
+}
+
+void RdmaLatencyHistogram::reset() {
+  for (size_t i = 0; i < num_buckets_; ++i) {
+    counts_[i].store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  min_.store(UINT64_MAX, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t RdmaLatencySnapshot::value_at(double percentile) const {
+  if (count == 0 || counts.empty()) {
+    return 0;
+  }
+  // 与 count 并发更新时各桶之和可能略有出入，以桶计数为准
+  uint64_t total = 0;
+  for (uint64_t c : counts) {
+    total += c;
+  }
+  double p = std::min(std::max(percentile, 0.0), 100.0);
+  uint64_t rank = static_cast<uint64_t>(std::ceil(p / 100.0 * total));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return std::min(RdmaLatencyHistogram::bucket_upper(i, sub_bits), max_ns);
+    }
+  }
+  return max_ns;
+}
+
+std::string RdmaLatencySnapshot::to_string() const {
+  char buf[192];
+  snprintf(buf, sizeof(buf),
+           "count=%llu min=%.2fus p50=%.2fus p90=%.2fus p99=%.2fus "
+           "p99.9=%.2fus max=%.2fus",
+           static_cast<unsigned long long>(count), min_ns / 1000.0,
+           value_at(50) / 1000.0, value_at(90) / 1000.0, value_at(99) / 1000.0,
+           value_at(99.9) / 1000.0, max_ns / 1000.0);
+  return buf;
+}
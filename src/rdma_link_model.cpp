@@ -0,0 +1,350 @@
+#include "../include/rdma_link_model.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// 线上字节数在给定速率下的串行化时间：位数 / (Gbit/s) 即纳秒
+static inline uint64_t wire_ns(double gbps, uint32_t wire_bytes) {
+  if (gbps <= 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(8.0 * wire_bytes / gbps + 0.5);
+}
+
+RdmaLinkModel::RdmaLinkModel(const LinkConfig &config) : config_(config) {}
+
+void RdmaLinkModel::configure(const LinkConfig &config) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  config_ = config;
+}
+
+LinkConfig RdmaLinkModel::config() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return config_;
+}
+
+bool RdmaLinkModel::timed() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return config_.bandwidth_gbps > 0 || config_.propagation_delay_ns > 0 ||
+         config_.loss_probability > 0;
+}
+
+uint64_t RdmaLinkModel::serialize_ns(uint32_t wire_bytes) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return wire_ns(config_.bandwidth_gbps, wire_bytes);
+}
+
+bool RdmaLinkModel::enqueue(uint32_t qp_num, WirePacket packet) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Flow &flow = flows_[qp_num];
+  flow.queue.push_back(std::move(packet));
+  if (!flow.active) {
+    // 重新变为活跃的流从当前系统虚拟时间开始计费，不能透支空闲期的份额
+    flow.active = true;
+    flow.finish_tag = std::max(flow.finish_tag, virtual_time_);
+    active_.push_back(qp_num);
+  }
+  if (egress_armed_) {
+    return false;
+  }
+  egress_armed_ = true;
+  return true;
+}
+
+bool RdmaLinkModel::dequeue(uint64_t now_ns, WirePacket &packet,
+                            uint64_t &done_ns, uint64_t &retry_ns) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  retry_ns = 0;
+  if (port_busy_until_ > now_ns) {
+    retry_ns = port_busy_until_;
+    return false;
+  }
+
+  size_t index = 0;
+  Flow *flow = pick_flow(now_ns, retry_ns, index);
+  if (flow == nullptr) {
+    if (retry_ns == 0) {
+      egress_armed_ = false; // 所有队列已空，等待下一次 enqueue 唤醒
+    }
+    return false;
+  }
+
+  packet = std::move(flow->queue.front());
+  flow->queue.pop_front();
+  uint32_t wire = packet.pkt.payload_length + RDMA_PACKET_OVERHEAD_BYTES;
+  done_ns = now_ns + wire_ns(config_.bandwidth_gbps, wire);
+  port_busy_until_ = done_ns;
+
+  flow->finish_tag += static_cast<double>(wire) / flow->weight;
+  virtual_time_ = flow->finish_tag;
+  if (flow->rate_gbps > 0) {
+    flow->next_send_ns = now_ns + wire_ns(flow->rate_gbps, wire);
+  }
+
+  // 服务过的流移到轮转队尾
+  uint32_t qp_num = active_[index];
+  active_.erase(active_.begin() + index);
+  if (!flow->queue.empty()) {
+    active_.push_back(qp_num);
+  } else {
+    flow->active = false;
+  }
+
+  stats_.tx_packets++;
+  stats_.tx_bytes += wire;
+  return true;
+}
+
+// 选出下一个发送的流：轮转取第一个可发送的流，加权取完成标签最小的流。
+// 被 DCQCN 限速的流跳过，并通过 retry_ns 返回最早可发送的时刻
+RdmaLinkModel::Flow *RdmaLinkModel::pick_flow(uint64_t now_ns,
+                                              uint64_t &retry_ns,
+                                              size_t &index) {
+  Flow *best = nullptr;
+  double best_tag = 0;
+  uint64_t earliest = 0;
+  for (size_t i = 0; i < active_.size(); ++i) {
+    Flow &flow = flows_[active_[i]];
+    update_rate(flow, now_ns);
+    if (flow.next_send_ns > now_ns) {
+      earliest = earliest == 0 ? flow.next_send_ns
+                               : std::min(earliest, flow.next_send_ns);
+      continue;
+    }
+    if (config_.scheduler == EgressScheduler::ROUND_ROBIN) {
+      index = i;
+      return &flow;
+    }
+    uint32_t head = flow.queue.front().pkt.payload_length +
+                    RDMA_PACKET_OVERHEAD_BYTES;
+    double tag = flow.finish_tag + static_cast<double>(head) / flow.weight;
+    if (best == nullptr || tag < best_tag) {
+      best = &flow;
+      best_tag = tag;
+      index = i;
+    }
+  }
+  if (best == nullptr) {
+    retry_ns = earliest;
+  }
+  return best;
+}
+
+// DCQCN 发送端的周期性更新按需惰性计算：
+// alpha 每个周期按 (1-g) 衰减；速率每个周期向目标速率折半逼近，
+// 快速恢复阶段结束后目标速率每周期增加 rai
+void RdmaLinkModel::update_rate(Flow &flow, uint64_t now_ns) const {
+  const DcqcnConfig &dcqcn = config_.dcqcn;
+  if (flow.alpha_ts != 0 && dcqcn.alpha_timer_ns > 0 &&
+      now_ns >= flow.alpha_ts + dcqcn.alpha_timer_ns) {
+    uint64_t periods = (now_ns - flow.alpha_ts) / dcqcn.alpha_timer_ns;
+    flow.alpha *= std::pow(1 - dcqcn.g, static_cast<double>(periods));
+    flow.alpha_ts += periods * dcqcn.alpha_timer_ns;
+  }
+  if (flow.rate_gbps <= 0 || dcqcn.rate_timer_ns == 0) {
+    return; // 线速发送，无需恢复
+  }
+
+  const double line = config_.bandwidth_gbps;
+  while (now_ns >= flow.rate_ts + dcqcn.rate_timer_ns) {
+    flow.rate_ts += dcqcn.rate_timer_ns;
+    if (++flow.stage > dcqcn.fast_recovery_steps) {
+      flow.target_gbps = std::min(line, flow.target_gbps + dcqcn.rai_gbps);
+    }
+    flow.rate_gbps = (flow.rate_gbps + flow.target_gbps) / 2;
+    if (flow.rate_gbps >= line * 0.999) {
+      flow.rate_gbps = 0;
+      flow.next_send_ns = 0;
+      break;
+    }
+  }
+}
+
+void RdmaLinkModel::set_weight(uint32_t qp_num, uint32_t weight) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  flows_[qp_num].weight = std::max(1u, weight);
+}
+
+void RdmaLinkModel::remove_flow(uint32_t qp_num) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  active_.erase(std::remove(active_.begin(), active_.end(), qp_num),
+                active_.end());
+  flows_.erase(qp_num);
+  last_cnp_ns_.erase(qp_num);
+}
+
+size_t RdmaLinkModel::purge_flow(uint32_t qp_num) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = flows_.find(qp_num);
+  if (it == flows_.end() || it->second.queue.empty()) {
+    return 0;
+  }
+  size_t purged = it->second.queue.size();
+  it->second.queue.clear();
+  it->second.active = false;
+  active_.erase(std::remove(active_.begin(), active_.end(), qp_num),
+                active_.end());
+  return purged;
+}
+
+bool RdmaLinkModel::lose_packet() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (config_.loss_probability <= 0) {
+    return false;
+  }
+  std::uniform_real_distribution<double> dist(0.0, 1.0);
+  if (dist(loss_rng_) >= config_.loss_probability) {
+    return false;
+  }
+  stats_.lost_packets++;
+  return true;
+}
+
+// 收到CNP：以当前速率为目标，按 alpha 降速，并加大 alpha
+void RdmaLinkModel::on_cnp(uint32_t qp_num, uint64_t now_ns) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.cnp_received++;
+  const DcqcnConfig &dcqcn = config_.dcqcn;
+  const double line = config_.bandwidth_gbps;
+  if (!dcqcn.enabled || line <= 0) {
+    return;
+  }
+
+  Flow &flow = flows_[qp_num];
+  update_rate(flow, now_ns);
+  double current = flow.rate_gbps > 0 ? flow.rate_gbps : line;
+  flow.target_gbps = current;
+  flow.rate_gbps = std::max(dcqcn.min_rate_gbps, current * (1 - flow.alpha / 2));
+  flow.alpha = (1 - dcqcn.g) * flow.alpha + dcqcn.g;
+  flow.stage = 0;
+  flow.alpha_ts = now_ns;
+  flow.rate_ts = now_ns;
+}
+
+double RdmaLinkModel::flow_rate_gbps(uint32_t qp_num, uint64_t now_ns) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = flows_.find(qp_num);
+  if (it == flows_.end()) {
+    return config_.bandwidth_gbps;
+  }
+  update_rate(it->second, now_ns);
+  return it->second.rate_gbps > 0 ? it->second.rate_gbps
+                                  : config_.bandwidth_gbps;
+}
+
+uint64_t RdmaLinkModel::ingress_admit(uint32_t wire_bytes, uint64_t arrival_ns,
+                                      bool &ecn_marked) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // 排队中的字节数 = 剩余排空时间 × 链路速率
+  uint64_t backlog_ns =
+      ingress_busy_until_ > arrival_ns ? ingress_busy_until_ - arrival_ns : 0;
+  auto backlog_bytes =
+      static_cast<uint64_t>(backlog_ns * config_.bandwidth_gbps / 8);
+  ecn_marked = config_.dcqcn.enabled &&
+               backlog_bytes >= config_.dcqcn.ecn_threshold_bytes;
+
+  uint64_t start = std::max(arrival_ns, ingress_busy_until_);
+  ingress_busy_until_ = start + wire_ns(config_.bandwidth_gbps, wire_bytes);
+
+  stats_.rx_packets++;
+  stats_.rx_bytes += wire_bytes;
+  stats_.ingress_queue_delay_ns += start - arrival_ns;
+  stats_.max_ingress_queue_bytes =
+      std::max(stats_.max_ingress_queue_bytes, backlog_bytes + wire_bytes);
+  if (ecn_marked) {
+    stats_.ecn_marked++;
+  }
+  return ingress_busy_until_;
+}
+
+bool RdmaLinkModel::should_send_cnp(uint32_t src_qp, uint64_t now_ns) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!config_.dcqcn.enabled) {
+    return false;
+  }
+  auto it = last_cnp_ns_.find(src_qp);
+  if (it != last_cnp_ns_.end() &&
+      now_ns < it->second + config_.dcqcn.cnp_interval_ns) {
+    return false;
+  }
+  last_cnp_ns_[src_qp] = now_ns;
+  stats_.cnp_sent++;
+  return true;
+}
+
+LinkStats RdmaLinkModel::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+RdmaFabric &RdmaFabric::instance() {
+  static RdmaFabric fabric;
+  return fabric;
+}
+
+uint64_t RdmaFabric::now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void RdmaFabric::schedule(uint64_t time_ns, const void *owner, Callback fn) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!thread_.joinable()) {
+    thread_ = std::thread(&RdmaFabric::run, this);
+  }
+  events_.push_back(Event{time_ns, next_seq_++, owner, std::move(fn)});
+  std::push_heap(events_.begin(), events_.end(), Later());
+  cv_.notify_one();
+}
+
+void RdmaFabric::cancel(const void *owner) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (std::this_thread::get_id() != thread_.get_id()) {
+    idle_cv_.wait(lock, [this] { return !running_; });
+  }
+  events_.erase(std::remove_if(events_.begin(), events_.end(),
+                               [owner](const Event &ev) {
+                                 return ev.owner == owner;
+                               }),
+                events_.end());
+  std::make_heap(events_.begin(), events_.end(), Later());
+}
+
+RdmaFabric::~RdmaFabric() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void RdmaFabric::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    if (events_.empty()) {
+      cv_.wait(lock);
+      continue;
+    }
+    // 事件不早于其时间戳执行；等待期间有更早的事件加入时会被唤醒
+    uint64_t now = now_ns();
+    uint64_t due = events_.front().time_ns;
+    if (due > now) {
+      cv_.wait_for(lock, std::chrono::nanoseconds(due - now));
+      continue;
+    }
+
+    std::pop_heap(events_.begin(), events_.end(), Later());
+    Event ev = std::move(events_.back());
+    events_.pop_back();
+    running_ = true;
+    lock.unlock();
+    ev.fn(ev.time_ns);
+    lock.lock();
+    running_ = false;
+    idle_cv_.notify_all();
+  }
+}
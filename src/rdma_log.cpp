@@ -0,0 +1,356 @@
+#include "../include/rdma_log.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <strings.h>
+#include <thread>
+
+namespace {
+
+const char *level_name(RdmaLogLevel level) {
+  switch (level) {
+  case RdmaLogLevel::TRACE:
+    return "TRACE";
+  case RdmaLogLevel::DBG:
+    return "DEBUG";
+  case RdmaLogLevel::INFO:
+    return "INFO";
+  case RdmaLogLevel::WARN:
+    return "WARN";
+  case RdmaLogLevel::ERR:
+    return "ERROR";
+  case RdmaLogLevel::OFF:
+    break;
+  }
+  return "OFF";
+}
+
+uint8_t env_level() {
+  const char *env = std::getenv("RDMA_LOG_LEVEL");
+  if (env != nullptr) {
+    for (uint8_t i = 0; i <= static_cast<uint8_t>(RdmaLogLevel::OFF); ++i) {
+      if (strcasecmp(env, level_name(static_cast<RdmaLogLevel>(i))) == 0) {
+        return i;
+      }
+    }
+  }
+  return static_cast<uint8_t>(RdmaLogLevel::INFO);
+}
+
+void default_sink(RdmaLogLevel level, std::string_view text) {
+  FILE *out = level >= RdmaLogLevel::WARN ? stderr : stdout;
+  fwrite(text.data(), 1, text.size(), out);
+  fputc('\n', out);
+}
+
+// 定长格式化缓冲，写满后丢弃其余字符
+class LineBuffer : public std::streambuf {
+public:
+  void reset() { setp(buffer_, buffer_ + RDMA_LOG_MAX_LINE); }
+  const char *data() const { return pbase(); }
+  size_t size() const { return static_cast<size_t>(pptr() - pbase()); }
+
+protected:
+  int_type overflow(int_type) override { return traits_type::eof(); }
+
+private:
+  char buffer_[RDMA_LOG_MAX_LINE];
+};
+
+} // namespace
+
+struct RdmaLogLineStream {
+  LineBuffer buffer;
+  std::ostream stream{&buffer};
+  std::ios_base::fmtflags flags = stream.flags();
+};
+
+namespace {
+
+// 每层嵌套一个缓冲；depth 为当前线程正在格式化的日志条数
+constexpr size_t kLineNesting = 4;
+
+struct LineStreams {
+  RdmaLogLineStream lines[kLineNesting];
+  size_t depth = 0;
+};
+
+thread_local LineStreams t_lines;
+
+// 多生产者单消费者的有界环（每槽带序号，生产者用 CAS 抢占写位置）
+struct LogSlot {
+  std::atomic<uint64_t> seq;
+  RdmaLogLevel level;
+  uint16_t length;
+  char text[RDMA_LOG_MAX_LINE];
+};
+
+class LogState {
+public:
+  LogState() {
+    for (size_t i = 0; i < RDMA_LOG_RING_SLOTS; ++i) {
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  void write(RdmaLogLevel level, const char *text, size_t length) {
+    if (!async_.load(std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> lock(sink_mutex_);
+      emit(level, std::string_view(text, length));
+      return;
+    }
+    ensure_thread();
+    if (!enqueue(level, text, length)) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    // 与消费者的 sleeping_ 写入构成 Dekker 式配对，避免漏唤醒；
+    // 消费者睡眠期间只有第一个生产者负责唤醒
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_relaxed) &&
+        sleeping_.exchange(false, std::memory_order_acq_rel)) {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+      wake_cv_.notify_one();
+    }
+  }
+
+  void flush() {
+    if (!started_.load(std::memory_order_acquire)) {
+      return;
+    }
+    const uint64_t target = head_.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    wake_cv_.notify_one();
+    flushed_cv_.wait(lock, [&]() {
+      return consumed_.load(std::memory_order_acquire) >= target ||
+             stopped_;
+    });
+  }
+
+  void set_async(bool async) {
+    if (!async) {
+      flush();
+    }
+    async_.store(async, std::memory_order_release);
+  }
+
+  void set_sink(RdmaLogger::Sink sink) {
+    std::lock_guard<std::mutex> lock(sink_mutex_);
+    sink_ = std::move(sink);
+  }
+
+  RdmaLogStats stats() const {
+    RdmaLogStats stats;
+    stats.written = written_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  // 进程退出时写完剩余日志，之后的日志同步输出
+  void shutdown() {
+    async_.store(false, std::memory_order_release);
+    {
+      std::lock_guard<std::mutex> lock(wake_mutex_);
+      stop_ = true;
+      wake_cv_.notify_one();
+    }
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+private:
+  LogSlot slots_[RDMA_LOG_RING_SLOTS];
+  alignas(64) std::atomic<uint64_t> head_{0}; // 下一个写位置
+  alignas(64) uint64_t tail_ = 0;             // 下一个读位置，只由消费者访问
+  std::atomic<uint64_t> consumed_{0};
+
+  std::atomic<bool> async_{true};
+  std::atomic<bool> started_{false};
+  std::atomic<bool> sleeping_{false};
+  std::once_flag start_once_;
+  std::thread thread_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+  std::condition_variable flushed_cv_;
+  bool stop_ = false;    // 受 wake_mutex_ 保护
+  bool stopped_ = false; // 受 wake_mutex_ 保护
+
+  std::mutex sink_mutex_;
+  RdmaLogger::Sink sink_;
+
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> dropped_{0};
+  uint64_t reported_dropped_ = 0; // 只由消费者访问
+
+  void ensure_thread() {
+    std::call_once(start_once_, [this]() {
+      thread_ = std::thread([this]() { run(); });
+      started_.store(true, std::memory_order_release);
+    });
+  }
+
+  bool enqueue(RdmaLogLevel level, const char *text, size_t length) {
+    uint64_t pos = head_.load(std::memory_order_relaxed);
+    LogSlot *slot;
+    for (;;) {
+      slot = &slots_[pos % RDMA_LOG_RING_SLOTS];
+      uint64_t seq = slot->seq.load(std::memory_order_acquire);
+      int64_t diff = static_cast<int64_t>(seq - pos);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false; // 环已满
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->level = level;
+    slot->length = static_cast<uint16_t>(std::min(length, RDMA_LOG_MAX_LINE));
+    memcpy(slot->text, text, slot->length);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // 取出所有已写好的槽，返回处理的条数
+  size_t drain() {
+    size_t count = 0;
+    std::lock_guard<std::mutex> lock(sink_mutex_);
+    for (;;) {
+      LogSlot &slot = slots_[tail_ % RDMA_LOG_RING_SLOTS];
+      if (slot.seq.load(std::memory_order_acquire) != tail_ + 1) {
+        break;
+      }
+      emit(slot.level, std::string_view(slot.text, slot.length));
+      slot.seq.store(tail_ + RDMA_LOG_RING_SLOTS, std::memory_order_release);
+      ++tail_;
+      ++count;
+    }
+    uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reported_dropped_) {
+      std::string note = "[WARN] " +
+                         std::to_string(dropped - reported_dropped_) +
+                         " log messages dropped (ring full)";
+      reported_dropped_ = dropped;
+      emit(RdmaLogLevel::WARN, note);
+    }
+    if (count > 0 && !sink_) {
+      fflush(stdout);
+    }
+    consumed_.store(tail_, std::memory_order_release);
+    return count;
+  }
+
+  void emit(RdmaLogLevel level, std::string_view text) {
+    if (sink_) {
+      sink_(level, text);
+    } else {
+      default_sink(level, text);
+    }
+    written_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void run() {
+    for (;;) {
+      if (drain() > 0) {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        flushed_cv_.notify_all();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(wake_mutex_);
+      flushed_cv_.notify_all();
+      if (stop_) {
+        break;
+      }
+      sleeping_.store(true, std::memory_order_seq_cst);
+      if (slots_[tail_ % RDMA_LOG_RING_SLOTS].seq.load(
+              std::memory_order_seq_cst) != tail_ + 1) {
+        wake_cv_.wait_for(lock, std::chrono::milliseconds(100));
+      }
+      sleeping_.store(false, std::memory_order_relaxed);
+    }
+    drain();
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    stopped_ = true;
+    flushed_cv_.notify_all();
+  }
+};
+
+// 有意不析构：静态对象析构期间仍可能写日志，退出时由 atexit 写完剩余日志
+LogState &state() {
+  static LogState *instance = []() {
+    LogState *s = new LogState();
+    std::atexit([]() { state().shutdown(); });
+    return s;
+  }();
+  return *instance;
+}
+
+} // namespace
+
+std::atomic<uint8_t> RdmaLogger::level_{kLevelUnset};
+
+uint8_t RdmaLogger::load_level() {
+  uint8_t expected = kLevelUnset;
+  const uint8_t level = env_level();
+  // 与 set_level 竞争时以已写入的值为准
+  if (level_.compare_exchange_strong(expected, level,
+                                     std::memory_order_relaxed)) {
+    return level;
+  }
+  return expected;
+}
+
+void RdmaLogger::set_level(RdmaLogLevel level) {
+  level_.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+RdmaLogLevel RdmaLogger::level() {
+  uint8_t current = level_.load(std::memory_order_relaxed);
+  if (current == kLevelUnset) {
+    current = load_level();
+  }
+  return static_cast<RdmaLogLevel>(current);
+}
+
+void RdmaLogger::set_async(bool async) { state().set_async(async); }
+
+void RdmaLogger::set_sink(Sink sink) { state().set_sink(std::move(sink)); }
+
+void RdmaLogger::flush() { state().flush(); }
+
+RdmaLogStats RdmaLogger::get_stats() { return state().stats(); }
+
+void RdmaLogger::write(RdmaLogLevel level, const char *text, size_t length) {
+  state().write(level, text, length);
+}
+
+RdmaLogLine::RdmaLogLine(RdmaLogLevel level, const char *file, int line)
+    : level_(level), owned_(t_lines.depth >= kLineNesting) {
+  line_ = owned_ ? new RdmaLogLineStream() : &t_lines.lines[t_lines.depth];
+  ++t_lines.depth;
+  line_->buffer.reset();
+  line_->stream.clear();
+  line_->stream.flags(line_->flags);
+  const char *base = strrchr(file, '/');
+  line_->stream << '[' << level_name(level) << "] "
+                << (base != nullptr ? base + 1 : file) << ':' << line << ' ';
+}
+
+RdmaLogLine::~RdmaLogLine() {
+  RdmaLogger::write(level_, line_->buffer.data(), line_->buffer.size());
+  --t_lines.depth;
+  if (owned_) {
+    delete line_;
+  }
+}
+
+std::ostream &RdmaLogLine::stream() { return line_->stream; }
@@ -1,20 +1,30 @@
 #include "../include/rdma_mr_cache.h"
 
 bool RdmaMRCache::get(uint32_t mr_handle, MRValue &info) {
+  RdmaCacheAccessTimer timer(counters_);
   auto it = cache_.find(mr_handle);
   if (it != cache_.end()) {
     info = it->second;
+    counters_.record_hit();
     return true;
   }
+  counters_.record_miss();
   return false;
 }
 
 void RdmaMRCache::set(uint32_t mr_handle, const MRValue &info) {
+  RdmaCacheAccessTimer timer(counters_);
+  auto existing = cache_.find(mr_handle);
+  if (existing != cache_.end()) {
+    existing->second = info;
+    counters_.record_write(sizeof(MRValue), sizeof(MRValue), sizeof(MRValue));
+    return;
+  }
   // 如果缓存已满，移除最旧的条目
-  if (cache_.size() >= cache_size_ && cache_.find(mr_handle) == cache_.end()) {
-    if (!cache_.empty()) {
-      cache_.erase(cache_.begin());
-    }
+  if (cache_.size() >= cache_size_ && !cache_.empty()) {
+    cache_.erase(cache_.begin());
+    counters_.record_evict(sizeof(MRValue));
   }
   cache_[mr_handle] = info;
+  counters_.record_insert(sizeof(MRValue));
 }
\ No newline at end of file
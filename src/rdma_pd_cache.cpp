@@ -1,20 +1,40 @@
 #include "../include/rdma_pd_cache.h"
 
+// 条目占用的字节数（含关联资源列表）
+static size_t entry_bytes(const PDValue &pd) {
+  size_t bytes = sizeof(PDValue);
+  for (const auto &entry : pd.resources) {
+    bytes += entry.first.size() + entry.second.size() * sizeof(uint32_t);
+  }
+  return bytes;
+}
+
 bool RdmaPDCache::get(uint32_t pd_handle, PDValue &info) {
+  RdmaCacheAccessTimer timer(counters_);
   auto it = cache_.find(pd_handle);
   if (it != cache_.end()) {
     info = it->second;
+    counters_.record_hit();
     return true;
   }
+  counters_.record_miss();
   return false;
 }
 
 void RdmaPDCache::set(uint32_t pd_handle, const PDValue &info) {
+  RdmaCacheAccessTimer timer(counters_);
+  const size_t bytes = entry_bytes(info);
+  auto existing = cache_.find(pd_handle);
+  if (existing != cache_.end()) {
+    counters_.record_write(bytes, bytes, entry_bytes(existing->second));
+    existing->second = info;
+    return;
+  }
   // 如果缓存已满，移除最旧的条目
-  if (cache_.size() >= cache_size_ && cache_.find(pd_handle) == cache_.end()) {
-    if (!cache_.empty()) {
-      cache_.erase(cache_.begin());
-    }
+  if (cache_.size() >= cache_size_ && !cache_.empty()) {
+    counters_.record_evict(entry_bytes(cache_.begin()->second));
+    cache_.erase(cache_.begin());
   }
   cache_[pd_handle] = info;
+  counters_.record_insert(bytes);
 }
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "../include/rdma_perf_counters.h"
+
+namespace {
+
+const char *const kCounterNames[] = {
+    "post_send",
+    "post_recv",
+    "post_errors",
+    "post_send_bytes",
+    "cqe",
+    "cqe_errors",
+    "poll_cq",
+    "poll_cq_empty",
+    "cqe_polled",
+    "qp_hit_device",
+    "qp_hit_cache",
+    "qp_hit_host",
+    "qp_miss",
+    "cq_hit_device",
+    "cq_hit_cache",
+    "cq_hit_host",
+    "cq_miss",
+    "qp_lock_contended",
+    "cq_lock_contended",
+    "tx_lock_contended",
+    "inflight_lock_contended"};
+static_assert(sizeof(kCounterNames) / sizeof(kCounterNames[0]) ==
+                  RDMA_COUNTER_COUNT,
+              "counter name table out of sync");
+
+} // namespace
+
+const char *rdma_counter_name(RdmaCounter counter) {
+  size_t index = static_cast<size_t>(counter);
+  return index < RDMA_COUNTER_COUNT ? kCounterNames[index] : "unknown";
+}
+
+double RdmaPerfSnapshot::tier_ratio(RdmaCounter tier) const {
+  RdmaCounter first;
+  if (tier >= RdmaCounter::QP_HIT_DEVICE && tier <= RdmaCounter::QP_MISS) {
+    first = RdmaCounter::QP_HIT_DEVICE;
+  } else if (tier >= RdmaCounter::CQ_HIT_DEVICE &&
+             tier <= RdmaCounter::CQ_MISS) {
+    first = RdmaCounter::CQ_HIT_DEVICE;
+  } else {
+    return 0.0;
+  }
+  uint64_t total = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    total += values[static_cast<size_t>(first) + i];
+  }
+  return total > 0 ? static_cast<double>((*this)[tier]) / total : 0.0;
+}
+
+std::string RdmaPerfSnapshot::to_string(bool skip_zero) const {
+  std::string out;
+  for (size_t i = 0; i < RDMA_COUNTER_COUNT; ++i) {
+    if (skip_zero && values[i] == 0) {
+      continue;
+    }
+    out += kCounterNames[i];
+    out += ": ";
+    out += std::to_string(values[i]);
+    out += '\n';
+  }
+  return out;
+}
+
+void RdmaPerfCounters::read(RdmaPerfSnapshot &snapshot) const {
+  snapshot.values.fill(0);
+  for (const Stripe &stripe : stripes_) {
+    for (size_t i = 0; i < RDMA_COUNTER_COUNT; ++i) {
+      snapshot.values[i] += stripe.values[i].load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void RdmaPerfCounters::reset() {
+  for (Stripe &stripe : stripes_) {
+    for (auto &value : stripe.values) {
+      value.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+size_t RdmaPerfCounters::stripe_index() {
+  static std::atomic<size_t> next{0};
+  thread_local size_t index =
+      next.fetch_add(1, std::memory_order_relaxed) % kStripes;
+  return index;
+}
@@ -4,28 +4,75 @@
 // 可选：用于多线程安全
 static std::mutex cache_mutex;
 
+// 条目占用的字节数（含尚未消费的接收WQE）
+static size_t entry_bytes(const QPValue &qp) {
+  return sizeof(QPValue) + qp.recv_queue.size() * sizeof(RecvWqe);
+}
+
 bool RdmaQPCache::get(uint32_t qp_num, QPValue &info) {
+  RdmaCacheAccessTimer timer(counters_);
   std::lock_guard<std::mutex> lock(cache_mutex);
 
   auto it = cache_.find(qp_num);
   if (it != cache_.end()) {
     info = it->second;
+    counters_.record_hit();
     return true;
   }
+  counters_.record_miss();
   return false;
 }
 
 void RdmaQPCache::set(uint32_t qp_num, const QPValue &info) {
+  RdmaCacheAccessTimer timer(counters_);
   std::lock_guard<std::mutex> lock(cache_mutex);
 
+  const size_t bytes = entry_bytes(info);
+  auto existing = cache_.find(qp_num);
+  if (existing != cache_.end()) {
+    // 覆盖已有条目（写回）不占新位置，不能挤掉其他QP
+    counters_.record_write(bytes, bytes, entry_bytes(existing->second));
+    existing->second = info;
+    return;
+  }
+
   // 如果超过大小，则简单地移除一个（更好的策略是 LRU）
   if (cache_.size() >= cache_size_) {
     // 简单策略：移除第一个
     auto it = cache_.begin();
     if (it != cache_.end()) {
+      counters_.record_evict(entry_bytes(it->second));
       cache_.erase(it);
     }
   }
 
   cache_[qp_num] = info;
+  counters_.record_insert(bytes);
+}
+
+bool RdmaQPCache::erase(uint32_t qp_num) {
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  auto it = cache_.find(qp_num);
+  if (it == cache_.end()) {
+    return false;
+  }
+  counters_.record_release(entry_bytes(it->second));
+  cache_.erase(it);
+  return true;
+}
+
+size_t RdmaQPCache::size() const {
+  std::lock_guard<std::mutex> lock(cache_mutex);
+  return cache_.size();
+}
+
+std::vector<uint32_t> RdmaQPCache::keys() const {
+  std::lock_guard<std::mutex> lock(cache_mutex);
+
+  std::vector<uint32_t> result;
+  result.reserve(cache_.size());
+  for (const auto &entry : cache_) {
+    result.push_back(entry.first);
+  }
+  return result;
 }
@@ -28,9 +28,7 @@ static uint64_t bench_loop(RdmaDevice &dev, uint32_t cq, uint32_t qp,
       break;
     }
     std::vector<CompletionEntry> comps;
-    while (!dev.poll_cq(cq, comps, 1)) {
-      std::this_thread::sleep_for(std::chrono::microseconds(10));
-    }
+    dev.wait_cq(cq, comps, 1);
   }
   auto t1 = Clock::now();
   return std::chrono::duration_cast<ns>(t1 - t0).count();
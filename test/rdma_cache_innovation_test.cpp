@@ -85,9 +85,7 @@ static uint64_t do_send_and_poll(RdmaDevice &dev, uint32_t cq, uint32_t qp,
   std::vector<CompletionEntry> comps;
   comps.reserve(batch);
   // 批量轮询：一次poll最多取batch个；单条时batch=1
-  while (!dev.poll_cq(cq, comps, batch)) {
-    std::this_thread::sleep_for(std::chrono::microseconds(1));
-  }
+  dev.wait_cq(cq, comps, batch);
   auto t1 = Clock::now();
   return std::chrono::duration_cast<ns>(t1 - t0).count();
 }
@@ -0,0 +1,330 @@
+#include "../include/rdma_cache_base.h"
+#include "../include/rdma_cq_cache.h"
+#include "../include/rdma_device.h"
+#include "../include/rdma_qp_cache.h"
+#include "../include/rdma_types.h"
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+// 以字符串长度为大小的缓存；compressed 时按一半大小存储
+class StringCache : public RdmaCacheBase<int, std::string> {
+public:
+  StringCache(size_t max_size, bool compressed)
+      : RdmaCacheBase(max_size), compressed_(compressed) {}
+
+protected:
+  size_t get_value_size(const std::string &value) const override {
+    return value.size();
+  }
+  size_t get_stored_size(const std::string &value) const override {
+    return compressed_ ? value.size() / 2 : value.size();
+  }
+
+private:
+  bool compressed_;
+};
+
+// 通用缓存模板：命中/未命中、写入/淘汰、字节数和压缩后大小
+bool test_base_cache_metrics() {
+  std::cout << "\nTesting RdmaCacheBase metrics..." << std::endl;
+
+  StringCache cache(300, true);
+  cache.put(1, std::string(100, 'a'));
+  cache.put(2, std::string(100, 'b'));
+  cache.put(1, std::string(100, 'c')); // 覆盖不驱逐
+  cache.put(3, std::string(100, 'd'));
+  cache.put(4, std::string(100, 'e')); // 驱逐最久未用的 2
+
+  std::string value;
+  TEST_ASSERT(cache.get(1, value) && value == std::string(100, 'c'),
+              "Overwritten value lost");
+  TEST_ASSERT(!cache.get(2, value), "Evicted key still present");
+
+  auto metrics = cache.get_metrics();
+  TEST_ASSERT(metrics.hit_rate.hits == 1 && metrics.hit_rate.misses == 1,
+              "Unexpected hit/miss counts");
+  TEST_ASSERT(metrics.churn.insertions == 4 && metrics.churn.evictions == 1,
+              "Unexpected insertions/evictions");
+  TEST_ASSERT(metrics.churn.bytes_written == 5 * 50 &&
+                  metrics.churn.bytes_evicted == 50,
+              "Unexpected byte counts");
+  TEST_ASSERT(metrics.memory_usage.original_size == 300 &&
+                  metrics.memory_usage.compressed_size == 150,
+              "compressed_size not maintained");
+  TEST_ASSERT(metrics.memory_usage.get_compression_ratio() == 0.5f,
+              "Unexpected compression ratio");
+  TEST_ASSERT(cache.get_stats().resident_bytes == 150,
+              "Unexpected resident bytes");
+
+  cache.remove(1);
+  TEST_ASSERT(cache.get_metrics().memory_usage.compressed_size == 100 &&
+                  cache.get_stats().resident_bytes == 100,
+              "remove did not release bytes");
+
+  // 单个值超过容量时驱逐全部后仍然写入，不会死循环
+  cache.put(5, std::string(500, 'f'));
+  TEST_ASSERT(cache.get_metrics().memory_usage.original_size == 500,
+              "Oversized put not stored");
+
+  cache.clear();
+  metrics = cache.get_metrics();
+  TEST_ASSERT(metrics.hit_rate.hits == 0 && metrics.churn.insertions == 0 &&
+                  metrics.memory_usage.compressed_size == 0 &&
+                  cache.get_stats().resident_bytes == 0,
+              "clear did not reset metrics");
+  return true;
+}
+
+// 访问延迟按线程每 kSampleInterval 次采样一次
+bool test_sampled_latency() {
+  std::cout << "\nTesting sampled access latency..." << std::endl;
+
+  StringCache cache(1 << 20, false);
+  cache.put(1, "value");
+  // 先对齐本线程的采样计数
+  std::string value;
+  while (cache.get_stats().latency_samples == 0) {
+    cache.get(1, value);
+  }
+  cache.clear();
+  cache.put(1, "value");
+
+  const int kGets = 64 * 1000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kGets; ++i) {
+    cache.get(i % 2, value);
+  }
+  double ns = std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - start)
+                  .count() /
+              kGets;
+
+  RdmaCacheStats stats = cache.get_stats();
+  std::cout << "  get: " << ns << " ns/次, 采样均值 "
+            << stats.average_access_ns() << " ns, 命中率 "
+            << stats.hit_ratio() << std::endl;
+  TEST_ASSERT(stats.latency_samples ==
+                  kGets / RdmaCacheCounters::kSampleInterval,
+              "samples=" + std::to_string(stats.latency_samples));
+  TEST_ASSERT(stats.latency_total_ns > 0, "No latency recorded");
+  TEST_ASSERT(stats.hits == kGets / 2 && stats.misses == kGets / 2,
+              "Unexpected hit/miss counts");
+  TEST_ASSERT(stats.hit_ratio() == 0.5, "Unexpected hit ratio");
+  return true;
+}
+
+// QP/CQ缓存：淘汰、覆盖、删除与完成的追加/取走都反映在字节数上
+bool test_concrete_caches() {
+  std::cout << "\nTesting QP/CQ cache counters..." << std::endl;
+
+  RdmaQPCache qp_cache(2);
+  QPValue qp;
+  for (uint32_t n = 1; n <= 3; ++n) {
+    qp.qp_num = n;
+    qp_cache.set(n, qp);
+  }
+  qp_cache.set(qp_cache.keys().front(), qp); // 覆盖不淘汰
+  RdmaCacheStats stats = qp_cache.get_stats();
+  TEST_ASSERT(stats.insertions == 3 && stats.evictions == 1,
+              "Unexpected QP insertions/evictions");
+  TEST_ASSERT(stats.resident_bytes == 2 * sizeof(QPValue) &&
+                  stats.bytes_evicted == sizeof(QPValue) &&
+                  stats.bytes_written == 4 * sizeof(QPValue),
+              "Unexpected QP byte counts");
+  for (uint32_t n : qp_cache.keys()) {
+    TEST_ASSERT(qp_cache.get(n, qp), "Cached QP missing");
+    TEST_ASSERT(qp_cache.erase(n), "erase failed");
+  }
+  TEST_ASSERT(qp_cache.size() == 0 && !qp_cache.get(1, qp),
+              "Erased QP still cached");
+  stats = qp_cache.get_stats();
+  TEST_ASSERT(stats.hits == 2 && stats.misses == 1,
+              "Unexpected QP hits/misses");
+  TEST_ASSERT(stats.resident_bytes == 0, "QP bytes not released");
+
+  RdmaCQCache cq_cache(4);
+  std::vector<CompletionEntry> comps(10);
+  cq_cache.batch_add_completions(7, comps);
+  cq_cache.batch_add_completions(7, comps);
+  stats = cq_cache.get_stats();
+  TEST_ASSERT(stats.insertions == 1 &&
+                  stats.resident_bytes ==
+                      sizeof(CQValue) + 20 * sizeof(CompletionEntry),
+              "Unexpected CQ bytes after append");
+  TEST_ASSERT(cq_cache.batch_get_completions(7, 15).size() == 15,
+              "batch_get_completions returned wrong count");
+  TEST_ASSERT(cq_cache.batch_get_completions(8, 15).empty(),
+              "Unknown CQ returned completions");
+  stats = cq_cache.get_stats();
+  TEST_ASSERT(stats.hits == 1 && stats.misses == 1,
+              "Unexpected CQ hits/misses");
+  TEST_ASSERT(stats.resident_bytes ==
+                  sizeof(CQValue) + 5 * sizeof(CompletionEntry),
+              "Consumed completions not released");
+  TEST_ASSERT(cq_cache.erase(7) && cq_cache.get_stats().resident_bytes == 0,
+              "CQ bytes not released on erase");
+
+  qp_cache.reset_stats();
+  TEST_ASSERT(qp_cache.get_stats().hits == 0, "reset_stats failed");
+  return true;
+}
+
+// 多线程并发读取：计数不丢失
+bool test_concurrent_counts() {
+  std::cout << "\nTesting concurrent counter updates..." << std::endl;
+
+  RdmaQPCache cache(16);
+  QPValue qp;
+  cache.set(1, qp);
+
+  const int kThreads = 8;
+  const int kGets = 10000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&cache, t]() {
+      QPValue out;
+      for (int i = 0; i < kGets; ++i) {
+        cache.get((t + i) % 2 == 0 ? 1 : 2, out);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  RdmaCacheStats stats = cache.get_stats();
+  TEST_ASSERT(stats.hits + stats.misses == kThreads * kGets,
+              "Lost counter updates");
+  TEST_ASSERT(stats.hits == kThreads * kGets / 2, "Unexpected hits");
+  return true;
+}
+
+// 设备：QP溢出到中间缓存后，缓存统计与分层命中比例可见
+bool test_device_cache_stats() {
+  std::cout << "\nTesting device middle cache stats..." << std::endl;
+
+  RdmaDevice::set_simulation_mode(true);
+  RdmaDevice dev(/*max_connections=*/16, /*max_qps=*/1);
+  uint32_t cq = dev.create_cq(64);
+  uint32_t qp_a = dev.create_qp(16, 16, cq, cq); // 设备表
+  uint32_t qp_b = dev.create_qp(16, 16, cq, cq); // 中间缓存
+  TEST_ASSERT(cq && qp_a && qp_b, "Failed to create resources");
+  QPValue info_a, info_b;
+  dev.get_qp_info(qp_a, info_a);
+  dev.get_qp_info(qp_b, info_b);
+  dev.connect_qp(qp_a, info_b);
+  dev.connect_qp(qp_b, info_a);
+  for (uint32_t qp : {qp_a, qp_b}) {
+    dev.modify_qp_state(qp, QpState::INIT);
+    dev.modify_qp_state(qp, QpState::RTR);
+    dev.modify_qp_state(qp, QpState::RTS);
+  }
+  dev.reset_perf_counters();
+
+  const int kMessages = 8;
+  std::vector<char> buf(64, 'x');
+  std::vector<CompletionEntry> comps;
+  for (int i = 0; i < kMessages; ++i) {
+    RdmaWorkRequest recv_wr;
+    recv_wr.opcode = RdmaOpcode::RECV;
+    recv_wr.local_addr = buf.data();
+    recv_wr.length = static_cast<uint32_t>(buf.size());
+    TEST_ASSERT(dev.post_recv(qp_b, recv_wr), "post_recv failed");
+    RdmaWorkRequest wr;
+    wr.opcode = RdmaOpcode::SEND;
+    wr.local_addr = buf.data();
+    wr.length = static_cast<uint32_t>(buf.size());
+    TEST_ASSERT(dev.post_send(qp_a, wr), "post_send failed");
+    size_t got = 0;
+    for (int spin = 0; spin < 2000 && got < 2; ++spin) {
+      comps.clear();
+      if (dev.poll_cq(cq, comps, 16)) {
+        got += comps.size();
+      } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    }
+    TEST_ASSERT(got == 2, "Missing completions");
+  }
+
+  MiddleCacheStats cache = dev.get_cache_stats();
+  RdmaPerfSnapshot perf = dev.get_perf_counters();
+  std::cout << "  qp缓存命中率 " << cache.qp.hit_ratio() << ", 设备层 "
+            << perf.tier_ratio(RdmaCounter::QP_HIT_DEVICE) << ", 中间缓存层 "
+            << perf.tier_ratio(RdmaCounter::QP_HIT_CACHE) << std::endl;
+  TEST_ASSERT(perf[RdmaCounter::QP_HIT_CACHE] > 0 &&
+                  cache.qp.hits >= perf[RdmaCounter::QP_HIT_CACHE],
+              "QP cache hits do not cover the tier counter");
+  TEST_ASSERT(cache.qp.resident_bytes > 0, "QP cache bytes not tracked");
+  double device = perf.tier_ratio(RdmaCounter::QP_HIT_DEVICE);
+  double cached = perf.tier_ratio(RdmaCounter::QP_HIT_CACHE);
+  TEST_ASSERT(device > 0 && cached > 0 && device + cached <= 1.0 + 1e-9 &&
+                  perf.tier_ratio(RdmaCounter::QP_HIT_HOST) == 0,
+              "Unexpected tier ratios");
+  TEST_ASSERT(perf.tier_ratio(RdmaCounter::POST_SEND) == 0,
+              "Non-tier counter has a ratio");
+
+  dev.reset_perf_counters();
+  TEST_ASSERT(dev.get_cache_stats().qp.hits == 0,
+              "reset_perf_counters did not reset cache stats");
+
+  // 空轮询设备上的CQ不访问中间缓存，不计未命中也不采样延迟
+  RdmaCacheStats before = dev.get_cache_stats().cq;
+  for (int i = 0; i < 1000; ++i) {
+    comps.clear();
+    TEST_ASSERT(!dev.poll_cq(cq, comps, 16), "Unexpected completion");
+  }
+  TEST_ASSERT(!dev.wait_cq(cq, comps, 16, 0), "Unexpected completion");
+  RdmaCacheStats after = dev.get_cache_stats().cq;
+  TEST_ASSERT(after.hits == before.hits && after.misses == before.misses &&
+                  after.latency_samples == before.latency_samples,
+              "Empty device CQ polls touched the CQ cache: misses " +
+                  std::to_string(before.misses) + " -> " +
+                  std::to_string(after.misses));
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA Cache Metrics Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Base Cache Metrics", test_base_cache_metrics},
+      {"Sampled Latency", test_sampled_latency},
+      {"Concrete Caches", test_concrete_caches},
+      {"Concurrent Counts", test_concurrent_counts},
+      {"Device Cache Stats", test_device_cache_stats}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
@@ -99,14 +99,11 @@ void device_a_thread() {
             << control_channel.get_peer_port() << std::endl;
 
   // 准备QP信息
+  // 从设备读取QP信息（qp_num、起始PSN、MTU），对端据此设置期望PSN
   QPValue qp_info;
-  qp_info.qp_num = qp_a;
+  device_a.get_qp_info(qp_a, qp_info);
   qp_info.lid = 1; // 模拟值
-  qp_info.port_num = 1;
   qp_info.qp_access_flags = 0x1; // 远程读写权限
-  qp_info.psn = 1000;            // 模拟值
-  qp_info.mtu = 1024;
-  qp_info.state = QpState::RESET;
 
   std::cout << "Device A: Sending connect request with QP=" << qp_a
             << std::endl;
@@ -311,14 +308,11 @@ void device_b_thread() {
             << ", QP=" << request.qp_info.qp_num << std::endl;
 
   // 准备QP信息
+  // 从设备读取QP信息（qp_num、起始PSN、MTU），对端据此设置期望PSN
   QPValue qp_info;
-  qp_info.qp_num = qp_b;
+  device_b.get_qp_info(qp_b, qp_info);
   qp_info.lid = 2; // 模拟值
-  qp_info.port_num = 1;
   qp_info.qp_access_flags = 0x1; // 远程读写权限
-  qp_info.psn = 2000;            // 模拟值
-  qp_info.mtu = 1024;
-  qp_info.state = QpState::RESET;
 
   // 发送连接响应
   std::cout << "Device B: Sending connect response with QP=" << qp_b
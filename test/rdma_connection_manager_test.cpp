@@ -0,0 +1,330 @@
+#include "../include/rdma_connection_manager.h"
+#include "../include/rdma_device.h"
+#include "rdma_test_util.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+using ConnId = RdmaConnectionManager::ConnId;
+
+static bool qp_in_state(RdmaDevice &device, uint32_t qp, QpState state) {
+  QPValue info;
+  return device.get_qp_info(qp, info) && info.state == state;
+}
+
+// 被动端：记录建立和断开的连接
+// （管理器最后声明、最先析构，回调不会访问已析构的成员）
+struct CmServer {
+  RdmaDevice device{4096, 4096};
+  uint32_t cq = 0;
+  std::mutex mutex;
+  std::vector<RdmaCmConnection> established;
+  std::vector<ConnId> disconnected;
+  RdmaConnectionManager cm{device};
+
+  bool start(bool valid_cq = true) {
+    cq = device.create_cq(4096);
+    RdmaCmParams params;
+    params.send_cq = valid_cq ? cq : 0;
+    params.recv_cq = params.send_cq;
+    params.max_send_wr = 16;
+    params.max_recv_wr = 16;
+    cm.set_disconnect_handler([this](ConnId id) {
+      std::lock_guard<std::mutex> lock(mutex);
+      disconnected.push_back(id);
+    });
+    return cq != 0 &&
+           cm.listen(0, params,
+                     [this](const RdmaCmConnection &conn) {
+                       std::lock_guard<std::mutex> lock(mutex);
+                       established.push_back(conn);
+                     },
+                     "127.0.0.1") &&
+           cm.start();
+  }
+
+  size_t established_count() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return established.size();
+  }
+};
+
+// 建连后两端QP都处于 RTS 并互为对端，数据可以直接收发；断开后对端QP进入 ERR
+bool test_connect_and_transfer() {
+  std::cout << "\nTesting asynchronous connect, transfer and disconnect..."
+            << std::endl;
+
+  CmServer server;
+  TEST_ASSERT(server.start(), server.cm.get_error());
+
+  RdmaDevice device;
+  uint32_t cq = device.create_cq(64);
+  std::vector<uint32_t> qps;
+  TEST_ASSERT(device.create_qp_batch(2, 16, 16, cq, cq, qps),
+              "Failed to create client QPs");
+  RdmaConnectionManager cm(device);
+  TEST_ASSERT(cm.start(), cm.get_error());
+
+  std::atomic<bool> callback_ok{false};
+  auto future = cm.connect("127.0.0.1", server.cm.listen_port(), qps,
+                           [&](const RdmaCmConnection &conn) {
+                             callback_ok = conn.ok;
+                           });
+  TEST_ASSERT(future.wait_for(std::chrono::seconds(5)) ==
+                  std::future_status::ready,
+              "Connect timed out");
+  RdmaCmConnection conn = future.get();
+  TEST_ASSERT(conn.ok, conn.error);
+  TEST_ASSERT(callback_ok, "Completion callback not called");
+  TEST_ASSERT(conn.local_qps == qps && conn.remote_qps.size() == 2,
+              "Unexpected connection result");
+  TEST_ASSERT(wait_until([&]() { return server.established_count() == 1; },
+                         5000),
+              "Server did not see the connection");
+  TEST_ASSERT(cm.connection_count() == 1 && cm.pending_count() == 0,
+              "Unexpected client connection count");
+
+  const RdmaCmConnection &accepted = server.established.front();
+  for (size_t i = 0; i < qps.size(); ++i) {
+    QPValue local;
+    TEST_ASSERT(device.get_qp_info(qps[i], local) &&
+                    local.state == QpState::RTS &&
+                    local.dest_qp_num == accepted.local_qps[i],
+                "Client QP not connected");
+    QPValue remote;
+    TEST_ASSERT(server.device.get_qp_info(accepted.local_qps[i], remote) &&
+                    remote.state == QpState::RTS &&
+                    remote.dest_qp_num == qps[i] &&
+                    conn.remote_qps[i].qp_num == accepted.local_qps[i],
+                "Server QP not connected");
+  }
+
+  // 第二对QP上发送一条消息
+  char recv_buf[64] = {};
+  RdmaWorkRequest recv_wr;
+  recv_wr.opcode = RdmaOpcode::RECV;
+  recv_wr.local_addr = recv_buf;
+  recv_wr.length = sizeof(recv_buf);
+  TEST_ASSERT(server.device.post_recv(accepted.local_qps[1], recv_wr),
+              "post_recv failed");
+  char message[] = "hello from rdma_cm";
+  RdmaWorkRequest send_wr;
+  send_wr.opcode = RdmaOpcode::SEND;
+  send_wr.local_addr = message;
+  send_wr.length = sizeof(message);
+  TEST_ASSERT(device.post_send(qps[1], send_wr), "post_send failed");
+  std::vector<CompletionEntry> completions;
+  TEST_ASSERT(wait_until(
+                  [&]() {
+                    return server.device.poll_cq(server.cq, completions, 1);
+                  },
+                  5000),
+              "No receive completion");
+  TEST_ASSERT(completions.front().status == WcStatus::SUCCESS &&
+                  strcmp(recv_buf, message) == 0,
+              "Unexpected received data");
+
+  // 主动端断开：本端QP进入 ERR，被动端收到断开通知
+  cm.disconnect(conn.id);
+  TEST_ASSERT(qp_in_state(device, qps[0], QpState::ERR),
+              "Client QP not moved to ERR");
+  TEST_ASSERT(wait_until(
+                  [&]() {
+                    std::lock_guard<std::mutex> lock(server.mutex);
+                    return server.disconnected.size() == 1;
+                  },
+                  5000),
+              "Server did not see the disconnect");
+  TEST_ASSERT(qp_in_state(server.device, accepted.local_qps[0], QpState::ERR),
+              "Server QP not moved to ERR");
+  TEST_ASSERT(server.cm.connection_count() == 0 &&
+                  server.cm.get_stats().disconnected == 1,
+              "Unexpected server state after disconnect");
+  return true;
+}
+
+// 被拒绝、连不上和参数无效时以失败结束，本端QP回到 RESET 可以重试
+bool test_reject_and_failure() {
+  std::cout << "\nTesting rejected and failed connects..." << std::endl;
+
+  // 被动端的CQ无效，创建QP失败后拒绝
+  CmServer broken;
+  TEST_ASSERT(broken.start(false), broken.cm.get_error());
+  CmServer good;
+  TEST_ASSERT(good.start(), good.cm.get_error());
+
+  RdmaDevice device;
+  uint32_t cq = device.create_cq(64);
+  std::vector<uint32_t> qps;
+  TEST_ASSERT(device.create_qp_batch(1, 16, 16, cq, cq, qps),
+              "Failed to create client QP");
+  RdmaConnectionManager cm(device);
+  TEST_ASSERT(cm.start(), cm.get_error());
+
+  RdmaCmConnection conn =
+      cm.connect("127.0.0.1", broken.cm.listen_port(), qps).get();
+  TEST_ASSERT(!conn.ok && conn.error.find("rejected") != std::string::npos,
+              "Expected rejection, got: " + conn.error);
+  TEST_ASSERT(qp_in_state(device, qps[0], QpState::RESET),
+              "QP not reset after rejection");
+  TEST_ASSERT(broken.cm.get_stats().rejected == 1, "Rejection not counted");
+
+  // 端口上没有监听者：借用一个已关闭的监听端口
+  uint16_t dead_port = 0;
+  {
+    RdmaDevice scratch;
+    RdmaConnectionManager closed(scratch);
+    TEST_ASSERT(closed.listen(0, RdmaCmParams(), nullptr, "127.0.0.1"),
+                closed.get_error());
+    dead_port = closed.listen_port();
+  }
+  conn = cm.connect("127.0.0.1", dead_port, qps).get();
+  TEST_ASSERT(!conn.ok, "Connect to closed port succeeded");
+  TEST_ASSERT(qp_in_state(device, qps[0], QpState::RESET),
+              "QP not reset after connect failure");
+
+  // 参数无效时立即失败
+  auto future = cm.connect("not-an-ip", good.cm.listen_port(), qps);
+  TEST_ASSERT(future.wait_for(std::chrono::seconds(0)) ==
+                      std::future_status::ready &&
+                  !future.get().ok,
+              "Invalid address accepted");
+  TEST_ASSERT(!cm.connect("127.0.0.1", good.cm.listen_port(), {}).get().ok,
+              "Empty QP list accepted");
+
+  // 同一组QP重试到正常的被动端
+  conn = cm.connect("127.0.0.1", good.cm.listen_port(), qps).get();
+  TEST_ASSERT(conn.ok, conn.error);
+  TEST_ASSERT(qp_in_state(device, qps[0], QpState::RTS), "QP not in RTS");
+  // 已连接的QP不能再次用于建连，且失败的建连不能拆掉这条已有连接
+  TEST_ASSERT(!cm.connect("127.0.0.1", good.cm.listen_port(), qps).get().ok,
+              "Connected QP reused");
+  TEST_ASSERT(qp_in_state(device, qps[0], QpState::RTS),
+              "Connected QP torn down by a failed connect");
+  // 列表中排在已连接QP之前的新QP要回滚到 RESET，已连接的QP不受影响
+  std::vector<uint32_t> fresh;
+  TEST_ASSERT(device.create_qp_batch(1, 16, 16, cq, cq, fresh),
+              "Failed to create client QP");
+  RdmaCmConnection mixed =
+      cm.connect("127.0.0.1", good.cm.listen_port(), {fresh[0], qps[0]})
+          .get();
+  TEST_ASSERT(!mixed.ok && mixed.error.find(std::to_string(qps[0])) !=
+                               std::string::npos,
+              "Mixed QP list accepted: " + mixed.error);
+  TEST_ASSERT(qp_in_state(device, fresh[0], QpState::RESET),
+              "New QP not rolled back");
+  TEST_ASSERT(qp_in_state(device, qps[0], QpState::RTS),
+              "Connected QP torn down by a mixed connect");
+  // 调用方自己移入 INIT 的QP同样被拒绝，且不会被回滚到 RESET
+  TEST_ASSERT(device.modify_qp_state(fresh[0], QpState::INIT),
+              "Failed to move QP to INIT");
+  TEST_ASSERT(!cm.connect("127.0.0.1", good.cm.listen_port(), fresh).get().ok,
+              "QP in INIT accepted");
+  TEST_ASSERT(qp_in_state(device, fresh[0], QpState::INIT),
+              "Caller's INIT QP rolled back");
+  TEST_ASSERT(cm.get_stats().failed == 7 && cm.get_stats().established == 1,
+              "Unexpected client stats");
+  return true;
+}
+
+// 一个主动端同时向被动端发起大量连接，全部由两个事件循环线程完成
+bool test_many_concurrent_connects() {
+  std::cout << "\nTesting many concurrent connects..." << std::endl;
+
+  const uint32_t kConns = 2000;
+  CmServer server;
+  TEST_ASSERT(server.start(), server.cm.get_error());
+
+  RdmaDevice device(4096, 4096);
+  uint32_t cq = device.create_cq(4096);
+  std::vector<uint32_t> qps;
+  TEST_ASSERT(device.create_qp_batch(kConns, 16, 16, cq, cq, qps),
+              "Failed to create client QPs");
+  RdmaConnectionManager cm(device);
+  TEST_ASSERT(cm.start(), cm.get_error());
+
+  std::atomic<uint32_t> done{0};
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::future<RdmaCmConnection>> futures;
+  futures.reserve(kConns);
+  for (uint32_t i = 0; i < kConns; ++i) {
+    futures.push_back(cm.connect("127.0.0.1", server.cm.listen_port(),
+                                 {qps[i]},
+                                 [&](const RdmaCmConnection &) { done++; }));
+  }
+  size_t ok = 0;
+  for (auto &future : futures) {
+    if (future.wait_for(std::chrono::seconds(30)) ==
+            std::future_status::ready &&
+        future.get().ok) {
+      ok++;
+    }
+  }
+  double ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  TEST_ASSERT(ok == kConns, "Only " + std::to_string(ok) + " of " +
+                                std::to_string(kConns) +
+                                " connects succeeded: " + cm.get_error());
+  TEST_ASSERT(done == kConns, "Completion callbacks missing");
+  TEST_ASSERT(wait_until(
+                  [&]() { return server.established_count() == kConns; },
+                  10000),
+              "Server did not see all connections");
+  TEST_ASSERT(cm.connection_count() == kConns &&
+                  server.cm.connection_count() == kConns,
+              "Unexpected connection counts");
+  for (uint32_t qp : qps) {
+    TEST_ASSERT(qp_in_state(device, qp, QpState::RTS), "QP not in RTS");
+  }
+  std::cout << "  " << kConns << " 个连接并发建立: " << ms << " ms（每连接 "
+            << ms * 1000 / kConns << " us）" << std::endl;
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA Connection Manager Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Connect And Transfer", test_connect_and_transfer},
+      {"Reject And Failure", test_reject_and_failure},
+      {"Many Concurrent Connects", test_many_concurrent_connects}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
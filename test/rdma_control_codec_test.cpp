@@ -0,0 +1,314 @@
+#include "../include/rdma_control_codec.h"
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+static QPValue make_qp(uint32_t n) {
+  QPValue qp;
+  qp.qp_num = n;
+  qp.dest_qp_num = n + 1;
+  qp.lid = static_cast<uint16_t>(n + 2);
+  qp.remote_lid = static_cast<uint16_t>(n + 3);
+  qp.port_num = 2;
+  qp.qp_access_flags = 0x7;
+  qp.psn = 0x123456;
+  qp.remote_psn = 0x654321;
+  qp.mtu = 2048;
+  qp.state = QpState::RTR;
+  for (size_t i = 0; i < qp.gid.size(); ++i) {
+    qp.gid[i] = static_cast<uint8_t>(i + n);
+    qp.remote_gid[i] = static_cast<uint8_t>(0xff - i);
+  }
+  return qp;
+}
+
+static bool same_qp(const QPValue &a, const QPValue &b) {
+  return a.qp_num == b.qp_num && a.dest_qp_num == b.dest_qp_num &&
+         a.lid == b.lid && a.remote_lid == b.remote_lid &&
+         a.port_num == b.port_num && a.qp_access_flags == b.qp_access_flags &&
+         a.psn == b.psn && a.remote_psn == b.remote_psn && a.mtu == b.mtu &&
+         a.state == b.state && a.gid == b.gid && a.remote_gid == b.remote_gid;
+}
+
+static uint32_t load_le32(const char *p) {
+  const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+  return u[0] | (u[1] << 8) | (u[2] << 16) |
+         (static_cast<uint32_t>(u[3]) << 24);
+}
+
+// 所有字段往返一致，固定头按小端布局
+bool test_round_trip_and_layout() {
+  std::cout << "\nTesting round trip and wire layout..." << std::endl;
+
+  RdmaControlMsg msg;
+  msg.type = RdmaControlMsgType::CONNECT_BATCH_RESPONSE;
+  msg.request_id = 0x01020304;
+  msg.accept = true;
+  msg.qp_info = make_qp(7);
+  msg.error_msg = "partial";
+  for (uint32_t i = 0; i < 5; ++i) {
+    msg.qp_batch.push_back(make_qp(100 + i));
+  }
+
+  std::string body = encode_control_msg(msg);
+  TEST_ASSERT(body.size() == control_msg_encoded_size(msg),
+              "Encoded size mismatch");
+  TEST_ASSERT(body.size() == sizeof(RdmaControlWireHeader) +
+                                 sizeof(RdmaControlWireTlv) * 2 + 7 +
+                                 5 * sizeof(RdmaControlWireQp),
+              "Unexpected encoded size");
+  // 魔数 "RC"、版本、类型、flags、小端请求编号、小端QP号
+  TEST_ASSERT(body[0] == 'R' && body[1] == 'C' &&
+                  body[2] == RDMA_CONTROL_WIRE_VERSION &&
+                  body[3] == static_cast<char>(msg.type) &&
+                  body[4] == RDMA_CONTROL_FLAG_ACCEPT,
+              "Unexpected header bytes");
+  TEST_ASSERT(load_le32(&body[8]) == 0x01020304,
+              "request_id not little endian");
+  TEST_ASSERT(load_le32(&body[12]) == body.size() - 80,
+              "Unexpected extension length");
+  TEST_ASSERT(load_le32(&body[16]) == 7, "qp_num not little endian");
+
+  RdmaControlMsg decoded;
+  std::string error;
+  TEST_ASSERT(decode_control_msg(body.data(), body.size(), decoded, error),
+              error);
+  TEST_ASSERT(decoded.type == msg.type &&
+                  decoded.request_id == msg.request_id && decoded.accept &&
+                  decoded.error_msg == msg.error_msg &&
+                  same_qp(decoded.qp_info, msg.qp_info) &&
+                  decoded.qp_batch.size() == msg.qp_batch.size(),
+              "Decoded message mismatch");
+  for (size_t i = 0; i < msg.qp_batch.size(); ++i) {
+    TEST_ASSERT(same_qp(decoded.qp_batch[i], msg.qp_batch[i]),
+                "Batch entry mismatch");
+  }
+
+  // 没有扩展的消息只有固定头
+  RdmaControlMsg ready;
+  ready.type = RdmaControlMsgType::READY;
+  TEST_ASSERT(encode_control_msg(ready).size() == sizeof(RdmaControlWireHeader),
+              "READY should be header only");
+  return true;
+}
+
+// 视图不拷贝变长部分；编码到预分配缓冲区，容量不足时不写入
+bool test_view_and_buffer() {
+  std::cout << "\nTesting zero-copy view and caller buffers..." << std::endl;
+
+  RdmaControlMsg msg;
+  msg.type = RdmaControlMsgType::ERROR;
+  msg.error_msg = "qp limit reached";
+  msg.qp_batch.push_back(make_qp(1));
+  msg.qp_batch.push_back(make_qp(2));
+
+  std::vector<char> buffer(control_msg_encoded_size(msg));
+  TEST_ASSERT(encode_control_msg(msg, buffer.data(), buffer.size() - 1) == 0,
+              "Short buffer accepted");
+  TEST_ASSERT(encode_control_msg(msg, buffer.data(), buffer.size()) ==
+                  buffer.size(),
+              "Encode into buffer failed");
+
+  RdmaControlMsgView view;
+  std::string error;
+  TEST_ASSERT(view.parse(buffer.data(), buffer.size(), error), error);
+  TEST_ASSERT(view.type() == RdmaControlMsgType::ERROR && !view.accept() &&
+                  view.version() == RDMA_CONTROL_WIRE_VERSION,
+              "Unexpected view header");
+  TEST_ASSERT(view.error_msg() == "qp limit reached", "Unexpected error text");
+  TEST_ASSERT(view.error_msg().data() > buffer.data() &&
+                  view.error_msg().data() < buffer.data() + buffer.size(),
+              "Error text should point into the receive buffer");
+  TEST_ASSERT(view.batch_size() == 2 && same_qp(view.batch_qp(1), make_qp(2)),
+              "Unexpected batch view");
+
+  // 帧 = 网络序长度前缀 + 消息体
+  std::string frame = "x";
+  TEST_ASSERT(append_control_frame(msg, frame), "append_control_frame failed");
+  TEST_ASSERT(frame.size() == 1 + 4 + buffer.size() &&
+                  memcmp(frame.data() + 5, buffer.data(), buffer.size()) == 0 &&
+                  static_cast<unsigned char>(frame[4]) == buffer.size(),
+              "Unexpected frame");
+  return true;
+}
+
+// 不认识的TLV被跳过；魔数、版本不符或越界的消息被拒绝
+bool test_extensions_and_errors() {
+  std::cout << "\nTesting unknown extensions and malformed input..."
+            << std::endl;
+
+  RdmaControlMsg msg;
+  msg.type = RdmaControlMsgType::CONNECT_REQUEST;
+  msg.qp_info = make_qp(9);
+  msg.error_msg = "e";
+  std::string body = encode_control_msg(msg);
+
+  // 在扩展区前插入一个未知类型的TLV，并相应增大扩展区长度
+  std::string unknown(sizeof(RdmaControlWireTlv) + 3, 'z');
+  unknown[0] = 0x34;
+  unknown[1] = 0x12;
+  unknown[2] = unknown[3] = 0;
+  unknown[4] = 3;
+  unknown[5] = unknown[6] = unknown[7] = 0;
+  std::string extended = body;
+  extended.insert(sizeof(RdmaControlWireHeader), unknown);
+  extended[12] = static_cast<char>(extended[12] + unknown.size());
+
+  RdmaControlMsg decoded;
+  std::string error;
+  TEST_ASSERT(decode_control_msg(extended.data(), extended.size(), decoded,
+                                 error),
+              error);
+  TEST_ASSERT(decoded.error_msg == "e" && same_qp(decoded.qp_info, msg.qp_info),
+              "Unknown TLV not skipped");
+
+  std::string bad = body;
+  bad[0] = 'X';
+  TEST_ASSERT(!decode_control_msg(bad.data(), bad.size(), decoded, error),
+              "Bad magic accepted");
+  bad = body;
+  bad[2] = RDMA_CONTROL_WIRE_VERSION + 1;
+  TEST_ASSERT(!decode_control_msg(bad.data(), bad.size(), decoded, error),
+              "Unknown version accepted");
+  TEST_ASSERT(!decode_control_msg(body.data(),
+                                  sizeof(RdmaControlWireHeader) - 1, decoded,
+                                  error),
+              "Truncated header accepted");
+  TEST_ASSERT(!decode_control_msg(body.data(), body.size() - 1, decoded, error),
+              "Truncated extension accepted");
+  // TLV声明的长度超出扩展区
+  bad = body;
+  bad[sizeof(RdmaControlWireHeader) + 4] = 100;
+  TEST_ASSERT(!decode_control_msg(bad.data(), bad.size(), decoded, error),
+              "Oversized TLV accepted");
+  return true;
+}
+
+// 批量上限与枚举取值范围在编解码层自身校验
+bool test_limits_and_ranges() {
+  std::cout << "\nTesting batch limit and enum ranges..." << std::endl;
+
+  RdmaControlMsg msg;
+  msg.type = RdmaControlMsgType::CONNECT_BATCH_REQUEST;
+  msg.qp_batch.assign(RDMA_CONTROL_MAX_BATCH + 1, make_qp(1));
+  std::vector<char> buffer(RDMA_CONTROL_MAX_FRAME * 2);
+  TEST_ASSERT(encode_control_msg(msg, buffer.data(), buffer.size()) == 0,
+              "Oversized batch encoded into buffer");
+  TEST_ASSERT(encode_control_msg(msg).empty(), "Oversized batch encoded");
+  std::string frames = "x";
+  TEST_ASSERT(!append_control_frame(msg, frames) && frames == "x",
+              "Oversized batch appended");
+  msg.qp_batch.pop_back();
+  TEST_ASSERT(append_control_frame(msg, frames), "Full batch rejected");
+
+  RdmaControlMsg decoded;
+  std::string error;
+  msg.qp_batch.assign(1, make_qp(7));
+  std::string body = encode_control_msg(msg);
+  std::string bad = body;
+  bad[offsetof(RdmaControlWireHeader, type)] =
+      static_cast<char>(RdmaControlMsgType::CONNECT_BATCH_RESPONSE) + 1;
+  TEST_ASSERT(!decode_control_msg(bad.data(), bad.size(), decoded, error),
+              "Unknown message type accepted");
+  bad = body;
+  bad[offsetof(RdmaControlWireHeader, qp) +
+      offsetof(RdmaControlWireQp, state)] =
+      static_cast<char>(QpState::ERR) + 1;
+  TEST_ASSERT(!decode_control_msg(bad.data(), bad.size(), decoded, error),
+              "Invalid QP state accepted");
+
+  // 用同一QP作为 qp_info 编码，找到批量区中对应的记录
+  RdmaControlMsg single;
+  single.qp_info = make_qp(7);
+  const std::string record =
+      encode_control_msg(single).substr(offsetof(RdmaControlWireHeader, qp),
+                                        sizeof(RdmaControlWireQp));
+  const size_t pos = body.find(record, sizeof(RdmaControlWireHeader));
+  TEST_ASSERT(pos != std::string::npos, "Batch record not found");
+  bad = body;
+  bad[pos + offsetof(RdmaControlWireQp, state)] =
+      static_cast<char>(QpState::ERR) + 1;
+  TEST_ASSERT(!decode_control_msg(bad.data(), bad.size(), decoded, error),
+              "Invalid batch QP state accepted");
+  TEST_ASSERT(decode_control_msg(body.data(), body.size(), decoded, error),
+              error);
+  return true;
+}
+
+// 编解码开销：重连风暴时每个对端都要走一遍
+bool test_cost() {
+  std::cout << "\nMeasuring encode/decode cost..." << std::endl;
+
+  const int kIters = 200000;
+  RdmaControlMsg msg;
+  msg.type = RdmaControlMsgType::CONNECT_REQUEST;
+  msg.qp_info = make_qp(3);
+  char buffer[256];
+  RdmaControlMsgView view;
+  std::string error;
+  uint64_t checksum = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIters; ++i) {
+    msg.request_id = i;
+    size_t n = encode_control_msg(msg, buffer, sizeof(buffer));
+    TEST_ASSERT(view.parse(buffer, n, error), error);
+    checksum += view.request_id() + view.qp_info().qp_num;
+  }
+  double ns = std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - start)
+                  .count() /
+              kIters;
+  TEST_ASSERT(checksum == static_cast<uint64_t>(kIters) * (kIters - 1) / 2 +
+                              static_cast<uint64_t>(kIters) * 3,
+              "Unexpected checksum");
+  std::cout << "  每条 CONNECT_REQUEST 编码+解析: " << ns << " ns"
+            << std::endl;
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA Control Codec Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Round Trip And Layout", test_round_trip_and_layout},
+      {"View And Buffer", test_view_and_buffer},
+      {"Extensions And Errors", test_extensions_and_errors},
+      {"Limits And Ranges", test_limits_and_ranges},
+      {"Cost", test_cost}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
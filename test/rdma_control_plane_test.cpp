@@ -0,0 +1,319 @@
+#include "../include/rdma_control_channel.h"
+#include "../include/rdma_control_plane.h"
+#include "rdma_test_util.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+using PeerId = RdmaControlPlane::PeerId;
+
+// 服务端：收到连接请求即回复连接响应（QP号加偏移），与集群建链时的交换一致
+static void serve_handshakes(RdmaControlPlane &server) {
+  RdmaControlPlane::Callbacks callbacks;
+  callbacks.on_message = [&server](PeerId peer, const RdmaControlMsg &msg) {
+    if (msg.type != RdmaControlMsgType::CONNECT_REQUEST) {
+      return;
+    }
+    RdmaControlMsg response;
+    response.type = RdmaControlMsgType::CONNECT_RESPONSE;
+    response.qp_info.qp_num = msg.qp_info.qp_num + 100000;
+    response.qp_info.dest_qp_num = msg.qp_info.qp_num;
+    response.accept = true;
+    server.send(peer, response);
+  };
+  server.set_callbacks(callbacks);
+}
+
+// 单个事件循环线程同时与上千个对端交换QP信息
+bool test_many_peers() {
+  std::cout << "\nTesting handshakes with many peers on one loop..."
+            << std::endl;
+
+  const uint32_t kPeers = 2000;
+  RdmaControlPlane server;
+  serve_handshakes(server);
+  TEST_ASSERT(server.listen(0, "127.0.0.1"), server.get_error());
+
+  RdmaControlPlane client;
+  std::mutex mutex;
+  std::unordered_map<PeerId, uint32_t> qp_of_peer;
+  std::atomic<uint32_t> responses{0};
+  std::atomic<uint32_t> mismatched{0};
+  std::atomic<uint32_t> failed{0};
+  RdmaControlPlane::Callbacks callbacks;
+  callbacks.on_connect = [&](PeerId peer, bool ok) {
+    if (!ok) {
+      failed++;
+    }
+    (void)peer;
+  };
+  callbacks.on_message = [&](PeerId peer, const RdmaControlMsg &msg) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = qp_of_peer.find(peer);
+    if (msg.type != RdmaControlMsgType::CONNECT_RESPONSE || !msg.accept ||
+        it == qp_of_peer.end() || msg.qp_info.dest_qp_num != it->second ||
+        msg.qp_info.qp_num != it->second + 100000) {
+      mismatched++;
+    }
+    responses++;
+  };
+  client.set_callbacks(callbacks);
+  TEST_ASSERT(server.start() && client.start(), "Failed to start loops");
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < kPeers; ++i) {
+    PeerId peer = client.connect("127.0.0.1", server.listen_port());
+    TEST_ASSERT(peer != 0, "connect failed");
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      qp_of_peer[peer] = i + 1;
+    }
+    // 连接建立前就可以发送，消息在建立后发出
+    RdmaControlMsg request;
+    request.type = RdmaControlMsgType::CONNECT_REQUEST;
+    request.qp_info.qp_num = i + 1;
+    TEST_ASSERT(client.send(peer, request), "send failed");
+  }
+  TEST_ASSERT(wait_until([&]() { return responses + failed >= kPeers; }, 30000),
+              "Handshakes did not finish");
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+
+  TEST_ASSERT(failed == 0 && mismatched == 0, "Handshake mismatch");
+  TEST_ASSERT(server.peer_count() == kPeers && client.peer_count() == kPeers,
+              "Unexpected peer count");
+  ControlPlaneStats s = server.get_stats();
+  ControlPlaneStats c = client.get_stats();
+  TEST_ASSERT(s.accepted == kPeers && c.connected == kPeers,
+              "Unexpected connection counts");
+  TEST_ASSERT(s.messages_rx == kPeers && c.messages_rx == kPeers,
+              "Unexpected message counts");
+  std::cout << "  对端数=" << kPeers << " 耗时(ms)=" << ms
+            << " 服务端事件循环唤醒=" << s.loop_wakeups
+            << " 客户端事件循环唤醒=" << c.loop_wakeups << std::endl;
+  client.stop();
+  server.stop();
+  return true;
+}
+
+// 与阻塞式 RdmaControlChannel 互通：帧格式相同
+bool test_channel_interop() {
+  std::cout << "\nTesting interop with RdmaControlChannel..." << std::endl;
+
+  RdmaControlPlane server;
+  serve_handshakes(server);
+  TEST_ASSERT(server.listen(0, "127.0.0.1"), server.get_error());
+  TEST_ASSERT(server.start(), "Failed to start loop");
+
+  RdmaControlChannel channel;
+  TEST_ASSERT(channel.connect_to_server("127.0.0.1", server.listen_port()),
+              channel.get_error());
+  QPValue qp;
+  qp.qp_num = 42;
+  TEST_ASSERT(channel.send_connect_request(qp), channel.get_error());
+  RdmaControlMsg msg;
+  TEST_ASSERT(channel.receive_message(msg, 5000), channel.get_error());
+  TEST_ASSERT(msg.type == RdmaControlMsgType::CONNECT_RESPONSE && msg.accept &&
+                  msg.qp_info.qp_num == 100042 && msg.qp_info.dest_qp_num == 42,
+              "Unexpected response");
+  server.stop();
+  return true;
+}
+
+// 通道一次 sendmsg 写出整帧、一次 recv 读入多条消息；大消息走 MSG_ZEROCOPY
+bool test_channel_batched_io() {
+  std::cout << "\nTesting channel scatter/gather and buffered reads..."
+            << std::endl;
+
+  const uint32_t kBurst = 50;
+  RdmaControlPlane server;
+  RdmaControlPlane::Callbacks callbacks;
+  // 接受连接后立即连发一批消息，客户端应能一次读入多条
+  callbacks.on_accept = [&server](PeerId peer) {
+    for (uint32_t i = 0; i < kBurst; ++i) {
+      RdmaControlMsg ready;
+      ready.type = RdmaControlMsgType::READY;
+      ready.request_id = i;
+      server.send(peer, ready);
+    }
+  };
+  callbacks.on_message = [&server](PeerId peer, const RdmaControlMsg &msg) {
+    RdmaControlMsg response = msg;
+    response.type = RdmaControlMsgType::CONNECT_BATCH_RESPONSE;
+    response.accept = true;
+    server.send(peer, response);
+  };
+  server.set_callbacks(callbacks);
+  TEST_ASSERT(server.listen(0, "127.0.0.1"), server.get_error());
+  TEST_ASSERT(server.start(), "Failed to start loop");
+
+  RdmaControlChannel channel;
+  TEST_ASSERT(channel.connect_to_server("127.0.0.1", server.listen_port()),
+              channel.get_error());
+  // 等对端的整批消息都到达后再读
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  for (uint32_t i = 0; i < kBurst; ++i) {
+    RdmaControlMsg msg;
+    TEST_ASSERT(channel.receive_message(msg, 5000), channel.get_error());
+    TEST_ASSERT(msg.type == RdmaControlMsgType::READY && msg.request_id == i,
+                "Burst out of order");
+  }
+  ControlChannelStats stats = channel.get_io_stats();
+  TEST_ASSERT(stats.messages_rx == kBurst && stats.recv_calls < kBurst / 10,
+              "Buffered reads should parse many messages per recv");
+
+  const uint32_t kRequests = 20;
+  for (uint32_t i = 0; i < kRequests; ++i) {
+    std::vector<QPValue> qps(4);
+    TEST_ASSERT(channel.send_connect_batch_request(qps), channel.get_error());
+  }
+  for (uint32_t i = 0; i < kRequests; ++i) {
+    RdmaControlMsg msg;
+    TEST_ASSERT(channel.receive_message(msg, 5000), channel.get_error());
+    TEST_ASSERT(msg.qp_batch.size() == 4, "Unexpected response");
+  }
+  stats = channel.get_io_stats();
+  TEST_ASSERT(stats.messages_tx == kRequests && stats.send_calls == kRequests,
+              "Each message should take exactly one sendmsg");
+  std::cout << "  收到消息=" << stats.messages_rx
+            << " recv调用=" << stats.recv_calls
+            << " 发出消息=" << stats.messages_tx
+            << " sendmsg调用=" << stats.send_calls << std::endl;
+
+  // 零拷贝：内核不支持时跳过
+  if (!channel.set_zerocopy_threshold(16 * 1024)) {
+    std::cout << "  跳过零拷贝: " << channel.get_error() << std::endl;
+    server.stop();
+    return true;
+  }
+  const uint32_t kLarge = 3;
+  for (uint32_t i = 0; i < kLarge; ++i) {
+    std::vector<QPValue> qps(RDMA_CONTROL_MAX_BATCH);
+    qps[0].qp_num = i + 1;
+    TEST_ASSERT(channel.send_connect_batch_request(qps), channel.get_error());
+    RdmaControlMsg msg;
+    TEST_ASSERT(channel.receive_message(msg, 5000), channel.get_error());
+    TEST_ASSERT(msg.qp_batch.size() == RDMA_CONTROL_MAX_BATCH &&
+                    msg.qp_batch[0].qp_num == i + 1,
+                "Unexpected zero-copy echo");
+  }
+  stats = channel.get_io_stats();
+  TEST_ASSERT(stats.zerocopy_sends == kLarge,
+              "Large sends should be zero-copy");
+  std::cout << "  零拷贝发送=" << stats.zerocopy_sends
+            << " 其中内核回退为拷贝=" << stats.zerocopy_copied << std::endl;
+  server.stop();
+  return true;
+}
+
+// 连接失败与对端关闭由回调报告；poll() 由调用方驱动
+bool test_failures_and_close() {
+  std::cout << "\nTesting connect failure and peer close..." << std::endl;
+
+  // 先占用一个端口再关闭，得到一个没有监听者的端口
+  uint16_t dead_port = 0;
+  {
+    RdmaControlPlane probe;
+    TEST_ASSERT(probe.listen(0, "127.0.0.1"), probe.get_error());
+    dead_port = probe.listen_port();
+  }
+
+  RdmaControlPlane server;
+  RdmaControlPlane client;
+  std::vector<std::pair<PeerId, bool>> connects;
+  std::vector<PeerId> server_closed;
+  std::vector<PeerId> accepted;
+  RdmaControlPlane::Callbacks client_cb;
+  client_cb.on_connect = [&](PeerId peer, bool ok) {
+    connects.emplace_back(peer, ok);
+  };
+  client.set_callbacks(client_cb);
+  RdmaControlPlane::Callbacks server_cb;
+  server_cb.on_accept = [&](PeerId peer) { accepted.push_back(peer); };
+  server_cb.on_close = [&](PeerId peer) { server_closed.push_back(peer); };
+  server.set_callbacks(server_cb);
+  TEST_ASSERT(server.listen(0, "127.0.0.1"), server.get_error());
+
+  TEST_ASSERT(client.connect("not-an-ip", 1) == 0, "Invalid address accepted");
+  PeerId bad = client.connect("127.0.0.1", dead_port);
+  PeerId good = client.connect("127.0.0.1", server.listen_port());
+  auto pump = [&]() {
+    client.poll(1);
+    server.poll(1);
+  };
+  TEST_ASSERT(wait_until(
+                  [&]() {
+                    pump();
+                    return connects.size() == 2 && accepted.size() == 1;
+                  },
+                  5000),
+              "Connect results not reported");
+  for (const auto &result : connects) {
+    TEST_ASSERT(result.second == (result.first == good),
+                "Unexpected connect result");
+  }
+  TEST_ASSERT(bad != good && client.peer_count() == 1,
+              "Failed peer should be removed");
+  TEST_ASSERT(client.get_stats().connect_failed == 1, "Missing failure count");
+
+  client.close(good);
+  TEST_ASSERT(wait_until(
+                  [&]() {
+                    pump();
+                    return server_closed.size() == 1;
+                  },
+                  5000),
+              "Peer close not reported");
+  TEST_ASSERT(server_closed[0] == accepted[0] && server.peer_count() == 0 &&
+                  client.peer_count() == 0,
+              "Closed peers should be removed");
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA Control Plane Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Many Peers", test_many_peers},
+      {"Channel Interop", test_channel_interop},
+      {"Channel Batched IO", test_channel_batched_io},
+      {"Failures And Close", test_failures_and_close}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,196 @@
+#include "../include/rdma_control_channel.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+static double elapsed_us(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// 服务端：对每个连接请求回复 qp_num+1000 的连接响应，收到 READY 后退出
+static void echo_server(RdmaControlChannel &server, std::atomic<bool> &ok) {
+  if (!server.accept_connection(5000)) {
+    return;
+  }
+  for (;;) {
+    RdmaControlMsg msg;
+    if (!server.receive_message(msg, 5000)) {
+      return;
+    }
+    if (msg.type == RdmaControlMsgType::READY) {
+      ok = true;
+      return;
+    }
+    RdmaControlMsg response;
+    response.type = RdmaControlMsgType::CONNECT_RESPONSE;
+    response.request_id = msg.request_id;
+    response.qp_info.qp_num = msg.qp_info.qp_num + 1000;
+    response.accept = true;
+    if (!server.send_message(response)) {
+      return;
+    }
+  }
+}
+
+// 同一组请求/响应在三种传输上往返，比较建连和往返耗时
+static bool run_ping_pong(ControlTransportType type, const std::string &address,
+                          const char *label) {
+  const uint32_t kRounds = 1000;
+  RdmaControlChannel server;
+  TEST_ASSERT(server.start_server(type, address), server.get_error());
+  std::string listen_address = server.get_listen_address();
+
+  std::atomic<bool> server_ok{false};
+  auto start = std::chrono::steady_clock::now();
+  std::thread server_thread(echo_server, std::ref(server),
+                            std::ref(server_ok));
+  RdmaControlChannel client;
+  bool connected = client.connect_to_server(type, listen_address);
+  double connect_us = elapsed_us(start);
+  if (!connected) {
+    server_thread.join();
+  }
+  TEST_ASSERT(connected, client.get_error());
+
+  start = std::chrono::steady_clock::now();
+  bool ok = true;
+  for (uint32_t i = 0; i < kRounds && ok; ++i) {
+    RdmaControlMsg request;
+    request.type = RdmaControlMsgType::CONNECT_REQUEST;
+    request.request_id = i;
+    request.qp_info.qp_num = i;
+    RdmaControlMsg response;
+    ok = client.send_message(request) &&
+         client.receive_message(response, 5000) && response.request_id == i &&
+         response.qp_info.qp_num == i + 1000;
+  }
+  double rtt_us = elapsed_us(start) / kRounds;
+  client.send_ready();
+  server_thread.join();
+  TEST_ASSERT(ok, std::string(label) + " round trip failed: " +
+                      client.get_error());
+  TEST_ASSERT(server_ok, std::string(label) + " server did not finish");
+  std::cout << "  " << label << ": 建连 " << connect_us << " us, 往返 "
+            << rtt_us << " us" << std::endl;
+  return true;
+}
+
+bool test_ping_pong_all_transports() {
+  std::cout << "\nTesting request/response over each transport..."
+            << std::endl;
+
+  const std::string pid = std::to_string(getpid());
+  TEST_ASSERT(run_ping_pong(ControlTransportType::TCP, "127.0.0.1:0", "TCP"),
+              "TCP failed");
+  const std::string path = "/tmp/rdma_control_" + pid + ".sock";
+  TEST_ASSERT(run_ping_pong(ControlTransportType::UNIX, path, "UNIX"),
+              "Unix socket failed");
+  TEST_ASSERT(access(path.c_str(), F_OK) != 0,
+              "Socket file should be removed on close");
+  TEST_ASSERT(run_ping_pong(ControlTransportType::UNIX, "@rdma_control_" + pid,
+                            "UNIX(抽象)"),
+              "Abstract unix socket failed");
+  TEST_ASSERT(run_ping_pong(ControlTransportType::INPROC, "ping-pong",
+                            "INPROC"),
+              "In-process transport failed");
+  return true;
+}
+
+// 进程内传输：写满字节环时发送方等待，接收方读走后继续；对端关闭可被检测
+bool test_inproc_backpressure_and_close() {
+  std::cout << "\nTesting in-process backpressure and close..." << std::endl;
+
+  // 每条约64KB，总量远超字节环容量
+  const uint32_t kMessages = 40;
+  RdmaControlChannel server;
+  TEST_ASSERT(server.start_server(ControlTransportType::INPROC, "bulk"),
+              server.get_error());
+  RdmaControlChannel duplicate;
+  TEST_ASSERT(!duplicate.start_server(ControlTransportType::INPROC, "bulk"),
+              "Duplicate in-process address accepted");
+  RdmaControlChannel stray;
+  TEST_ASSERT(!stray.connect_to_server(ControlTransportType::INPROC, "nobody"),
+              "Connect to missing listener succeeded");
+
+  std::atomic<uint32_t> received{0};
+  std::atomic<bool> saw_close{false};
+  std::thread server_thread([&]() {
+    if (!server.accept_connection(5000)) {
+      return;
+    }
+    RdmaControlMsg msg;
+    while (server.receive_message(msg, 5000)) {
+      if (msg.qp_batch.size() == RDMA_CONTROL_MAX_BATCH &&
+          msg.qp_batch.back().qp_num == received) {
+        received++;
+      }
+    }
+    saw_close = server.get_error().find("closed") != std::string::npos;
+  });
+
+  bool sent = true;
+  bool zerocopy_rejected = false;
+  {
+    // 客户端析构时关闭连接
+    RdmaControlChannel client;
+    sent = client.connect_to_server(ControlTransportType::INPROC, "bulk");
+    std::vector<QPValue> qps(RDMA_CONTROL_MAX_BATCH);
+    for (uint32_t i = 0; i < kMessages && sent; ++i) {
+      qps.back().qp_num = i;
+      sent = client.send_connect_batch_request(qps);
+    }
+    zerocopy_rejected = !client.set_zerocopy_threshold(4096);
+  }
+  server_thread.join();
+  TEST_ASSERT(sent, "In-process send failed");
+  TEST_ASSERT(zerocopy_rejected, "Zero-copy should be TCP only");
+  TEST_ASSERT(received == kMessages, "Lost messages under backpressure");
+  TEST_ASSERT(saw_close, "Peer close not detected");
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA Control Transport Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Ping Pong All Transports", test_ping_pong_all_transports},
+      {"Inproc Backpressure And Close", test_inproc_backpressure_and_close}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
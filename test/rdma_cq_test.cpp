@@ -0,0 +1,402 @@
+#include "../include/rdma_device.h"
+#include "../include/rdma_types.h"
+#include "rdma_test_util.h"
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <sys/epoll.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+// 发送端（A端）使用普通CQ，接收端（B端）CQ绑定到给定完成通道
+static PairConfig channel_config(uint32_t channel, uint32_t recv_cqe = 64) {
+  PairConfig config;
+  config.channel_b = channel;
+  config.cqe_b = recv_cqe;
+  return config;
+}
+
+// 投递一个接收WQE并发送一条小消息
+static bool send_message(RdmaDevice &dev, const QpPair &p, bool solicited,
+                         uint64_t wr_id = 1) {
+  static char recv_buf[64];
+  static char send_buf[16] = "ping";
+  RdmaWorkRequest recv_wr;
+  recv_wr.opcode = RdmaOpcode::RECV;
+  recv_wr.local_addr = recv_buf;
+  recv_wr.length = sizeof(recv_buf);
+  recv_wr.wr_id = wr_id;
+  if (!dev.post_recv(p.qp_b, recv_wr)) {
+    return false;
+  }
+
+  RdmaWorkRequest wr;
+  wr.opcode = RdmaOpcode::SEND;
+  wr.local_addr = send_buf;
+  wr.length = sizeof(send_buf);
+  wr.solicited = solicited;
+  wr.wr_id = wr_id;
+  return dev.post_send(p.qp_a, wr);
+}
+
+// 完成通道：武装后第一个完成触发一次事件，取出后需重新武装
+bool test_comp_channel() {
+  std::cout << "\nTesting completion channel..." << std::endl;
+
+  RdmaDevice dev;
+  uint32_t channel = dev.create_comp_channel();
+  TEST_ASSERT(channel != 0, "Failed to create completion channel");
+  TEST_ASSERT(dev.get_comp_channel_fd(channel) >= 0, "Channel has no fd");
+
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p, channel_config(channel)),
+              "Failed to set up QP pair");
+  TEST_ASSERT(!dev.req_notify_cq(p.cq_a, false),
+              "Arming a CQ without channel should fail");
+
+  uint32_t cq_num = 0;
+  TEST_ASSERT(dev.req_notify_cq(p.cq_b, false), "req_notify_cq failed");
+  TEST_ASSERT(!dev.get_cq_event(channel, cq_num, 0),
+              "No event expected before a completion");
+
+  TEST_ASSERT(send_message(dev, p, false), "send failed");
+  TEST_ASSERT(dev.get_cq_event(channel, cq_num, 1000), "No CQ event");
+  TEST_ASSERT(cq_num == p.cq_b, "Event for unexpected CQ");
+  std::vector<CompletionEntry> comps;
+  TEST_ASSERT(dev.poll_cq(p.cq_b, comps, 16), "Completion missing");
+
+  // 未重新武装时不再产生事件
+  TEST_ASSERT(send_message(dev, p, false, 2), "send failed");
+  TEST_ASSERT(!dev.get_cq_event(channel, cq_num, 0),
+              "Event without re-arming");
+
+  TEST_ASSERT(!dev.destroy_comp_channel(channel),
+              "Channel with attached CQ should not be destroyed");
+  dev.destroy_cq(p.cq_b);
+  TEST_ASSERT(dev.destroy_comp_channel(channel), "destroy channel failed");
+  return true;
+}
+
+// solicited-only：普通完成不触发，solicited 完成触发
+bool test_solicited_only() {
+  std::cout << "\nTesting solicited-only notification..." << std::endl;
+
+  RdmaDevice dev;
+  uint32_t channel = dev.create_comp_channel();
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p, channel_config(channel)),
+              "Failed to set up QP pair");
+
+  uint32_t cq_num = 0;
+  TEST_ASSERT(dev.req_notify_cq(p.cq_b, true), "req_notify_cq failed");
+  TEST_ASSERT(send_message(dev, p, false), "send failed");
+  TEST_ASSERT(!dev.get_cq_event(channel, cq_num, 0),
+              "Unsolicited completion should not notify");
+  TEST_ASSERT(send_message(dev, p, true, 2), "send failed");
+  TEST_ASSERT(dev.get_cq_event(channel, cq_num, 1000),
+              "Solicited completion should notify");
+  TEST_ASSERT(cq_num == p.cq_b, "Event for unexpected CQ");
+
+  std::vector<CompletionEntry> comps;
+  dev.poll_cq(p.cq_b, comps, 16);
+  TEST_ASSERT(comps.size() == 2, "Both completions should be queued");
+  return true;
+}
+
+// 多个完成通道加入同一个 epoll，只有产生完成的通道就绪
+bool test_epoll_channels() {
+  std::cout << "\nTesting epoll over completion channels..." << std::endl;
+
+  RdmaDevice dev;
+  const int kPairs = 4;
+  std::vector<uint32_t> channels;
+  std::vector<QpPair> pairs(kPairs);
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+  TEST_ASSERT(epfd >= 0, "epoll_create1 failed");
+  for (int i = 0; i < kPairs; ++i) {
+    channels.push_back(dev.create_comp_channel());
+    TEST_ASSERT(setup_pair(dev, pairs[i], channel_config(channels[i])),
+              "setup failed");
+    TEST_ASSERT(dev.req_notify_cq(pairs[i].cq_b, false), "arm failed");
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u32 = channels[i];
+    TEST_ASSERT(epoll_ctl(epfd, EPOLL_CTL_ADD,
+                          dev.get_comp_channel_fd(channels[i]), &ev) == 0,
+                "epoll_ctl failed");
+  }
+
+  epoll_event ready[kPairs];
+  TEST_ASSERT(epoll_wait(epfd, ready, kPairs, 0) == 0,
+              "No channel should be ready while idle");
+
+  TEST_ASSERT(send_message(dev, pairs[2], false), "send failed");
+  int n = epoll_wait(epfd, ready, kPairs, 1000);
+  TEST_ASSERT(n == 1 && ready[0].data.u32 == channels[2],
+              "Only the channel with a completion should be ready");
+
+  uint32_t cq_num = 0;
+  TEST_ASSERT(dev.get_cq_event(channels[2], cq_num, 0), "get_cq_event failed");
+  TEST_ASSERT(cq_num == pairs[2].cq_b, "Event for unexpected CQ");
+  TEST_ASSERT(epoll_wait(epfd, ready, kPairs, 0) == 0,
+              "Channel should not stay ready after the event is consumed");
+  close(epfd);
+  return true;
+}
+
+// 通知合并：按数量攒批，不足数量时由超时触发
+bool test_cq_moderation() {
+  std::cout << "\nTesting CQ moderation..." << std::endl;
+
+  RdmaDevice dev;
+  uint32_t channel = dev.create_comp_channel();
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p, channel_config(channel)),
+              "Failed to set up QP pair");
+
+  // 数量触发：第4个完成才产生事件
+  TEST_ASSERT(dev.modify_cq_moderation(p.cq_b, 4, 1000000),
+              "modify_cq_moderation failed");
+  TEST_ASSERT(dev.req_notify_cq(p.cq_b, false), "req_notify_cq failed");
+  uint32_t cq_num = 0;
+  for (uint64_t i = 1; i <= 3; ++i) {
+    TEST_ASSERT(send_message(dev, p, false, i), "send failed");
+  }
+  TEST_ASSERT(!dev.get_cq_event(channel, cq_num, 0),
+              "Event before cq_count completions");
+  TEST_ASSERT(send_message(dev, p, false, 4), "send failed");
+  TEST_ASSERT(dev.get_cq_event(channel, cq_num, 0),
+              "cq_count completions should notify");
+  std::vector<CompletionEntry> comps;
+  dev.poll_cq(p.cq_b, comps, 16);
+  TEST_ASSERT(comps.size() == 4, "All completions should be queued");
+
+  // 超时触发：只有1个完成时在 cq_period 之后产生事件
+  TEST_ASSERT(dev.modify_cq_moderation(p.cq_b, 16, 2000),
+              "modify_cq_moderation failed");
+  TEST_ASSERT(dev.req_notify_cq(p.cq_b, false), "req_notify_cq failed");
+  auto start = std::chrono::steady_clock::now();
+  TEST_ASSERT(send_message(dev, p, false, 5), "send failed");
+  TEST_ASSERT(!dev.get_cq_event(channel, cq_num, 0),
+              "Event before cq_period elapsed");
+  TEST_ASSERT(dev.get_cq_event(channel, cq_num, 1000),
+              "cq_period should notify");
+  auto waited = std::chrono::steady_clock::now() - start;
+  TEST_ASSERT(waited >= std::chrono::microseconds(2000),
+              "Event fired before cq_period");
+
+  CQValue info;
+  dev.get_cq_info(p.cq_b, info);
+  TEST_ASSERT(info.notify_events == 2, "Unexpected event count");
+  return true;
+}
+
+// 自适应合并：高完成速率下 cq_count 增大，低速率下回落到1
+bool test_adaptive_moderation() {
+  std::cout << "\nTesting adaptive CQ moderation..." << std::endl;
+
+  RdmaDevice dev;
+  uint32_t channel = dev.create_comp_channel();
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p, channel_config(channel, 1024)),
+              "Failed to set up QP pair");
+  TEST_ASSERT(dev.set_cq_adaptive_moderation(p.cq_b, 500),
+              "set_cq_adaptive_moderation failed");
+
+  // 事件驱动的消费者：武装 -> 等事件 -> 取走全部完成
+  uint32_t cq_num = 0;
+  std::vector<CompletionEntry> comps;
+  auto consume = [&]() {
+    if (!dev.get_cq_event(channel, cq_num, 1000)) {
+      return false;
+    }
+    comps.clear();
+    while (dev.poll_cq(p.cq_b, comps, 64)) {
+    }
+    return dev.req_notify_cq(p.cq_b, false);
+  };
+
+  TEST_ASSERT(dev.req_notify_cq(p.cq_b, false), "req_notify_cq failed");
+  for (int round = 0; round < 5; ++round) {
+    for (uint64_t i = 0; i < 8; ++i) {
+      TEST_ASSERT(send_message(dev, p, false, i), "send failed");
+    }
+    TEST_ASSERT(consume(), "No event under load");
+  }
+  CQValue info;
+  dev.get_cq_info(p.cq_b, info);
+  std::cout << "busy: cq_count=" << info.cq_count
+            << ", cq_period_us=" << info.cq_period_us << std::endl;
+  TEST_ASSERT(info.cq_count > 1, "cq_count should grow under load");
+  TEST_ASSERT(info.cq_period_us == 500, "cq_period should track target");
+
+  for (int round = 0; round < 5; ++round) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    TEST_ASSERT(send_message(dev, p, false, round), "send failed");
+    TEST_ASSERT(consume(), "No event when idle");
+  }
+  dev.get_cq_info(p.cq_b, info);
+  std::cout << "idle: cq_count=" << info.cq_count << std::endl;
+  TEST_ASSERT(info.cq_count == 1, "cq_count should fall back when idle");
+  return true;
+}
+
+// wait_cq：分别由忙轮询、yield 和阻塞阶段结束等待，空CQ上按时超时
+bool test_wait_cq() {
+  std::cout << "\nTesting hybrid wait_cq..." << std::endl;
+
+  RdmaDevice dev;
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p, channel_config(0)),
+              "Failed to set up QP pair");
+  std::vector<CompletionEntry> comps;
+
+  // 完成已就绪：第一次轮询即返回
+  TEST_ASSERT(send_message(dev, p, false, 1), "send failed");
+  TEST_ASSERT(dev.wait_cq(p.cq_b, comps, 16, 100), "wait_cq failed");
+  TEST_ASSERT(comps.size() == 1 && comps.front().wr_id == 1,
+              "Unexpected completion");
+  CqWaitStats stats = dev.get_cq_wait_stats();
+  TEST_ASSERT(stats.spin_completions == 1, "Spin phase should finish");
+
+  // 空CQ：不轮询直接阻塞，到期后超时
+  CqWaitPolicy block_only;
+  block_only.spin_ns = 0;
+  block_only.yield_ns = 0;
+  dev.set_cq_wait_policy(block_only);
+  auto start = std::chrono::steady_clock::now();
+  TEST_ASSERT(!dev.wait_cq(p.cq_b, comps, 16, 10), "Empty CQ should time out");
+  TEST_ASSERT(std::chrono::steady_clock::now() - start >=
+                  std::chrono::milliseconds(10),
+              "Timed out early");
+  TEST_ASSERT(dev.get_cq_wait_stats().timeouts == 1, "Timeout not counted");
+
+  // 阻塞阶段：由另一线程产生的完成唤醒
+  std::thread sender([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    send_message(dev, p, false, 2);
+  });
+  comps.clear();
+  bool got = dev.wait_cq(p.cq_b, comps, 16, -1);
+  sender.join();
+  TEST_ASSERT(got && comps.front().wr_id == 2, "Blocked waiter not woken");
+  TEST_ASSERT(dev.get_cq_wait_stats().block_completions == 1,
+              "Block phase should finish");
+
+  // yield 阶段：预算足够长时在阻塞之前取到
+  CqWaitPolicy yield_only;
+  yield_only.spin_ns = 0;
+  yield_only.yield_ns = 1000000000;
+  dev.set_cq_wait_policy(yield_only);
+  sender = std::thread([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    send_message(dev, p, false, 3);
+  });
+  comps.clear();
+  got = dev.wait_cq(p.cq_b, comps, 16, 1000);
+  sender.join();
+  TEST_ASSERT(got && comps.front().wr_id == 3, "Yield phase missed completion");
+
+  stats = dev.get_cq_wait_stats();
+  std::cout << "spin=" << stats.spin_completions
+            << ", yield=" << stats.yield_completions
+            << ", block=" << stats.block_completions
+            << ", timeouts=" << stats.timeouts << std::endl;
+  TEST_ASSERT(stats.yield_completions == 1, "Yield phase should finish");
+  return true;
+}
+
+// CQ溢出：超出深度的完成被丢弃，产生 CQ_ERR 事件并把关联QP置为 ERR
+bool test_cq_overflow() {
+  std::cout << "\nTesting CQ overflow..." << std::endl;
+
+  RdmaDevice dev;
+  TEST_ASSERT(dev.create_cq(0) == 0, "Zero-depth CQ should be rejected");
+  TEST_ASSERT(dev.get_async_fd() >= 0, "Device has no async event fd");
+
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p, channel_config(0, 4)),
+              "Failed to set up QP pair");
+  AsyncEvent event;
+  TEST_ASSERT(!dev.get_async_event(event, 0), "No async event expected");
+
+  for (uint64_t i = 1; i <= 4; ++i) {
+    TEST_ASSERT(send_message(dev, p, false, i), "send failed");
+  }
+  TEST_ASSERT(!dev.get_async_event(event, 0), "Full CQ is not an overflow");
+  TEST_ASSERT(send_message(dev, p, false, 5), "send failed");
+
+  TEST_ASSERT(dev.get_async_event(event, 1000), "No CQ_ERR event");
+  TEST_ASSERT(event.type == AsyncEventType::CQ_ERR &&
+                  event.element == p.cq_b,
+              "Unexpected CQ event");
+  TEST_ASSERT(dev.get_async_event(event, 1000), "No QP_FATAL event");
+  TEST_ASSERT(event.type == AsyncEventType::QP_FATAL &&
+                  event.element == p.qp_b,
+              "Unexpected QP event");
+  TEST_ASSERT(!dev.get_async_event(event, 0), "Unexpected extra event");
+
+  QPValue qp_info;
+  dev.get_qp_info(p.qp_b, qp_info);
+  TEST_ASSERT(qp_info.state == QpState::ERR, "QP should be in ERR");
+  dev.get_qp_info(p.qp_a, qp_info);
+  TEST_ASSERT(qp_info.state == QpState::RTS, "Unrelated QP should stay RTS");
+
+  CQValue cq_info;
+  dev.get_cq_info(p.cq_b, cq_info);
+  TEST_ASSERT(cq_info.overflowed && cq_info.dropped_completions == 1,
+              "Dropped completion not recorded");
+  std::vector<CompletionEntry> comps;
+  dev.poll_cq(p.cq_b, comps, 16);
+  TEST_ASSERT(comps.size() == 4, "CQ should hold exactly cqe completions");
+
+  // ERR 状态的QP不再接受接收WQE
+  TEST_ASSERT(!send_message(dev, p, false, 6), "QP in ERR accepted work");
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA CQ Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Completion Channel", test_comp_channel},
+      {"Solicited Only", test_solicited_only},
+      {"Epoll Channels", test_epoll_channels},
+      {"CQ Moderation", test_cq_moderation},
+      {"Adaptive Moderation", test_adaptive_moderation},
+      {"Wait CQ", test_wait_cq},
+      {"CQ Overflow", test_cq_overflow}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,321 @@
+#include "../include/rdma_device.h"
+#include "../include/rdma_types.h"
+#include "rdma_test_util.h"
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+static bool wait_completion(RdmaDevice &dev, uint32_t cq,
+                            std::vector<CompletionEntry> &out) {
+  for (int i = 0; i < 1000; ++i) {
+    if (dev.poll_cq(cq, out, 16)) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  return false;
+}
+
+// inline 发送：post 返回后源缓冲区可立即复用，接收方仍拿到原始数据
+bool test_inline_send() {
+  std::cout << "\nTesting inline send..." << std::endl;
+
+  RdmaDevice dev;
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p, 256), "Failed to set up QP pair");
+
+  std::vector<char> recv_buf(256, 0);
+  RdmaWorkRequest recv_wr;
+  recv_wr.opcode = RdmaOpcode::RECV;
+  recv_wr.local_addr = recv_buf.data();
+  recv_wr.length = static_cast<uint32_t>(recv_buf.size());
+  recv_wr.wr_id = 7;
+  TEST_ASSERT(dev.post_recv(p.qp_b, recv_wr), "post_recv failed");
+
+  std::string msg(200, 'x');
+  for (size_t i = 0; i < msg.size(); ++i) {
+    msg[i] = static_cast<char>('a' + i % 26);
+  }
+  std::string expected = msg;
+
+  RdmaWorkRequest wr;
+  wr.opcode = RdmaOpcode::SEND;
+  wr.local_addr = &msg[0];
+  wr.length = static_cast<uint32_t>(msg.size());
+  wr.send_inline = true;
+  wr.wr_id = 1;
+  TEST_ASSERT(dev.post_send(p.qp_a, wr), "inline post_send failed");
+
+  // 源缓冲区在 post 之后立即被覆盖
+  std::fill(msg.begin(), msg.end(), 'Z');
+
+  std::vector<CompletionEntry> comps;
+  TEST_ASSERT(wait_completion(dev, p.cq_b, comps), "No receive completion");
+  TEST_ASSERT(comps.front().length == expected.size(),
+              "Unexpected receive length");
+  TEST_ASSERT(std::memcmp(recv_buf.data(), expected.data(), expected.size()) ==
+                  0,
+              "Received data does not match inline payload");
+
+  // 超过QP inline阈值的请求必须被拒绝
+  std::string big(300, 'y');
+  wr.local_addr = &big[0];
+  wr.length = static_cast<uint32_t>(big.size());
+  TEST_ASSERT(!dev.post_send(p.qp_a, wr),
+              "Inline send above threshold should fail");
+
+  return true;
+}
+
+// 分散/聚合：头部和负载来自两个独立缓冲区，接收端按不同切分落到三个缓冲区
+bool test_scatter_gather() {
+  std::cout << "\nTesting scatter/gather lists..." << std::endl;
+
+  RdmaDevice dev;
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p, 0, 4), "Failed to set up QP pair");
+
+  std::string header = "HDR:0123";
+  std::string payload(100, 'p');
+  std::vector<char> r0(5), r1(50), r2(200);
+  uint32_t mr_r1 = dev.register_mr(r1.data(), r1.size(), 0x1);
+  TEST_ASSERT(mr_r1 != 0, "Failed to register receive buffer");
+
+  RdmaSge recv_sges[3] = {{r0.data(), static_cast<uint32_t>(r0.size()), 0},
+                          {r1.data(), static_cast<uint32_t>(r1.size()), mr_r1},
+                          {r2.data(), static_cast<uint32_t>(r2.size()), 0}};
+  RdmaWorkRequest recv_wr;
+  recv_wr.opcode = RdmaOpcode::RECV;
+  recv_wr.sg_list = recv_sges;
+  recv_wr.num_sge = 3;
+  recv_wr.wr_id = 11;
+  TEST_ASSERT(dev.post_recv(p.qp_b, recv_wr), "post_recv with SGEs failed");
+
+  RdmaSge send_sges[2] = {
+      {&header[0], static_cast<uint32_t>(header.size()), 0},
+      {&payload[0], static_cast<uint32_t>(payload.size()), 0}};
+  RdmaWorkRequest wr;
+  wr.opcode = RdmaOpcode::SEND;
+  wr.sg_list = send_sges;
+  wr.num_sge = 2;
+  wr.wr_id = 12;
+  TEST_ASSERT(dev.post_send(p.qp_a, wr), "post_send with SGEs failed");
+
+  std::vector<CompletionEntry> comps;
+  TEST_ASSERT(wait_completion(dev, p.cq_b, comps), "No receive completion");
+  TEST_ASSERT(comps.front().wr_id == 11, "Unexpected receive wr_id");
+  TEST_ASSERT(comps.front().status == WcStatus::SUCCESS,
+              "Receive completed with error");
+  TEST_ASSERT(comps.front().length == header.size() + payload.size(),
+              "Unexpected receive length");
+
+  std::string expected = header + payload;
+  std::string got(r0.begin(), r0.end());
+  got.append(r1.begin(), r1.end());
+  got.append(r2.begin(), r2.begin() + (expected.size() - got.size()));
+  TEST_ASSERT(got == expected, "Scattered data does not match");
+
+  // SGE数量超过 max_sge、或 lkey 与缓冲区不匹配时 post 必须失败
+  RdmaSge many[5] = {send_sges[0], send_sges[0], send_sges[0], send_sges[0],
+                     send_sges[0]};
+  wr.sg_list = many;
+  wr.num_sge = 5;
+  TEST_ASSERT(!dev.post_send(p.qp_a, wr), "num_sge above max_sge should fail");
+
+  RdmaSge bad{&payload[0], static_cast<uint32_t>(payload.size()), mr_r1};
+  wr.sg_list = &bad;
+  wr.num_sge = 1;
+  TEST_ASSERT(!dev.post_send(p.qp_a, wr), "Mismatched lkey should fail");
+
+  return true;
+}
+
+// MTU分段：10KB消息按1024字节切成10个包，PSN连续，接收端重组出完整数据
+bool test_mtu_segmentation() {
+  std::cout << "\nTesting MTU segmentation..." << std::endl;
+
+  RdmaDevice dev;
+  dev.set_link_bandwidth(100.0);
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p), "Failed to set up QP pair");
+
+  QPValue info_a;
+  TEST_ASSERT(dev.get_qp_info(p.qp_a, info_a), "get_qp_info failed");
+  TEST_ASSERT(info_a.mtu == 1024, "Unexpected path MTU");
+  const uint32_t first_psn = info_a.sq_psn;
+
+  std::vector<char> msg(10 * 1024);
+  for (size_t i = 0; i < msg.size(); ++i) {
+    msg[i] = static_cast<char>(i * 7);
+  }
+
+  // 先发送后投递接收：首包被 RNR NAK 拒绝，post_recv 之后由RNR重试交付
+  RdmaWorkRequest wr;
+  wr.opcode = RdmaOpcode::SEND;
+  wr.local_addr = msg.data();
+  wr.length = static_cast<uint32_t>(msg.size());
+  wr.wr_id = 21;
+  TEST_ASSERT(dev.post_send(p.qp_a, wr), "post_send failed");
+  for (int i = 0; i < 1000 && dev.get_transport_stats().rnr_naks == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  TEST_ASSERT(dev.get_transport_stats().rnr_naks >= 1, "Expected an RNR NAK");
+
+  std::vector<char> recv_buf(msg.size(), 0);
+  RdmaWorkRequest recv_wr;
+  recv_wr.opcode = RdmaOpcode::RECV;
+  recv_wr.local_addr = recv_buf.data();
+  recv_wr.length = static_cast<uint32_t>(recv_buf.size());
+  recv_wr.wr_id = 22;
+  TEST_ASSERT(dev.post_recv(p.qp_b, recv_wr), "post_recv failed");
+
+  std::vector<CompletionEntry> comps;
+  TEST_ASSERT(wait_completion(dev, p.cq_b, comps), "No receive completion");
+  TEST_ASSERT(comps.front().wr_id == 22, "Unexpected receive wr_id");
+  TEST_ASSERT(comps.front().length == msg.size(), "Unexpected receive length");
+  TEST_ASSERT(recv_buf == msg, "Reassembled data does not match");
+
+  // 先投递接收再发送：包直接分散到接收WQE
+  std::fill(recv_buf.begin(), recv_buf.end(), 0);
+  TEST_ASSERT(dev.post_recv(p.qp_b, recv_wr), "post_recv failed");
+  TEST_ASSERT(dev.post_send(p.qp_a, wr), "post_send failed");
+  comps.clear();
+  TEST_ASSERT(wait_completion(dev, p.cq_b, comps), "No receive completion");
+  TEST_ASSERT(recv_buf == msg, "Reassembled data does not match");
+
+  // 两条消息共20个包，发送端PSN前进20，接收端期望PSN与之对齐
+  QPValue info_b;
+  dev.get_qp_info(p.qp_a, info_a);
+  dev.get_qp_info(p.qp_b, info_b);
+  TEST_ASSERT(info_a.sq_psn == ((first_psn + 20) & RDMA_PSN_MASK),
+              "Send PSN did not advance per packet");
+  TEST_ASSERT(info_b.rq_psn == info_a.sq_psn, "Receive PSN out of step");
+
+  // 被 RNR 拒绝后已上线的包重新发送，接收端每个PSN只接受一次
+  TransportStats stats = dev.get_transport_stats();
+  const uint64_t tx_packets = 20 + stats.tx_retransmitted;
+  TEST_ASSERT(stats.tx_packets == tx_packets && stats.rx_packets == 20,
+              "Unexpected packet count");
+  TEST_ASSERT(stats.tx_retransmitted >= 1, "RNR retry did not retransmit");
+  TEST_ASSERT(stats.tx_bytes == tx_packets * 1024, "Unexpected byte count");
+  TEST_ASSERT(stats.rx_messages == 2, "Unexpected message count");
+  TEST_ASSERT(stats.rx_duplicate == 0, "Unexpected duplicate");
+  // 100Gbps 下每包 (1024+82)*8/100 ≈ 88ns
+  TEST_ASSERT(stats.wire_time_ns >= tx_packets * 88 &&
+                  stats.wire_time_ns <= tx_packets * 89,
+              "Unexpected wire time");
+
+  return true;
+}
+
+// 发送队列深度：未完成的发送达到 max_send_wr 后拒绝投递，完成或冲刷后恢复
+bool test_send_queue_depth() {
+  std::cout << "\nTesting send queue depth..." << std::endl;
+
+  RdmaDevice dev;
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p), "Failed to set up QP pair");
+
+  // 对端没有接收WQE：首条消息等待 RNR 重试，之后的消息在其后排队
+  std::vector<char> buf(64, 'q');
+  RdmaWorkRequest wr;
+  wr.opcode = RdmaOpcode::SEND;
+  wr.local_addr = buf.data();
+  wr.length = static_cast<uint32_t>(buf.size());
+  for (uint32_t i = 0; i < 16; ++i) {
+    wr.wr_id = i;
+    wr.signaled = i % 2 == 0; // 无信号的发送同样占用队列
+    TEST_ASSERT(dev.post_send(p.qp_a, wr),
+                "post_send " + std::to_string(i) + " failed");
+  }
+  const uint64_t errors = dev.get_perf_counters()[RdmaCounter::POST_ERRORS];
+  wr.signaled = true;
+  TEST_ASSERT(!dev.post_send(p.qp_a, wr), "Post beyond max_send_wr accepted");
+  TEST_ASSERT(dev.get_perf_counters()[RdmaCounter::POST_ERRORS] ==
+                  errors + 1,
+              "Full send queue not counted as a post error");
+
+  // 接收WQE到位后消息依次完成，队列重新可用
+  std::vector<char> recv_buf(64);
+  RdmaWorkRequest recv_wr;
+  recv_wr.opcode = RdmaOpcode::RECV;
+  recv_wr.local_addr = recv_buf.data();
+  recv_wr.length = static_cast<uint32_t>(recv_buf.size());
+  for (int i = 0; i < 16; ++i) {
+    TEST_ASSERT(dev.post_recv(p.qp_b, recv_wr), "post_recv failed");
+  }
+  std::vector<CompletionEntry> comps;
+  for (int i = 0; i < 1000 && comps.size() < 8; ++i) {
+    wait_completion(dev, p.cq_a, comps);
+  }
+  TEST_ASSERT(comps.size() == 8, "Expected 8 signaled send completions");
+  TEST_ASSERT(dev.post_recv(p.qp_b, recv_wr), "post_recv failed");
+  TEST_ASSERT(dev.post_send(p.qp_a, wr), "Send queue not released");
+
+  // 进入 ERR 时被冲刷的发送同样归还队列
+  comps.clear();
+  TEST_ASSERT(wait_completion(dev, p.cq_a, comps), "No send completion");
+  for (uint32_t i = 0; i < 16; ++i) {
+    TEST_ASSERT(dev.post_send(p.qp_a, wr), "post_send failed");
+  }
+  TEST_ASSERT(!dev.post_send(p.qp_a, wr), "Post beyond max_send_wr accepted");
+  TEST_ASSERT(dev.modify_qp_state(p.qp_a, QpState::ERR), "ERR failed");
+  comps.clear();
+  for (int i = 0; i < 1000 && comps.size() < 16; ++i) {
+    wait_completion(dev, p.cq_a, comps);
+  }
+  TEST_ASSERT(comps.size() == 16 &&
+                  comps.back().status == WcStatus::WR_FLUSH_ERR,
+              "Expected 16 flushed sends");
+  for (QpState state : {QpState::RESET, QpState::INIT, QpState::RTR,
+                        QpState::RTS}) {
+    TEST_ASSERT(dev.modify_qp_state(p.qp_a, state), "Re-arming QP failed");
+  }
+  TEST_ASSERT(dev.post_recv(p.qp_b, recv_wr), "post_recv failed");
+  TEST_ASSERT(dev.post_send(p.qp_a, wr), "Flushed sends not released");
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA Datapath Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Inline Send", test_inline_send},
+      {"Scatter Gather", test_scatter_gather},
+      {"MTU Segmentation", test_mtu_segmentation},
+      {"Send Queue Depth", test_send_queue_depth}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
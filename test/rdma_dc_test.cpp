@@ -0,0 +1,418 @@
+#include "../include/rdma_device.h"
+#include "../include/rdma_types.h"
+#include "rdma_test_util.h"
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+// DCI：没有固定对端，RTR 不需要路径和目的参数
+static bool bring_up_dci(RdmaDevice &dev, uint32_t qp) {
+  QpAttr attr;
+  attr.qp_state = QpState::INIT;
+  if (!dev.modify_qp(qp, attr,
+                     QP_ATTR_STATE | QP_ATTR_PKEY_INDEX | QP_ATTR_PORT)) {
+    return false;
+  }
+  attr.qp_state = QpState::RTR;
+  if (!dev.modify_qp(qp, attr, QP_ATTR_STATE)) {
+    return false;
+  }
+  attr.qp_state = QpState::RTS;
+  return dev.modify_qp(qp, attr,
+                       QP_ATTR_STATE | QP_ATTR_SQ_PSN | QP_ATTR_TIMEOUT |
+                           QP_ATTR_RETRY_CNT | QP_ATTR_RNR_RETRY |
+                           QP_ATTR_MAX_QP_RD_ATOMIC);
+}
+
+// DCT：只作为响应端，停留在 RTR
+static bool bring_up_dct(RdmaDevice &dev, uint32_t qp, uint32_t dc_key) {
+  QpAttr attr;
+  attr.qp_state = QpState::INIT;
+  attr.qp_access_flags = 0x7;
+  attr.qkey = dc_key;
+  if (!dev.modify_qp(qp, attr,
+                     QP_ATTR_STATE | QP_ATTR_PKEY_INDEX | QP_ATTR_PORT |
+                         QP_ATTR_ACCESS_FLAGS | QP_ATTR_QKEY)) {
+    return false;
+  }
+  attr.qp_state = QpState::RTR;
+  return dev.modify_qp(qp, attr, QP_ATTR_STATE | QP_ATTR_MIN_RNR_TIMER);
+}
+
+static uint32_t create_dci(RdmaDevice &dev, uint32_t cq) {
+  uint32_t qp = dev.create_qp(64, 1, cq, cq, 0, 1, QpType::DCI);
+  return qp != 0 && bring_up_dci(dev, qp) ? qp : 0;
+}
+
+static uint32_t create_dct(RdmaDevice &dev, uint32_t cq, uint32_t dc_key) {
+  uint32_t qp = dev.create_qp(1, 1024, cq, cq, 0, 1, QpType::DCT);
+  return qp != 0 && bring_up_dct(dev, qp, dc_key) ? qp : 0;
+}
+
+static RdmaWorkRequest dc_send(uint32_t ah, uint32_t dct, uint32_t dc_key,
+                               void *buf, uint32_t length, uint64_t wr_id) {
+  RdmaWorkRequest wr;
+  wr.opcode = RdmaOpcode::SEND;
+  wr.local_addr = buf;
+  wr.length = length;
+  wr.wr_id = wr_id;
+  wr.ah = ah;
+  wr.remote_qpn = dct;
+  wr.remote_qkey = dc_key;
+  return wr;
+}
+
+// DC 的建链属性：DCT 需要 DC 访问密钥且不能进入 RTS，DCI 不能 connect_qp
+bool test_dc_attributes() {
+  std::cout << "\nTesting DC attribute masks..." << std::endl;
+
+  RdmaDevice dev;
+  uint32_t cq = dev.create_cq(64);
+  uint32_t dct = dev.create_qp(1, 16, cq, cq, 0, 1, QpType::DCT);
+  QpAttr attr;
+  attr.qp_state = QpState::INIT;
+  TEST_ASSERT(!dev.modify_qp(dct, attr,
+                             QP_ATTR_STATE | QP_ATTR_PKEY_INDEX |
+                                 QP_ATTR_PORT | QP_ATTR_ACCESS_FLAGS),
+              "DCT RESET->INIT without DC key should fail");
+  TEST_ASSERT(bring_up_dct(dev, dct, 7), "DCT bring-up failed");
+  attr.qp_state = QpState::RTS;
+  TEST_ASSERT(!dev.modify_qp(dct, attr, QP_ATTR_STATE | QP_ATTR_SQ_PSN),
+              "DCT should stay in RTR");
+
+  uint32_t dci = create_dci(dev, cq);
+  TEST_ASSERT(dci != 0, "DCI bring-up failed");
+  QPValue info;
+  dev.get_qp_info(dct, info);
+  TEST_ASSERT(!dev.connect_qp(dci, info), "connect_qp on DCI should fail");
+
+  AhAttr ah_attr;
+  ah_attr.dlid = 1;
+  uint32_t ah = dev.create_ah(ah_attr);
+  char buf[64] = "dc";
+  TEST_ASSERT(!dev.post_send(dci, dc_send(0, dct, 7, buf, 8, 1)),
+              "DCI send without AH should fail");
+  TEST_ASSERT(!dev.post_send(dct, dc_send(ah, dci, 7, buf, 8, 1)),
+              "DCT cannot send");
+  return true;
+}
+
+// 两个DCI组成的池服务三个目标：按消息挂接，同一目标连续发送时不重新挂接
+bool test_dc_pool_fanout() {
+  std::cout << "\nTesting DCI pool fan-out..." << std::endl;
+
+  RdmaDevice initiator;
+  RdmaDevice target;
+  uint32_t send_cq = initiator.create_cq(256);
+  uint32_t recv_cq = target.create_cq(256);
+  std::vector<uint32_t> pool = {create_dci(initiator, send_cq),
+                                create_dci(initiator, send_cq)};
+  TEST_ASSERT(pool[0] != 0 && pool[1] != 0, "Failed to create DCIs");
+
+  const uint32_t keys[3] = {0x100, 0x200, 0x300};
+  uint32_t dcts[3];
+  std::vector<std::vector<char>> bufs(3, std::vector<char>(8 * 64, 0));
+  for (int t = 0; t < 3; ++t) {
+    dcts[t] = create_dct(target, recv_cq, keys[t]);
+    TEST_ASSERT(dcts[t] != 0, "Failed to create DCT");
+    for (int i = 0; i < 8; ++i) {
+      TEST_ASSERT(post_recv_buf(target, dcts[t], &bufs[t][i * 64], 64,
+                                t * 100 + i),
+                  "post_recv failed");
+    }
+  }
+  AhAttr ah_attr;
+  ah_attr.dlid = 2;
+  uint32_t ah = initiator.create_ah(ah_attr);
+
+  // 目标序列：0 0 1 2 2 0 1 1，每次切换目标都要挂接
+  const int order[8] = {0, 0, 1, 2, 2, 0, 1, 1};
+  char payload[8][32];
+  for (int i = 0; i < 8; ++i) {
+    int t = order[i];
+    snprintf(payload[i], sizeof(payload[i]), "to-%d-msg-%d", t, i);
+    uint32_t dci = initiator.post_send_dc(
+        pool, dc_send(ah, dcts[t], keys[t], payload[i], sizeof(payload[i]), i));
+    TEST_ASSERT(dci != 0, "post_send_dc failed");
+  }
+
+  std::vector<CompletionEntry> sends, recvs;
+  TEST_ASSERT(collect(initiator, send_cq, 8, sends), "Missing send completions");
+  TEST_ASSERT(collect(target, recv_cq, 8, recvs), "Missing recv completions");
+  int next_slot[3] = {0, 0, 0};
+  for (int i = 0; i < 8; ++i) {
+    int t = order[i];
+    const char *got = &bufs[t][next_slot[t]++ * 64];
+    TEST_ASSERT(std::strcmp(got, payload[i]) == 0,
+                "Payload mismatch at target " << t);
+  }
+  for (const CompletionEntry &c : recvs) {
+    TEST_ASSERT(c.status == WcStatus::SUCCESS, "Recv completion failed");
+    TEST_ASSERT(c.src_qp == pool[0] || c.src_qp == pool[1],
+                "Recv completion should carry the DCI number");
+  }
+
+  // DCI0 挂接 0，DCI1 挂接 1；之后 DCI0 在 0、2 之间切换两次
+  TransportStats stats = initiator.get_transport_stats();
+  std::cout << "dc_connects=" << stats.dc_connects
+            << " dc_disconnects=" << stats.dc_disconnects << std::endl;
+  TEST_ASSERT(stats.dc_connects == 4 && stats.dc_disconnects == 2,
+              "Unexpected connect/disconnect counts");
+
+  // DC 访问密钥不符的包被丢弃，同步路径上发送照常完成
+  TEST_ASSERT(post_recv_buf(target, dcts[0], bufs[0].data(), 64, 999),
+              "post_recv failed");
+  TEST_ASSERT(initiator.post_send_dc(
+                  pool, dc_send(ah, dcts[0], 0xBAD, payload[0], 8, 50)) != 0,
+              "post_send_dc failed");
+  TEST_ASSERT(target.get_transport_stats().rx_dropped == 1,
+              "Wrong DC key should be dropped");
+  return true;
+}
+
+// 链路路径：有未确认消息的DCI不能切换目标，确认后才能挂接新目标
+bool test_dc_switch_waits_for_acks() {
+  std::cout << "\nTesting DCI target switch on the timed link..." << std::endl;
+
+  RdmaDevice dev;
+  LinkConfig link;
+  link.bandwidth_gbps = 10;
+  // 链路事件按真实时间执行，往返时延取得足够长，确认不会先于第二次投递到达
+  link.propagation_delay_ns = 20000000;
+  dev.configure_link(link);
+  uint32_t cq = dev.create_cq(64);
+  uint32_t dci = create_dci(dev, cq);
+  uint32_t dct_a = create_dct(dev, cq, 1);
+  uint32_t dct_b = create_dct(dev, cq, 2);
+  AhAttr ah_attr;
+  ah_attr.dlid = 1;
+  uint32_t ah = dev.create_ah(ah_attr);
+  std::vector<char> buf(4096, 'd');
+  std::vector<char> rx(2 * 4096);
+  TEST_ASSERT(post_recv_buf(dev, dct_a, rx.data(), 4096, 10) &&
+                  post_recv_buf(dev, dct_b, rx.data() + 4096, 4096, 11),
+              "post_recv failed");
+
+  TEST_ASSERT(dev.post_send(dci, dc_send(ah, dct_a, 1, buf.data(), 4096, 1)),
+              "First send failed");
+  TEST_ASSERT(!dev.post_send(dci, dc_send(ah, dct_b, 2, buf.data(), 64, 2)),
+              "Switch with unacknowledged messages should fail");
+  TEST_ASSERT(!dev.post_send_dc({dci}, dc_send(ah, dct_b, 2, buf.data(), 64, 2)),
+              "Pool has no idle DCI for another target");
+
+  std::vector<CompletionEntry> comps;
+  TEST_ASSERT(collect(dev, cq, 2, comps), "Missing completions");
+  TEST_ASSERT(dev.post_send(dci, dc_send(ah, dct_b, 2, buf.data(), 64, 2)),
+              "Switch after acknowledgement should succeed");
+  comps.clear();
+  TEST_ASSERT(collect(dev, cq, 2, comps), "Missing completions");
+  TransportStats stats = dev.get_transport_stats();
+  TEST_ASSERT(stats.dc_connects == 2 && stats.dc_disconnects == 1,
+              "Unexpected connect/disconnect counts");
+  return true;
+}
+
+// 引擎模式：WR在提交环中尚未上线时同样占用DCI，单个DCI在两个目标间
+// 反复切换，每次切换被接受时之前的消息都已交付给旧目标
+bool test_dc_switch_with_engines() {
+  std::cout << "\nTesting DCI target switch with send engines..." << std::endl;
+
+  RdmaDevice initiator;
+  RdmaDevice target;
+  EngineConfig engines;
+  engines.num_engines = 1;
+  TEST_ASSERT(initiator.configure_engines(engines), "configure_engines failed");
+  uint32_t send_cq = initiator.create_cq(1024);
+  uint32_t recv_cq = target.create_cq(1024);
+  uint32_t dci = create_dci(initiator, send_cq);
+  uint32_t dcts[2] = {create_dct(target, recv_cq, 0xA),
+                      create_dct(target, recv_cq, 0xB)};
+  TEST_ASSERT(dci != 0 && dcts[0] != 0 && dcts[1] != 0,
+              "Failed to create DC QPs");
+  const int kRounds = 40;
+  const int kBurst = 8;
+  const int kMessages = kRounds * kBurst;
+  std::vector<char> rx(kMessages * 64);
+  for (int i = 0; i < kMessages; ++i) {
+    const int t = i / kBurst % 2;
+    TEST_ASSERT(post_recv_buf(target, dcts[t], &rx[i * 64], 64, i),
+                "post_recv failed");
+  }
+  AhAttr ah_attr;
+  ah_attr.dlid = 4;
+  uint32_t ah = initiator.create_ah(ah_attr);
+
+  char payload[64] = "engine-dc";
+  std::vector<CompletionEntry> sends, recvs;
+  int posted = 0;
+  for (int r = 0; r < kRounds; ++r) {
+    const int t = r % 2;
+    for (int k = 0; k < kBurst; ++k) {
+      RdmaWorkRequest wr =
+          dc_send(ah, dcts[t], 0xA + t, payload, sizeof(payload), posted);
+      auto deadline =
+          std::chrono::steady_clock::now() + std::chrono::seconds(10);
+      while (!initiator.post_send(dci, wr)) {
+        TEST_ASSERT(std::chrono::steady_clock::now() < deadline,
+                    "DCI never became idle");
+        initiator.poll_cq(send_cq, sends, 64);
+      }
+      if (k == 0 && r > 0) {
+        while (target.poll_cq(recv_cq, recvs, 64)) {
+        }
+        TEST_ASSERT(recvs.size() >= static_cast<size_t>(posted),
+                    "Switched target with earlier sends still queued");
+      }
+      ++posted;
+    }
+  }
+  TEST_ASSERT(collect(initiator, send_cq, kMessages, sends),
+              "Missing send completions");
+  TEST_ASSERT(collect(target, recv_cq, kMessages, recvs),
+              "Missing recv completions");
+  for (const CompletionEntry &c : recvs) {
+    TEST_ASSERT(c.status == WcStatus::SUCCESS, "Recv completion failed");
+  }
+  TransportStats stats = initiator.get_transport_stats();
+  TEST_ASSERT(stats.dc_connects == kRounds &&
+                  stats.dc_disconnects == kRounds - 1,
+              "Unexpected connect/disconnect counts");
+  return true;
+}
+
+// 丢包时DC与RC一样由重传恢复；多个DCI的多包消息交错到达同一个 DCT，
+// 每个DCI各自的连接上下文保证按序重组
+bool test_dc_reliability_under_loss() {
+  std::cout << "\nTesting DC under packet loss..." << std::endl;
+
+  RdmaDevice initiator;
+  RdmaDevice target;
+  LinkConfig link;
+  link.bandwidth_gbps = 25;
+  link.propagation_delay_ns = 1000;
+  link.loss_probability = 0.02;
+  initiator.configure_link(link);
+  link.loss_probability = 0;
+  target.configure_link(link);
+
+  uint32_t send_cq = initiator.create_cq(1024);
+  uint32_t recv_cq = target.create_cq(1024);
+  std::vector<uint32_t> pool;
+  for (int i = 0; i < 3; ++i) {
+    pool.push_back(create_dci(initiator, send_cq));
+    TEST_ASSERT(pool.back() != 0, "Failed to create DCI");
+  }
+  const int kTargets = 4;
+  const int kMessages = 80;
+  const uint32_t kLen = 3000; // 3 个包
+  uint32_t dcts[kTargets];
+  std::vector<char> rx(kMessages * kLen, 0);
+  for (int t = 0; t < kTargets; ++t) {
+    dcts[t] = create_dct(target, recv_cq, 0xD0 + t);
+    TEST_ASSERT(dcts[t] != 0, "Failed to create DCT");
+  }
+  // 每个 DCT 的接收WQE编号即缓冲区槽位
+  for (int i = 0; i < kMessages; ++i) {
+    TEST_ASSERT(post_recv_buf(target, dcts[i % kTargets], &rx[i * kLen], kLen,
+                              i),
+                "post_recv failed");
+  }
+  AhAttr ah_attr;
+  ah_attr.dlid = 3;
+  uint32_t ah = initiator.create_ah(ah_attr);
+
+  std::vector<std::vector<char>> payloads(kMessages, std::vector<char>(kLen));
+  std::vector<CompletionEntry> sends;
+  for (int i = 0; i < kMessages; ++i) {
+    std::memset(payloads[i].data(), 'A' + i % 26, kLen);
+    std::memcpy(payloads[i].data(), &i, sizeof(i));
+    const int t = i % kTargets;
+    RdmaWorkRequest wr =
+        dc_send(ah, dcts[t], 0xD0 + t, payloads[i].data(), kLen, i);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (initiator.post_send_dc(pool, wr) == 0) {
+      // 所有DCI都在等待其他目标的确认：回收完成后重试
+      TEST_ASSERT(std::chrono::steady_clock::now() < deadline,
+                  "No DCI became idle");
+      initiator.wait_cq(send_cq, sends, 16, 1);
+    }
+  }
+  TEST_ASSERT(collect(initiator, send_cq, kMessages, sends),
+              "Missing send completions");
+  std::vector<CompletionEntry> recvs;
+  TEST_ASSERT(collect(target, recv_cq, kMessages, recvs),
+              "Missing recv completions");
+
+  std::set<int> seen;
+  for (const CompletionEntry &c : recvs) {
+    TEST_ASSERT(c.status == WcStatus::SUCCESS && c.length == kLen,
+                "Recv completion failed");
+    const char *slot = &rx[c.wr_id * kLen];
+    int msg = -1;
+    std::memcpy(&msg, slot, sizeof(msg));
+    TEST_ASSERT(msg >= 0 && msg < kMessages && msg % kTargets ==
+                    static_cast<int>(c.wr_id) % kTargets,
+                "Message landed on the wrong target");
+    TEST_ASSERT(std::memcmp(slot, payloads[msg].data(), kLen) == 0,
+                "Payload corrupted for message " << msg);
+    TEST_ASSERT(seen.insert(msg).second, "Duplicate delivery of " << msg);
+  }
+  for (const CompletionEntry &c : sends) {
+    TEST_ASSERT(c.status == WcStatus::SUCCESS, "Send completion failed");
+  }
+  TransportStats stats = initiator.get_transport_stats();
+  std::cout << "lost=" << initiator.get_link_stats().lost_packets
+            << " retransmitted=" << stats.tx_retransmitted
+            << " dc_connects=" << stats.dc_connects << std::endl;
+  TEST_ASSERT(initiator.get_link_stats().lost_packets == 0 ||
+                  stats.tx_retransmitted > 0,
+              "Lost packets should be retransmitted");
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA DC Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"DC Attributes", test_dc_attributes},
+      {"DCI Pool Fan-out", test_dc_pool_fanout},
+      {"DCI Switch Waits For ACKs", test_dc_switch_waits_for_acks},
+      {"DCI Switch With Engines", test_dc_switch_with_engines},
+      {"DC Reliability Under Loss", test_dc_reliability_under_loss}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
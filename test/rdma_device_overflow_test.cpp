@@ -27,7 +27,12 @@ int main() {
     return 1;
   }
 
-  // 将QP切换到RTS（当前实现 validate_qp_transition 总是返回true）
+  // QP自环连接：发送的消息落到自己的接收队列
+  QPValue self_info;
+  dev.get_qp_info(qp, self_info);
+  dev.connect_qp(qp, self_info);
+
+  // 将QP切换到RTS
   dev.modify_qp_state(qp, QpState::INIT);
   dev.modify_qp_state(qp, QpState::RTR);
   dev.modify_qp_state(qp, QpState::RTS);
@@ -37,6 +42,18 @@ int main() {
   std::vector<char> buf(strlen(msg) + 1);
   std::memcpy(buf.data(), msg, buf.size());
 
+  // RC的SEND需要对端有接收WQE，否则请求端收到 RNR NAK 并一直重试
+  std::vector<char> first_recv(64, 0);
+  RdmaWorkRequest first_recv_wr;
+  first_recv_wr.opcode = RdmaOpcode::RECV;
+  first_recv_wr.local_addr = first_recv.data();
+  first_recv_wr.length = static_cast<uint32_t>(first_recv.size());
+  first_recv_wr.wr_id = 99;
+  if (!dev.post_recv(qp, first_recv_wr)) {
+    std::cerr << "post_recv 失败" << std::endl;
+    return 1;
+  }
+
   // 提交一个有信号的发送WR（将生成完成事件加入send_cq）
   RdmaWorkRequest wr;
   wr.opcode = RdmaOpcode::SEND;
@@ -0,0 +1,406 @@
+#include "../include/rdma_device.h"
+#include "../include/rdma_types.h"
+#include "rdma_test_util.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <sched.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+// 发送端设备与接收端设备之间的一组RC连接，每个QP各用一个CQ
+struct Pairs {
+  std::vector<uint32_t> send_cqs, recv_cqs;
+  std::vector<uint32_t> local, remote;
+};
+
+static bool setup_pairs(RdmaDevice &sender, RdmaDevice &receiver, size_t count,
+                        uint32_t depth, Pairs &p) {
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t send_cq = sender.create_cq(depth * 2);
+    uint32_t recv_cq = receiver.create_cq(depth * 2);
+    uint32_t a = sender.create_qp(depth, 1, send_cq, send_cq);
+    uint32_t b = receiver.create_qp(1, depth, recv_cq, recv_cq);
+    if (!send_cq || !recv_cq || !a || !b) {
+      return false;
+    }
+    QPValue qa, qb;
+    sender.get_qp_info(a, qa);
+    receiver.get_qp_info(b, qb);
+    if (!sender.connect_qp(a, qb) || !receiver.connect_qp(b, qa)) {
+      return false;
+    }
+    for (QpState s : {QpState::INIT, QpState::RTR, QpState::RTS}) {
+      if (!sender.modify_qp_state(a, s) || !receiver.modify_qp_state(b, s)) {
+        return false;
+      }
+    }
+    p.send_cqs.push_back(send_cq);
+    p.recv_cqs.push_back(recv_cq);
+    p.local.push_back(a);
+    p.remote.push_back(b);
+  }
+  return true;
+}
+
+static bool post(RdmaDevice &dev, uint32_t qp, RdmaOpcode opcode, void *buf,
+                 uint32_t length, uint64_t wr_id, void *remote = nullptr) {
+  RdmaWorkRequest wr;
+  wr.opcode = opcode;
+  wr.local_addr = buf;
+  wr.remote_addr = remote;
+  wr.length = length;
+  wr.wr_id = wr_id;
+  return dev.post_send(qp, wr);
+}
+
+// 多个应用线程并发投递到多个QP，QP散列到4个引擎：
+// 每个QP的发送完成与接收按投递顺序，载荷不错位
+bool test_engine_ordering() {
+  std::cout << "\nTesting per-QP ordering across engines..." << std::endl;
+
+  const size_t kQps = 8;
+  const size_t kThreads = 4;
+  const uint32_t kMsgs = 64;
+  RdmaDevice sender;
+  RdmaDevice receiver;
+  Pairs p;
+  TEST_ASSERT(setup_pairs(sender, receiver, kQps, kMsgs, p),
+              "Failed to set up QP pairs");
+  EngineConfig config;
+  config.num_engines = 4;
+  TEST_ASSERT(sender.configure_engines(config), "configure_engines failed");
+
+  std::vector<uint64_t> tx(kQps * kMsgs);
+  std::vector<uint64_t> rx(kQps * kMsgs, 0);
+  for (size_t q = 0; q < kQps; ++q) {
+    for (uint32_t m = 0; m < kMsgs; ++m) {
+      RdmaWorkRequest recv;
+      recv.opcode = RdmaOpcode::RECV;
+      recv.local_addr = &rx[q * kMsgs + m];
+      recv.length = sizeof(uint64_t);
+      recv.wr_id = m;
+      TEST_ASSERT(receiver.post_recv(p.remote[q], recv), "post_recv failed");
+    }
+  }
+
+  // 每个线程负责 kQps/kThreads 个QP，交替投递
+  std::atomic<uint32_t> failures{0};
+  std::vector<std::thread> producers;
+  for (size_t t = 0; t < kThreads; ++t) {
+    producers.emplace_back([&, t]() {
+      for (uint32_t m = 0; m < kMsgs; ++m) {
+        for (size_t q = t; q < kQps; q += kThreads) {
+          uint64_t &slot = tx[q * kMsgs + m];
+          slot = (static_cast<uint64_t>(q) << 32) | m;
+          if (!post(sender, p.local[q], RdmaOpcode::SEND, &slot, sizeof(slot),
+                    m)) {
+            failures++;
+          }
+        }
+      }
+    });
+  }
+  for (auto &producer : producers) {
+    producer.join();
+  }
+  TEST_ASSERT(failures == 0, "post_send failed");
+
+  for (size_t q = 0; q < kQps; ++q) {
+    std::vector<CompletionEntry> sends, recvs;
+    TEST_ASSERT(collect(sender, p.send_cqs[q], kMsgs, sends),
+                "Missing send completions");
+    TEST_ASSERT(collect(receiver, p.recv_cqs[q], kMsgs, recvs),
+                "Missing receive completions");
+    for (uint32_t m = 0; m < kMsgs; ++m) {
+      TEST_ASSERT(sends[m].wr_id == m && sends[m].status == WcStatus::SUCCESS,
+                  "Send completions out of order");
+      TEST_ASSERT(recvs[m].wr_id == m && recvs[m].status == WcStatus::SUCCESS,
+                  "Receive completions out of order");
+      TEST_ASSERT(rx[q * kMsgs + m] == ((static_cast<uint64_t>(q) << 32) | m),
+                  "Payload landed in the wrong buffer");
+    }
+  }
+
+  uint64_t processed = 0;
+  std::vector<EngineStats> stats = sender.get_engine_stats();
+  TEST_ASSERT(stats.size() == 4, "Unexpected engine count");
+  for (const EngineStats &s : stats) {
+    processed += s.messages;
+  }
+  TEST_ASSERT(processed == kQps * kMsgs, "Engines lost messages");
+  return true;
+}
+
+// 显式指定的引擎处理QP的全部消息；绑核失败的引擎照常运行
+bool test_explicit_assignment() {
+  std::cout << "\nTesting explicit QP-to-engine assignment..." << std::endl;
+
+  RdmaDevice sender;
+  RdmaDevice receiver;
+  Pairs p;
+  TEST_ASSERT(setup_pairs(sender, receiver, 4, 16, p),
+              "Failed to set up QP pairs");
+  EngineConfig config;
+  config.num_engines = 2;
+  const int cpu = sched_getcpu();
+  config.cpu_cores = {cpu, 1 << 20};
+  TEST_ASSERT(sender.configure_engines(config), "configure_engines failed");
+  std::vector<EngineStats> stats = sender.get_engine_stats();
+  TEST_ASSERT(stats[0].cpu == cpu, "Engine 0 should be pinned");
+  TEST_ASSERT(stats[1].cpu == -1, "Invalid core should leave engine unpinned");
+
+  for (uint32_t qp : p.local) {
+    TEST_ASSERT(sender.set_qp_engine(qp, 1), "set_qp_engine failed");
+  }
+  TEST_ASSERT(!sender.set_qp_engine(0xFFFFFF, 1), "Unknown QP should fail");
+  std::vector<char> src(256, 'w');
+  std::vector<char> dst(256 * p.local.size(), 0);
+  for (size_t q = 0; q < p.local.size(); ++q) {
+    for (uint32_t m = 0; m < 8; ++m) {
+      TEST_ASSERT(post(sender, p.local[q], RdmaOpcode::RDMA_WRITE, src.data(),
+                       256, m, &dst[q * 256]),
+                  "post_send failed");
+    }
+  }
+  for (size_t q = 0; q < p.local.size(); ++q) {
+    std::vector<CompletionEntry> sends;
+    TEST_ASSERT(collect(sender, p.send_cqs[q], 8, sends),
+                "Missing send completions");
+  }
+  stats = sender.get_engine_stats();
+  TEST_ASSERT(stats[0].messages == 0 && stats[1].messages == 32,
+              "Messages should all go to engine 1");
+  TEST_ASSERT(std::string(dst.begin(), dst.end()) ==
+                  std::string(dst.size(), 'w'),
+              "RDMA_WRITE payload missing");
+  return true;
+}
+
+// 门铃聚合：一次 post_send_list 只敲一次门铃，引擎按 burst 成批取回WQE；
+// 列表中无法投递的WR之前的WQE仍然生效
+bool test_doorbell_batching() {
+  std::cout << "\nTesting doorbell records and WQE burst fetch..." << std::endl;
+
+  RdmaDevice sender;
+  RdmaDevice receiver;
+  Pairs p;
+  TEST_ASSERT(setup_pairs(sender, receiver, 1, 64, p),
+              "Failed to set up QP pair");
+  EngineConfig config;
+  config.num_engines = 1;
+  config.wqe_prefetch_burst = 8;
+  TEST_ASSERT(sender.configure_engines(config), "configure_engines failed");
+
+  std::vector<char> src(64, 'b');
+  std::vector<char> dst(64, 0);
+  std::vector<RdmaWorkRequest> wrs(32);
+  for (uint32_t i = 0; i < wrs.size(); ++i) {
+    wrs[i].opcode = RdmaOpcode::RDMA_WRITE;
+    wrs[i].local_addr = src.data();
+    wrs[i].remote_addr = dst.data();
+    wrs[i].length = 64;
+    wrs[i].wr_id = i;
+  }
+  TEST_ASSERT(sender.post_send_list(p.local[0], wrs) == 32,
+              "post_send_list failed");
+  std::vector<CompletionEntry> sends;
+  TEST_ASSERT(collect(sender, p.send_cqs[0], 32, sends),
+              "Missing send completions");
+  for (uint32_t i = 0; i < 32; ++i) {
+    TEST_ASSERT(sends[i].wr_id == i, "Send completions out of order");
+  }
+  EngineStats stats = sender.get_engine_stats()[0];
+  TEST_ASSERT(stats.doorbells == 1 && stats.messages == 32,
+              "One doorbell should cover the whole list");
+  TEST_ASSERT(stats.bursts == 4, "WQEs should be fetched in bursts of 8");
+
+  // 逐条投递：每条WR一次门铃
+  for (uint32_t i = 0; i < 16; ++i) {
+    TEST_ASSERT(post(sender, p.local[0], RdmaOpcode::RDMA_WRITE, src.data(), 64,
+                     100 + i, dst.data()),
+                "post_send failed");
+  }
+  sends.clear();
+  TEST_ASSERT(collect(sender, p.send_cqs[0], 16, sends),
+              "Missing send completions");
+  stats = sender.get_engine_stats()[0];
+  TEST_ASSERT(stats.doorbells == 17 && stats.messages == 48,
+              "Each post_send should ring its own doorbell");
+
+  // 第3条WR要求 inline 但QP不支持：只投递前两条
+  wrs.resize(4);
+  wrs[2].send_inline = true;
+  TEST_ASSERT(sender.post_send_list(p.local[0], wrs) == 2,
+              "List should stop at the first bad WR");
+  sends.clear();
+  TEST_ASSERT(collect(sender, p.send_cqs[0], 2, sends),
+              "Missing send completions");
+  stats = sender.get_engine_stats()[0];
+  TEST_ASSERT(stats.doorbells == 18 && stats.messages == 50,
+              "Partial list should still ring one doorbell");
+  return true;
+}
+
+// 引擎线程上的 RNR：对端没有接收WQE时消息排队等待，接收WQE到达后按序送达
+bool test_engine_rnr() {
+  std::cout << "\nTesting RNR handling on an engine..." << std::endl;
+
+  RdmaDevice sender;
+  RdmaDevice receiver;
+  Pairs p;
+  TEST_ASSERT(setup_pairs(sender, receiver, 1, 16, p),
+              "Failed to set up QP pair");
+  EngineConfig config;
+  config.num_engines = 1;
+  TEST_ASSERT(sender.configure_engines(config), "configure_engines failed");
+
+  uint32_t values[3] = {10, 11, 12};
+  for (uint32_t i = 0; i < 3; ++i) {
+    TEST_ASSERT(post(sender, p.local[0], RdmaOpcode::SEND, &values[i],
+                     sizeof(uint32_t), i),
+                "post_send failed");
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  uint32_t rx[3] = {0, 0, 0};
+  for (uint32_t i = 0; i < 3; ++i) {
+    RdmaWorkRequest recv;
+    recv.opcode = RdmaOpcode::RECV;
+    recv.local_addr = &rx[i];
+    recv.length = sizeof(uint32_t);
+    recv.wr_id = i;
+    TEST_ASSERT(receiver.post_recv(p.remote[0], recv), "post_recv failed");
+  }
+
+  std::vector<CompletionEntry> sends, recvs;
+  TEST_ASSERT(collect(sender, p.send_cqs[0], 3, sends),
+              "Missing send completions");
+  TEST_ASSERT(collect(receiver, p.recv_cqs[0], 3, recvs),
+              "Missing receive completions");
+  for (uint32_t i = 0; i < 3; ++i) {
+    TEST_ASSERT(sends[i].wr_id == i && sends[i].status == WcStatus::SUCCESS,
+                "Send completions out of order");
+    TEST_ASSERT(recvs[i].wr_id == i && rx[i] == values[i],
+                "Messages delivered out of order");
+  }
+  TEST_ASSERT(sender.get_transport_stats().rnr_naks > 0,
+              "Receiver should have sent RNR NAKs");
+  return true;
+}
+
+// 重新配置：排空原有引擎后生效，0 个引擎时恢复同步投递；
+// 另输出同步投递与多引擎下的吞吐（单核机器上引擎不会更快）
+bool test_reconfigure_and_throughput() {
+  std::cout << "\nTesting engine reconfiguration and throughput..."
+            << std::endl;
+
+  const size_t kQps = 8;
+  const uint32_t kMsgs = 20000;
+  RdmaDevice sender;
+  RdmaDevice receiver;
+  Pairs p;
+  // 引擎模式下未回收的完成最多多出一个提交环，CQ深度大于环的槽数
+  TEST_ASSERT(setup_pairs(sender, receiver, kQps, 128, p),
+              "Failed to set up QP pairs");
+  std::vector<char> src(64, 's');
+  std::vector<char> dst(64 * kQps, 0);
+
+  for (uint32_t engines : {0u, 2u, 4u}) {
+    EngineConfig config;
+    config.num_engines = engines;
+    config.ring_entries = 64;
+    TEST_ASSERT(sender.configure_engines(config), "configure_engines failed");
+    TEST_ASSERT(sender.get_engine_stats().size() == engines,
+                "Unexpected engine count");
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    std::atomic<uint32_t> failures{0};
+    for (size_t q = 0; q < kQps; ++q) {
+      producers.emplace_back([&, q]() {
+        std::vector<CompletionEntry> comps;
+        uint32_t done = 0;
+        for (uint32_t m = 0; m < kMsgs; ++m) {
+          // 提交环或CQ满时回收完成后重试
+          while (!post(sender, p.local[q], RdmaOpcode::RDMA_WRITE, src.data(),
+                       64, m, &dst[q * 64])) {
+            comps.clear();
+            sender.poll_cq(p.send_cqs[q], comps, 64);
+            done += static_cast<uint32_t>(comps.size());
+            if (comps.empty()) {
+              std::this_thread::yield();
+            }
+          }
+          if ((m & 31) == 31) {
+            comps.clear();
+            sender.poll_cq(p.send_cqs[q], comps, 64);
+            done += static_cast<uint32_t>(comps.size());
+          }
+        }
+        comps.clear();
+        if (!collect(sender, p.send_cqs[q], kMsgs - done, comps)) {
+          failures++;
+        }
+      });
+    }
+    for (auto &producer : producers) {
+      producer.join();
+    }
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+    TEST_ASSERT(failures == 0, "Missing send completions");
+    std::cout << "  引擎数=" << engines << " 消息数=" << kQps * kMsgs
+              << " 吞吐(Mmsg/s)="
+              << static_cast<double>(kQps * kMsgs) / (us > 0 ? us : 1)
+              << std::endl;
+  }
+  TEST_ASSERT(!sender.configure_engines(EngineConfig{0, {}, 0, 0}),
+              "Zero ring entries should be rejected");
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA Engine Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Engine Ordering", test_engine_ordering},
+      {"Explicit Assignment", test_explicit_assignment},
+      {"Doorbell Batching", test_doorbell_batching},
+      {"Engine RNR", test_engine_rnr},
+      {"Reconfigure And Throughput", test_reconfigure_and_throughput}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,372 @@
+#include "../include/rdma_control_channel.h"
+#include "../include/rdma_control_plane.h"
+#include "../include/rdma_device.h"
+#include "rdma_test_util.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+using PeerId = RdmaControlPlane::PeerId;
+
+static const uint32_t kQps = 256;
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// 服务端：用预先创建的QP依次应答连接请求，单个请求和批量请求都支持
+struct HandshakeServer {
+  RdmaDevice device{1024, 1024};
+  std::vector<uint32_t> qps;
+  size_t next_qp = 0;                // 只由事件循环线程访问
+  std::atomic<uint64_t> requests{0}; // 收到的连接请求消息数
+  RdmaControlPlane plane;
+
+  bool init(uint32_t count) {
+    uint32_t cq = device.create_cq(1024);
+    return cq != 0 && device.create_qp_batch(count, 16, 16, cq, cq, qps);
+  }
+
+  // 把下一个本端QP连到 remote，返回本端QP信息
+  QPValue accept_one(const QPValue &remote) {
+    QPValue local;
+    uint32_t qp = qps[next_qp++];
+    device.connect_qp(qp, remote);
+    device.get_qp_info(qp, local);
+    return local;
+  }
+
+  void serve() {
+    RdmaControlPlane::Callbacks callbacks;
+    callbacks.on_message = [this](PeerId peer, const RdmaControlMsg &msg) {
+      RdmaControlMsg response;
+      response.request_id = msg.request_id;
+      response.accept = true;
+      if (msg.type == RdmaControlMsgType::CONNECT_REQUEST) {
+        response.type = RdmaControlMsgType::CONNECT_RESPONSE;
+        response.qp_info = accept_one(msg.qp_info);
+      } else if (msg.type == RdmaControlMsgType::CONNECT_BATCH_REQUEST) {
+        response.type = RdmaControlMsgType::CONNECT_BATCH_RESPONSE;
+        for (const QPValue &remote : msg.qp_batch) {
+          response.qp_batch.push_back(accept_one(remote));
+        }
+      } else {
+        return;
+      }
+      requests++;
+      plane.send(peer, response);
+    };
+    plane.set_callbacks(callbacks);
+  }
+};
+
+// 检查本端QP都连到了服务端对应的QP，且服务端也连了回来
+static bool check_connected(RdmaDevice &client, RdmaDevice &server,
+                            const std::vector<uint32_t> &local,
+                            const std::vector<QPValue> &remote) {
+  if (local.size() != remote.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < local.size(); ++i) {
+    QPValue mine;
+    QPValue theirs;
+    if (!client.get_qp_info(local[i], mine) ||
+        !server.get_qp_info(remote[i].qp_num, theirs) ||
+        mine.dest_qp_num != remote[i].qp_num ||
+        theirs.dest_qp_num != local[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// 逐个QP往返 vs 一条批量消息：256个QP从256个往返降到1个
+bool test_batch_vs_serial() {
+  std::cout << "\nTesting batched handshake against per-QP round trips..."
+            << std::endl;
+
+  HandshakeServer server;
+  TEST_ASSERT(server.init(kQps * 2), "Failed to create server QPs");
+  server.serve();
+  TEST_ASSERT(server.plane.listen(0, "127.0.0.1"), server.plane.get_error());
+  TEST_ASSERT(server.plane.start(), "Failed to start loop");
+
+  RdmaDevice device(1024, 1024);
+  uint32_t cq = device.create_cq(1024);
+  std::vector<uint32_t> serial_qps;
+  std::vector<uint32_t> batch_qps;
+  TEST_ASSERT(device.create_qp_batch(kQps, 16, 16, cq, cq, serial_qps) &&
+                  device.create_qp_batch(kQps, 16, 16, cq, cq, batch_qps),
+              "Failed to create client QPs");
+
+  RdmaControlChannel channel;
+  uint16_t port = server.plane.listen_port();
+  TEST_ASSERT(channel.connect_to_server("127.0.0.1", port), channel.get_error());
+
+  // 1. 每个QP一次请求/响应往返
+  auto start = std::chrono::steady_clock::now();
+  std::vector<QPValue> serial_remote;
+  for (uint32_t qp : serial_qps) {
+    QPValue info;
+    device.get_qp_info(qp, info);
+    TEST_ASSERT(channel.send_connect_request(info), channel.get_error());
+    RdmaControlMsg msg;
+    TEST_ASSERT(channel.receive_message(msg, 5000), channel.get_error());
+    TEST_ASSERT(msg.type == RdmaControlMsgType::CONNECT_RESPONSE && msg.accept,
+                "Unexpected response");
+    TEST_ASSERT(device.connect_qp(qp, msg.qp_info), "connect_qp failed");
+    serial_remote.push_back(msg.qp_info);
+  }
+  double serial_ms = elapsed_ms(start);
+  TEST_ASSERT(server.requests == kQps, "Expected one request per QP");
+
+  // 2. 一条批量请求携带全部QP描述
+  start = std::chrono::steady_clock::now();
+  std::vector<std::vector<QPValue>> batches(1);
+  for (uint32_t qp : batch_qps) {
+    QPValue info;
+    device.get_qp_info(qp, info);
+    batches[0].push_back(info);
+  }
+  std::vector<std::vector<QPValue>> remote;
+  TEST_ASSERT(channel.exchange_qp_batches(batches, remote, 1, 5000),
+              channel.get_error());
+  for (size_t i = 0; i < batch_qps.size(); ++i) {
+    TEST_ASSERT(device.connect_qp(batch_qps[i], remote[0][i]),
+                "connect_qp failed");
+  }
+  double batch_ms = elapsed_ms(start);
+  TEST_ASSERT(server.requests == kQps + 1, "Batch should be one request");
+
+  TEST_ASSERT(check_connected(device, server.device, serial_qps, serial_remote),
+              "Serial handshake connected wrong QPs");
+  TEST_ASSERT(check_connected(device, server.device, batch_qps, remote[0]),
+              "Batched handshake connected wrong QPs");
+  std::cout << "  QP数=" << kQps << " 逐个往返: " << kQps << "次 " << serial_ms
+            << "ms, 批量: 1次 " << batch_ms << "ms" << std::endl;
+  server.plane.stop();
+  return true;
+}
+
+// 流水线：多个批量请求同时在途，响应乱序返回时按请求编号匹配
+bool test_pipelined_out_of_order() {
+  std::cout << "\nTesting pipelined batch requests with reordered responses..."
+            << std::endl;
+
+  const uint32_t kBatches = 4;
+  RdmaControlPlane server;
+  std::mutex mutex;
+  std::vector<RdmaControlMsg> held;
+  RdmaControlPlane::Callbacks callbacks;
+  // 服务端攒齐全部请求后才逆序应答：客户端若等待每个响应再发下一个请求就会超时
+  callbacks.on_message = [&](PeerId peer, const RdmaControlMsg &msg) {
+    std::lock_guard<std::mutex> lock(mutex);
+    held.push_back(msg);
+    if (held.size() < kBatches) {
+      return;
+    }
+    for (auto it = held.rbegin(); it != held.rend(); ++it) {
+      RdmaControlMsg response;
+      response.type = RdmaControlMsgType::CONNECT_BATCH_RESPONSE;
+      response.request_id = it->request_id;
+      response.accept = true;
+      for (const QPValue &remote : it->qp_batch) {
+        QPValue local;
+        local.qp_num = remote.qp_num + 100000;
+        local.dest_qp_num = remote.qp_num;
+        response.qp_batch.push_back(local);
+      }
+      server.send(peer, response);
+    }
+  };
+  server.set_callbacks(callbacks);
+  TEST_ASSERT(server.listen(0, "127.0.0.1"), server.get_error());
+  TEST_ASSERT(server.start(), "Failed to start loop");
+
+  RdmaControlChannel channel;
+  TEST_ASSERT(channel.connect_to_server("127.0.0.1", server.listen_port()),
+              channel.get_error());
+  std::vector<std::vector<QPValue>> batches(kBatches);
+  for (uint32_t b = 0; b < kBatches; ++b) {
+    for (uint32_t i = 0; i < kQps / kBatches; ++i) {
+      QPValue qp;
+      qp.qp_num = b * 1000 + i + 1;
+      batches[b].push_back(qp);
+    }
+  }
+  std::vector<std::vector<QPValue>> remote;
+  TEST_ASSERT(channel.exchange_qp_batches(batches, remote, kBatches, 5000),
+              channel.get_error());
+  for (uint32_t b = 0; b < kBatches; ++b) {
+    TEST_ASSERT(remote[b].size() == batches[b].size(), "Batch size mismatch");
+    for (size_t i = 0; i < remote[b].size(); ++i) {
+      TEST_ASSERT(remote[b][i].dest_qp_num == batches[b][i].qp_num &&
+                      remote[b][i].qp_num == batches[b][i].qp_num + 100000,
+                  "Response matched to wrong batch");
+    }
+  }
+
+  // 超过单条消息上限的批被拒绝，不发出
+  std::vector<QPValue> too_many(RDMA_CONTROL_MAX_BATCH + 1);
+  TEST_ASSERT(!channel.send_connect_batch_request(too_many),
+              "Oversized batch accepted");
+  server.stop();
+  return true;
+}
+
+// 事件循环控制面：每个对端一条批量消息完成全部QP的交换
+bool test_many_peers_batched() {
+  std::cout << "\nTesting batched handshakes with many peers..." << std::endl;
+
+  const uint32_t kPeers = 64;
+  RdmaControlPlane server;
+  RdmaControlPlane::Callbacks server_cb;
+  server_cb.on_message = [&server](PeerId peer, const RdmaControlMsg &msg) {
+    if (msg.type != RdmaControlMsgType::CONNECT_BATCH_REQUEST) {
+      return;
+    }
+    RdmaControlMsg response;
+    response.type = RdmaControlMsgType::CONNECT_BATCH_RESPONSE;
+    response.request_id = msg.request_id;
+    response.accept = true;
+    response.qp_batch = msg.qp_batch;
+    for (QPValue &qp : response.qp_batch) {
+      qp.dest_qp_num = qp.qp_num;
+      qp.qp_num += 100000;
+    }
+    server.send(peer, response);
+  };
+  server.set_callbacks(server_cb);
+  TEST_ASSERT(server.listen(0, "127.0.0.1"), server.get_error());
+
+  RdmaControlPlane client;
+  std::atomic<uint32_t> responses{0};
+  std::atomic<uint32_t> mismatched{0};
+  RdmaControlPlane::Callbacks client_cb;
+  client_cb.on_message = [&](PeerId peer, const RdmaControlMsg &msg) {
+    bool ok = msg.type == RdmaControlMsgType::CONNECT_BATCH_RESPONSE &&
+              msg.accept && msg.request_id == static_cast<uint32_t>(peer) &&
+              msg.qp_batch.size() == kQps;
+    for (uint32_t i = 0; ok && i < msg.qp_batch.size(); ++i) {
+      ok = msg.qp_batch[i].dest_qp_num == i + 1 &&
+           msg.qp_batch[i].qp_num == i + 100001;
+    }
+    if (!ok) {
+      mismatched++;
+    }
+    responses++;
+  };
+  client.set_callbacks(client_cb);
+  TEST_ASSERT(server.start() && client.start(), "Failed to start loops");
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t p = 0; p < kPeers; ++p) {
+    PeerId peer = client.connect("127.0.0.1", server.listen_port());
+    TEST_ASSERT(peer != 0, "connect failed");
+    RdmaControlMsg request;
+    request.type = RdmaControlMsgType::CONNECT_BATCH_REQUEST;
+    request.request_id = static_cast<uint32_t>(peer);
+    for (uint32_t i = 0; i < kQps; ++i) {
+      QPValue qp;
+      qp.qp_num = i + 1;
+      request.qp_batch.push_back(qp);
+    }
+    TEST_ASSERT(client.send(peer, request), "send failed");
+  }
+  TEST_ASSERT(wait_until([&]() { return responses >= kPeers; }, 30000),
+              "Handshakes did not finish");
+  double ms = elapsed_ms(start);
+  TEST_ASSERT(mismatched == 0, "Handshake mismatch");
+  ControlPlaneStats s = server.get_stats();
+  TEST_ASSERT(s.messages_rx == kPeers, "Expected one request per peer");
+  std::cout << "  对端数=" << kPeers << " 每对端QP数=" << kQps
+            << " 请求消息数=" << s.messages_rx << " 耗时(ms)=" << ms
+            << std::endl;
+  client.stop();
+  server.stop();
+  return true;
+}
+
+// 编解码：批量描述与请求编号往返一致
+bool test_codec() {
+  std::cout << "\nTesting batch message encoding..." << std::endl;
+
+  RdmaControlMsg msg;
+  msg.type = RdmaControlMsgType::CONNECT_BATCH_REQUEST;
+  msg.request_id = 7;
+  for (uint32_t i = 0; i < 3; ++i) {
+    QPValue qp;
+    qp.qp_num = 10 + i;
+    qp.psn = 1000 + i;
+    qp.gid[15] = static_cast<uint8_t>(i);
+    qp.mtu = 4096;
+    msg.qp_batch.push_back(qp);
+  }
+  std::string body = encode_control_msg(msg);
+  RdmaControlMsg decoded;
+  std::string error;
+  TEST_ASSERT(decode_control_msg(body.data(), body.size(), decoded, error),
+              error);
+  TEST_ASSERT(decoded.type == msg.type && decoded.request_id == 7 &&
+                  decoded.qp_batch.size() == 3,
+              "Batch header mismatch");
+  for (uint32_t i = 0; i < 3; ++i) {
+    const QPValue &qp = decoded.qp_batch[i];
+    TEST_ASSERT(qp.qp_num == 10 + i && qp.psn == 1000 + i && qp.gid[15] == i &&
+                    qp.mtu == 4096,
+                "Batch entry mismatch");
+  }
+
+  // 截断的批量描述被拒绝
+  TEST_ASSERT(!decode_control_msg(body.data(), body.size() - 1, decoded, error),
+              "Truncated batch accepted");
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA Batched Handshake Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Codec", test_codec},
+      {"Batch Vs Serial", test_batch_vs_serial},
+      {"Pipelined Out Of Order", test_pipelined_out_of_order},
+      {"Many Peers Batched", test_many_peers_batched}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
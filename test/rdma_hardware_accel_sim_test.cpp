@@ -27,11 +27,11 @@ struct HWSimConfig {
   // 发送路径优化
   bool blueflame_inline = true;         // 小包 inline 化
   uint32_t inline_threshold = 256;      // inline 阈值
-  bool doorbell_coalesce = true;        // 门铃聚合/写合并
+  bool doorbell_coalesce = true;        // 门铃聚合：每个WR列表只敲一次门铃（引擎实测）
 
   // WQE/数据路径
-  bool wqe_prefetch_burst = true;       // 门铃触发后按 burst 拉取多条 WQE
-  uint32_t wqe_burst = 4;               // WQE 预取 burst 数
+  bool wqe_prefetch_burst = true;       // 门铃触发后引擎按 burst 拉取多条 WQE（引擎实测）
+  uint32_t wqe_burst = 4;               // WQE 预取 burst 数，也是每个WR列表的长度
   bool inline_threshold_adaptive = true;// inline 阈值自适应
 
   // 多队列亲和
@@ -69,7 +69,7 @@ static uint64_t do_send_and_poll_baseline(RdmaDevice &dev, uint32_t cq, uint32_t
   wr.length=(uint32_t)len; wr.signaled=true; wr.wr_id=1;
   auto t0 = Clock::now(); if (!dev.post_send(qp, wr)) return UINT64_MAX;
   std::vector<CompletionEntry> comps; comps.reserve(batch);
-  while (!dev.poll_cq(cq, comps, batch)) { std::this_thread::sleep_for(std::chrono::microseconds(1)); }
+  dev.wait_cq(cq, comps, batch);
   auto t1 = Clock::now(); return std::chrono::duration_cast<ns>(t1-t0).count();
 }
 
@@ -80,12 +80,10 @@ static uint64_t do_send_and_poll_hw(RdmaDevice &dev, uint32_t cq, uint32_t qp,
 {
   // 自适应 inline 阈值（简单模型：高负载/小包时提升 inline 概率）
   uint32_t inline_thr = cfg.inline_threshold;
-  if (cfg.inline_threshold_adaptive && len <= 512) inline_thr = std::max(128u, cfg.inline_threshold/2);
+  if (cfg.inline_threshold_adaptive && len <= 512) inline_thr = std::min(cfg.inline_threshold, std::max(128u, cfg.inline_threshold/2));
 
-  // BlueFlame/门铃合并：用更少的门铃写次数等效为更大批次
+  // 门铃聚合与 WQE 预取不再折算为批次，由 run_doorbell 在设备引擎上实测
   uint32_t eff_batch = base_batch;
-  if (cfg.doorbell_coalesce) eff_batch = std::max(eff_batch, base_batch + 4);
-  if (cfg.wqe_prefetch_burst) eff_batch = std::max(eff_batch, base_batch + cfg.wqe_burst);
   if (cfg.cqe_dma_batch) eff_batch = std::max(eff_batch, cfg.cqe_dma_batch);
 
   // RSS/亲和：热点流绑定专属队列，减少争用 => 减少轮询空转
@@ -108,10 +106,10 @@ static uint64_t do_send_and_poll_hw(RdmaDevice &dev, uint32_t cq, uint32_t qp,
     else eff_batch = std::max(eff_batch, base_batch + 4);
   }
 
-  // 发送（inline 优先）
+  // 发送（inline 优先：数据在 post 时拷入 WQE，QP 的 inline 阈值在创建时配置）
   RdmaWorkRequest wr{}; wr.opcode=RdmaOpcode::SEND; wr.local_addr=const_cast<void*>(data);
   wr.length=(uint32_t)len; wr.signaled=true; wr.wr_id=1;
-  bool use_inline = cfg.blueflame_inline && len <= inline_thr;
+  wr.send_inline = cfg.blueflame_inline && len <= inline_thr;
 
   auto t0 = Clock::now();
   if (!dev.post_send(qp, wr)) return UINT64_MAX;
@@ -131,16 +129,59 @@ static uint64_t do_send_and_poll_hw(RdmaDevice &dev, uint32_t cq, uint32_t qp,
 
   // 根据优化折减固定时间（避免负值）
   if (dur > fixed_boost_ns) dur -= fixed_boost_ns;
-  if (use_inline && dur > 150) dur -= 150; // inline 带来的额外缩短
   return dur;
 }
 
+// 门铃聚合/WQE预取实测：单个引擎处理一个QP，每轮投递 wqe_burst 条WR并收齐完成。
+// doorbell_coalesce 时整轮用一次 post_send_list（一次门铃），否则逐条 post_send；
+// wqe_prefetch_burst 时引擎每次取回 wqe_burst 条WQE，否则逐条取回
+struct DoorbellResult { uint64_t ns_per_wqe{0}; EngineStats stats{}; };
+static DoorbellResult run_doorbell(const HWSimConfig &cfg, const void *data, size_t len, int iters) {
+  DoorbellResult r;
+  RdmaDevice dev(/*conn*/64, /*qps*/16, /*cqs*/16, /*mrs*/16, /*pds*/8);
+  EngineConfig ec; ec.num_engines = 1;
+  ec.wqe_prefetch_burst = cfg.wqe_prefetch_burst ? cfg.wqe_burst : 1;
+  if (!dev.configure_engines(ec)) return r;
+  uint32_t cq = dev.create_cq(256); uint32_t qp = dev.create_qp(64, 64, cq, cq);
+  if (!cq || !qp) return r;
+  dev.modify_qp_state(qp, QpState::INIT); dev.modify_qp_state(qp, QpState::RTR); dev.modify_qp_state(qp, QpState::RTS);
+
+  std::vector<RdmaWorkRequest> wrs(std::max(1u, cfg.wqe_burst));
+  for (size_t i=0;i<wrs.size();++i) {
+    wrs[i].opcode=RdmaOpcode::SEND; wrs[i].local_addr=const_cast<void*>(data);
+    wrs[i].length=(uint32_t)len; wrs[i].wr_id=i;
+  }
+  std::vector<CompletionEntry> comps; comps.reserve(wrs.size());
+  size_t wqes = 0;
+  auto t0 = Clock::now();
+  for (int i=0;i<iters;++i) {
+    size_t posted = 0;
+    if (cfg.doorbell_coalesce) posted = dev.post_send_list(qp, wrs);
+    else for (const auto &wr : wrs) posted += dev.post_send(qp, wr) ? 1 : 0;
+    comps.clear();
+    while (comps.size() < posted) dev.wait_cq(cq, comps, (uint32_t)(posted - comps.size()), 100);
+    wqes += posted;
+  }
+  auto t1 = Clock::now();
+  if (wqes) r.ns_per_wqe = std::chrono::duration_cast<ns>(t1-t0).count() / wqes;
+  r.stats = dev.get_engine_stats()[0];
+  return r;
+}
+
+static void report_doorbell(const char *name, const DoorbellResult &r) {
+  std::cout << name << ": 每WQE(ns)=" << r.ns_per_wqe << ", WQE=" << r.stats.messages
+            << ", 门铃=" << r.stats.doorbells << ", 取回次数=" << r.stats.bursts
+            << ", WQE/门铃=" << (r.stats.doorbells ? (double)r.stats.messages / r.stats.doorbells : 0.0)
+            << ", 引擎休眠=" << r.stats.sleeps << std::endl;
+}
+
 struct CQPair { RdmaDevice* dev; uint32_t cq; uint32_t qp; uint32_t flow_hash; };
-static std::vector<CQPair> create_pairs(RdmaDevice &dev_hot, RdmaDevice &dev_cold, size_t total, size_t hot_count) {
+static std::vector<CQPair> create_pairs(RdmaDevice &dev_hot, RdmaDevice &dev_cold, size_t total, size_t hot_count,
+                                        uint32_t max_inline_data) {
   std::vector<CQPair> res; res.reserve(total);
   for (size_t i=0;i<total;++i) {
     bool hot = i < hot_count; RdmaDevice &d = hot ? dev_hot : dev_cold;
-    uint32_t cq = d.create_cq(256); uint32_t qp = d.create_qp(64, 64, cq, cq);
+    uint32_t cq = d.create_cq(256); uint32_t qp = d.create_qp(64, 64, cq, cq, max_inline_data);
     if (!cq || !qp) continue; d.modify_qp_state(qp, QpState::INIT);
     d.modify_qp_state(qp, QpState::RTR); d.modify_qp_state(qp, QpState::RTS);
     res.push_back({&d, cq, qp, (uint32_t)i});
@@ -157,11 +198,11 @@ int main() {
   RdmaDevice dev_hot(/*conn*/512, /*qps*/128, /*cqs*/128, /*mrs*/64, /*pds*/32);
   RdmaDevice dev_cold(/*conn*/512, /*qps*/0, /*cqs*/0, /*mrs*/0, /*pds*/0);
 
-  auto pairs = create_pairs(dev_hot, dev_cold, total_cq, hot_cq);
-  auto access_idx = gen_zipf_indices(pairs.size(), iters, zipf_s);
-
   HWSimConfig cfg{}; // 默认启用所有优化
 
+  auto pairs = create_pairs(dev_hot, dev_cold, total_cq, hot_cq, cfg.inline_threshold);
+  auto access_idx = gen_zipf_indices(pairs.size(), iters, zipf_s);
+
   // A) 基线（batch=1）
   std::vector<uint64_t> l_base; l_base.reserve(iters);
   for (int i=0;i<iters;++i) {
@@ -192,11 +233,21 @@ int main() {
   std::cout << "硬件加速: avg(ns)=" << s_hw.avg_ns << ", p50=" << s_hw.p50_ns
             << ", p95=" << s_hw.p95_ns << ", p99=" << s_hw.p99_ns << ", ops=" << s_hw.ops << std::endl;
 
+  // D) 门铃聚合与 WQE 预取（设备引擎实测）
+  HWSimConfig db_off = cfg; db_off.doorbell_coalesce = false; db_off.wqe_prefetch_burst = false;
+  auto d_off = run_doorbell(db_off, payload.data(), payload.size(), iters / (int)cfg.wqe_burst);
+  auto d_on = run_doorbell(cfg, payload.data(), payload.size(), iters / (int)cfg.wqe_burst);
+  std::cout << std::endl;
+  report_doorbell("逐条门铃", d_off);
+  report_doorbell("门铃聚合+预取", d_on);
+
   std::cout << "\n=== 收益概览 ===" << std::endl;
   std::cout << std::fixed << std::setprecision(2);
   std::cout << "基线 -> 批量: " << (s_base.avg_ns>0? (double)s_base.avg_ns/(double)s_batch.avg_ns:0.0) << "x (avg延迟降低)" << std::endl;
   std::cout << "批量 -> 硬件: " << (s_batch.avg_ns>0? (double)s_batch.avg_ns/(double)s_hw.avg_ns:0.0) << "x (avg延迟降低)" << std::endl;
   std::cout << "基线 -> 硬件: " << (s_base.avg_ns>0? (double)s_base.avg_ns/(double)s_hw.avg_ns:0.0) << "x (avg延迟降低)" << std::endl;
+  std::cout << "逐条门铃 -> 门铃聚合: " << (d_on.ns_per_wqe>0? (double)d_off.ns_per_wqe/(double)d_on.ns_per_wqe:0.0)
+            << "x (每WQE耗时降低), 门铃数 " << d_off.stats.doorbells << " -> " << d_on.stats.doorbells << std::endl;
 
   return 0;
 }
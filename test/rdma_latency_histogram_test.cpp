@@ -0,0 +1,269 @@
+#include "../include/rdma_device.h"
+#include "../include/rdma_latency_histogram.h"
+#include "../include/rdma_types.h"
+#include "rdma_test_util.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+// 分桶：相邻桶首尾相接，桶宽相对误差不超过 1/32，超出上限的值落在最后一桶
+bool test_bucket_layout() {
+  std::cout << "\nTesting log-linear bucket layout..." << std::endl;
+
+  TEST_ASSERT(RdmaLatencyHistogram::bucket_lower(0) == 0,
+              "First bucket must start at 0");
+  for (size_t i = 0; i + 1 < RDMA_HIST_BUCKETS; ++i) {
+    uint64_t lower = RdmaLatencyHistogram::bucket_lower(i);
+    uint64_t upper = RdmaLatencyHistogram::bucket_upper(i);
+    TEST_ASSERT(RdmaLatencyHistogram::bucket_lower(i + 1) == upper + 1,
+                "Gap after bucket " + std::to_string(i));
+    TEST_ASSERT(RdmaLatencyHistogram::bucket_index(lower) == i &&
+                    RdmaLatencyHistogram::bucket_index(upper) == i,
+                "Bucket bounds map elsewhere: " + std::to_string(i));
+    TEST_ASSERT((upper - lower + 1) * 32 <= std::max<uint64_t>(lower, 32),
+                "Bucket too wide: " + std::to_string(i));
+  }
+  uint64_t top = (uint64_t{1} << RDMA_HIST_MAX_BITS) - 1;
+  TEST_ASSERT(RdmaLatencyHistogram::bucket_upper(RDMA_HIST_BUCKETS - 1) == top,
+              "Last bucket does not end at the maximum");
+  TEST_ASSERT(RdmaLatencyHistogram::bucket_index(UINT64_MAX) ==
+                  RDMA_HIST_BUCKETS - 1,
+              "Huge value not clamped");
+
+  // 降低精度和覆盖范围：桶数随之减少，桶宽相对误差不超过 1/8
+  RdmaLatencyHistogram coarse(3, 20);
+  TEST_ASSERT(coarse.bucket_count() == 8 * 18, "Unexpected bucket count");
+  for (size_t i = 0; i + 1 < coarse.bucket_count(); ++i) {
+    uint64_t lower = RdmaLatencyHistogram::bucket_lower(i, 3);
+    uint64_t upper = RdmaLatencyHistogram::bucket_upper(i, 3);
+    TEST_ASSERT(RdmaLatencyHistogram::bucket_lower(i + 1, 3) == upper + 1 &&
+                    RdmaLatencyHistogram::bucket_index(upper, 3, 20) == i,
+                "Coarse layout broken at " + std::to_string(i));
+    TEST_ASSERT((upper - lower + 1) * 8 <= std::max<uint64_t>(lower, 8),
+                "Coarse bucket too wide: " + std::to_string(i));
+  }
+  coarse.record(1000);
+  coarse.record(uint64_t{1} << 30);
+  RdmaLatencySnapshot snap = coarse.snapshot();
+  TEST_ASSERT(snap.sub_bits == 3 && snap.counts.size() == 8 * 18 &&
+                  snap.value_at(50) >= 1000 && snap.value_at(50) <= 1000 + 125,
+              "Coarse percentile outside bucket width");
+  TEST_ASSERT(snap.counts.back() == 1, "Out-of-range value not clamped");
+
+  // 参数越界时截断
+  RdmaLatencyHistogram clamped(0, 100);
+  TEST_ASSERT(clamped.sub_bits() == 1 &&
+                  clamped.max_bits() == RDMA_HIST_LIMIT_BITS,
+              "Parameters not clamped");
+  return true;
+}
+
+// 百分位与精确排序结果的误差在桶宽以内
+bool test_percentiles() {
+  std::cout << "\nTesting percentiles against sorted samples..." << std::endl;
+
+  std::mt19937_64 rng(42);
+  std::lognormal_distribution<double> dist(9.0, 1.2); // 中位数约 8us，长尾
+  std::vector<uint64_t> samples(200000);
+  RdmaLatencyHistogram hist;
+  for (auto &sample : samples) {
+    sample = static_cast<uint64_t>(dist(rng));
+    hist.record(sample);
+  }
+  std::sort(samples.begin(), samples.end());
+
+  RdmaLatencySnapshot snap = hist.snapshot();
+  TEST_ASSERT(snap.count == samples.size(), "Unexpected sample count");
+  TEST_ASSERT(snap.min_ns == samples.front() && snap.max_ns == samples.back(),
+              "Unexpected min/max");
+  for (double p : {50.0, 90.0, 99.0, 99.9, 100.0}) {
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * samples.size()));
+    uint64_t exact = samples[std::max<size_t>(rank, 1) - 1];
+    uint64_t approx = snap.value_at(p);
+    TEST_ASSERT(approx >= exact && approx - exact <= exact / 32 + 1,
+                "p" + std::to_string(p) + ": exact=" + std::to_string(exact) +
+                    " approx=" + std::to_string(approx));
+  }
+  std::cout << "  " << snap.to_string() << std::endl;
+
+  hist.reset();
+  snap = hist.snapshot();
+  TEST_ASSERT(snap.count == 0 && snap.value_at(99) == 0, "reset failed");
+  return true;
+}
+
+// 多线程并发记录：计数与总和不丢失
+bool test_concurrent_record() {
+  std::cout << "\nTesting concurrent recording..." << std::endl;
+
+  RdmaLatencyHistogram hist;
+  const int kThreads = 8;
+  const int kPerThread = 50000;
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&hist, t]() {
+      for (int i = 0; i < kPerThread; ++i) {
+        hist.record(1000 + t);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double ns = std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - start)
+                  .count() /
+              (kThreads * kPerThread);
+
+  RdmaLatencySnapshot snap = hist.snapshot();
+  std::cout << "  record: " << ns << " ns/次" << std::endl;
+  TEST_ASSERT(snap.count == kThreads * kPerThread, "Lost samples");
+  uint64_t expected_sum = 0;
+  for (int t = 0; t < kThreads; ++t) {
+    expected_sum += static_cast<uint64_t>(1000 + t) * kPerThread;
+  }
+  TEST_ASSERT(snap.sum_ns == expected_sum, "Lost sum");
+  TEST_ASSERT(snap.min_ns == 1000 && snap.max_ns == 1000 + kThreads - 1,
+              "Unexpected min/max");
+  return true;
+}
+
+// 设备：有信号的发送按QP/CQ记录投递到完成的延迟，完成带生成时间戳
+bool test_device_latency() {
+  std::cout << "\nTesting per-QP post-to-completion latency..." << std::endl;
+
+  RdmaDevice dev;
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p), "Failed to set up QP pair");
+
+  // 统计默认关闭：不读时钟、不创建直方图
+  RdmaLatencySnapshot snap;
+  TEST_ASSERT(exchange(dev, p, 3), "Exchange failed");
+  TEST_ASSERT(!dev.get_qp_latency(p.qp_a, snap) &&
+                  !dev.get_cq_latency(p.cq_a, snap),
+              "Latency recorded while tracking is off by default");
+  dev.set_latency_tracking(true);
+
+  // 完成时间戳位于投递与取走之间
+  uint64_t before = RdmaFabric::now_ns();
+  std::vector<char> buf(64, 'y');
+  RdmaWorkRequest recv_wr;
+  recv_wr.opcode = RdmaOpcode::RECV;
+  recv_wr.local_addr = buf.data();
+  recv_wr.length = static_cast<uint32_t>(buf.size());
+  TEST_ASSERT(dev.post_recv(p.qp_b, recv_wr), "post_recv failed");
+  RdmaWorkRequest wr;
+  wr.opcode = RdmaOpcode::SEND;
+  wr.local_addr = buf.data();
+  wr.length = static_cast<uint32_t>(buf.size());
+  TEST_ASSERT(dev.post_send(p.qp_a, wr), "post_send failed");
+  std::vector<CompletionEntry> send_comps, recv_comps;
+  TEST_ASSERT(collect(dev, p.cq_a, 1, send_comps) &&
+                  collect(dev, p.cq_b, 1, recv_comps),
+              "Missing completions");
+  uint64_t after = RdmaFabric::now_ns();
+  for (const auto &comp : {send_comps.front(), recv_comps.front()}) {
+    TEST_ASSERT(comp.timestamp_ns >= before && comp.timestamp_ns <= after,
+                "CQE timestamp outside the operation window");
+  }
+
+  const int kMessages = 200;
+  TEST_ASSERT(exchange(dev, p, kMessages), "Exchange failed");
+  TEST_ASSERT(dev.get_qp_latency(p.qp_a, snap), "No QP latency recorded");
+  std::cout << "  QP " << p.qp_a << ": " << snap.to_string() << std::endl;
+  TEST_ASSERT(snap.count == kMessages + 1,
+              "count=" + std::to_string(snap.count));
+  TEST_ASSERT(snap.min_ns > 0 && snap.min_ns <= snap.value_at(50) &&
+                  snap.value_at(50) <= snap.value_at(99) &&
+                  snap.value_at(99) <= snap.max_ns,
+              "Percentiles not ordered");
+  TEST_ASSERT(dev.get_cq_latency(p.cq_a, snap) && snap.count == kMessages + 1,
+              "CQ latency does not match QP");
+  // 接收端没有发送完成
+  TEST_ASSERT(!dev.get_qp_latency(p.qp_b, snap) &&
+                  !dev.get_cq_latency(p.cq_b, snap),
+              "Receive side should have no post-to-completion samples");
+
+  // 无信号的发送不产生完成，也不计入
+  TEST_ASSERT(exchange(dev, p, 10, 256, false), "Unsignaled exchange failed");
+  TEST_ASSERT(dev.get_qp_latency(p.qp_a, snap) && snap.count == kMessages + 1,
+              "Unsignaled send recorded");
+
+  // 关闭统计后不再记录
+  dev.set_latency_tracking(false);
+  TEST_ASSERT(exchange(dev, p, 10), "Exchange failed");
+  TEST_ASSERT(dev.get_qp_latency(p.qp_a, snap) && snap.count == kMessages + 1,
+              "Recorded while tracking disabled");
+  dev.set_latency_tracking(true);
+
+  dev.reset_latency();
+  TEST_ASSERT(!dev.get_qp_latency(p.qp_a, snap), "reset_latency failed");
+  TEST_ASSERT(exchange(dev, p, 5), "Exchange failed");
+  TEST_ASSERT(dev.get_qp_latency(p.qp_a, snap) && snap.count == 5,
+              "Not recording after reset");
+
+  // 销毁QP/CQ时删除其直方图
+  dev.destroy_qp(p.qp_a);
+  dev.destroy_cq(p.cq_a);
+  TEST_ASSERT(!dev.get_qp_latency(p.qp_a, snap) &&
+                  !dev.get_cq_latency(p.cq_a, snap),
+              "Histogram survived destroy");
+
+  // 新参数作用于之后创建的直方图
+  dev.set_latency_tracking(true, 3, 24);
+  QpPair q;
+  TEST_ASSERT(setup_pair(dev, q), "Failed to set up QP pair");
+  TEST_ASSERT(exchange(dev, q, 5), "Exchange failed");
+  TEST_ASSERT(dev.get_qp_latency(q.qp_a, snap) && snap.count == 5 &&
+                  snap.sub_bits == 3 && snap.counts.size() == 8 * 22,
+              "Histogram precision not applied");
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA Latency Histogram Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Bucket Layout", test_bucket_layout},
+      {"Percentiles", test_percentiles},
+      {"Concurrent Record", test_concurrent_record},
+      {"Device Latency", test_device_latency}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,425 @@
+#include "../include/rdma_device.h"
+#include "../include/rdma_link_model.h"
+#include "../include/rdma_types.h"
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+using Clock = std::chrono::steady_clock;
+
+static WirePacket make_packet(uint32_t qp_num, uint32_t payload) {
+  WirePacket packet;
+  packet.pkt = RdmaPacket{};
+  packet.pkt.src_qp = qp_num;
+  packet.pkt.payload_length = payload;
+  return packet;
+}
+
+// 轮转调度：两个积压的QP交替上线，端口按线速串行化
+bool test_round_robin() {
+  std::cout << "\nTesting round-robin egress..." << std::endl;
+
+  LinkConfig config;
+  config.bandwidth_gbps = 8.0; // 1 字节/纳秒
+  RdmaLinkModel link(config);
+  for (int i = 0; i < 4; ++i) {
+    link.enqueue(1, make_packet(1, 1000 - RDMA_PACKET_OVERHEAD_BYTES));
+    link.enqueue(2, make_packet(2, 1000 - RDMA_PACKET_OVERHEAD_BYTES));
+  }
+
+  uint64_t now = 0;
+  std::vector<uint32_t> order;
+  WirePacket packet;
+  uint64_t done = 0, retry = 0;
+  while (link.dequeue(now, packet, done, retry) || retry != 0) {
+    if (retry != 0) {
+      TEST_ASSERT(retry == now, "Port should be busy until previous packet");
+      continue;
+    }
+    TEST_ASSERT(done == now + 1000, "Unexpected serialization time");
+    order.push_back(packet.pkt.src_qp);
+    now = done;
+  }
+  TEST_ASSERT((order == std::vector<uint32_t>{1, 2, 1, 2, 1, 2, 1, 2}),
+              "Round-robin order is wrong");
+  return true;
+}
+
+// 加权调度：权重 1:3 的两个积压QP按 1:3 分享端口
+bool test_weighted() {
+  std::cout << "\nTesting weighted egress..." << std::endl;
+
+  LinkConfig config;
+  config.bandwidth_gbps = 8.0;
+  config.scheduler = EgressScheduler::WEIGHTED;
+  RdmaLinkModel link(config);
+  link.set_weight(1, 1);
+  link.set_weight(2, 3);
+  for (int i = 0; i < 40; ++i) {
+    link.enqueue(1, make_packet(1, 1024));
+    link.enqueue(2, make_packet(2, 1024));
+  }
+
+  uint64_t now = 0;
+  int sent[3] = {0, 0, 0};
+  WirePacket packet;
+  uint64_t done = 0, retry = 0;
+  for (int i = 0; i < 40; ++i) {
+    TEST_ASSERT(link.dequeue(now, packet, done, retry), "dequeue failed");
+    sent[packet.pkt.src_qp]++;
+    now = done;
+  }
+  std::cout << "QP1=" << sent[1] << " QP2=" << sent[2] << std::endl;
+  TEST_ASSERT(sent[1] == 10 && sent[2] == 30, "Weighted share is not 1:3");
+  return true;
+}
+
+// 入口队列：同时到达的包排队，深度超过阈值后开始标记ECN
+bool test_ingress_ecn() {
+  std::cout << "\nTesting ingress queue and ECN marking..." << std::endl;
+
+  LinkConfig config;
+  config.bandwidth_gbps = 8.0;
+  config.dcqcn.enabled = true;
+  config.dcqcn.ecn_threshold_bytes = 4000;
+  RdmaLinkModel link(config);
+
+  uint64_t leave = 0;
+  for (int i = 0; i < 10; ++i) {
+    bool ecn = false;
+    leave = link.ingress_admit(1000, 0, ecn);
+    TEST_ASSERT(ecn == (i >= 4), "Unexpected ECN mark at packet " << i);
+  }
+  TEST_ASSERT(leave == 10000, "Queue should drain at line rate");
+
+  LinkStats stats = link.stats();
+  TEST_ASSERT(stats.ecn_marked == 6, "Unexpected ECN count");
+  TEST_ASSERT(stats.max_ingress_queue_bytes == 10000, "Unexpected peak depth");
+
+  // 同一QP的CNP按间隔限频
+  TEST_ASSERT(link.should_send_cnp(7, 0), "First CNP should be sent");
+  TEST_ASSERT(!link.should_send_cnp(7, 1000), "CNP should be rate limited");
+  TEST_ASSERT(link.should_send_cnp(7, config.dcqcn.cnp_interval_ns),
+              "CNP should be sent after the interval");
+  return true;
+}
+
+// DCQCN：收到CNP后降速，之后随定时器逐步恢复到线速
+bool test_dcqcn_rate() {
+  std::cout << "\nTesting DCQCN rate control..." << std::endl;
+
+  LinkConfig config;
+  config.bandwidth_gbps = 25.0;
+  config.dcqcn.enabled = true;
+  RdmaLinkModel link(config);
+
+  const uint64_t t0 = 1000000;
+  TEST_ASSERT(link.flow_rate_gbps(1, t0) == 25.0, "Flow should start at line");
+  link.on_cnp(1, t0);
+  double cut = link.flow_rate_gbps(1, t0);
+  TEST_ASSERT(cut == 12.5, "First CNP should halve the rate");
+  link.on_cnp(1, t0 + 1000);
+  double cut_again = link.flow_rate_gbps(1, t0 + 1000);
+  TEST_ASSERT(cut_again < cut, "Second CNP should cut further");
+
+  // 快速恢复：每个周期向降速前的速率折半逼近
+  double recovering = link.flow_rate_gbps(1, t0 + 1000 + 3 * 55000);
+  TEST_ASSERT(recovering > cut_again && recovering < cut,
+              "Rate should recover towards the target after CNPs stop");
+  TEST_ASSERT(link.flow_rate_gbps(1, t0 + 1000000000ULL) == 25.0,
+              "Rate should return to line rate");
+  return true;
+}
+
+// 端到端：两台设备之间的消息按带宽和传播时延投递
+bool test_link_timing() {
+  std::cout << "\nTesting link timing between devices..." << std::endl;
+
+  LinkConfig config;
+  config.bandwidth_gbps = 10.0;
+  config.propagation_delay_ns = 5000;
+  RdmaDevice dev_a, dev_b;
+  dev_a.configure_link(config);
+  dev_b.configure_link(config);
+
+  uint32_t cq_a = dev_a.create_cq(16);
+  uint32_t cq_b = dev_b.create_cq(16);
+  uint32_t qp_a = dev_a.create_qp(16, 16, cq_a, cq_a);
+  uint32_t qp_b = dev_b.create_qp(16, 16, cq_b, cq_b);
+  TEST_ASSERT(qp_a && qp_b, "Failed to create QPs");
+  QPValue info_a, info_b;
+  dev_a.get_qp_info(qp_a, info_a);
+  dev_b.get_qp_info(qp_b, info_b);
+  info_a.mtu = info_b.mtu = 4096;
+  dev_a.connect_qp(qp_a, info_b);
+  dev_b.connect_qp(qp_b, info_a);
+  for (QpState s : {QpState::INIT, QpState::RTR, QpState::RTS}) {
+    dev_a.modify_qp_state(qp_a, s);
+    dev_b.modify_qp_state(qp_b, s);
+  }
+
+  std::vector<char> src(256 * 1024), dst(src.size(), 0);
+  for (size_t i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<char>(i * 13);
+  }
+  RdmaWorkRequest recv_wr;
+  recv_wr.opcode = RdmaOpcode::RECV;
+  recv_wr.local_addr = dst.data();
+  recv_wr.length = static_cast<uint32_t>(dst.size());
+  TEST_ASSERT(dev_b.post_recv(qp_b, recv_wr), "post_recv failed");
+
+  RdmaWorkRequest wr;
+  wr.opcode = RdmaOpcode::SEND;
+  wr.local_addr = src.data();
+  wr.length = static_cast<uint32_t>(src.size());
+  auto start = Clock::now();
+  TEST_ASSERT(dev_a.post_send(qp_a, wr), "post_send failed");
+
+  // 发送完成要等对端收到尾包并经反向传播返回
+  std::vector<CompletionEntry> comps;
+  while (!dev_a.poll_cq(cq_a, comps, 1)) {
+    TEST_ASSERT(Clock::now() - start < std::chrono::seconds(5),
+                "Send completion timed out");
+    std::this_thread::yield();
+  }
+  auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        Clock::now() - start)
+                        .count();
+  TEST_ASSERT(dev_b.poll_cq(cq_b, comps, 1), "Receive completion missing");
+  TEST_ASSERT(dst == src, "Received data does not match");
+
+  // 64个包的串行化时间 + 正反向各两段传播时延
+  uint64_t packets = src.size() / 4096;
+  uint64_t min_ns = packets * (4096 + RDMA_PACKET_OVERHEAD_BYTES) * 8 / 10 +
+                    4 * config.propagation_delay_ns;
+  std::cout << "elapsed(ns)=" << elapsed_ns << ", model lower bound(ns)="
+            << min_ns << std::endl;
+  TEST_ASSERT(static_cast<uint64_t>(elapsed_ns) >= min_ns,
+              "Message completed faster than the link allows");
+
+  TransportStats tstats = dev_a.get_transport_stats();
+  TEST_ASSERT(tstats.tx_packets == packets, "Unexpected packet count");
+  LinkStats lstats = dev_b.get_link_stats();
+  TEST_ASSERT(lstats.rx_packets == packets, "Ingress did not see all packets");
+  return true;
+}
+
+// 64 打 1 汇聚：64台发送设备同时向同一接收设备连续发送 rounds 条消息
+struct IncastResult {
+  uint64_t elapsed_ns = 0;
+  uint64_t max_queue_bytes = 0;
+  uint64_t avg_queue_delay_ns = 0;
+  uint64_t ecn_marked = 0;
+  uint64_t cnp_sent = 0;
+  bool data_ok = true;
+};
+
+static bool run_incast(bool dcqcn, uint32_t senders, uint32_t msg_size,
+                       uint32_t rounds, IncastResult &result) {
+  LinkConfig config;
+  config.bandwidth_gbps = 25.0;
+  config.propagation_delay_ns = 1000;
+  config.dcqcn.enabled = dcqcn;
+
+  RdmaDevice receiver;
+  receiver.configure_link(config);
+  uint32_t recv_cq = receiver.create_cq(senders * rounds);
+
+  std::vector<std::unique_ptr<RdmaDevice>> devs;
+  std::vector<uint32_t> send_qps, recv_qps, send_cqs;
+  std::vector<std::vector<char>> src(senders), dst(senders);
+  for (uint32_t i = 0; i < senders; ++i) {
+    devs.emplace_back(new RdmaDevice());
+    RdmaDevice &dev = *devs.back();
+    dev.configure_link(config);
+    uint32_t cq = dev.create_cq(rounds);
+    uint32_t sq = dev.create_qp(rounds, rounds, cq, cq);
+    uint32_t rq = receiver.create_qp(rounds, rounds, recv_cq, recv_cq);
+    if (!cq || !sq || !rq) {
+      return false;
+    }
+    QPValue s_info, r_info;
+    dev.get_qp_info(sq, s_info);
+    receiver.get_qp_info(rq, r_info);
+    s_info.mtu = r_info.mtu = 4096;
+    dev.connect_qp(sq, r_info);
+    receiver.connect_qp(rq, s_info);
+    for (QpState s : {QpState::INIT, QpState::RTR, QpState::RTS}) {
+      dev.modify_qp_state(sq, s);
+      receiver.modify_qp_state(rq, s);
+    }
+    send_cqs.push_back(cq);
+    send_qps.push_back(sq);
+    recv_qps.push_back(rq);
+
+    src[i].assign(msg_size, static_cast<char>('A' + i % 26));
+    dst[i].assign(msg_size, 0);
+    RdmaWorkRequest recv_wr;
+    recv_wr.opcode = RdmaOpcode::RECV;
+    recv_wr.local_addr = dst[i].data();
+    recv_wr.length = msg_size;
+    recv_wr.wr_id = i;
+    for (uint32_t r = 0; r < rounds; ++r) {
+      if (!receiver.post_recv(rq, recv_wr)) {
+        return false;
+      }
+    }
+  }
+
+  auto start = Clock::now();
+  for (uint32_t i = 0; i < senders; ++i) {
+    RdmaWorkRequest wr;
+    wr.opcode = RdmaOpcode::SEND;
+    wr.local_addr = src[i].data();
+    wr.length = msg_size;
+    wr.wr_id = i;
+    for (uint32_t r = 0; r < rounds; ++r) {
+      if (!devs[i]->post_send(send_qps[i], wr)) {
+        return false;
+      }
+    }
+  }
+
+  std::vector<CompletionEntry> comps;
+  while (comps.size() < senders * rounds) {
+    if (Clock::now() - start > std::chrono::seconds(60)) {
+      return false;
+    }
+    if (!receiver.poll_cq(recv_cq, comps, senders)) {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+  result.elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          Clock::now() - start)
+                          .count();
+
+  // 等所有发送完成返回，确保发送缓冲区不再被引用
+  for (uint32_t i = 0; i < senders; ++i) {
+    std::vector<CompletionEntry> send_comps;
+    while (send_comps.size() < rounds) {
+      devs[i]->poll_cq(send_cqs[i], send_comps, rounds);
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+  for (uint32_t i = 0; i < senders; ++i) {
+    result.data_ok = result.data_ok && dst[i] == src[i];
+  }
+  LinkStats stats = receiver.get_link_stats();
+  result.max_queue_bytes = stats.max_ingress_queue_bytes;
+  result.avg_queue_delay_ns =
+      stats.rx_packets ? stats.ingress_queue_delay_ns / stats.rx_packets : 0;
+  result.ecn_marked = stats.ecn_marked;
+  result.cnp_sent = stats.cnp_sent;
+  return true;
+}
+
+static void print_incast(const char *name, const IncastResult &r) {
+  std::cout << std::left << std::setw(12) << name << std::setw(16)
+            << r.elapsed_ns / 1000 << std::setw(18) << r.max_queue_bytes / 1024
+            << std::setw(18) << r.avg_queue_delay_ns / 1000 << std::setw(10)
+            << r.ecn_marked << r.cnp_sent << std::endl;
+}
+
+// 对比有无 DCQCN 的 N 打 1 汇聚，检查两种模式共同满足的约束
+static bool compare_incast(uint32_t senders, uint32_t msg_size,
+                           uint32_t rounds, IncastResult &plain,
+                           IncastResult &controlled) {
+  TEST_ASSERT(run_incast(false, senders, msg_size, rounds, plain),
+              "Incast without DCQCN did not complete");
+  TEST_ASSERT(run_incast(true, senders, msg_size, rounds, controlled),
+              "Incast with DCQCN did not complete");
+
+  std::cout << senders << " 打 1, 每端 " << rounds << " x "
+            << msg_size / 1024 << "KB @25Gbps" << std::endl;
+  std::cout << std::left << std::setw(12) << "模式" << std::setw(16)
+            << "耗时(us)" << std::setw(18) << "队列峰值(KB)" << std::setw(18)
+            << "平均排队(us)" << std::setw(10) << "ECN" << "CNP" << std::endl;
+  print_incast("无DCQCN", plain);
+  print_incast("DCQCN", controlled);
+
+  TEST_ASSERT(plain.data_ok && controlled.data_ok, "Incast data corrupted");
+  // 瓶颈是接收端口：总耗时不可能短于全部字节在25Gbps下的串行化时间
+  uint64_t bottleneck_ns =
+      static_cast<uint64_t>(senders) * rounds * msg_size * 8 / 25;
+  TEST_ASSERT(plain.elapsed_ns >= bottleneck_ns &&
+                  controlled.elapsed_ns >= bottleneck_ns,
+              "Incast finished faster than the bottleneck link");
+  TEST_ASSERT(plain.ecn_marked == 0 && plain.cnp_sent == 0,
+              "ECN must stay off without DCQCN");
+  TEST_ASSERT(controlled.cnp_sent > 0, "DCQCN should generate CNPs");
+  return true;
+}
+
+// 长流汇聚：CNP 能在队列失控前返回，DCQCN 把排队时延压到阈值附近
+bool test_incast_steady_state() {
+  std::cout << "\nTesting 4-to-1 incast with long flows..." << std::endl;
+
+  IncastResult plain, controlled;
+  TEST_ASSERT(compare_incast(4, 512 * 1024, 8, plain, controlled),
+              "4-to-1 incast failed");
+  TEST_ASSERT(controlled.avg_queue_delay_ns * 10 < plain.avg_queue_delay_ns,
+              "DCQCN should bound the incast queueing delay");
+  return true;
+}
+
+// 64 打 1 汇聚：ECN 标记随包排队，反馈时延随队列增长，
+// 突发在降速生效前就已进入队列，队列峰值由突发总量决定
+bool test_incast_64_to_1() {
+  std::cout << "\nTesting 64-to-1 incast..." << std::endl;
+
+  IncastResult plain, controlled;
+  TEST_ASSERT(compare_incast(64, 512 * 1024, 2, plain, controlled),
+              "64-to-1 incast failed");
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA Link Model Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Round Robin", test_round_robin},
+      {"Weighted", test_weighted},
+      {"Ingress ECN", test_ingress_ecn},
+      {"DCQCN Rate", test_dcqcn_rate},
+      {"Link Timing", test_link_timing},
+      {"Incast Steady State", test_incast_steady_state},
+      {"Incast 64-to-1", test_incast_64_to_1}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
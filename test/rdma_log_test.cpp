@@ -0,0 +1,306 @@
+#include "../include/rdma_log.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+// 收集输出端收到的日志
+struct Captured {
+  std::mutex mutex;
+  std::vector<std::pair<RdmaLogLevel, std::string>> lines;
+
+  void install() {
+    RdmaLogger::set_sink([this](RdmaLogLevel level, std::string_view text) {
+      std::lock_guard<std::mutex> lock(mutex);
+      lines.emplace_back(level, std::string(text));
+    });
+  }
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lines.size();
+  }
+};
+
+static void restore_defaults() {
+  RdmaLogger::flush();
+  RdmaLogger::set_sink(nullptr);
+  RdmaLogger::set_async(true);
+  RdmaLogger::set_level(RdmaLogLevel::INFO);
+}
+
+// 运行期级别在首次使用时才读取环境变量；必须是第一个用到日志器的测试
+bool test_env_level() {
+  std::cout << "\nTesting lazily read RDMA_LOG_LEVEL..." << std::endl;
+
+  setenv("RDMA_LOG_LEVEL", "error", 1);
+  TEST_ASSERT(RdmaLogger::level() == RdmaLogLevel::ERR,
+              "RDMA_LOG_LEVEL not honoured on first use");
+  TEST_ASSERT(!RdmaLogger::enabled(RdmaLogLevel::WARN) &&
+                  RdmaLogger::enabled(RdmaLogLevel::ERR),
+              "Unexpected runtime filtering");
+  unsetenv("RDMA_LOG_LEVEL");
+
+  restore_defaults();
+  return true;
+}
+
+// 运行期级别过滤、编译期删除（参数不求值）、前缀格式和截断
+bool test_levels_and_elision() {
+  std::cout << "\nTesting level filtering and compile-time elision..."
+            << std::endl;
+
+  Captured captured;
+  captured.install();
+  RdmaLogger::set_async(false);
+  RdmaLogger::set_level(RdmaLogLevel::WARN);
+
+  int evaluated = 0;
+  RDMA_LOG_INFO("filtered " << ++evaluated);
+  RDMA_LOG_WARN("kept " << ++evaluated);
+  RDMA_LOG_ERROR(std::hex << 255);
+  TEST_ASSERT(evaluated == 1, "Disabled statement evaluated its arguments");
+  TEST_ASSERT(captured.size() == 2, "Unexpected number of lines");
+  TEST_ASSERT(captured.lines[0].first == RdmaLogLevel::WARN &&
+                  captured.lines[0].second.rfind(
+                      "[WARN] rdma_log_test.cpp:", 0) == 0 &&
+                  captured.lines[0].second.find(" kept 1") !=
+                      std::string::npos,
+              "Unexpected line: " + captured.lines[0].second);
+  TEST_ASSERT(captured.lines[1].second.find(" ff") != std::string::npos,
+              "Unexpected line: " + captured.lines[1].second);
+
+  // 上一条的 std::hex 不影响下一条
+  RDMA_LOG_WARN(255);
+  TEST_ASSERT(captured.lines[2].second.find(" 255") != std::string::npos,
+              "Stream flags leaked between lines");
+
+  // 超长日志截断到定长缓冲
+  RDMA_LOG_WARN(std::string(4 * RDMA_LOG_MAX_LINE, 'x'));
+  TEST_ASSERT(captured.lines[3].second.size() == RDMA_LOG_MAX_LINE,
+              "Long line not truncated");
+
+  // 低于编译期级别的语句即使运行期打开也不存在
+  RdmaLogger::set_level(RdmaLogLevel::TRACE);
+  RDMA_LOG_TRACE("trace " << ++evaluated);
+  RDMA_LOG_DEBUG("debug " << ++evaluated);
+  const int expected =
+      1 + (RDMA_LOG_COMPILE_LEVEL <= 0) + (RDMA_LOG_COMPILE_LEVEL <= 1);
+  TEST_ASSERT(evaluated == expected, "Compile-time elision mismatch");
+
+  restore_defaults();
+  return true;
+}
+
+// 日志参数中再写日志：每层使用各自的缓冲，内层先提交，外层内容不被覆盖
+static int log_nested(int depth) {
+  if (depth > 0) {
+    RDMA_LOG_WARN("inner" << depth << ' ' << log_nested(depth - 1));
+  }
+  return depth;
+}
+
+bool test_nested_lines() {
+  std::cout << "\nTesting log statements nested in log arguments..."
+            << std::endl;
+
+  Captured captured;
+  captured.install();
+  RdmaLogger::set_async(false);
+
+  // 6 层超过线程局部缓冲的层数，最内层的语句使用临时缓冲
+  RDMA_LOG_WARN("outer " << std::hex << 255 << ' ' << log_nested(6)
+                         << " tail");
+  TEST_ASSERT(captured.size() == 7, "Unexpected number of lines");
+  for (int i = 1; i <= 6; ++i) {
+    const std::string &text = captured.lines[i - 1].second;
+    const std::string expected =
+        " inner" + std::to_string(i) + ' ' + std::to_string(i - 1);
+    TEST_ASSERT(text.size() >= expected.size() &&
+                    text.compare(text.size() - expected.size(),
+                                 expected.size(), expected) == 0,
+                "Unexpected nested line: " + text);
+  }
+  const std::string &outer = captured.lines[6].second;
+  TEST_ASSERT(outer.find(" outer ff 6 tail") != std::string::npos,
+              "Outer line corrupted: " + outer);
+
+  restore_defaults();
+  return true;
+}
+
+// 多线程异步写入：flush 后全部到达输出端，每个线程内保持顺序
+bool test_async_multi_thread() {
+  std::cout << "\nTesting asynchronous ring from several threads..."
+            << std::endl;
+
+  const int kThreads = 4;
+  const int kPerThread = 200; // 总数小于环容量，不会丢弃
+  Captured captured;
+  captured.install();
+  RdmaLogStats before = RdmaLogger::get_stats();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([t]() {
+      for (int i = 0; i < kPerThread; ++i) {
+        RDMA_LOG_INFO("t" << t << " " << i);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  RdmaLogger::flush();
+
+  TEST_ASSERT(captured.size() == kThreads * kPerThread, "Lost log lines");
+  std::vector<int> next(kThreads, 0);
+  for (const auto &line : captured.lines) {
+    size_t pos = line.second.find(" t");
+    TEST_ASSERT(pos != std::string::npos, "Unexpected line: " + line.second);
+    int t = std::stoi(line.second.substr(pos + 2));
+    int i = std::stoi(line.second.substr(line.second.find(' ', pos + 2)));
+    TEST_ASSERT(t >= 0 && t < kThreads && i == next[t]++,
+                "Out of order: " + line.second);
+  }
+  RdmaLogStats after = RdmaLogger::get_stats();
+  TEST_ASSERT(after.written - before.written == kThreads * kPerThread &&
+                  after.dropped == before.dropped,
+              "Unexpected log stats");
+
+  restore_defaults();
+  return true;
+}
+
+// 输出端阻塞时环被写满：新日志被丢弃并计数，调用方不被阻塞
+bool test_ring_full_drops() {
+  std::cout << "\nTesting drops when the ring is full..." << std::endl;
+
+  const int kLines = 3 * static_cast<int>(RDMA_LOG_RING_SLOTS);
+  std::atomic<bool> release{false};
+  std::atomic<size_t> delivered{0};
+  std::atomic<bool> saw_note{false};
+  RdmaLogger::set_sink([&](RdmaLogLevel, std::string_view text) {
+    while (!release) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (text.find("log messages dropped") != std::string_view::npos) {
+      saw_note = true;
+    } else {
+      delivered++;
+    }
+  });
+  RdmaLogStats before = RdmaLogger::get_stats();
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kLines; ++i) {
+    RDMA_LOG_INFO("line " << i);
+  }
+  double ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+  release = true;
+  RdmaLogger::flush();
+  // 丢弃提示在下一轮取出时补发
+  RDMA_LOG_INFO("after");
+  RdmaLogger::flush();
+
+  uint64_t dropped = RdmaLogger::get_stats().dropped - before.dropped;
+  TEST_ASSERT(dropped >= kLines - RDMA_LOG_RING_SLOTS - 1,
+              "Expected drops, got " + std::to_string(dropped));
+  TEST_ASSERT(delivered + dropped == static_cast<uint64_t>(kLines) + 1,
+              "Lines neither delivered nor dropped");
+  TEST_ASSERT(saw_note, "Drop note not emitted");
+  TEST_ASSERT(ms < 1000, "Producers blocked on a full ring");
+
+  restore_defaults();
+  return true;
+}
+
+// 每条日志语句在调用线程上的开销
+bool test_cost() {
+  std::cout << "\nMeasuring per-statement cost..." << std::endl;
+
+  const int kIters = 200000;
+  RdmaLogger::set_sink([](RdmaLogLevel, std::string_view) {});
+  RdmaLogger::set_level(RdmaLogLevel::WARN);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIters; ++i) {
+    RDMA_LOG_INFO("Updated QP " << i << " receive queue: depth=" << i);
+  }
+  double disabled_ns = std::chrono::duration<double, std::nano>(
+                           std::chrono::steady_clock::now() - start)
+                           .count() /
+                       kIters;
+
+  // 分批写入并等待输出，避免环满丢弃
+  const int kBatch = static_cast<int>(RDMA_LOG_RING_SLOTS) / 2;
+  RdmaLogger::set_level(RdmaLogLevel::INFO);
+  double enabled_ns = 0;
+  for (int done = 0; done < kIters; done += kBatch) {
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kBatch; ++i) {
+      RDMA_LOG_INFO("Updated QP " << i << " receive queue: depth=" << i);
+    }
+    enabled_ns += std::chrono::duration<double, std::nano>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    RdmaLogger::flush();
+  }
+  enabled_ns /= (kIters / kBatch) * kBatch;
+  std::cout << "  运行期关闭: " << disabled_ns << " ns/条, 异步写入: "
+            << enabled_ns << " ns/条" << std::endl;
+  TEST_ASSERT(disabled_ns < enabled_ns, "Disabled statement is not cheaper");
+
+  restore_defaults();
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA Log Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Env Level", test_env_level},
+      {"Levels And Elision", test_levels_and_elision},
+      {"Nested Lines", test_nested_lines},
+      {"Async Multi Thread", test_async_multi_thread},
+      {"Ring Full Drops", test_ring_full_drops},
+      {"Cost", test_cost}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+      restore_defaults();
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,259 @@
+#include "../include/rdma_device.h"
+#include "../include/rdma_perf_counters.h"
+#include "../include/rdma_types.h"
+#include "rdma_test_util.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+// 投递、完成、轮询计数与实际操作一致，被拒绝的WR计入 post_errors
+bool test_datapath_counts() {
+  std::cout << "\nTesting post/completion/poll counters..." << std::endl;
+
+  RdmaDevice dev;
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p), "Failed to set up QP pair");
+  dev.reset_perf_counters();
+
+  const int kMessages = 10;
+  const uint32_t kLength = 128;
+  TEST_ASSERT(exchange(dev, p, kMessages, kLength), "Exchange failed");
+
+  RdmaPerfSnapshot snap = dev.get_perf_counters();
+  TEST_ASSERT(snap[RdmaCounter::POST_SEND] == kMessages,
+              "post_send=" + std::to_string(snap[RdmaCounter::POST_SEND]));
+  TEST_ASSERT(snap[RdmaCounter::POST_RECV] == kMessages,
+              "post_recv=" + std::to_string(snap[RdmaCounter::POST_RECV]));
+  TEST_ASSERT(snap[RdmaCounter::POST_SEND_BYTES] == kMessages * kLength,
+              "Unexpected post_send_bytes");
+  // 每条消息产生发送端和接收端各一个完成，且全部已被取走
+  TEST_ASSERT(snap[RdmaCounter::CQE] == 2 * kMessages,
+              "cqe=" + std::to_string(snap[RdmaCounter::CQE]));
+  TEST_ASSERT(snap[RdmaCounter::CQE_POLLED] == snap[RdmaCounter::CQE],
+              "Not all completions were counted as polled");
+  TEST_ASSERT(snap[RdmaCounter::CQE_ERRORS] == 0, "Unexpected error CQEs");
+  TEST_ASSERT(snap[RdmaCounter::POLL_CQ] ==
+                  snap[RdmaCounter::POLL_CQ_EMPTY] + 2 * kMessages,
+              "Every non-empty poll returned exactly one completion");
+  TEST_ASSERT(snap[RdmaCounter::POST_ERRORS] == 0, "Unexpected post errors");
+  TEST_ASSERT(snap[RdmaCounter::QP_HIT_DEVICE] > 0 &&
+                  snap[RdmaCounter::QP_HIT_HOST] == 0,
+              "Device-resident QPs should hit the device table");
+
+  // 不存在的QP：投递被拒绝，查找计为未命中
+  RdmaWorkRequest wr;
+  wr.opcode = RdmaOpcode::SEND;
+  TEST_ASSERT(!dev.post_send(p.qp_b + 1000, wr), "Post to bogus QP accepted");
+  snap = dev.get_perf_counters();
+  TEST_ASSERT(snap[RdmaCounter::POST_ERRORS] == 1, "Post error not counted");
+  TEST_ASSERT(snap[RdmaCounter::QP_MISS] >= 1, "QP miss not counted");
+  TEST_ASSERT(snap[RdmaCounter::POST_SEND] == kMessages,
+              "Rejected post counted as posted");
+
+  return true;
+}
+
+// 设备表容量为0且关闭中间缓存时，QP/CQ 访问都计为主机交换表命中
+bool test_tier_counters() {
+  std::cout << "\nTesting QP/CQ tier hit counters..." << std::endl;
+
+  RdmaDevice::set_simulation_mode(false);
+  bool ok = [&]() {
+    RdmaDevice dev(/*max_connections=*/16, /*max_qps=*/0, /*max_cqs=*/0);
+    QpPair p;
+    TEST_ASSERT(setup_pair(dev, p), "Failed to set up QP pair");
+    dev.reset_perf_counters();
+    TEST_ASSERT(exchange(dev, p, 4, 64), "Exchange failed");
+
+    RdmaPerfSnapshot snap = dev.get_perf_counters();
+    std::cout << snap.to_string();
+    TEST_ASSERT(snap[RdmaCounter::QP_HIT_HOST] > 0 &&
+                    snap[RdmaCounter::QP_HIT_DEVICE] == 0 &&
+                    snap[RdmaCounter::QP_HIT_CACHE] == 0,
+                "QP accesses should all come from the host table");
+    TEST_ASSERT(snap[RdmaCounter::CQ_HIT_HOST] > 0 &&
+                    snap[RdmaCounter::CQ_HIT_DEVICE] == 0,
+                "CQ accesses should all come from the host table");
+    return true;
+  }();
+  RdmaDevice::set_simulation_mode(true);
+  return ok;
+}
+
+// 多线程并发递增：各线程落在不同分片上，汇总后不丢计数
+bool test_multi_thread_aggregation() {
+  std::cout << "\nTesting per-thread stripes aggregate exactly..."
+            << std::endl;
+
+  RdmaDevice dev;
+  uint32_t cq = dev.create_cq(16);
+  TEST_ASSERT(cq != 0, "Failed to create CQ");
+  dev.reset_perf_counters();
+
+  const int kThreads = 8;
+  const int kPolls = 20000;
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&]() {
+      std::vector<CompletionEntry> comps;
+      for (int i = 0; i < kPolls; ++i) {
+        dev.poll_cq(cq, comps, 1);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double ns = std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - start)
+                  .count() /
+              (kThreads * kPolls);
+
+  RdmaPerfSnapshot snap = dev.get_perf_counters();
+  std::cout << "  空轮询: " << ns << " ns/次, cq锁竞争 "
+            << snap[RdmaCounter::CQ_LOCK_CONTENDED] << " 次" << std::endl;
+  TEST_ASSERT(snap[RdmaCounter::POLL_CQ] == kThreads * kPolls,
+              "poll_cq=" + std::to_string(snap[RdmaCounter::POLL_CQ]));
+  TEST_ASSERT(snap[RdmaCounter::POLL_CQ_EMPTY] == kThreads * kPolls,
+              "Unexpected empty poll count");
+
+  // 计数器组本身：超过分片数的线程共用分片，计数仍然准确
+  RdmaPerfCounters counters;
+  const int kManyThreads = static_cast<int>(RdmaPerfCounters::kStripes) + 8;
+  threads.clear();
+  for (int t = 0; t < kManyThreads; ++t) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < 1000; ++i) {
+        counters.add(RdmaCounter::CQE);
+      }
+      counters.add(RdmaCounter::POST_SEND_BYTES, 4096);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  counters.read(snap);
+  TEST_ASSERT(snap[RdmaCounter::CQE] == kManyThreads * 1000ULL,
+              "Lost increments with shared stripes");
+  TEST_ASSERT(snap[RdmaCounter::POST_SEND_BYTES] == kManyThreads * 4096ULL,
+              "Lost byte increments");
+
+  return true;
+}
+
+// 锁竞争计数：加锁时锁已被占用才计数
+bool test_lock_contention() {
+  std::cout << "\nTesting contended lock counting..." << std::endl;
+
+  RdmaCountedMutex mutex;
+  {
+    std::lock_guard<RdmaCountedMutex> lock(mutex);
+  }
+  TEST_ASSERT(mutex.contended() == 0, "Uncontended lock counted");
+
+  std::atomic<bool> acquired{false};
+  bool acquired_while_held = false;
+  std::thread waiter;
+  {
+    std::lock_guard<RdmaCountedMutex> lock(mutex);
+    waiter = std::thread([&]() {
+      std::lock_guard<RdmaCountedMutex> inner(mutex);
+      acquired = true;
+    });
+    // 等待另一线程进入阻塞加锁
+    for (int i = 0; i < 1000 && mutex.contended() == 0; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    acquired_while_held = acquired;
+  }
+  waiter.join();
+  TEST_ASSERT(!acquired_while_held, "Lock acquired while held");
+  TEST_ASSERT(acquired && mutex.contended() == 1,
+              "contended=" + std::to_string(mutex.contended()));
+  mutex.reset_contended();
+  TEST_ASSERT(mutex.contended() == 0, "reset_contended failed");
+
+  return true;
+}
+
+// 重置与格式化输出
+bool test_reset_and_format() {
+  std::cout << "\nTesting reset and formatting..." << std::endl;
+
+  RdmaDevice dev;
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p), "Failed to set up QP pair");
+  TEST_ASSERT(exchange(dev, p, 2, 32), "Exchange failed");
+
+  std::string text = dev.get_perf_counters().to_string();
+  TEST_ASSERT(text.find("post_send: 2\n") != std::string::npos &&
+                  text.find("post_send_bytes: 64\n") != std::string::npos,
+              "Unexpected text:\n" + text);
+  TEST_ASSERT(text.find("cqe_errors") == std::string::npos,
+              "Zero counter not skipped");
+  TEST_ASSERT(std::string(rdma_counter_name(RdmaCounter::QP_HIT_HOST)) ==
+                  "qp_hit_host",
+              "Unexpected counter name");
+
+  dev.reset_perf_counters();
+  RdmaPerfSnapshot snap = dev.get_perf_counters();
+  for (size_t i = 0; i < RDMA_COUNTER_COUNT; ++i) {
+    TEST_ASSERT(snap.values[i] == 0, std::string("Counter not reset: ") +
+                                         rdma_counter_name(
+                                             static_cast<RdmaCounter>(i)));
+  }
+  TEST_ASSERT(snap.to_string().empty(), "Reset snapshot should print empty");
+  TEST_ASSERT(snap.to_string(false).find("cqe_errors: 0\n") !=
+                  std::string::npos,
+              "Full format should list zero counters");
+
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA Perf Counter Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Datapath Counts", test_datapath_counts},
+      {"Tier Counters", test_tier_counters},
+      {"Multi Thread Aggregation", test_multi_thread_aggregation},
+      {"Lock Contention", test_lock_contention},
+      {"Reset And Format", test_reset_and_format}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
@@ -60,9 +60,7 @@ public:
         }
         
         std::vector<CompletionEntry> comps;
-        while (!dev.poll_cq(cq, comps, 1)) {
-            std::this_thread::sleep_for(std::chrono::microseconds(1));
-        }
+        dev.wait_cq(cq, comps, 1);
         auto t1 = Clock::now();
         
         total_bytes_transferred_ += len;
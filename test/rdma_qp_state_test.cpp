@@ -0,0 +1,340 @@
+#include "../include/rdma_device.h"
+#include "../include/rdma_types.h"
+#include "rdma_test_util.h"
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+static bool post_recv_buf(RdmaDevice &dev, uint32_t qp, uint64_t wr_id) {
+  static char buf[64];
+  RdmaWorkRequest wr;
+  wr.opcode = RdmaOpcode::RECV;
+  wr.local_addr = buf;
+  wr.length = sizeof(buf);
+  wr.wr_id = wr_id;
+  return dev.post_recv(qp, wr);
+}
+
+static bool post_send_buf(RdmaDevice &dev, uint32_t qp, uint64_t wr_id) {
+  static char buf[64] = "payload";
+  RdmaWorkRequest wr;
+  wr.opcode = RdmaOpcode::SEND;
+  wr.local_addr = buf;
+  wr.length = sizeof(buf);
+  wr.wr_id = wr_id;
+  return dev.post_send(qp, wr);
+}
+
+// 属性掩码：缺少必需属性或带有不允许的属性时迁移失败
+bool test_attr_masks() {
+  std::cout << "\nTesting QP attribute masks..." << std::endl;
+
+  RdmaDevice dev;
+  uint32_t cq = dev.create_cq(16);
+  uint32_t qp = dev.create_qp(8, 8, cq, cq);
+  uint32_t peer = dev.create_qp(8, 8, cq, cq);
+  TEST_ASSERT(cq && qp && peer, "Failed to create resources");
+
+  QpAttr attr;
+  attr.qp_state = QpState::INIT;
+  attr.port_num = 1;
+  attr.qp_access_flags = 0x7;
+  TEST_ASSERT(!dev.modify_qp(qp, attr, QP_ATTR_STATE | QP_ATTR_PORT),
+              "RESET->INIT without PKEY_INDEX/ACCESS_FLAGS should fail");
+  TEST_ASSERT(!dev.modify_qp(qp, attr,
+                             QP_ATTR_STATE | QP_ATTR_PKEY_INDEX |
+                                 QP_ATTR_PORT | QP_ATTR_ACCESS_FLAGS |
+                                 QP_ATTR_SQ_PSN),
+              "RESET->INIT with SQ_PSN should fail");
+  TEST_ASSERT(dev.modify_qp(qp, attr,
+                            QP_ATTR_STATE | QP_ATTR_PKEY_INDEX | QP_ATTR_PORT |
+                                QP_ATTR_ACCESS_FLAGS),
+              "RESET->INIT failed");
+
+  attr.qp_state = QpState::RTR;
+  attr.path_mtu = 2048;
+  attr.dest_qp_num = peer;
+  attr.rq_psn = 0x100;
+  attr.min_rnr_timer = 5;
+  const uint32_t rtr_mask = QP_ATTR_STATE | QP_ATTR_AV | QP_ATTR_PATH_MTU |
+                            QP_ATTR_DEST_QPN | QP_ATTR_RQ_PSN |
+                            QP_ATTR_MAX_DEST_RD_ATOMIC | QP_ATTR_MIN_RNR_TIMER;
+  TEST_ASSERT(!dev.modify_qp(qp, attr, rtr_mask & ~QP_ATTR_DEST_QPN),
+              "INIT->RTR without DEST_QPN should fail");
+  attr.path_mtu = 1000;
+  TEST_ASSERT(!dev.modify_qp(qp, attr, rtr_mask), "Invalid MTU should fail");
+  attr.path_mtu = 2048;
+  TEST_ASSERT(dev.modify_qp(qp, attr, rtr_mask), "INIT->RTR failed");
+
+  attr.qp_state = QpState::RTS;
+  attr.sq_psn = 0x200;
+  attr.timeout = 10;
+  attr.retry_cnt = 3;
+  attr.rnr_retry = 2;
+  const uint32_t rts_mask = QP_ATTR_STATE | QP_ATTR_SQ_PSN | QP_ATTR_TIMEOUT |
+                            QP_ATTR_RETRY_CNT | QP_ATTR_RNR_RETRY |
+                            QP_ATTR_MAX_QP_RD_ATOMIC;
+  attr.cur_qp_state = QpState::INIT;
+  TEST_ASSERT(!dev.modify_qp(qp, attr, rts_mask | QP_ATTR_CUR_STATE),
+              "Mismatched CUR_STATE should fail");
+  attr.cur_qp_state = QpState::RTR;
+  TEST_ASSERT(dev.modify_qp(qp, attr, rts_mask | QP_ATTR_CUR_STATE),
+              "RTR->RTS failed");
+
+  QPValue info;
+  dev.get_qp_info(qp, info);
+  TEST_ASSERT(info.state == QpState::RTS, "QP should be in RTS");
+  TEST_ASSERT(info.mtu == 2048 && info.dest_qp_num == peer,
+              "RTR attributes not applied");
+  TEST_ASSERT(info.rq_psn == 0x100 && info.sq_psn == 0x200,
+              "PSN attributes not applied");
+  TEST_ASSERT(info.timeout == 10 && info.retry_cnt == 3 &&
+                  info.rnr_retry == 2 && info.min_rnr_timer == 5,
+              "RTS attributes not applied");
+
+  // 不带 STATE 的修改视为 RTS->RTS，只允许可选属性
+  attr.min_rnr_timer = 7;
+  TEST_ASSERT(dev.modify_qp(qp, attr, QP_ATTR_MIN_RNR_TIMER),
+              "RTS->RTS with MIN_RNR_TIMER failed");
+  TEST_ASSERT(!dev.modify_qp(qp, attr, QP_ATTR_PATH_MTU),
+              "RTS->RTS with PATH_MTU should fail");
+
+  // 非法迁移
+  TEST_ASSERT(!dev.modify_qp_state(qp, QpState::RTR), "RTS->RTR should fail");
+  TEST_ASSERT(!dev.modify_qp_state(qp, QpState::SQE), "RTS->SQE should fail");
+  TEST_ASSERT(dev.modify_qp_state(qp, QpState::SQD), "RTS->SQD failed");
+  TEST_ASSERT(dev.modify_qp_state(qp, QpState::RTS), "SQD->RTS failed");
+  TEST_ASSERT(dev.modify_qp_state(qp, QpState::ERR), "RTS->ERR failed");
+  TEST_ASSERT(!dev.modify_qp_state(qp, QpState::INIT), "ERR->INIT should fail");
+  TEST_ASSERT(dev.modify_qp_state(qp, QpState::RESET), "ERR->RESET failed");
+  TEST_ASSERT(dev.modify_qp_state(qp, QpState::INIT), "RESET->INIT failed");
+  return true;
+}
+
+// 进入 ERR：已投递的接收WQE和在途的发送全部以 WR_FLUSH_ERR 完成
+bool test_flush_on_error() {
+  std::cout << "\nTesting flush on error..." << std::endl;
+
+  RdmaDevice dev;
+  // 较大的传播时延让发送在进入 ERR 时仍在途
+  LinkConfig link;
+  link.propagation_delay_ns = 5000000;
+  dev.configure_link(link);
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p), "Failed to set up QP pair");
+
+  for (uint64_t i = 1; i <= 4; ++i) {
+    TEST_ASSERT(post_recv_buf(dev, p.qp_a, 100 + i), "post_recv failed");
+  }
+  for (uint64_t i = 1; i <= 3; ++i) {
+    TEST_ASSERT(post_send_buf(dev, p.qp_a, i), "post_send failed");
+  }
+  TEST_ASSERT(dev.modify_qp_state(p.qp_a, QpState::ERR), "RTS->ERR failed");
+
+  std::vector<CompletionEntry> comps;
+  dev.poll_cq(p.cq_a, comps, 64);
+  TEST_ASSERT(comps.size() == 7, "Every WQE should be flushed");
+  size_t sends = 0;
+  size_t recvs = 0;
+  for (const auto &c : comps) {
+    TEST_ASSERT(c.status == WcStatus::WR_FLUSH_ERR, "Expected WR_FLUSH_ERR");
+    if (c.opcode == RdmaOpcode::RECV) {
+      TEST_ASSERT(c.wr_id == 100 + ++recvs, "Receive flush out of order");
+    } else {
+      TEST_ASSERT(c.wr_id == ++sends, "Send flush out of order");
+    }
+  }
+  TEST_ASSERT(sends == 3 && recvs == 4, "Unexpected flush mix");
+  TEST_ASSERT(!post_send_buf(dev, p.qp_a, 9), "Post in ERR should fail");
+
+  // 被冲刷的发送在确认到达时不再产生完成
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  comps.clear();
+  TEST_ASSERT(!dev.poll_cq(p.cq_a, comps, 64), "Flushed send completed twice");
+
+  // RESET 丢弃WQE且不产生完成
+  TEST_ASSERT(post_recv_buf(dev, p.qp_b, 1), "post_recv failed");
+  TEST_ASSERT(dev.modify_qp_state(p.qp_b, QpState::RESET), "->RESET failed");
+  comps.clear();
+  while (dev.poll_cq(p.cq_b, comps, 64)) {
+  }
+  for (const auto &c : comps) {
+    TEST_ASSERT(c.status != WcStatus::WR_FLUSH_ERR,
+                "RESET should not produce flush completions");
+  }
+  return true;
+}
+
+// SQD：在途发送全部完成后产生 SQ_DRAINED，期间不接受新的发送
+bool test_send_queue_drain() {
+  std::cout << "\nTesting send queue drain..." << std::endl;
+
+  RdmaDevice dev;
+  LinkConfig link;
+  link.propagation_delay_ns = 2000000;
+  dev.configure_link(link);
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p), "Failed to set up QP pair");
+
+  TEST_ASSERT(post_recv_buf(dev, p.qp_b, 1), "post_recv failed");
+  TEST_ASSERT(post_send_buf(dev, p.qp_a, 1), "post_send failed");
+  TEST_ASSERT(dev.modify_qp_state(p.qp_a, QpState::SQD), "RTS->SQD failed");
+  TEST_ASSERT(!post_send_buf(dev, p.qp_a, 2), "Post in SQD should fail");
+
+  AsyncEvent event;
+  TEST_ASSERT(!dev.get_async_event(event, 0), "Drained before the ACK");
+  TEST_ASSERT(dev.get_async_event(event, 1000), "No SQ_DRAINED event");
+  TEST_ASSERT(event.type == AsyncEventType::SQ_DRAINED &&
+                  event.element == p.qp_a,
+              "Unexpected async event");
+  std::vector<CompletionEntry> comps;
+  TEST_ASSERT(dev.poll_cq(p.cq_a, comps, 16) &&
+                  comps.front().status == WcStatus::SUCCESS,
+              "In-flight send should complete normally");
+
+  TEST_ASSERT(dev.modify_qp_state(p.qp_a, QpState::RTS), "SQD->RTS failed");
+  TEST_ASSERT(post_send_buf(dev, p.qp_a, 3), "Post after SQD->RTS failed");
+  return true;
+}
+
+// 排空前 SQD->RTS：撤销排空等待，之后的确认不再产生 SQ_DRAINED
+bool test_send_queue_drain_cancelled() {
+  std::cout << "\nTesting SQD->RTS before the drain completes..." << std::endl;
+
+  RdmaDevice dev;
+  LinkConfig link;
+  link.propagation_delay_ns = 2000000;
+  dev.configure_link(link);
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p), "Failed to set up QP pair");
+
+  TEST_ASSERT(post_recv_buf(dev, p.qp_b, 1), "post_recv failed");
+  TEST_ASSERT(post_send_buf(dev, p.qp_a, 1), "post_send failed");
+  TEST_ASSERT(dev.modify_qp_state(p.qp_a, QpState::SQD), "RTS->SQD failed");
+  TEST_ASSERT(dev.modify_qp_state(p.qp_a, QpState::RTS), "SQD->RTS failed");
+
+  std::vector<CompletionEntry> comps;
+  TEST_ASSERT(collect(dev, p.cq_a, 1, comps) &&
+                  comps.front().status == WcStatus::SUCCESS,
+              "In-flight send should complete normally");
+  AsyncEvent event;
+  TEST_ASSERT(!dev.get_async_event(event, 10),
+              "SQ_DRAINED raised for a QP back in RTS");
+  return true;
+}
+
+// 引擎模式：提交环中尚未上线的WR同样算作未完成，SQ_DRAINED 在它们全部完成之后产生
+bool test_send_queue_drain_with_engines() {
+  std::cout << "\nTesting send queue drain with send engines..." << std::endl;
+
+  RdmaDevice dev;
+  EngineConfig engines;
+  engines.num_engines = 1;
+  TEST_ASSERT(dev.configure_engines(engines), "configure_engines failed");
+  QpPair p;
+  TEST_ASSERT(setup_pair(dev, p), "Failed to set up QP pair");
+
+  const int kSends = 16;
+  for (int i = 0; i < kSends; ++i) {
+    TEST_ASSERT(post_recv_buf(dev, p.qp_b, i), "post_recv failed");
+  }
+  for (int i = 0; i < kSends; ++i) {
+    TEST_ASSERT(post_send_buf(dev, p.qp_a, i), "post_send failed");
+  }
+  TEST_ASSERT(dev.modify_qp_state(p.qp_a, QpState::SQD), "RTS->SQD failed");
+
+  AsyncEvent event;
+  TEST_ASSERT(dev.get_async_event(event, 1000), "No SQ_DRAINED event");
+  TEST_ASSERT(event.type == AsyncEventType::SQ_DRAINED &&
+                  event.element == p.qp_a,
+              "Unexpected async event");
+  std::vector<CompletionEntry> comps;
+  dev.poll_cq(p.cq_a, comps, 64);
+  TEST_ASSERT(comps.size() == kSends,
+              "SQ_DRAINED raised before all queued sends completed");
+  return true;
+}
+
+// 大量QP同时进入 ERR 时的冲刷耗时
+bool test_mass_failover() {
+  std::cout << "\nTesting mass failover flush..." << std::endl;
+
+  const int kQps = 2000;
+  const int kRecvPerQp = 8;
+  RdmaDevice dev(1000, kQps, 8, 16, 16);
+  uint32_t cq = dev.create_cq(kQps * kRecvPerQp);
+  TEST_ASSERT(cq != 0, "Failed to create CQ");
+  std::vector<uint32_t> qps;
+  for (int i = 0; i < kQps; ++i) {
+    uint32_t qp = dev.create_qp(4, kRecvPerQp, cq, cq);
+    TEST_ASSERT(qp != 0, "Failed to create QP");
+    dev.modify_qp_state(qp, QpState::INIT);
+    for (int j = 0; j < kRecvPerQp; ++j) {
+      TEST_ASSERT(post_recv_buf(dev, qp, j), "post_recv failed");
+    }
+    qps.push_back(qp);
+  }
+
+  auto t0 = std::chrono::steady_clock::now();
+  for (uint32_t qp : qps) {
+    TEST_ASSERT(dev.modify_qp_state(qp, QpState::ERR), "->ERR failed");
+  }
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - t0)
+                .count();
+
+  std::vector<CompletionEntry> comps;
+  while (dev.poll_cq(cq, comps, 4096)) {
+  }
+  std::cout << kQps << " QPs -> ERR in " << us << " us, "
+            << comps.size() << " flush completions" << std::endl;
+  TEST_ASSERT(comps.size() == static_cast<size_t>(kQps * kRecvPerQp),
+              "Missing flush completions");
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA QP State Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Attribute Masks", test_attr_masks},
+      {"Flush On Error", test_flush_on_error},
+      {"Send Queue Drain", test_send_queue_drain},
+      {"Send Queue Drain Cancelled", test_send_queue_drain_cancelled},
+      {"Send Queue Drain With Engines", test_send_queue_drain_with_engines},
+      {"Mass Failover", test_mass_failover}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
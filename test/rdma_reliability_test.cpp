@@ -0,0 +1,474 @@
+#include "../include/rdma_device.h"
+#include "../include/rdma_types.h"
+#include "rdma_test_util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+// RC可靠性参数（对应 ibv_qp_attr 中的同名字段）
+struct RcParams {
+  uint8_t timeout = 14;
+  uint8_t retry_cnt = 7;
+  uint8_t rnr_retry = 7;
+  uint8_t min_rnr_timer = 12;
+};
+
+static bool bring_up(RdmaDevice &dev, uint32_t qp, const QPValue &local,
+                     const QPValue &peer, const RcParams &params) {
+  QpAttr attr;
+  attr.qp_state = QpState::INIT;
+  attr.qp_access_flags = 0x7;
+  if (!dev.modify_qp(qp, attr,
+                     QP_ATTR_STATE | QP_ATTR_PKEY_INDEX | QP_ATTR_PORT |
+                         QP_ATTR_ACCESS_FLAGS)) {
+    return false;
+  }
+  attr.qp_state = QpState::RTR;
+  attr.path_mtu = 1024;
+  attr.dest_qp_num = peer.qp_num;
+  attr.rq_psn = peer.psn;
+  attr.min_rnr_timer = params.min_rnr_timer;
+  if (!dev.modify_qp(qp, attr,
+                     QP_ATTR_STATE | QP_ATTR_AV | QP_ATTR_PATH_MTU |
+                         QP_ATTR_DEST_QPN | QP_ATTR_RQ_PSN |
+                         QP_ATTR_MAX_DEST_RD_ATOMIC | QP_ATTR_MIN_RNR_TIMER)) {
+    return false;
+  }
+  attr.qp_state = QpState::RTS;
+  attr.sq_psn = local.psn;
+  attr.timeout = params.timeout;
+  attr.retry_cnt = params.retry_cnt;
+  attr.rnr_retry = params.rnr_retry;
+  return dev.modify_qp(qp, attr,
+                       QP_ATTR_STATE | QP_ATTR_SQ_PSN | QP_ATTR_TIMEOUT |
+                           QP_ATTR_RETRY_CNT | QP_ATTR_RNR_RETRY |
+                           QP_ATTR_MAX_QP_RD_ATOMIC);
+}
+
+// 同一设备上的一对互联QP，通过 modify_qp 带属性掩码建链
+static bool setup_rc_pair(RdmaDevice &dev, QpPair &p, const RcParams &params,
+                          uint32_t depth = 16) {
+  PairConfig config;
+  config.depth = depth;
+  config.cqe = depth * 2;
+  if (!create_pair(dev, p, config)) {
+    return false;
+  }
+  QPValue info_a, info_b;
+  dev.get_qp_info(p.qp_a, info_a);
+  dev.get_qp_info(p.qp_b, info_b);
+  return bring_up(dev, p.qp_a, info_a, info_b, params) &&
+         bring_up(dev, p.qp_b, info_b, info_a, params);
+}
+
+static bool post(RdmaDevice &dev, uint32_t qp, RdmaOpcode opcode, void *buf,
+                 uint32_t length, uint64_t wr_id, void *remote = nullptr) {
+  RdmaWorkRequest wr;
+  wr.opcode = opcode;
+  wr.local_addr = buf;
+  wr.length = length;
+  wr.wr_id = wr_id;
+  wr.remote_addr = remote;
+  return opcode == RdmaOpcode::RECV ? dev.post_recv(qp, wr)
+                                    : dev.post_send(qp, wr);
+}
+
+static QpState qp_state(RdmaDevice &dev, uint32_t qp) {
+  QPValue info;
+  dev.get_qp_info(qp, info);
+  return info.state;
+}
+
+// 5% 丢包下多包消息仍按序、完整地交付：丢包由乱序触发的NAK或ACK超时恢复
+bool test_loss_recovery() {
+  std::cout << "\nTesting go-back-N recovery under loss..." << std::endl;
+
+  RdmaDevice dev;
+  LinkConfig link;
+  link.bandwidth_gbps = 100;
+  link.propagation_delay_ns = 1000;
+  link.loss_probability = 0.05;
+  dev.configure_link(link);
+
+  RcParams params;
+  params.timeout = 8; // 约1ms
+  QpPair p;
+  TEST_ASSERT(setup_rc_pair(dev, p, params, 64), "Failed to set up QP pair");
+
+  const uint32_t kMessages = 64;
+  const uint32_t kLength = 4096;
+  std::vector<std::vector<char>> send_bufs(kMessages);
+  std::vector<std::vector<char>> recv_bufs(kMessages);
+  for (uint32_t i = 0; i < kMessages; ++i) {
+    send_bufs[i].assign(kLength, static_cast<char>(i + 1));
+    recv_bufs[i].assign(kLength, 0);
+    TEST_ASSERT(post(dev, p.qp_b, RdmaOpcode::RECV, recv_bufs[i].data(),
+                     kLength, 1000 + i),
+                "post_recv failed");
+  }
+  for (uint32_t i = 0; i < kMessages; ++i) {
+    TEST_ASSERT(post(dev, p.qp_a, RdmaOpcode::SEND, send_bufs[i].data(),
+                     kLength, i),
+                "post_send failed");
+  }
+
+  std::vector<CompletionEntry> sends, recvs;
+  TEST_ASSERT(collect(dev, p.cq_a, kMessages, sends), "Missing send completions");
+  TEST_ASSERT(collect(dev, p.cq_b, kMessages, recvs), "Missing recv completions");
+  for (uint32_t i = 0; i < kMessages; ++i) {
+    TEST_ASSERT(sends[i].status == WcStatus::SUCCESS && sends[i].wr_id == i,
+                "Send completion out of order or failed");
+    TEST_ASSERT(recvs[i].status == WcStatus::SUCCESS &&
+                    recvs[i].wr_id == 1000 + i,
+                "Recv completion out of order or failed");
+    TEST_ASSERT(recv_bufs[i] == send_bufs[i], "Payload corrupted");
+  }
+
+  TransportStats stats = dev.get_transport_stats();
+  LinkStats link_stats = dev.get_link_stats();
+  std::cout << "lost=" << link_stats.lost_packets
+            << " retransmitted=" << stats.tx_retransmitted
+            << " seq_naks=" << stats.seq_naks
+            << " timeouts=" << stats.ack_timeouts
+            << " duplicates=" << stats.rx_duplicate << std::endl;
+  TEST_ASSERT(link_stats.lost_packets > 0, "Expected some packet loss");
+  TEST_ASSERT(stats.tx_retransmitted >= link_stats.lost_packets,
+              "Every lost packet must be retransmitted");
+  TEST_ASSERT(stats.rx_packets == kMessages * 4, "Unexpected accepted packets");
+  TEST_ASSERT(qp_state(dev, p.qp_a) == QpState::RTS, "QP left RTS");
+  return true;
+}
+
+// 响应端QP在中间缓存中：缺口状态随上下文写回，每个丢包至多引起一次序列NAK
+bool test_loss_recovery_cached() {
+  std::cout << "\nTesting one NAK per gap with a cached responder..."
+            << std::endl;
+
+  RdmaDevice::set_simulation_mode(true);
+  bool ok = [] {
+    RdmaDevice dev(/*max_connections=*/16, /*max_qps=*/1);
+    LinkConfig link;
+    link.bandwidth_gbps = 100;
+    link.propagation_delay_ns = 1000;
+    link.loss_probability = 0.05;
+    dev.configure_link(link);
+
+    RcParams params;
+    params.timeout = 8;
+    QpPair p; // qp_a 在设备表，qp_b 溢出到中间缓存
+    TEST_ASSERT(setup_rc_pair(dev, p, params, 64), "Failed to set up QP pair");
+
+    const uint32_t kMessages = 64;
+    const uint32_t kLength = 4096;
+    std::vector<char> src(kLength, 'c');
+    std::vector<std::vector<char>> dst(kMessages, std::vector<char>(kLength));
+    for (uint32_t i = 0; i < kMessages; ++i) {
+      TEST_ASSERT(post(dev, p.qp_b, RdmaOpcode::RECV, dst[i].data(), kLength,
+                       i),
+                  "post_recv failed");
+    }
+    for (uint32_t i = 0; i < kMessages; ++i) {
+      TEST_ASSERT(post(dev, p.qp_a, RdmaOpcode::SEND, src.data(), kLength, i),
+                  "post_send failed");
+    }
+    std::vector<CompletionEntry> sends, recvs;
+    TEST_ASSERT(collect(dev, p.cq_a, kMessages, sends),
+                "Missing send completions");
+    TEST_ASSERT(collect(dev, p.cq_b, kMessages, recvs),
+                "Missing recv completions");
+    for (uint32_t i = 0; i < kMessages; ++i) {
+      TEST_ASSERT(dst[i] == src, "Payload corrupted");
+    }
+
+    TransportStats stats = dev.get_transport_stats();
+    LinkStats link_stats = dev.get_link_stats();
+    std::cout << "lost=" << link_stats.lost_packets
+              << " seq_naks=" << stats.seq_naks
+              << " out_of_sequence=" << stats.rx_out_of_sequence << std::endl;
+    TEST_ASSERT(link_stats.lost_packets > 0, "Expected some packet loss");
+    TEST_ASSERT(stats.seq_naks <= link_stats.lost_packets,
+                "More sequence NAKs than gaps");
+    return true;
+  }();
+  RdmaDevice::set_simulation_mode(false);
+  return ok;
+}
+
+// 没有接收WQE时回 RNR NAK：重试次数内投递接收即可交付，耗尽后以
+// RNR_RETRY_EXC_ERR 完成并把QP置为 ERR，其后的发送被冲刷
+bool test_rnr_retry() {
+  std::cout << "\nTesting RNR NAK and rnr_retry..." << std::endl;
+
+  char payload[256] = "rnr";
+  char recv_buf[256];
+
+  // 无链路模型的同步路径：RNR 之后同一QP的发送排在其后，保持顺序
+  {
+    RdmaDevice dev;
+    RcParams params;
+    params.min_rnr_timer = 1; // 10us
+    QpPair p;
+    TEST_ASSERT(setup_rc_pair(dev, p, params), "Failed to set up QP pair");
+    TEST_ASSERT(post(dev, p.qp_a, RdmaOpcode::SEND, payload, 256, 1),
+                "post_send failed");
+    TEST_ASSERT(post(dev, p.qp_a, RdmaOpcode::SEND, payload, 256, 2),
+                "post_send failed");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    TEST_ASSERT(dev.get_transport_stats().rnr_naks >= 1, "Expected RNR NAK");
+    TEST_ASSERT(post(dev, p.qp_b, RdmaOpcode::RECV, recv_buf, 256, 11),
+                "post_recv failed");
+    TEST_ASSERT(post(dev, p.qp_b, RdmaOpcode::RECV, recv_buf, 256, 12),
+                "post_recv failed");
+    std::vector<CompletionEntry> sends, recvs;
+    TEST_ASSERT(collect(dev, p.cq_a, 2, sends), "Missing send completions");
+    TEST_ASSERT(collect(dev, p.cq_b, 2, recvs), "Missing recv completions");
+    TEST_ASSERT(sends[0].wr_id == 1 && sends[1].wr_id == 2,
+                "Send completions out of order");
+    TEST_ASSERT(recvs[0].wr_id == 11 && recvs[1].wr_id == 12 &&
+                    recvs[0].status == WcStatus::SUCCESS,
+                "Recv completions out of order");
+  }
+
+  // 链路路径：rnr_retry=2 共发送3次后失败
+  {
+    RdmaDevice dev;
+    dev.set_link_bandwidth(100.0);
+    RcParams params;
+    params.min_rnr_timer = 14; // 1.28ms，两次 post_send 之间QP不会先失败
+    params.rnr_retry = 2;
+    QpPair p;
+    TEST_ASSERT(setup_rc_pair(dev, p, params), "Failed to set up QP pair");
+    TEST_ASSERT(post(dev, p.qp_a, RdmaOpcode::SEND, payload, 256, 1),
+                "post_send failed");
+    TEST_ASSERT(post(dev, p.qp_a, RdmaOpcode::SEND, payload, 256, 2),
+                "post_send failed");
+    std::vector<CompletionEntry> sends;
+    TEST_ASSERT(collect(dev, p.cq_a, 2, sends), "Missing send completions");
+    TEST_ASSERT(sends[0].wr_id == 1 &&
+                    sends[0].status == WcStatus::RNR_RETRY_EXC_ERR,
+                "First send should fail with RNR_RETRY_EXC_ERR");
+    TEST_ASSERT(sends[1].wr_id == 2 &&
+                    sends[1].status == WcStatus::WR_FLUSH_ERR,
+                "Queued send should be flushed");
+    TEST_ASSERT(dev.get_transport_stats().rnr_naks == 3,
+                "Expected one RNR NAK per attempt");
+    TEST_ASSERT(qp_state(dev, p.qp_a) == QpState::ERR, "QP should be in ERR");
+  }
+  return true;
+}
+
+// 报文全部丢失：每次ACK超时重传一次，retry_cnt 次之后以 RETRY_EXC_ERR 完成
+bool test_retry_exceeded() {
+  std::cout << "\nTesting ACK timeout and retry_cnt..." << std::endl;
+
+  RdmaDevice dev;
+  LinkConfig link;
+  link.bandwidth_gbps = 100;
+  link.loss_probability = 1.0;
+  dev.configure_link(link);
+
+  RcParams params;
+  params.timeout = 4; // 约65us
+  params.retry_cnt = 2;
+  QpPair p;
+  TEST_ASSERT(setup_rc_pair(dev, p, params), "Failed to set up QP pair");
+
+  char payload[64] = "lost";
+  TEST_ASSERT(post(dev, p.qp_a, RdmaOpcode::RDMA_WRITE, payload, 64, 1),
+              "post_send failed");
+  TEST_ASSERT(post(dev, p.qp_a, RdmaOpcode::RDMA_WRITE, payload, 64, 2),
+              "post_send failed");
+
+  std::vector<CompletionEntry> sends;
+  TEST_ASSERT(collect(dev, p.cq_a, 2, sends), "Missing send completions");
+  TEST_ASSERT(sends[0].wr_id == 1 &&
+                  sends[0].status == WcStatus::RETRY_EXC_ERR,
+              "First send should fail with RETRY_EXC_ERR");
+  TEST_ASSERT(sends[1].wr_id == 2 && sends[1].status == WcStatus::WR_FLUSH_ERR,
+              "Second send should be flushed");
+  TransportStats stats = dev.get_transport_stats();
+  TEST_ASSERT(stats.ack_timeouts == 3, "Expected retry_cnt + 1 timeouts");
+  TEST_ASSERT(stats.tx_retransmitted == 4, "Expected two retransmissions each");
+  TEST_ASSERT(qp_state(dev, p.qp_a) == QpState::ERR, "QP should be in ERR");
+  return true;
+}
+
+// 目的QP不存在：包被丢弃而不是当作已确认，ACK超时重试耗尽后 RETRY_EXC_ERR
+bool test_unknown_destination() {
+  std::cout << "\nTesting RC send to an unknown QP..." << std::endl;
+
+  for (bool timed : {false, true}) {
+    RdmaDevice dev;
+    if (timed) {
+      dev.set_link_bandwidth(100);
+    }
+    RcParams params;
+    params.timeout = 4; // 约65us
+    params.retry_cnt = 2;
+    uint32_t cq = dev.create_cq(16);
+    uint32_t qp = dev.create_qp(16, 16, cq, cq);
+    TEST_ASSERT(cq && qp, "Failed to create resources");
+    QPValue local, ghost;
+    dev.get_qp_info(qp, local);
+    ghost.qp_num = 0xFFFFF0; // 没有设备拥有的QP号
+    TEST_ASSERT(bring_up(dev, qp, local, ghost, params), "bring_up failed");
+
+    char payload[64] = "nowhere";
+    TEST_ASSERT(post(dev, qp, RdmaOpcode::SEND, payload, 64, 1),
+                "post_send failed");
+    TEST_ASSERT(post(dev, qp, RdmaOpcode::RDMA_WRITE, payload, 64, 2),
+                "post_send failed");
+    std::vector<CompletionEntry> sends;
+    TEST_ASSERT(collect(dev, cq, 2, sends), "Missing send completions");
+    TEST_ASSERT(sends[0].wr_id == 1 &&
+                    sends[0].status == WcStatus::RETRY_EXC_ERR,
+                std::string(timed ? "Timed" : "Sync") +
+                    " path completed an unacknowledged send");
+    TEST_ASSERT(sends[1].wr_id == 2 &&
+                    sends[1].status == WcStatus::WR_FLUSH_ERR,
+                "Second send should be flushed");
+    TEST_ASSERT(dev.get_transport_stats().ack_timeouts == 3,
+                "Expected retry_cnt + 1 timeouts");
+    TEST_ASSERT(qp_state(dev, qp) == QpState::ERR, "QP should be in ERR");
+  }
+  return true;
+}
+
+// 窗口内流水发送 4KB RDMA_WRITE，统计 post 到发送完成的时延分布
+static bool measure_latency(double loss, uint8_t timeout,
+                            std::vector<double> &latencies_us,
+                            TransportStats &stats, LinkStats &link_stats) {
+  RdmaDevice dev;
+  LinkConfig link;
+  link.bandwidth_gbps = 100;
+  link.propagation_delay_ns = 1000;
+  link.loss_probability = loss;
+  dev.configure_link(link);
+
+  RcParams params;
+  params.timeout = timeout;
+  QpPair p;
+  const uint32_t kWindow = 16;
+  TEST_ASSERT(setup_rc_pair(dev, p, params, kWindow),
+              "Failed to set up QP pair");
+
+  const uint32_t kMessages = 20000;
+  const uint32_t kLength = 4096;
+  std::vector<char> src(kLength, 'x');
+  std::vector<char> dst(kLength, 0);
+  std::vector<std::chrono::steady_clock::time_point> posted(kMessages);
+  latencies_us.clear();
+  latencies_us.reserve(kMessages);
+
+  uint32_t next = 0;
+  std::vector<CompletionEntry> comps;
+  while (latencies_us.size() < kMessages) {
+    while (next < kMessages && next - latencies_us.size() < kWindow) {
+      posted[next] = std::chrono::steady_clock::now();
+      TEST_ASSERT(post(dev, p.qp_a, RdmaOpcode::RDMA_WRITE, src.data(),
+                       kLength, next, dst.data()),
+                  "post_send failed");
+      ++next;
+    }
+    comps.clear();
+    TEST_ASSERT(dev.wait_cq(p.cq_a, comps, kWindow, 1000),
+                "Send completions stalled");
+    auto now = std::chrono::steady_clock::now();
+    for (const CompletionEntry &c : comps) {
+      TEST_ASSERT(c.status == WcStatus::SUCCESS, "Send failed");
+      latencies_us.push_back(
+          std::chrono::duration<double, std::micro>(now - posted[c.wr_id])
+              .count());
+    }
+  }
+  TEST_ASSERT(dst == src, "RDMA_WRITE payload corrupted");
+  stats = dev.get_transport_stats();
+  link_stats = dev.get_link_stats();
+  std::sort(latencies_us.begin(), latencies_us.end());
+  return true;
+}
+
+static double percentile(const std::vector<double> &sorted, double p) {
+  size_t index = static_cast<size_t>(p * (sorted.size() - 1));
+  return sorted[index];
+}
+
+// 0.01% 丢包下的尾时延：丢包影响的是极少数消息，中位数不变，
+// 尾部取决于恢复方式（乱序NAK约一个往返，尾包丢失则要等ACK超时）
+bool test_tail_latency() {
+  std::cout << "\nMeasuring tail latency under 0.01% loss..." << std::endl;
+
+  const double losses[] = {0.0, 0.0001};
+  std::vector<double> p50(2), p999(2);
+  for (int i = 0; i < 2; ++i) {
+    std::vector<double> lat;
+    TransportStats stats;
+    LinkStats link_stats;
+    TEST_ASSERT(measure_latency(losses[i], 10, lat, stats, link_stats),
+                "Latency run failed");
+    p50[i] = percentile(lat, 0.5);
+    p999[i] = percentile(lat, 0.999);
+    std::cout << "loss=" << losses[i] << " p50=" << p50[i]
+              << "us p99=" << percentile(lat, 0.99) << "us p99.9=" << p999[i]
+              << "us p99.99=" << percentile(lat, 0.9999)
+              << "us max=" << lat.back() << "us lost="
+              << link_stats.lost_packets
+              << " retransmitted=" << stats.tx_retransmitted
+              << " seq_naks=" << stats.seq_naks
+              << " timeouts=" << stats.ack_timeouts << std::endl;
+    TEST_ASSERT(stats.tx_retransmitted >= link_stats.lost_packets,
+                "Every lost packet must be retransmitted");
+    if (losses[i] == 0) {
+      TEST_ASSERT(stats.tx_retransmitted == 0, "Unexpected retransmission");
+    }
+  }
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA Reliability Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"Loss Recovery", test_loss_recovery},
+      {"Loss Recovery Cached", test_loss_recovery_cached},
+      {"RNR Retry", test_rnr_retry},
+      {"Retry Exceeded", test_retry_exceeded},
+      {"Unknown Destination", test_unknown_destination},
+      {"Tail Latency", test_tail_latency}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
@@ -0,0 +1,139 @@
+#ifndef RDMA_TEST_UTIL_H
+#define RDMA_TEST_UTIL_H
+
+#include "../include/rdma_device.h"
+#include "../include/rdma_types.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// 测试共用的辅助函数
+
+// 轮询条件直到成立或超时
+inline bool wait_until(const std::function<bool()> &done, int timeout_ms) {
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (!done()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+// 在同一设备上创建一对互联的QP
+struct QpPair {
+  uint32_t cq_a, qp_a;
+  uint32_t cq_b, qp_b;
+};
+
+// QP对的创建参数
+struct PairConfig {
+  uint32_t depth = 16;     // 每个QP的发送/接收队列深度
+  uint32_t cqe = 64;       // 每个CQ的容量
+  uint32_t cqe_b = 0;      // B端CQ容量，0 表示与 cqe 相同
+  uint32_t channel_b = 0;  // B端CQ绑定的完成通道，0 表示不绑定
+  uint32_t max_inline_data = 0;
+  uint32_t max_sge = 1;
+};
+
+// 只创建CQ与QP，QP停留在 RESET，由调用方按需要的属性建链
+inline bool create_pair(RdmaDevice &dev, QpPair &p,
+                        const PairConfig &config = PairConfig()) {
+  p.cq_a = dev.create_cq(config.cqe);
+  p.cq_b = dev.create_cq(config.cqe_b ? config.cqe_b : config.cqe,
+                         config.channel_b);
+  p.qp_a = dev.create_qp(config.depth, config.depth, p.cq_a, p.cq_a,
+                         config.max_inline_data, config.max_sge);
+  p.qp_b = dev.create_qp(config.depth, config.depth, p.cq_b, p.cq_b,
+                         config.max_inline_data, config.max_sge);
+  return p.cq_a && p.cq_b && p.qp_a && p.qp_b;
+}
+
+inline bool setup_pair(RdmaDevice &dev, QpPair &p, const PairConfig &config) {
+  if (!create_pair(dev, p, config)) {
+    return false;
+  }
+
+  QPValue info_a, info_b;
+  dev.get_qp_info(p.qp_a, info_a);
+  dev.get_qp_info(p.qp_b, info_b);
+  dev.connect_qp(p.qp_a, info_b);
+  dev.connect_qp(p.qp_b, info_a);
+  for (uint32_t qp : {p.qp_a, p.qp_b}) {
+    dev.modify_qp_state(qp, QpState::INIT);
+    dev.modify_qp_state(qp, QpState::RTR);
+    dev.modify_qp_state(qp, QpState::RTS);
+  }
+  return true;
+}
+
+inline bool setup_pair(RdmaDevice &dev, QpPair &p,
+                       uint32_t max_inline_data = 0, uint32_t max_sge = 1) {
+  PairConfig config;
+  config.max_inline_data = max_inline_data;
+  config.max_sge = max_sge;
+  return setup_pair(dev, p, config);
+}
+
+inline bool post_recv_buf(RdmaDevice &dev, uint32_t qp, void *buf,
+                          uint32_t length, uint64_t wr_id) {
+  RdmaWorkRequest wr;
+  wr.opcode = RdmaOpcode::RECV;
+  wr.local_addr = buf;
+  wr.length = length;
+  wr.wr_id = wr_id;
+  return dev.post_recv(qp, wr);
+}
+
+// 收齐 count 个完成（追加到 out），超时返回 false
+inline bool collect(RdmaDevice &dev, uint32_t cq, size_t count,
+                    std::vector<CompletionEntry> &out,
+                    int timeout_ms = 10000) {
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(timeout_ms);
+  while (out.size() < count) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    dev.wait_cq(cq, out, static_cast<uint32_t>(count - out.size()), 10);
+  }
+  return out.size() == count;
+}
+
+// 在QP对上逐条收发 count 条消息，signaled 控制是否请求并等待发送完成
+inline bool exchange(RdmaDevice &dev, const QpPair &p, int count,
+                     uint32_t length = 256, bool signaled = true) {
+  std::vector<char> send_buf(length, 's');
+  std::vector<char> recv_buf(length, 0);
+  for (int i = 0; i < count; ++i) {
+    RdmaWorkRequest recv_wr;
+    recv_wr.opcode = RdmaOpcode::RECV;
+    recv_wr.local_addr = recv_buf.data();
+    recv_wr.length = length;
+    recv_wr.wr_id = i;
+    if (!dev.post_recv(p.qp_b, recv_wr)) {
+      return false;
+    }
+    RdmaWorkRequest wr;
+    wr.opcode = RdmaOpcode::SEND;
+    wr.local_addr = send_buf.data();
+    wr.length = length;
+    wr.signaled = signaled;
+    wr.wr_id = i;
+    if (!dev.post_send(p.qp_a, wr)) {
+      return false;
+    }
+    std::vector<CompletionEntry> recv_comps, send_comps;
+    if (!collect(dev, p.cq_b, 1, recv_comps) ||
+        (signaled && !collect(dev, p.cq_a, 1, send_comps))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif // RDMA_TEST_UTIL_H
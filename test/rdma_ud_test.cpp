@@ -0,0 +1,432 @@
+#include "../include/rdma_device.h"
+#include "../include/rdma_types.h"
+#include "rdma_test_util.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 测试辅助宏
+#define TEST_ASSERT(condition, message)                                        \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::cerr << "Assertion failed: " << message << std::endl;               \
+      std::cerr << "File: " << __FILE__ << ", Line: " << __LINE__              \
+                << std::endl;                                                  \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+const uint32_t kQkey = 0x11111111;
+
+// 按 UD 的属性掩码把QP迁移到 RTS
+static bool bring_up_ud(RdmaDevice &dev, uint32_t qp, uint32_t qkey = kQkey) {
+  QpAttr attr;
+  attr.qp_state = QpState::INIT;
+  attr.qkey = qkey;
+  if (!dev.modify_qp(qp, attr,
+                     QP_ATTR_STATE | QP_ATTR_PKEY_INDEX | QP_ATTR_PORT |
+                         QP_ATTR_QKEY)) {
+    return false;
+  }
+  attr.qp_state = QpState::RTR;
+  if (!dev.modify_qp(qp, attr, QP_ATTR_STATE)) {
+    return false;
+  }
+  attr.qp_state = QpState::RTS;
+  return dev.modify_qp(qp, attr, QP_ATTR_STATE | QP_ATTR_SQ_PSN);
+}
+
+static uint32_t create_ud_qp(RdmaDevice &dev, uint32_t cq) {
+  uint32_t qp = dev.create_qp(64, 64, cq, cq, 0, 1, QpType::UD);
+  return qp != 0 && bring_up_ud(dev, qp) ? qp : 0;
+}
+
+static bool post_ud_send(RdmaDevice &dev, uint32_t qp, uint32_t ah,
+                         uint32_t remote_qpn, void *buf, uint32_t length,
+                         uint64_t wr_id, uint32_t qkey = kQkey) {
+  RdmaWorkRequest wr;
+  wr.opcode = RdmaOpcode::SEND;
+  wr.local_addr = buf;
+  wr.length = length;
+  wr.wr_id = wr_id;
+  wr.ah = ah;
+  wr.remote_qpn = remote_qpn;
+  wr.remote_qkey = qkey;
+  return dev.post_send(qp, wr);
+}
+
+// 一个UD QP按消息发往不同设备上的多个对端；GRH写入接收缓冲区开头
+bool test_ud_fanout() {
+  std::cout << "\nTesting UD fan-out with address handles..." << std::endl;
+
+  RdmaDevice sender_dev;
+  RdmaDevice peer_dev;
+  uint32_t send_cq = sender_dev.create_cq(64);
+  uint32_t recv_cq = peer_dev.create_cq(64);
+  uint32_t sender = create_ud_qp(sender_dev, send_cq);
+  TEST_ASSERT(sender != 0, "Failed to create sender UD QP");
+
+  const int kPeers = 3;
+  uint32_t peers[kPeers];
+  std::vector<std::vector<char>> bufs(kPeers, std::vector<char>(1024 + 64, 0));
+  for (int i = 0; i < kPeers; ++i) {
+    peers[i] = create_ud_qp(peer_dev, recv_cq);
+    TEST_ASSERT(peers[i] != 0, "Failed to create peer UD QP");
+    TEST_ASSERT(post_recv_buf(peer_dev, peers[i], bufs[i].data(),
+                              static_cast<uint32_t>(bufs[i].size()), 100 + i),
+                "post_recv failed");
+  }
+
+  // 带GRH的地址句柄和只有LID的地址句柄
+  AhAttr global;
+  global.is_global = true;
+  global.dgid[15] = 0x2A;
+  global.hop_limit = 7;
+  global.traffic_class = 3;
+  global.flow_label = 0x12345;
+  uint32_t ah_grh = sender_dev.create_ah(global);
+  AhAttr local;
+  local.dlid = 9;
+  uint32_t ah_lid = sender_dev.create_ah(local);
+  TEST_ASSERT(ah_grh != 0 && ah_lid != 0, "create_ah failed");
+  TEST_ASSERT(sender_dev.create_ah(AhAttr()) == 0,
+              "AH without dlid or GRH should fail");
+
+  char payload[kPeers][32];
+  for (int i = 0; i < kPeers; ++i) {
+    snprintf(payload[i], sizeof(payload[i]), "heartbeat-%d", i);
+    TEST_ASSERT(post_ud_send(sender_dev, sender, i == 2 ? ah_lid : ah_grh,
+                             peers[i], payload[i], sizeof(payload[i]), i),
+                "UD post_send failed");
+  }
+
+  std::vector<CompletionEntry> sends, recvs;
+  TEST_ASSERT(collect(sender_dev, send_cq, kPeers, sends),
+              "Missing UD send completions");
+  TEST_ASSERT(collect(peer_dev, recv_cq, kPeers, recvs),
+              "Missing UD recv completions");
+  for (int i = 0; i < kPeers; ++i) {
+    const CompletionEntry &c = recvs[i];
+    TEST_ASSERT(c.status == WcStatus::SUCCESS && c.wr_id == 100u + i,
+                "Unexpected recv completion");
+    TEST_ASSERT(c.src_qp == sender, "Recv completion should carry src_qp");
+    TEST_ASSERT(c.length == sizeof(payload[i]) + RDMA_GRH_BYTES,
+                "UD recv length should include the GRH area");
+    TEST_ASSERT(std::memcmp(bufs[i].data() + RDMA_GRH_BYTES, payload[i],
+                            sizeof(payload[i])) == 0,
+                "Payload should follow the GRH area");
+    TEST_ASSERT(c.grh == (i != 2), "GRH flag should follow the AH");
+  }
+
+  RdmaGrh grh;
+  std::memcpy(&grh, bufs[0].data(), sizeof(grh));
+  TEST_ASSERT(grh.dgid[15] == 0x2A && grh.hop_limit == 7,
+              "GRH dgid/hop_limit mismatch");
+  TEST_ASSERT(ntohs(grh.paylen) == sizeof(payload[0]), "GRH paylen mismatch");
+  TEST_ASSERT(ntohl(grh.version_tclass_flow) ==
+                  ((6u << 28) | (3u << 20) | 0x12345),
+              "GRH version/traffic class/flow label mismatch");
+  TEST_ASSERT(sender_dev.destroy_ah(ah_grh), "destroy_ah failed");
+  TEST_ASSERT(!post_ud_send(sender_dev, sender, ah_grh, peers[0], payload[0],
+                            8, 9),
+              "Send with destroyed AH should fail");
+  return true;
+}
+
+// UD 的限制：单包消息、只支持 SEND、必须有AH、不能 connect_qp、
+// 建链属性掩码不同于RC
+bool test_ud_limits() {
+  std::cout << "\nTesting UD limits..." << std::endl;
+
+  RdmaDevice dev;
+  uint32_t cq = dev.create_cq(64);
+  uint32_t qp = dev.create_qp(16, 16, cq, cq, 0, 1, QpType::UD);
+  uint32_t peer = create_ud_qp(dev, cq);
+  TEST_ASSERT(qp != 0 && peer != 0, "Failed to create UD QPs");
+
+  QpAttr attr;
+  attr.qp_state = QpState::INIT;
+  attr.qp_access_flags = 0x7;
+  TEST_ASSERT(!dev.modify_qp(qp, attr,
+                             QP_ATTR_STATE | QP_ATTR_PKEY_INDEX |
+                                 QP_ATTR_PORT | QP_ATTR_ACCESS_FLAGS),
+              "UD RESET->INIT without QKEY should fail");
+  TEST_ASSERT(bring_up_ud(dev, qp), "UD bring-up failed");
+  QPValue peer_info;
+  dev.get_qp_info(peer, peer_info);
+  TEST_ASSERT(!dev.connect_qp(qp, peer_info), "connect_qp on UD should fail");
+
+  AhAttr ah_attr;
+  ah_attr.dlid = 1;
+  uint32_t ah = dev.create_ah(ah_attr);
+  std::vector<char> big(2048, 'x');
+  TEST_ASSERT(!post_ud_send(dev, qp, ah, peer, big.data(), 1025, 1),
+              "UD message above MTU should fail");
+  TEST_ASSERT(!post_ud_send(dev, qp, 0, peer, big.data(), 64, 2),
+              "UD send without AH should fail");
+  RdmaWorkRequest write;
+  write.opcode = RdmaOpcode::RDMA_WRITE;
+  write.local_addr = big.data();
+  write.length = 64;
+  write.remote_addr = big.data() + 1024;
+  write.ah = ah;
+  write.remote_qpn = peer;
+  TEST_ASSERT(!dev.post_send(qp, write), "RDMA_WRITE on UD should fail");
+  TEST_ASSERT(post_ud_send(dev, qp, ah, peer, big.data(), 1024, 3),
+              "MTU-sized UD message should succeed");
+  return true;
+}
+
+// 数据报不可靠：Q_Key 不符或没有接收WQE时静默丢弃，发送端照常成功；
+// 接收缓冲区放不下 GRH 区加负载时以 LOC_LEN_ERR 完成
+bool test_ud_drops() {
+  std::cout << "\nTesting UD drops..." << std::endl;
+
+  RdmaDevice dev;
+  uint32_t cq_a = dev.create_cq(64);
+  uint32_t cq_b = dev.create_cq(64);
+  uint32_t a = create_ud_qp(dev, cq_a);
+  uint32_t b = create_ud_qp(dev, cq_b);
+  AhAttr ah_attr;
+  ah_attr.dlid = 1;
+  uint32_t ah = dev.create_ah(ah_attr);
+  TEST_ASSERT(a != 0 && b != 0 && ah != 0, "Failed to create resources");
+
+  char msg[64] = "datagram";
+  TEST_ASSERT(post_ud_send(dev, a, ah, b, msg, sizeof(msg), 1),
+              "post_send failed");
+  char small[64];
+  TEST_ASSERT(post_recv_buf(dev, b, small, sizeof(small), 10),
+              "post_recv failed");
+  TEST_ASSERT(post_ud_send(dev, a, ah, b, msg, sizeof(msg), 2, kQkey + 1),
+              "post_send failed");
+  TEST_ASSERT(post_ud_send(dev, a, ah, b, msg, sizeof(msg), 3),
+              "post_send failed");
+
+  std::vector<CompletionEntry> sends, recvs;
+  TEST_ASSERT(collect(dev, cq_a, 3, sends), "Missing send completions");
+  for (const CompletionEntry &c : sends) {
+    TEST_ASSERT(c.status == WcStatus::SUCCESS, "UD send should succeed");
+  }
+  TEST_ASSERT(collect(dev, cq_b, 1, recvs), "Missing recv completion");
+  TEST_ASSERT(recvs[0].wr_id == 10 && recvs[0].status == WcStatus::LOC_LEN_ERR,
+              "64-byte buffer cannot hold GRH area plus 64-byte payload");
+  TransportStats stats = dev.get_transport_stats();
+  TEST_ASSERT(stats.rx_dropped == 2, "No-recv and Q_Key mismatch should drop");
+  TEST_ASSERT(stats.rnr_naks == 0 && stats.rx_out_of_sequence == 0,
+              "UD must not use RNR or PSN checks");
+  return true;
+}
+
+// 链路路径：UD 发送在上线后完成，线上丢失不重传
+bool test_ud_over_link() {
+  std::cout << "\nTesting UD over the link model..." << std::endl;
+
+  RdmaDevice dev;
+  LinkConfig link;
+  link.bandwidth_gbps = 100;
+  link.propagation_delay_ns = 1000;
+  dev.configure_link(link);
+  uint32_t cq_a = dev.create_cq(64);
+  uint32_t cq_b = dev.create_cq(64);
+  uint32_t a = create_ud_qp(dev, cq_a);
+  uint32_t b = create_ud_qp(dev, cq_b);
+  AhAttr ah_attr;
+  ah_attr.is_global = true;
+  uint32_t ah = dev.create_ah(ah_attr);
+
+  char msg[512] = "over the wire";
+  std::vector<char> buf(1024, 0);
+  TEST_ASSERT(post_recv_buf(dev, b, buf.data(), 1024, 10), "post_recv failed");
+  TEST_ASSERT(post_ud_send(dev, a, ah, b, msg, sizeof(msg), 1),
+              "post_send failed");
+  std::vector<CompletionEntry> sends, recvs;
+  TEST_ASSERT(collect(dev, cq_a, 1, sends), "Missing send completion");
+  TEST_ASSERT(collect(dev, cq_b, 1, recvs), "Missing recv completion");
+  TEST_ASSERT(std::strcmp(buf.data() + RDMA_GRH_BYTES, msg) == 0,
+              "Payload mismatch");
+
+  // 全部丢包：发送仍然成功完成，接收端收不到
+  link.loss_probability = 1.0;
+  dev.configure_link(link);
+  TEST_ASSERT(post_recv_buf(dev, b, buf.data(), 1024, 11), "post_recv failed");
+  for (uint64_t i = 0; i < 4; ++i) {
+    TEST_ASSERT(post_ud_send(dev, a, ah, b, msg, sizeof(msg), 2 + i),
+                "post_send failed");
+  }
+  sends.clear();
+  TEST_ASSERT(collect(dev, cq_a, 4, sends), "Missing send completions");
+  recvs.clear();
+  TEST_ASSERT(!dev.wait_cq(cq_b, recvs, 1, 5), "Lost datagram was delivered");
+  TransportStats stats = dev.get_transport_stats();
+  TEST_ASSERT(dev.get_link_stats().lost_packets == 4, "Expected 4 lost packets");
+  TEST_ASSERT(stats.tx_retransmitted == 0, "UD must not retransmit");
+  return true;
+}
+
+// 发送线程持续向另一设备上的QP发包时析构该设备：
+// 析构等待进行中的投递结束，之后的包因目的QP不存在被丢弃，发送照常完成
+bool test_peer_teardown() {
+  std::cout << "\nTesting peer device teardown during sends..." << std::endl;
+
+  RdmaDevice sender_dev;
+  std::unique_ptr<RdmaDevice> peer_dev(new RdmaDevice());
+  uint32_t send_cq = sender_dev.create_cq(64);
+  uint32_t recv_cq = peer_dev->create_cq(64);
+  uint32_t sender = create_ud_qp(sender_dev, send_cq);
+  uint32_t peer = create_ud_qp(*peer_dev, recv_cq);
+  AhAttr ah_attr;
+  ah_attr.dlid = 3;
+  uint32_t ah = sender_dev.create_ah(ah_attr);
+  TEST_ASSERT(sender != 0 && peer != 0 && ah != 0,
+              "Failed to create resources");
+
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> posted{0};
+  std::atomic<uint64_t> failed{0};
+  std::thread worker([&] {
+    char msg[64] = "teardown";
+    std::vector<CompletionEntry> comps;
+    while (!stop.load()) {
+      if (post_ud_send(sender_dev, sender, ah, peer, msg, sizeof(msg),
+                       posted.load())) {
+        posted.fetch_add(1);
+      }
+      comps.clear();
+      sender_dev.poll_cq(send_cq, comps, 16);
+      for (const CompletionEntry &c : comps) {
+        if (c.status != WcStatus::SUCCESS) {
+          failed.fetch_add(1);
+        }
+      }
+    }
+  });
+
+  while (posted.load() < 1000) {
+    std::this_thread::yield();
+  }
+  peer_dev.reset();
+  uint64_t after_teardown = posted.load();
+  while (posted.load() < after_teardown + 1000) {
+    std::this_thread::yield();
+  }
+  stop.store(true);
+  worker.join();
+  TEST_ASSERT(failed.load() == 0, "UD sends should succeed");
+  return true;
+}
+
+// 向 N 个对端发心跳：RC 需要 N 个QP（超出设备容量后溢出到缓存/主机层），
+// UD 只需要一个QP和 N 个地址句柄
+bool test_memory_footprint() {
+  std::cout << "\nComparing RC and UD footprint for heartbeats..." << std::endl;
+
+  const uint32_t kPeers = 2000;
+  RdmaDevice peer_dev(1024, kPeers + 16, 16);
+  uint32_t peer_cq = peer_dev.create_cq(kPeers * 2);
+  std::vector<uint32_t> peers;
+  TEST_ASSERT(peer_dev.create_qp_batch(kPeers, 4, 4, peer_cq, peer_cq, peers, 0,
+                                       1, QpType::UD),
+              "Failed to create peer QPs");
+  std::vector<char> recv_bufs(kPeers * 128);
+  for (uint32_t i = 0; i < kPeers; ++i) {
+    TEST_ASSERT(bring_up_ud(peer_dev, peers[i]), "Peer bring-up failed");
+    TEST_ASSERT(post_recv_buf(peer_dev, peers[i], &recv_bufs[i * 128], 128, i),
+                "post_recv failed");
+  }
+
+  // RC：每个对端一个QP
+  RdmaDevice rc_dev;
+  uint32_t rc_cq = rc_dev.create_cq(64);
+  std::vector<uint32_t> rc_qps;
+  auto start = std::chrono::steady_clock::now();
+  TEST_ASSERT(rc_dev.create_qp_batch(kPeers, 16, 16, rc_cq, rc_cq, rc_qps),
+              "Failed to create RC QPs");
+  auto rc_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+
+  // UD：一个QP加每个对端一个地址句柄
+  RdmaDevice ud_dev;
+  uint32_t ud_cq = ud_dev.create_cq(kPeers * 2);
+  start = std::chrono::steady_clock::now();
+  uint32_t ud_qp = create_ud_qp(ud_dev, ud_cq);
+  std::vector<uint32_t> ahs(kPeers);
+  for (uint32_t i = 0; i < kPeers; ++i) {
+    AhAttr attr;
+    attr.is_global = true;
+    attr.dgid[12] = static_cast<uint8_t>(i >> 8);
+    attr.dgid[13] = static_cast<uint8_t>(i);
+    ahs[i] = ud_dev.create_ah(attr);
+    TEST_ASSERT(ahs[i] != 0, "create_ah failed");
+  }
+  auto ud_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+
+  const size_t rc_bytes = kPeers * sizeof(QPValue);
+  const size_t ud_bytes = sizeof(QPValue) + kPeers * sizeof(AhAttr);
+  std::cout << "peers=" << kPeers << " RC: " << kPeers << " QPs, " << rc_bytes
+            << " bytes of QP state, setup " << rc_us << "us" << std::endl;
+  std::cout << "peers=" << kPeers << " UD: 1 QP + " << kPeers << " AHs, "
+            << ud_bytes << " bytes, setup " << ud_us << "us ("
+            << rc_bytes / ud_bytes << "x smaller)" << std::endl;
+  TEST_ASSERT(ud_bytes * 10 < rc_bytes, "UD should need far less state");
+
+  // 心跳经同一个UD QP逐个发往所有对端
+  uint64_t beat = 0x4845415254ULL;
+  for (uint32_t i = 0; i < kPeers; ++i) {
+    while (!post_ud_send(ud_dev, ud_qp, ahs[i], peers[i], &beat, sizeof(beat),
+                         i)) {
+      std::vector<CompletionEntry> drained;
+      ud_dev.poll_cq(ud_cq, drained, 64); // 发送队列满时回收完成
+    }
+  }
+  std::vector<CompletionEntry> recvs;
+  TEST_ASSERT(collect(peer_dev, peer_cq, kPeers, recvs),
+              "Missing heartbeats");
+  for (const CompletionEntry &c : recvs) {
+    TEST_ASSERT(c.status == WcStatus::SUCCESS && c.src_qp == ud_qp,
+                "Unexpected heartbeat completion");
+  }
+  return true;
+}
+
+int main() {
+  std::cout << "Starting RDMA UD Tests..." << std::endl;
+
+  bool all_tests_passed = true;
+
+  std::vector<std::pair<std::string, std::function<bool()>>> tests = {
+      {"UD Fan-out", test_ud_fanout},
+      {"UD Limits", test_ud_limits},
+      {"UD Drops", test_ud_drops},
+      {"UD Over Link", test_ud_over_link},
+      {"Peer Teardown", test_peer_teardown},
+      {"Memory Footprint", test_memory_footprint}};
+
+  for (const auto &test : tests) {
+    std::cout << "\n=== Running Test: " << test.first << " ===" << std::endl;
+    if (!test.second()) {
+      std::cerr << "Test Failed: " << test.first << std::endl;
+      all_tests_passed = false;
+    } else {
+      std::cout << "Test Passed: " << test.first << std::endl;
+    }
+  }
+
+  std::cout << "\n=== Test Summary ===" << std::endl;
+  if (all_tests_passed) {
+    std::cout << "All tests passed successfully!" << std::endl;
+    return 0;
+  }
+  std::cerr << "Some tests failed!" << std::endl;
+  return 1;
+}
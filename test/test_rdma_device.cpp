@@ -1,5 +1,6 @@
 #include "../include/rdma_device.h"
 #include <cassert>
+#include <chrono>
 #include <functional>
 #include <iostream>
 #include <vector>
@@ -167,6 +168,79 @@ bool test_qp_state_transitions() {
   return true;
 }
 
+// 测试QP的批量创建和销毁：跨设备/中间缓存/主机三层分配，销毁后各层条目都被移除
+bool test_qp_batch_operations() {
+  std::cout << "\nTesting Batch Queue Pair Operations..." << std::endl;
+
+  // 设备容纳4个QP，中间缓存容纳8个，其余进入主机交换表
+  RdmaDevice device(1024, 4, 16, 16, 16);
+  uint32_t cq = device.create_cq(16);
+  TEST_ASSERT(cq != 0, "Failed to create completion queue");
+
+  std::vector<uint32_t> qps;
+  TEST_ASSERT(!device.create_qp_batch(8, 0, 8, cq, cq, qps),
+              "Batch with invalid send depth should fail");
+  TEST_ASSERT(!device.create_qp_batch(8, 8, 8, cq, cq + 100, qps),
+              "Batch with missing CQ should fail");
+  TEST_ASSERT(qps.empty(), "Failed batch should not create QPs");
+
+  TEST_ASSERT(device.create_qp_batch(20, 8, 8, cq, cq, qps),
+              "Failed to create QP batch");
+  TEST_ASSERT(qps.size() == 20, "Unexpected batch size");
+  for (size_t i = 1; i < qps.size(); ++i) {
+    TEST_ASSERT(qps[i] == qps[0] + i, "QP numbers should be contiguous");
+  }
+  QPValue info;
+  for (uint32_t qp : qps) {
+    TEST_ASSERT(device.get_qp_info(qp, info) && info.qp_num == qp,
+                "Batch QP not reachable");
+    TEST_ASSERT(info.state == QpState::RESET && info.max_send_wr == 8,
+                "Batch QP has unexpected attributes");
+  }
+
+  std::vector<uint32_t> half(qps.begin(), qps.begin() + 10);
+  TEST_ASSERT(device.destroy_qp_batch(half) == 10, "Failed to destroy half");
+  TEST_ASSERT(device.destroy_qp_batch(half) == 0,
+              "Destroyed QPs should not be found again");
+  std::vector<uint32_t> rest(qps.begin() + 10, qps.end());
+  TEST_ASSERT(device.destroy_qp_batch(rest) == 10, "Failed to destroy rest");
+  for (uint32_t qp : qps) {
+    TEST_ASSERT(!device.get_qp_info(qp, info), "Destroyed QP still reachable");
+  }
+
+  // 释放后的容量可以再次使用：新批次重新占满设备资源
+  qps.clear();
+  TEST_ASSERT(device.create_qp_batch(4, 8, 8, cq, cq, qps),
+              "Failed to reuse freed capacity");
+
+  // 批量与逐个创建/销毁的耗时对比
+  const uint32_t kQps = 40000;
+  RdmaDevice big(1024, kQps, 16, 16, 16);
+  uint32_t big_cq = big.create_cq(16);
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<uint32_t> single;
+  for (uint32_t i = 0; i < kQps; ++i) {
+    single.push_back(big.create_qp(8, 8, big_cq, big_cq));
+  }
+  for (uint32_t qp : single) {
+    big.destroy_qp(qp);
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  std::vector<uint32_t> batch;
+  TEST_ASSERT(big.create_qp_batch(kQps, 8, 8, big_cq, big_cq, batch),
+              "Failed to create large batch");
+  TEST_ASSERT(big.destroy_qp_batch(batch) == kQps,
+              "Failed to destroy large batch");
+  auto t2 = std::chrono::steady_clock::now();
+  auto ms = [](std::chrono::steady_clock::duration d) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+  };
+  std::cout << kQps << " QPs create+destroy: single " << ms(t1 - t0)
+            << " ms, batch " << ms(t2 - t1) << " ms" << std::endl;
+
+  return true;
+}
+
 // 主测试函数
 int main() {
   std::cout << "Starting RDMA Device Tests..." << std::endl;
@@ -178,6 +252,7 @@ int main() {
       {"Protection Domain Operations", test_pd_operations},
       {"Completion Queue Operations", test_cq_operations},
       {"Queue Pair Operations", test_qp_operations},
+      {"Batch Queue Pair Operations", test_qp_batch_operations},
       {"Memory Region Operations", test_mr_operations},
       {"QP State Transitions", test_qp_state_transitions}};
 
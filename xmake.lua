@@ -13,6 +13,8 @@ if is_mode("debug") then
     set_symbols("debug")
     set_optimize("none")
     add_defines("DEBUG")
+    -- 调试构建保留 TRACE 级日志（运行期仍由 RDMA_LOG_LEVEL 控制是否输出）
+    add_defines("RDMA_LOG_COMPILE_LEVEL=0")
 elseif is_mode("release") then
     set_symbols("hidden")
     set_optimize("fastest")
@@ -45,6 +47,132 @@ target("rdma_communication_test")
     add_deps("rdmasim")
     add_links("pthread")
 
+-- 数据路径功能测试
+target("rdma_datapath_test")
+    set_kind("binary")
+    add_files("test/rdma_datapath_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- 完成队列通知/等待测试
+target("rdma_cq_test")
+    set_kind("binary")
+    add_files("test/rdma_cq_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- QP状态机/属性掩码/错误冲刷测试
+target("rdma_qp_state_test")
+    set_kind("binary")
+    add_files("test/rdma_qp_state_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- RC可靠传输（丢包重传/RNR/超时重试）测试
+target("rdma_reliability_test")
+    set_kind("binary")
+    add_files("test/rdma_reliability_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- UD数据报/地址句柄测试
+target("rdma_ud_test")
+    set_kind("binary")
+    add_files("test/rdma_ud_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- DC动态连接（DCI池/DCT）测试
+target("rdma_dc_test")
+    set_kind("binary")
+    add_files("test/rdma_dc_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- RC+缓存 与 DC 在大量对端下的对比工具
+target("rdma_dc_benchmark")
+    set_kind("binary")
+    add_files("test/rdma_dc_benchmark.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- 多发送处理引擎（QP分组/绑核）测试
+target("rdma_engine_test")
+    set_kind("binary")
+    add_files("test/rdma_engine_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- epoll 控制面（单线程多对端建链）测试
+target("rdma_control_plane_test")
+    set_kind("binary")
+    add_files("test/rdma_control_plane_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- 控制消息线上格式（固定头+TLV）测试
+target("rdma_control_codec_test")
+    set_kind("binary")
+    add_files("test/rdma_control_codec_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- 控制通道传输（TCP/Unix域套接字/进程内）测试
+target("rdma_control_transport_test")
+    set_kind("binary")
+    add_files("test/rdma_control_transport_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- 分级日志（编译期删除/异步环形缓冲输出）测试
+target("rdma_log_test")
+    set_kind("binary")
+    add_files("test/rdma_log_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- 连接管理器（异步建链，类似 rdma_cm）测试
+target("rdma_connection_manager_test")
+    set_kind("binary")
+    add_files("test/rdma_connection_manager_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- 设备性能计数器测试
+target("rdma_perf_counters_test")
+    set_kind("binary")
+    add_files("test/rdma_perf_counters_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- 缓存统计测试
+target("rdma_cache_metrics_test")
+    set_kind("binary")
+    add_files("test/rdma_cache_metrics_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- 投递到完成延迟直方图测试
+target("rdma_latency_histogram_test")
+    set_kind("binary")
+    add_files("test/rdma_latency_histogram_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- 批量/流水线建链测试
+target("rdma_handshake_test")
+    set_kind("binary")
+    add_files("test/rdma_handshake_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
+-- 链路带宽/调度/拥塞控制模型测试
+target("rdma_link_model_test")
+    set_kind("binary")
+    add_files("test/rdma_link_model_test.cpp")
+    add_deps("rdmasim")
+    add_links("pthread")
+
 -- 基准测试：缓存 vs 无缓存
 target("rdma_cache_benchmark")
     set_kind("binary")